@@ -0,0 +1,35 @@
+﻿if (CMAKE_VERSION VERSION_GREATER_EQUAL "3.10")
+    include_guard(GLOBAL)
+endif()
+
+# =========== 3rdparty liburing(optional) ==================
+# liburing is only used by the io_uring backend of io_stream channel, and it's optional.
+# When it's not found, io_stream channel will always use libuv.
+unset(ATBUS_MACRO_WITH_IO_URING)
+if (ATBUS_MACRO_ENABLE_IO_URING AND CMAKE_SYSTEM_NAME STREQUAL "Linux")
+    if (LIBURING_ROOT)
+        find_path(3RD_PARTY_LIBURING_INC_DIR NAMES liburing.h PATHS "${LIBURING_ROOT}/include" NO_DEFAULT_PATH)
+        find_library(3RD_PARTY_LIBURING_LINK_NAME NAMES uring PATHS "${LIBURING_ROOT}/lib" "${LIBURING_ROOT}/lib64" NO_DEFAULT_PATH)
+    else ()
+        find_path(3RD_PARTY_LIBURING_INC_DIR NAMES liburing.h)
+        find_library(3RD_PARTY_LIBURING_LINK_NAME NAMES uring)
+    endif ()
+
+    if (3RD_PARTY_LIBURING_INC_DIR AND 3RD_PARTY_LIBURING_LINK_NAME)
+        include(CheckSymbolExists)
+        set(CMAKE_REQUIRED_INCLUDES ${3RD_PARTY_LIBURING_INC_DIR})
+        # io_uring_setup_buf_ring is available since liburing 2.4
+        CHECK_SYMBOL_EXISTS(io_uring_setup_buf_ring "liburing.h" 3RD_PARTY_LIBURING_HAS_BUF_RING)
+        unset(CMAKE_REQUIRED_INCLUDES)
+    endif ()
+
+    if (3RD_PARTY_LIBURING_HAS_BUF_RING)
+        EchoWithColor(COLOR GREEN "-- Dependency: liburing found.(${3RD_PARTY_LIBURING_LINK_NAME})")
+        set(ATBUS_MACRO_WITH_IO_URING 1)
+        include_directories(${3RD_PARTY_LIBURING_INC_DIR})
+        # all targets which link libuv link libatbus, so just append it into the dependency list of libuv
+        list(APPEND 3RD_PARTY_LIBUV_LINK_DEPS ${3RD_PARTY_LIBURING_LINK_NAME})
+    else ()
+        EchoWithColor(COLOR YELLOW "-- Dependency: liburing(>=2.4) not found, io_uring backend of io_stream channel is disabled.")
+    endif ()
+endif ()
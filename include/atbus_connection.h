@@ -28,6 +28,7 @@
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_config.h"
 #include "detail/libatbus_error.h"
+#include "detail/timer_wheel.h"
 
 namespace atbus {
     namespace protocol {
@@ -95,6 +96,21 @@ namespace atbus {
          */
         int proc(node &n, time_t sec, time_t usec);
 
+        /**
+         * @brief 执行一帧，最多接收max_bytes字节
+         * @param sec 当前时间-秒
+         * @param usec 当前时间-微秒
+         * @param max_bytes 本帧最多接收的字节数，最后一条消息可能超出
+         * @param recv_bytes 输出本帧接收的字节数，可以为NULL
+         * @return 本帧处理的消息数
+         */
+        int proc(node &n, time_t sec, time_t usec, size_t max_bytes, size_t *recv_bytes);
+
+        /**
+         * @brief 是否可能有待接收的数据，只检查通道的读写游标，不支持检查的连接总是返回true
+         */
+        bool has_pending_data();
+
         /**
          * @brief 监听数据接收地址
          * @param addr 监听地址
@@ -128,6 +144,16 @@ namespace atbus {
          */
         int push(const void *buffer, size_t s);
 
+        /**
+         * @brief 把多个数据块作为一条消息发送
+         * @param buffers 数据块地址数组
+         * @param sizes 数据块长度数组
+         * @param count 数据块数量
+         * @return 0或错误码
+         * @note 流式通道直接把各个数据块复制进发送缓冲区，其他通道先合并再发送
+         */
+        int push_v(const void *const *buffers, const size_t *sizes, size_t count);
+
         /**
          * @brief 获取连接的地址
          */
@@ -180,14 +206,18 @@ namespace atbus {
                                         void *buffer, size_t s);
 
 #ifdef ATBUS_CHANNEL_SHM
-        static int shm_proc_fn(node &n, connection &conn, time_t sec, time_t usec);
+        static int shm_proc_fn(node &n, connection &conn, time_t sec, time_t usec, size_t max_bytes, size_t *recv_bytes);
+
+        static bool shm_check_fn(connection &conn);
 
         static int shm_free_fn(node &n, connection &conn);
 
         static int shm_push_fn(connection &conn, const void *buffer, size_t s);
 #endif
 
-        static int mem_proc_fn(node &n, connection &conn, time_t sec, time_t usec);
+        static int mem_proc_fn(node &n, connection &conn, time_t sec, time_t usec, size_t max_bytes, size_t *recv_bytes);
+
+        static bool mem_check_fn(connection &conn);
 
         static int mem_free_fn(node &n, connection &conn);
 
@@ -197,7 +227,14 @@ namespace atbus {
 
         static int ios_push_fn(connection &conn, const void *buffer, size_t s);
 
-        static bool unpack(void *res, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s);
+        static int ios_push_v_fn(connection &conn, const void *const *buffers, const size_t *sizes, size_t count);
+
+        /**
+         * @brief 解包消息
+         * @note 消息中的二进制数据直接引用buffer，所以buffer必须在m使用完之前一直有效
+         * @note 解包使用的内存从zone分配(msgpack::zone*)，所以zone也必须在m使用完之前一直有效
+         */
+        static bool unpack(void *zone_ptr, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s);
 
     private:
         state_t::type state_;
@@ -236,19 +273,28 @@ namespace atbus {
 #endif
                 conn_data_ios ios_fd;
             } shared_t;
-            typedef int (*proc_fn_t)(node &n, connection &conn, time_t sec, time_t usec);
+            typedef int (*proc_fn_t)(node &n, connection &conn, time_t sec, time_t usec, size_t max_bytes, size_t *recv_bytes);
+            typedef bool (*check_fn_t)(connection &conn);
             typedef int (*free_fn_t)(node &n, connection &conn);
             typedef int (*push_fn_t)(connection &conn, const void *buffer, size_t s);
+            typedef int (*push_v_fn_t)(connection &conn, const void *const *buffers, const size_t *sizes, size_t count);
 
             shared_t shared;
             proc_fn_t proc_fn;
+            check_fn_t check_fn; // 可选，检查是否有待接收的数据，为空时总是轮询
             free_fn_t free_fn;
             push_fn_t push_fn;
+            push_v_fn_t push_v_fn; // 可选，为空时合并后使用push_fn
         } connection_data_t;
         connection_data_t conn_data_;
         stat_t stat_;
 
+        // 握手超时定时器，由node管理，在定时器里时持有自身的引用
+        detail::timer_wheel::node_t connecting_timer_;
+        ptr_t connecting_holder_;
+
         friend class endpoint;
+        friend class node;
     };
 } // namespace atbus
 
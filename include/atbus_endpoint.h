@@ -25,6 +25,7 @@
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_config.h"
 #include "detail/libatbus_error.h"
+#include "detail/timer_wheel.h"
 
 #include "atbus_connection.h"
 
@@ -58,6 +59,7 @@ namespace atbus {
 
                 MUTABLE_FLAGS,
                 GLOBAL_ROUTER = MUTABLE_FLAGS, /** 全局路由表 **/
+                COMPACT_DATA,                  /** 支持紧凑编码的数据转发消息 **/
                 MAX
             };
         } flag_t;
@@ -170,6 +172,9 @@ namespace atbus {
 
         inline const node *get_owner() const { return owner_; }
 
+        /** ping定时器，由node管理 **/
+        inline detail::timer_wheel::node_t &get_ping_timer() { return ping_timer_; }
+
     private:
         bus_id_t id_;
         uint32_t children_mask_;
@@ -190,6 +195,8 @@ namespace atbus {
         std::string type_name_;
         std::vector<std::string> tags_;
 
+        detail::timer_wheel::node_t ping_timer_;
+
         // 统计数据
         struct stat_t {
             size_t fault_count;       // 错误容忍计数
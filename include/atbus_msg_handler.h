@@ -15,6 +15,7 @@
 #include <bitset>
 #include <ctime>
 #include <list>
+#include <stdint.h>
 
 namespace atbus {
     namespace protocol {
@@ -36,6 +37,15 @@ namespace atbus {
 
         static int send_transfer_rsp(node &n, protocol::msg &, int32_t ret_code);
 
+        static int send_node_sync_req(node &n, endpoint &ep, uint64_t since);
+
+        /**
+         * @brief 发送路由表增量
+         * @param since 对端已收到的版本号
+         * @param force 没有变更时是否也要发送(用于回复请求)
+         */
+        static int send_node_sync_rsp(node &n, endpoint &ep, uint64_t since, bool force);
+
         static int send_msg(node &n, connection &conn, const protocol::msg &m);
 
 
@@ -56,6 +66,13 @@ namespace atbus {
 
 
         static int send_transfer_req(node &n, protocol::msg &, bool broadcast= false);
+
+        // 广播时所有目标共用的打包数据，发送时只修改目标ID
+        struct broadcast_cache_t;
+        static int send_broadcast_req(node &n, protocol::msg &, broadcast_cache_t &cache);
+
+        // 未设置on_custom_route时，按节点的服务索引选择自定义路由的目标
+        static int send_custom_route_by_index(node &n, protocol::msg &, broadcast_cache_t &cache);
     };
 } // namespace atbus
 
@@ -28,13 +28,25 @@
 #include "std/functional.h"
 #include "std/smart_ptr.h"
 
+#include "detail/libatbus_allocator.h"
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_config.h"
+#include "detail/flat_map.h"
 #include "detail/libatbus_error.h"
+#include "detail/libatbus_route_table.h"
+#include "detail/libatbus_service_index.h"
+#include "detail/mpsc_inbox.h"
+#include "detail/poll_scheduler.h"
+#include "detail/self_msg_ring.h"
 
 #include "atbus_endpoint.h"
 #include "libatbus_protocol.h"
 
+// 路由缓存的槽位数，必须是2的幂
+#ifndef ATBUS_MACRO_ROUTE_CACHE_SIZE
+#define ATBUS_MACRO_ROUTE_CACHE_SIZE 64
+#endif
+
 namespace atbus {
 
     class node UTIL_CONFIG_FINAL : public util::design_pattern::noncopyable {
@@ -45,6 +57,9 @@ namespace atbus {
         struct conf_flag_t {
             enum type {
                 EN_CONF_GLOBAL_ROUTER, /** 全局路由表 **/
+                EN_CONF_COMPACT_DATA,  /** 数据转发消息使用紧凑编码(需要对端也支持) **/
+                EN_CONF_BROADCAST_FILTER, /** 转发CUSTOM_ROUTE_BROADCAST2时跳过没有订阅者(type_name和tag匹配)的子树 **/
+                EN_CONF_THREAD_SAFE_INBOX, /** 创建线程安全的收件箱，允许其他线程调用send_data_thread_safe **/
                 EN_CONF_MAX
             };
         };
@@ -62,6 +77,7 @@ namespace atbus {
                 EN_FT_SHUTDOWN,        /** 已完成关闭前的资源回收 **/
                 EN_FT_RECV_SELF_MSG,   /** 正在接收发给自己的信息 **/
                 EN_FT_IN_CALLBACK,     /** 在回调函数中 **/
+                EN_FT_PACKING,         /** 正在使用打包缓冲区 **/
                 EN_FT_MAX,             /** flag max **/
             };
         };
@@ -86,20 +102,31 @@ namespace atbus {
             size_t recv_buffer_size;   /** 接收缓冲区，和数据包大小有关 **/
             size_t send_buffer_size;   /** 发送缓冲区限制 **/
             size_t send_buffer_number; /** 发送缓冲区静态Buffer数量限制，0则为动态缓冲区 **/
+            int io_stream_backend;     /** IO流通道后端，参见 channel::io_stream_backend_t::type_t，不支持时回退到libuv **/
+            time_t idle_trim_timeout;  /** IO流连接空闲多久后释放静态发送缓冲区和共享接收池中的空闲块，秒，0则不释放。
+                                            同样时间内没有新的分配时也会释放当前线程缓冲区块分级缓存中的空闲块。
+                                            动态发送缓冲区(send_buffer_number为0，默认)发送完即释放，不需要也不会被回收 **/
+            size_t msg_arena_size;     /** 单条消息处理期间临时内存池的块大小，处理完后重置，0则使用默认值 **/
+            size_t proc_quantum_size;  /** 内存/共享内存通道每次proc按字节公平分配的配额，0则只受loop_times限制 **/
+            size_t proc_max_backoff;   /** 内存/共享内存通道连续空闲时最多跳过的proc次数，0(默认)则每次都检查 **/
 
 
             std::list<std::string> advertise_addrs;  /** 广告地址 **/
 
             std::string type_name;                  /** 类型 **/
             std::vector<std::string> tags;          /** tags **/
+            int custom_route_select_mode;           /** 未设置on_custom_route时内置的服务选择方式，参见 detail::service_index::select_mode_t **/
+            time_t outstanding_timeout;             /** EN_SSM_LEAST_OUTSTANDING时转发的请求多久没有回包就不再计数，秒 **/
 
             bool pure_forward;  /** 纯转发节点一般用于顶级节点，字节点不能是业务进程 **/
         } conf_t;
 
-        typedef std::map<bus_id_t, endpoint::ptr_t> endpoint_collection_t;
+        // key 为子域上界，有序数组存储，查找和广播遍历都是连续内存
+        typedef detail::flat_map<bus_id_t, endpoint::ptr_t> endpoint_collection_t;
 
         struct evt_msg_t {
-            //
+            // 自定义路由回调 => 参数列表: 当前节点，发起节点，路由数据，输出的候选目标
+            // 单播时有routing_key则在候选里按key一致性哈希，否则发给第一个候选
             typedef std::function<int(const node &, bus_id_t, const protocol::custom_route_data&, std::vector<uint64_t >& )>
                     on_custom_route_fn_t;
 
@@ -157,6 +184,25 @@ namespace atbus {
             inline operator bool() { return holder; }
         };
 
+        // 临时内存池的作用域，最外层的作用域结束时重置临时内存池
+        struct msg_arena_guard_t {
+            node *owner;
+            msg_arena_guard_t(node *o);
+            ~msg_arena_guard_t();
+        };
+
+        // 解包使用的zone，最外层的作用域使用节点可复用的zone并在结束时清理，嵌套时使用临时的zone
+        struct unpack_zone_guard_t {
+            node *owner;
+            msgpack::zone *zone;
+            unpack_zone_guard_t(node *o);
+            ~unpack_zone_guard_t();
+
+        private:
+            unpack_zone_guard_t(const unpack_zone_guard_t &);
+            unpack_zone_guard_t &operator=(const unpack_zone_guard_t &);
+        };
+
         // ================== 用这个来取代C++继承，减少层次结构 ==================
         struct no_stream_channel_t {
             void *channel;
@@ -258,6 +304,18 @@ namespace atbus {
 
         /*int send_data(bus_id_t tid, int type, const void *buffer, size_t s, bool require_rsp , const protocol::custom_route_data*custom_route_data = NULL);*/
 
+        /**
+         * @brief 在任意线程发送数据，数据复制到收件箱后由事件循环线程批量调用send_data发送
+         * @param tid 发送目标ID
+         * @param type 自定义类型，将作为msg.head.type字段传递
+         * @param buffer 数据块地址
+         * @param s 数据块长度
+         * @param require_rsp 是否强制需要回包
+         * @return 0或错误码，只表示是否放入收件箱，发送失败时在事件循环线程里通过on_send_data_failed通知
+         * @note 需要开启EN_CONF_THREAD_SAFE_INBOX，并且只能在init之后、reset之前调用
+         */
+        int send_data_thread_safe(bus_id_t tid, int type, const void *buffer, size_t s, bool require_rsp = false);
+
         /**
          * @brief 发送数据消息
          * @param tid 发送目标ID
@@ -327,6 +385,11 @@ namespace atbus {
          */
         int get_remote_channel(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out);
 
+        /**
+         * @brief 使路由缓存失效，endpoint或者connection变更时调用
+         */
+        inline void invalidate_route_cache() { ++route_generation_; }
+
         /**
          * @brief 根据对端ID查找直链的端点
          * @param tid 目标端点ID
@@ -368,6 +431,24 @@ namespace atbus {
 
         inline const endpoint_collection_t &get_brother() const { return node_brother_; };
 
+        /**
+         * @brief 获取通过全局路由表直连的其他节点(非父节点、兄弟节点和子节点)
+         */
+        inline const endpoint_collection_t &get_global() const { return node_global_; };
+
+        /**
+         * @brief 获取全局路由表，由节点同步协议维护
+         */
+        inline const detail::route_table &get_route_table() const { return route_table_; }
+        inline detail::route_table &get_route_table() { return route_table_; }
+
+        /**
+         * @brief 获取按type_name和tag索引的对端，对端加入和移除时自动更新
+         * @note 未设置on_custom_route时，自定义路由使用这个索引选择目标
+         */
+        inline const detail::service_index &get_service_index() const { return service_index_; }
+        inline detail::service_index &get_service_index() { return service_index_; }
+
         /**
          * @brief 获取关联的事件管理器,如果未设置则会初始化为默认时间管理器
          * @return 关联的事件管理器
@@ -412,6 +493,23 @@ namespace atbus {
 
         time_t get_timer_usec() const;
 
+        /**
+         * @brief 获取定时器使用的毫秒时间
+         */
+        uint64_t get_timer_msec() const;
+
+        /**
+         * @brief 获取常驻的缓冲区内存大小(IO流通道的收发缓冲区+节点的静态缓冲区+当前线程缓冲区块分级缓存的空闲块)
+         * @note 每秒在proc中刷新一次
+         * @return 缓冲区内存大小，字节
+         */
+        inline size_t get_resident_buffer_size() const { return stat_.resident_buffer_size; }
+
+        /**
+         * @brief 获取get_remote_channel命中路由缓存的次数
+         */
+        inline size_t get_route_cache_hit_times() const { return stat_.route_cache_hit_times; }
+
         void on_recv(connection *conn, protocol::msg *m, int status, int errcode);
 
         void on_recv_data(const endpoint *ep, connection *conn, const protocol::msg &m, const void *buffer, size_t s) const;
@@ -447,15 +545,64 @@ namespace atbus {
         /** dispatch all self messages **/
         int dispatch_all_self_msgs();
 
+        /** send all messages in the thread-safe inbox, must be called in the event loop thread **/
+        int dispatch_inbox_msgs();
+
         inline const detail::buffer_block *get_temp_static_buffer() const { return static_buffer_; }
         inline detail::buffer_block *get_temp_static_buffer() { return static_buffer_; }
 
+        /** reusable buffer for packing messages, must be used in the scope of flag_guard_t(EN_FT_PACKING) **/
+        inline detail::buffer_block *get_pack_buffer() { return pack_buffer_; }
+
+        /** temporary memory for processing one message, must be used in the scope of msg_arena_guard_t **/
+        inline detail::arena_allocator &get_msg_arena() { return msg_arena_; }
+
         int ping_endpoint(endpoint &ep);
 
+        /**
+         * @brief 推送路由表增量，上报自身子树给父节点(没有父节点时给兄弟节点)，下发全量表给需要全局路由表的子节点
+         */
         int push_node_sync();
 
+        /**
+         * @brief 需要全局路由表时，从父节点拉取上次接收之后的增量
+         */
         int pull_node_sync();
 
+        /**
+         * @brief 标记路由表有变更，下一次proc时合并推送
+         */
+        void add_node_sync_push();
+
+        /**
+         * @brief 按服务索引转发了需要回包的请求，增加目标的未完成请求数，用于 EN_SSM_LEAST_OUTSTANDING
+         * @param target 转发目标
+         * @param m 转发的请求
+         */
+        void add_outstanding_request(bus_id_t target, const protocol::msg &m);
+
+        /**
+         * @brief 回包经过本节点时减少对应目标的未完成请求数
+         * @param m 回包
+         */
+        void remove_outstanding_request(const protocol::msg &m);
+
+        /**
+         * @brief 获取和对端同步路由表的范围
+         * @param peer 对端节点
+         * @param push_scope 发给对端的范围，可以为NULL
+         * @param accept_scope 接受对端同步的范围，可以为NULL
+         * @return 对端是否参与路由表同步
+         */
+        bool get_node_sync_scope(const endpoint &peer, detail::route_table::scope_t *push_scope,
+                                 detail::route_table::scope_t *accept_scope) const;
+
+        /**
+         * @brief 对端的子树里是否可能有广播的订阅者
+         * @note 未开启EN_CONF_BROADCAST_FILTER或者还没有收到过对端子树的同步数据时总是返回true
+         */
+        bool has_broadcast_subscriber(const endpoint &peer, const protocol::custom_route_data &route_data) const;
+
         uint64_t alloc_msg_seq();
 
         void add_check_list(const endpoint::ptr_t &ep);
@@ -500,6 +647,9 @@ namespace atbus {
         void unref_object(void *);
 
     private:
+        int resolve_remote_channel(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out,
+                                   bool *cacheable);
+
         static endpoint *find_child(endpoint_collection_t &coll, bus_id_t id);
 
         bool insert_child(endpoint_collection_t &coll, endpoint::ptr_t ep);
@@ -517,7 +667,48 @@ namespace atbus {
         /**
          * @brief 添加到ping列表
          */
-        void add_ping_timer(endpoint::ptr_t &ep);
+        void add_ping_timer(endpoint &ep);
+
+        /**
+         * @brief 是否有正在连接或握手的到addr的连接
+         * @param binding 不为NULL时只检查绑定到这个endpoint的连接
+         */
+        bool is_connecting(const char *addr_str, const endpoint *binding) const;
+
+        /**
+         * @brief 派发一条发给自己的命令消息
+         * @return 记录格式正确并已派发时返回true
+         */
+        bool dispatch_self_cmd_msg(const detail::self_msg_ring::record_t &rec);
+
+        /**
+         * @brief 创建收件箱的唤醒句柄并允许其他线程发送，必须在事件循环线程调用
+         */
+        int open_inbox();
+
+        /**
+         * @brief 拒绝新的消息，等正在发送的线程完成后把剩余的消息按发送失败处理
+         * @note 唤醒句柄保留到node析构，其他线程在关闭期间仍然可以安全地访问它
+         */
+        void close_inbox();
+
+        /**
+         * @brief 关闭并释放收件箱的唤醒句柄，只在析构或者更换事件循环时调用
+         */
+        void destroy_inbox_async();
+
+        static void on_inbox_async(adapter::async_t *handle);
+        static void on_inbox_closed(adapter::handle_t *handle);
+
+        /**
+         * @brief 直连节点变更时更新路由表
+         */
+        void update_route_endpoint(const endpoint &ep, bool removed);
+
+        /**
+         * @brief 按全局路由表直连目标节点，连接成功前仍然由父节点转发
+         */
+        void connect_global_route(bus_id_t tid);
 
     public:
         void stat_add_dispatch_times();
@@ -543,33 +734,49 @@ namespace atbus {
         std::unique_ptr<channel::io_stream_channel, io_stream_channel_del> iostream_channel_;
         std::unique_ptr<channel::io_stream_conf> iostream_conf_;
         evt_msg_t event_msg_;
-        typedef std::list<std::vector<unsigned char> > self_data_msgs_t;
-        typedef std::list<std::vector<std::vector<unsigned char> > > self_cmd_msgs_t;
-        self_data_msgs_t self_data_msgs_;
-        self_cmd_msgs_t self_cmd_msgs_;
+        // 发给自己的数据和命令消息，按发送顺序派发
+        detail::self_msg_ring self_msgs_;
+        // 其他线程发送的数据，inbox_async_用于唤醒事件循环线程，未开启时为NULL
+        // 生产者先增加inbox_producers_再检查inbox_state_，关闭时先修改状态再等待计数归零，关闭后不会再有消息压入
+        struct inbox_state_t {
+            enum type {
+                EN_IS_CLOSED = 0,
+                EN_IS_OPEN,
+                EN_IS_CLOSING,
+            };
+        };
+        detail::mpsc_inbox inbox_;
+        adapter::async_t *inbox_async_;
+        util::lock::atomic_int_type<int> inbox_state_;
+        util::lock::atomic_int_type<size_t> inbox_producers_;
 
         // ============ 定时器 ============
         typedef struct {
-            template <typename TObj>
-            struct timer_desc_ls {
-                typedef std::pair<time_t, TObj> pair_type;
-                typedef std::list<pair_type> type;
-            };
-
             time_t sec;
             time_t usec;
 
-            time_t node_sync_push;                                   // 节点变更推送
-            time_t father_opr_time_point;                            // 父节点操作时间（断线重连或Ping）
-            timer_desc_ls<std::weak_ptr<endpoint> >::type ping_list; // 定时ping
-            timer_desc_ls<connection::ptr_t>::type connecting_list;  // 未完成连接（正在网络连接或握手）
-            std::list<endpoint::ptr_t> pending_check_list_;          // 待检测列表
+            time_t node_sync_push;                            // 节点变更推送
+            time_t father_opr_time_point;                     // 父节点操作时间（断线重连或Ping）
+            time_t idle_trim_time_point;                      // 空闲连接缓冲区回收
+            size_t allocator_alloc_times;                     // 上一次回收检查时线程分级缓存的分配次数
+            time_t allocator_active_time_point;               // 线程分级缓存最后一次有新分配的时间
+            detail::timer_wheel ping_timers;                  // 定时ping，节点嵌入在endpoint里，毫秒
+            detail::timer_wheel connecting_timers;            // 未完成连接（正在网络连接或握手），节点嵌入在connection里，毫秒
+            detail::timer_wheel outstanding_timers;           // 未完成请求超时，节点嵌入在outstanding_requests_里，毫秒
+            std::vector<endpoint::ptr_t> pending_check_list_; // 待检测列表
         } evt_timer_t;
         evt_timer_t event_timer_;
 
         // 轮训接收通道集
         detail::buffer_block *static_buffer_;
+        detail::buffer_block *pack_buffer_;
+        detail::arena_allocator msg_arena_;
+        int msg_arena_depth_;
+        msgpack::zone unpack_zone_;
+        int unpack_zone_depth_;
         detail::auto_select_map<std::string, connection::ptr_t>::type proc_connections_;
+        // proc_connections_里的连接，proc时按数组顺序轮询
+        detail::poll_scheduler proc_scheduler_;
 
         // 基于事件的通道信息
         // 基于事件的通道超时收集
@@ -587,11 +794,41 @@ namespace atbus {
         // 子节点
         endpoint_collection_t node_children_;
 
+        // 通过全局路由表直连的节点
+        endpoint_collection_t node_global_;
+
         // 全局路由表
+        detail::route_table route_table_;
+        std::map<bus_id_t, time_t> global_route_connecting_; // 正在直连的节点和发起时间
+
+        // 服务索引
+        detail::service_index service_index_;
+
+        // 按服务索引转发的未完成请求，key为请求方ID和序号，回包、超时或重置时减少目标的未完成请求数
+        typedef std::pair<bus_id_t, uint64_t> outstanding_key_t;
+        struct outstanding_request_t {
+            outstanding_key_t key;
+            bus_id_t target;
+            detail::timer_wheel::node_t timer;
+        };
+        std::map<outstanding_key_t, outstanding_request_t> outstanding_requests_;
+
+        // 路由缓存，按目标ID哈希，generation不一致时失效
+        struct route_cache_t {
+            bus_id_t tid;
+            endpoint::get_connection_fn_t fn;
+            uint64_t generation;
+            endpoint *ep;
+            connection *conn;
+        };
+        route_cache_t route_cache_[ATBUS_MACRO_ROUTE_CACHE_SIZE];
+        uint64_t route_generation_;
 
         // 统计信息
         struct stat_info_t {
             size_t dispatch_times;
+            size_t resident_buffer_size; // 常驻缓冲区内存
+            size_t route_cache_hit_times;
 
             stat_info_t();
         };
@@ -8,10 +8,32 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <list>
 #include <stdint.h>
 #include <vector>
 
+#include "lock/atomic_int_type.h"
+
+// 动态模式缓冲块的分级缓存分配器，按2的幂分级，最小级别和级别数量
+#ifndef ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT
+#define ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT 6
+#endif
+
+#ifndef ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER
+#define ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER 12
+#endif
+
+// 每个线程每个级别最多缓存的空闲内存大小(至少缓存1块)
+#ifndef ATBUS_BUFFER_ALLOCATOR_CLASS_CACHE_SIZE
+#define ATBUS_BUFFER_ALLOCATOR_CLASS_CACHE_SIZE (256 * 1024)
+#endif
+
+// 数据区不超过这个大小的小块直接走malloc/free，不经过分级缓存(ptmalloc的tcache处理小块更快，参见docs/Benchmark.md)
+#ifndef ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE
+#define ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE 128
+#endif
+
 namespace atbus {
     namespace detail {
         namespace fn {
@@ -46,7 +68,65 @@ namespace atbus {
             size_t write_vint(uint64_t in, void *pointer, size_t s);
         }
 
+        /**
+         * @brief stream for msgpack::pack which only count the packed size
+         */
+        class pack_size_counter {
+        public:
+            pack_size_counter() : size_(0) {}
+
+            inline void write(const char *, size_t len) { size_ += len; }
+
+            inline size_t size() const { return size_; }
+
+        private:
+            size_t size_;
+        };
+
+        /**
+         * @brief stream for msgpack::pack which write into a fixed size buffer
+         * @note data out of range will be dropped and good() will return false
+         */
+        class pack_fixed_buffer {
+        public:
+            pack_fixed_buffer(void *buffer, size_t s) : data_(reinterpret_cast<char *>(buffer)), size_(0), capacity_(s), good_(true) {}
+
+            inline void write(const char *buf, size_t len) {
+                if (!good_ || size_ + len > capacity_) {
+                    good_ = false;
+                    return;
+                }
+
+                memcpy(data_ + size_, buf, len);
+                size_ += len;
+            }
+
+            inline const char *data() const { return data_; }
+            inline size_t size() const { return size_; }
+            inline bool good() const { return good_; }
+
+        private:
+            char *data_;
+            size_t size_;
+            size_t capacity_;
+            bool good_;
+        };
+
         class buffer_manager;
+        struct buffer_allocator_cache_t;
+
+        /**
+         * @brief stats of one size class in buffer block allocator
+         * @note the last class(block_size=0) means blocks too large to be cached
+         * @note blocks not larger than ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE bypass the allocator and are not counted
+         */
+        struct buffer_allocator_stats_t {
+            size_t block_size;    // 分级块大小(包含头部)，0表示不缓存的大块
+            size_t using_number;  // 当前线程分配出去还未释放的块数量
+            size_t cached_number; // 当前线程缓存的空闲块数量
+            size_t alloc_times;   // 分配次数
+            size_t hit_times;     // 命中缓存的分配次数
+        };
 
         /**
          * @brief buffer block, not thread safe
@@ -67,12 +147,43 @@ namespace atbus {
             size_t instance_size() const;
 
         public:
-            /** alloc and init buffer_block **/
+            /**
+             * @brief alloc and init buffer_block
+             * @note blocks are allocated from the size class cache of current thread,
+             *       except tiny blocks(not larger than ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE) and too large blocks
+             **/
             static buffer_block *malloc(size_t s);
 
-            /** destroy and free buffer_block **/
+            /**
+             * @brief destroy and free buffer_block
+             * @note blocks in size classes are put back to the size class cache of current thread
+             **/
             static void free(buffer_block *p);
 
+            /**
+             * @brief release all cached free blocks of current thread
+             * @return memory size released
+             **/
+            static size_t shrink_allocator();
+
+            /**
+             * @brief get allocator stats of current thread
+             * @param out ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER size classes and one more for uncached large blocks
+             **/
+            static void get_allocator_stats(std::vector<buffer_allocator_stats_t> &out);
+
+            /**
+             * @brief get memory size of free blocks cached by current thread
+             * @note these blocks are not counted in any buffer_manager, release them by shrink_allocator()
+             **/
+            static size_t get_allocator_cached_size();
+
+            /**
+             * @brief get memory size actually allocated by malloc(s)
+             * @note blocks in size classes are allocated at their class size, others at full_size(s)
+             **/
+            static size_t alloc_size(size_t s);
+
             /**
              * @brief init buffer_block as specify address
              * @param pointer data address
@@ -91,9 +202,11 @@ namespace atbus {
 
         private:
             friend class buffer_manager;
+            friend struct buffer_allocator_cache_t;
             size_t size_;
             size_t used_;
-            void *pointer_;
+            buffer_block *next_; // 动态模式下侵入式队列的下一个块，或分配器空闲链表的下一个块。数据区紧跟在头部后
+            buffer_block *prev_; // 动态模式下侵入式队列的上一个块，从尾部操作时不需要遍历
         };
 
         /**
@@ -109,6 +222,15 @@ namespace atbus {
                 size_t limit_size_;
             };
 
+            /**
+             * @brief data segment of a buffer block
+             * @note a block in static mode may wrap the end of the circle buffer, and then it has two segments
+             */
+            struct segment_t {
+                void *pointer;
+                size_t size;
+            };
+
         private:
             buffer_manager(const buffer_manager &);
             buffer_manager &operator=(const buffer_manager &);
@@ -161,8 +283,52 @@ namespace atbus {
              */
             int merge_front(void *&pointer, size_t s);
 
+            /**
+             * @brief append buffer which may wrap the end of the static circle buffer
+             * @note in dynamic mode or if there is enough space at the end, just like push_back and segs[1].size will be 0
+             * @note data()/pop() of a block which has two segments only work on the first segment, use raw_segments to access it
+             * @param segs output the writable segments
+             * @param s buffer size
+             * @param min_first_size min size of the first segment, for data which can not be splited
+             * @return 0 or error code
+             */
+            int push_back_split(segment_t segs[2], size_t s, size_t min_first_size);
+
+            /**
+             * @brief prepend buffer which may wrap the end of the static circle buffer
+             * @note in dynamic mode or if there is enough space before the head, just like push_front and segs[1].size will be 0
+             * @param segs output the writable segments
+             * @param s buffer size
+             * @param min_first_size min size of the first segment, for data which can not be splited
+             * @return 0 or error code
+             */
+            int push_front_split(segment_t segs[2], size_t s, size_t min_first_size);
+
+            /**
+             * @brief get all data segments of a buffer block in this manager
+             * @param block buffer block
+             * @param segs output the segments, segs[1].size is 0 if the block is not splited
+             * @return segment number, 0 if block is NULL
+             */
+            size_t raw_segments(const buffer_block *block, segment_t segs[2]) const;
+
             bool empty() const;
 
+            /**
+             * @brief get memory size held by this manager
+             * @note static mode: the whole circle buffer, dynamic mode: all allocated buffer blocks(by buffer_block::alloc_size)
+             * @note maintained incrementally when blocks are allocated or freed, O(1)
+             * @return resident memory size in bytes
+             */
+            inline size_t resident_size() const { return resident_size_; }
+
+            /**
+             * @brief bind an external counter which is updated together with resident_size()
+             * @param counter aggregate counter(for example the total of a channel), NULL to unbind
+             * @note current resident_size() is added to the new counter and removed from the old one
+             */
+            void bind_resident_counter(size_t *counter);
+
             void reset();
 
             /**
@@ -193,6 +359,12 @@ namespace atbus {
 
             int static_merge_front(void *&pointer, size_t s);
 
+            int static_push_back_split(segment_t segs[2], size_t s, size_t min_first_size);
+
+            int static_push_front_split(segment_t segs[2], size_t s, size_t min_first_size);
+
+            bool static_is_split(const buffer_block *block) const;
+
             bool static_empty() const;
 
             buffer_block *dynamic_front();
@@ -213,6 +385,10 @@ namespace atbus {
 
             bool dynamic_empty() const;
 
+            void add_resident_size(size_t s);
+
+            void sub_resident_size(size_t s);
+
         private:
             struct static_buffer_t {
                 void *buffer_;
@@ -223,10 +399,108 @@ namespace atbus {
                 std::vector<buffer_block *> circle_index_;
             };
 
+            struct dynamic_buffer_t {
+                buffer_block *head_;
+                buffer_block *tail_;
+            };
+
             static_buffer_t static_buffer_;
-            std::list<buffer_block *> dynamic_buffer_;
+            dynamic_buffer_t dynamic_buffer_;
 
             limit_t limit_;
+
+            size_t resident_size_;
+            size_t *resident_counter_;
+        };
+
+        /**
+         * @brief lock-free buffer block queue for one producer thread and one consumer thread
+         * @note push_back/back/commit_back/cancel_back can only be called by the producer thread
+         * @note front/pop_front can only be called by the consumer thread
+         * @note set_limit/reset can only be called when no other thread is using it
+         * @note blocks are allocated by buffer_block::malloc in producer thread and put back to the allocator cache of consumer thread
+         */
+        class spsc_buffer_manager {
+        public:
+            typedef buffer_manager::limit_t limit_t;
+
+        private:
+            spsc_buffer_manager(const spsc_buffer_manager &);
+            spsc_buffer_manager &operator=(const spsc_buffer_manager &);
+
+        public:
+            spsc_buffer_manager();
+            ~spsc_buffer_manager();
+
+            /**
+             * @brief get a snapshot of limit
+             * @note cost_number_ and cost_size_ may be changed by the other thread at any time
+             */
+            limit_t limit() const;
+
+            /**
+             * @brief set limit and clear all data
+             * @param max_size size limit, set 0 if unlimited
+             * @param max_number number limit, can not be 0
+             * @return true on success
+             */
+            bool set_limit(size_t max_size, size_t max_number);
+
+            /**
+             * @brief alloc a buffer block at the tail(producer)
+             * @note the block is invisible to consumer until commit_back is called, only one uncommitted block is allowed
+             * @param pointer output the writable buffer address
+             * @param s buffer size
+             * @return 0 or error code
+             */
+            int push_back(void *&pointer, size_t s);
+
+            /** get the uncommitted block(producer) **/
+            buffer_block *back();
+
+            int back(void *&pointer, size_t &nread, size_t &nwrite);
+
+            /**
+             * @brief publish the uncommitted block to consumer(producer)
+             * @return 0 or error code
+             */
+            int commit_back();
+
+            /**
+             * @brief free the uncommitted block(producer)
+             * @return 0 or error code
+             */
+            int cancel_back();
+
+            /** get the first committed block(consumer) **/
+            buffer_block *front();
+
+            int front(void *&pointer, size_t &nread, size_t &nwrite);
+
+            /**
+             * @brief pop data from the first committed block(consumer)
+             * @param s data size
+             * @param free_unwritable free the block and move to next one when all data of it are poped
+             * @return 0 or error code
+             */
+            int pop_front(size_t s, bool free_unwritable = true);
+
+            bool empty() const;
+
+            void reset();
+
+        private:
+            std::vector<buffer_block *> ring_;
+            size_t limit_size_;
+            buffer_block *pending_; // 生产者未提交的块
+
+            // 生产者和消费者的游标放在不同的cache line，避免伪共享
+            char padding_head_[64];
+            util::lock::atomic_int_type<size_t> head_; // 消费者写
+            char padding_tail_[64];
+            util::lock::atomic_int_type<size_t> tail_; // 生产者写
+            char padding_cost_[64];
+            util::lock::atomic_int_type<size_t> cost_size_;
         };
     }
 }
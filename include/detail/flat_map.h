@@ -0,0 +1,118 @@
+﻿/**
+ * @brief 基于有序数组的map，接口和std::map的常用部分一致
+ * @note 查找和遍历都是连续内存，适合查找和遍历远多于插入和删除的场景(比如子节点集合)
+ * @note 插入和删除会使所有迭代器失效
+ */
+
+#ifndef LIBATBUS_DETAIL_FLAT_MAP_H
+#define LIBATBUS_DETAIL_FLAT_MAP_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace atbus {
+    namespace detail {
+        template <typename TKey, typename TValue>
+        class flat_map {
+        public:
+            typedef TKey key_type;
+            typedef TValue mapped_type;
+            typedef std::pair<TKey, TValue> value_type;
+            typedef std::vector<value_type> container_type;
+            typedef typename container_type::size_type size_type;
+            typedef typename container_type::iterator iterator;
+            typedef typename container_type::const_iterator const_iterator;
+            typedef typename container_type::reverse_iterator reverse_iterator;
+            typedef typename container_type::const_reverse_iterator const_reverse_iterator;
+
+        private:
+            struct key_compare {
+                inline bool operator()(const value_type &l, const key_type &r) const { return l.first < r; }
+                inline bool operator()(const key_type &l, const value_type &r) const { return l < r.first; }
+            };
+
+        public:
+            inline iterator begin() { return data_.begin(); }
+            inline iterator end() { return data_.end(); }
+            inline const_iterator begin() const { return data_.begin(); }
+            inline const_iterator end() const { return data_.end(); }
+            inline reverse_iterator rbegin() { return data_.rbegin(); }
+            inline reverse_iterator rend() { return data_.rend(); }
+            inline const_reverse_iterator rbegin() const { return data_.rbegin(); }
+            inline const_reverse_iterator rend() const { return data_.rend(); }
+
+            inline size_type size() const { return data_.size(); }
+            inline bool empty() const { return data_.empty(); }
+            inline void clear() { data_.clear(); }
+            inline void reserve(size_type n) { data_.reserve(n); }
+            inline void swap(flat_map &other) { data_.swap(other.data_); }
+
+            inline iterator lower_bound(const key_type &k) { return std::lower_bound(data_.begin(), data_.end(), k, key_compare()); }
+            inline const_iterator lower_bound(const key_type &k) const {
+                return std::lower_bound(data_.begin(), data_.end(), k, key_compare());
+            }
+
+            inline iterator upper_bound(const key_type &k) { return std::upper_bound(data_.begin(), data_.end(), k, key_compare()); }
+            inline const_iterator upper_bound(const key_type &k) const {
+                return std::upper_bound(data_.begin(), data_.end(), k, key_compare());
+            }
+
+            iterator find(const key_type &k) {
+                iterator iter = lower_bound(k);
+                if (iter != data_.end() && !(k < iter->first)) {
+                    return iter;
+                }
+                return data_.end();
+            }
+
+            const_iterator find(const key_type &k) const {
+                const_iterator iter = lower_bound(k);
+                if (iter != data_.end() && !(k < iter->first)) {
+                    return iter;
+                }
+                return data_.end();
+            }
+
+            inline size_type count(const key_type &k) const { return find(k) == end() ? 0 : 1; }
+
+            std::pair<iterator, bool> insert(const value_type &v) {
+                iterator iter = lower_bound(v.first);
+                if (iter != data_.end() && !(v.first < iter->first)) {
+                    return std::make_pair(iter, false);
+                }
+
+                return std::make_pair(data_.insert(iter, v), true);
+            }
+
+            mapped_type &operator[](const key_type &k) {
+                iterator iter = lower_bound(k);
+                if (iter == data_.end() || k < iter->first) {
+                    iter = data_.insert(iter, value_type(k, mapped_type()));
+                }
+
+                return iter->second;
+            }
+
+            inline iterator erase(iterator iter) { return data_.erase(iter); }
+
+            size_type erase(const key_type &k) {
+                iterator iter = find(k);
+                if (iter == data_.end()) {
+                    return 0;
+                }
+
+                data_.erase(iter);
+                return 1;
+            }
+
+        private:
+            container_type data_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
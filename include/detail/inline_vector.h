@@ -0,0 +1,142 @@
+﻿/**
+ * @brief 带内联存储的小数组，元素数量不超过N时不分配内存
+ * @note 只用于POD类型(比如bus_id)，元素直接按内存复制
+ */
+
+#ifndef LIBATBUS_DETAIL_INLINE_VECTOR_H
+#define LIBATBUS_DETAIL_INLINE_VECTOR_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include "detail/libatbus_allocator.h"
+
+namespace atbus {
+    namespace detail {
+        template <typename T, size_t N>
+        class inline_vector {
+        public:
+            typedef T value_type;
+            typedef size_t size_type;
+            typedef T &reference;
+            typedef const T &const_reference;
+            typedef T *iterator;
+            typedef const T *const_iterator;
+
+        public:
+            inline_vector() : data_(inline_data_), size_(0), capacity_(N) {}
+
+            inline_vector(const inline_vector &other) : data_(inline_data_), size_(0), capacity_(N) { assign(other.data(), other.size()); }
+
+            ~inline_vector() { release(); }
+
+            inline_vector &operator=(const inline_vector &other) {
+                if (this != &other) {
+                    assign(other.data(), other.size());
+                }
+
+                return *this;
+            }
+
+            inline size_type size() const { return size_; }
+            inline bool empty() const { return 0 == size_; }
+            inline size_type capacity() const { return capacity_; }
+            inline bool is_inline() const { return data_ == inline_data_; }
+
+            inline T *data() { return data_; }
+            inline const T *data() const { return data_; }
+
+            inline iterator begin() { return data_; }
+            inline iterator end() { return data_ + size_; }
+            inline const_iterator begin() const { return data_; }
+            inline const_iterator end() const { return data_ + size_; }
+
+            inline reference operator[](size_type i) { return data_[i]; }
+            inline const_reference operator[](size_type i) const { return data_[i]; }
+
+            inline reference front() { return data_[0]; }
+            inline const_reference front() const { return data_[0]; }
+            inline reference back() { return data_[size_ - 1]; }
+            inline const_reference back() const { return data_[size_ - 1]; }
+
+            void reserve(size_type n) {
+                if (n <= capacity_) {
+                    return;
+                }
+
+                void *buffer = fn::allocate(n * sizeof(T));
+                if (NULL == buffer) {
+                    throw std::bad_alloc();
+                }
+
+                if (size_ > 0) {
+                    memcpy(buffer, data_, size_ * sizeof(T));
+                }
+                release();
+
+                data_     = reinterpret_cast<T *>(buffer);
+                capacity_ = n;
+            }
+
+            void resize(size_type n) {
+                if (n > capacity_) {
+                    reserve(n);
+                }
+
+                for (size_type i = size_; i < n; ++i) {
+                    data_[i] = T();
+                }
+                size_ = n;
+            }
+
+            void push_back(const T &v) {
+                if (size_ >= capacity_) {
+                    // v可能引用自身的元素，先复制
+                    T copy = v;
+                    reserve(capacity_ * 2);
+                    data_[size_++] = copy;
+                    return;
+                }
+
+                data_[size_++] = v;
+            }
+
+            inline void pop_back() {
+                if (size_ > 0) {
+                    --size_;
+                }
+            }
+
+            inline void clear() { size_ = 0; }
+
+            void assign(const T *v, size_type n) {
+                clear();
+                reserve(n);
+                if (n > 0) {
+                    memcpy(data_, v, n * sizeof(T));
+                }
+                size_ = n;
+            }
+
+        private:
+            void release() {
+                if (data_ != inline_data_) {
+                    fn::deallocate(data_, capacity_ * sizeof(T));
+                    data_     = inline_data_;
+                    capacity_ = N;
+                }
+            }
+
+        private:
+            T *data_;
+            size_type size_;
+            size_type capacity_;
+            T inline_data_[N];
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
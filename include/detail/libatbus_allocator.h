@@ -0,0 +1,241 @@
+﻿/**
+ * @brief 可替换的内存分配接口，以及单条消息处理期间使用的临时内存池
+ */
+
+#ifndef LIBATBUS_DETAIL_LIBATBUS_ALLOCATOR_H
+#define LIBATBUS_DETAIL_LIBATBUS_ALLOCATOR_H
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <stdint.h>
+#include <utility>
+
+// 临时内存池每个块的默认大小
+#ifndef ATBUS_ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE
+#define ATBUS_ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE (64 * 1024)
+#endif
+
+// 小对象缓存的分级粒度和级别数量，超过 ATBUS_OBJECT_CACHE_ALIGN * ATBUS_OBJECT_CACHE_CLASS_NUMBER 的对象不缓存
+#ifndef ATBUS_OBJECT_CACHE_ALIGN
+#define ATBUS_OBJECT_CACHE_ALIGN 16
+#endif
+
+#ifndef ATBUS_OBJECT_CACHE_CLASS_NUMBER
+#define ATBUS_OBJECT_CACHE_CLASS_NUMBER 32
+#endif
+
+// 每个线程每个级别最多缓存的空闲对象数量
+#ifndef ATBUS_OBJECT_CACHE_MAX_NUMBER
+#define ATBUS_OBJECT_CACHE_MAX_NUMBER 64
+#endif
+
+namespace atbus {
+    namespace detail {
+        /**
+         * @brief allocator hooks for hot-path allocations of libatbus
+         * @note buffer blocks, static circle buffers, message bodies and self message queues are allocated by this allocator
+         */
+        struct allocator_t {
+            void *(*allocate)(void *priv_data, size_t s);            // 分配内存，失败返回NULL
+            void (*deallocate)(void *priv_data, void *p, size_t s); // 释放内存，s为分配时的大小
+            void *priv_data;                                         // 透传给分配和释放函数的私有数据
+        };
+
+        namespace fn {
+            /**
+             * @brief set global allocator hooks
+             * @param alloc allocator hooks, set NULL to restore ::malloc and ::free
+             * @note this api is not thread safe, call it before any node or channel is created
+             * @note memory must be released by the same allocator which allocate it
+             */
+            void set_allocator(const allocator_t *alloc);
+
+            const allocator_t &get_allocator();
+
+            void *allocate(size_t s);
+
+            void deallocate(void *p, size_t s);
+
+            /**
+             * @brief allocate memory for small objects, such as message bodies
+             * @note freed memory is cached by current thread and reused by objects of the same size class
+             */
+            void *allocate_object(size_t s);
+
+            void deallocate_object(void *p, size_t s);
+
+            /**
+             * @brief release all cached object memory of current thread
+             * @return memory size released
+             **/
+            size_t shrink_object_cache();
+        }
+
+        /**
+         * @brief stl allocator using global allocator hooks
+         */
+        template <typename T>
+        class stl_allocator {
+        public:
+            typedef T value_type;
+            typedef T *pointer;
+            typedef const T *const_pointer;
+            typedef T &reference;
+            typedef const T &const_reference;
+            typedef size_t size_type;
+            typedef ptrdiff_t difference_type;
+
+            template <typename U>
+            struct rebind {
+                typedef stl_allocator<U> other;
+            };
+
+            stl_allocator() {}
+            stl_allocator(const stl_allocator &) {}
+            template <typename U>
+            stl_allocator(const stl_allocator<U> &) {}
+
+            pointer address(reference x) const { return &x; }
+            const_pointer address(const_reference x) const { return &x; }
+
+            pointer allocate(size_type n, const void * = 0) {
+                void *ret = fn::allocate(n * sizeof(T));
+                if (NULL == ret) {
+                    throw std::bad_alloc();
+                }
+
+                return reinterpret_cast<pointer>(ret);
+            }
+
+            void deallocate(pointer p, size_type n) { fn::deallocate(p, n * sizeof(T)); }
+
+            size_type max_size() const { return (std::numeric_limits<size_type>::max)() / sizeof(T); }
+
+            void construct(pointer p, const T &val) { new (p) T(val); }
+            void destroy(pointer p) { p->~T(); }
+
+#if (defined(__cplusplus) && __cplusplus >= 201103L) || (defined(_MSC_VER) && _MSC_VER >= 1800)
+            template <typename U, typename... Args>
+            void construct(U *p, Args &&... args) {
+                new (p) U(std::forward<Args>(args)...);
+            }
+
+            template <typename U>
+            void destroy(U *p) {
+                p->~U();
+            }
+#endif
+        };
+
+        template <typename T, typename U>
+        inline bool operator==(const stl_allocator<T> &, const stl_allocator<U> &) {
+            return true;
+        }
+
+        template <typename T, typename U>
+        inline bool operator!=(const stl_allocator<T> &, const stl_allocator<U> &) {
+            return false;
+        }
+
+        /**
+         * @brief arena allocator for temporary memory during processing one message, not thread safe
+         * @note memory can not be released one by one, all memory will be released by reset()
+         * @note chunks are allocated by global allocator hooks and will be reused after reset()
+         */
+        class arena_allocator {
+        private:
+            arena_allocator(const arena_allocator &);
+            arena_allocator &operator=(const arena_allocator &);
+
+        public:
+            arena_allocator();
+            ~arena_allocator();
+
+            /**
+             * @brief set default chunk size
+             * @param s chunk size, 0 for ATBUS_ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE
+             */
+            void set_chunk_size(size_t s);
+
+            inline size_t get_chunk_size() const { return chunk_size_; }
+
+            /**
+             * @brief allocate memory from arena
+             * @param s memory size
+             * @return memory address aligned to sizeof(void*) * 2, NULL if failed
+             */
+            void *allocate(size_t s);
+
+            /**
+             * @brief release all memory allocated from arena
+             * @note if more than one chunk was used, they are merged into one larger chunk
+             */
+            void reset();
+
+            /**
+             * @brief release all memory and chunks
+             */
+            void release();
+
+            /** memory size allocated since last reset **/
+            inline size_t used_size() const { return used_size_; }
+
+            /** memory size of all chunks **/
+            inline size_t capacity() const { return capacity_; }
+
+        private:
+            struct chunk_t {
+                chunk_t *next;
+                size_t size;
+                size_t used;
+            };
+
+            chunk_t *alloc_chunk(size_t s);
+
+        private:
+            chunk_t *head_;
+            chunk_t *current_;
+            size_t chunk_size_;
+            size_t used_size_;
+            size_t capacity_;
+        };
+
+        /**
+         * @brief write buffer allocated from arena, can be used as the stream of msgpack::pack
+         * @note all memory will be released by arena_allocator::reset()
+         */
+        class arena_buffer {
+        private:
+            arena_buffer(const arena_buffer &);
+            arena_buffer &operator=(const arena_buffer &);
+
+        public:
+            explicit arena_buffer(arena_allocator &arena, size_t reserve_size = 0);
+
+            /**
+             * @brief append data
+             * @note if allocate failed, data will be dropped and good() will return false
+             */
+            void write(const char *buf, size_t len);
+
+            inline const char *data() const { return data_; }
+            inline size_t size() const { return size_; }
+            inline bool good() const { return good_; }
+
+        private:
+            bool reserve(size_t s);
+
+        private:
+            arena_allocator *arena_;
+            char *data_;
+            size_t size_;
+            size_t capacity_;
+            bool good_;
+        };
+    }
+}
+
+#endif // LIBATBUS_DETAIL_LIBATBUS_ALLOCATOR_H
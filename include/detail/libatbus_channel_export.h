@@ -41,6 +41,7 @@ namespace atbus {
         extern int mem_init(void *buf, size_t len, mem_channel **channel, const mem_conf *conf);
         extern int mem_send(mem_channel *channel, const void *buf, size_t len);
         extern int mem_recv(mem_channel *channel, void *buf, size_t len, size_t *recv_size);
+        extern bool mem_has_data(mem_channel *channel);
         extern std::pair<size_t, size_t> mem_last_action();
         extern void mem_show_channel(mem_channel *channel, std::ostream &out, bool need_node_status, size_t need_node_data);
 
@@ -58,6 +59,7 @@ namespace atbus {
         extern int shm_close(key_t shm_key);
         extern int shm_send(shm_channel *channel, const void *buf, size_t len);
         extern int shm_recv(shm_channel *channel, void *buf, size_t len, size_t *recv_size);
+        extern bool shm_has_data(shm_channel *channel);
         extern std::pair<size_t, size_t> shm_last_action();
         extern void shm_show_channel(shm_channel *channel, std::ostream &out, bool need_node_status, size_t need_node_data);
 
@@ -84,8 +86,26 @@ namespace atbus {
         extern int io_stream_disconnect_fd(io_stream_channel *channel, adapter::fd_t fd, io_stream_callback_t callback);
         extern int io_stream_try_write(io_stream_connection *connection);
         extern int io_stream_send(io_stream_connection *connection, const void *buf, size_t len);
+        // send several buffers as one message, the buffers are copied into send buffer directly without merging first
+        extern int io_stream_send_v(io_stream_connection *connection, const void *const *bufs, const size_t *lens, size_t nbufs);
         extern size_t io_stream_get_max_unix_socket_length();
 
+        // connection table
+        extern size_t io_stream_get_connection_number(const io_stream_channel *channel);
+        extern uint64_t io_stream_get_connection_id(const io_stream_connection *connection);
+        extern io_stream_connection *io_stream_find_connection(io_stream_channel *channel, uint64_t connection_id);
+        // iterate all alive connections, pass NULL to get the first one, return NULL when reach the end
+        extern io_stream_connection *io_stream_next_connection(io_stream_channel *channel, const io_stream_connection *prev);
+
+        /**
+         * @brief release buffers of idle connections and unused blocks in shared receive pool
+         * @param idle_timeout_ms connections without any read or write for this long(milliseconds) will release their static send buffer
+         * @return number of connections trimmed
+         */
+        extern size_t io_stream_trim_idle(io_stream_channel *channel, uint64_t idle_timeout_ms);
+        // get memory size held by all buffers of this channel
+        extern size_t io_stream_get_resident_buffer_size(const io_stream_channel *channel);
+
         extern void io_stream_show_channel(io_stream_channel *channel, std::ostream &out);
     } // namespace channel
 } // namespace atbus
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "libatbus_adapter_libuv.h"
 
@@ -99,13 +100,37 @@ namespace atbus {
                 EN_FN_CONNECTED, // 连接或listen成功
                 EN_FN_DISCONNECTED,
                 EN_FN_RECVED,
-                EN_FN_WRITEN,
+                EN_FN_WRITEN, // 数据跨越静态发送缓冲区尾部时，回调的数据地址为NULL，长度依然有效
                 MAX
             };
             // 回调函数
             io_stream_callback_t callbacks[MAX];
         };
 
+        /**
+         * @brief io_stream通道的底层IO后端
+         * @note 连接的建立、监听和关闭始终使用libuv，后端只接管已连接流上的读写操作
+         *       后端初始化失败（比如内核不支持）时会自动回退到libuv后端
+         */
+        struct io_stream_backend_t {
+            typedef enum {
+                EN_BT_LIBUV = 0, // libuv(默认)
+                EN_BT_IO_URING,  // Linux io_uring(需要编译时检测到liburing)
+                EN_BT_MAX,
+            } type_t;
+
+            type_t type;
+            const char *name;
+
+            int (*init)(io_stream_channel *channel);             // 初始化后端数据，返回0或错误码
+            void (*close)(io_stream_channel *channel);           // 释放后端数据，之后仍需要运行事件循环以完成handle的关闭
+            int (*read_start)(io_stream_connection *connection); // 开始接收数据
+            int (*read_stop)(io_stream_connection *connection);  // 停止接收数据，连接关闭前一定会调用
+            // 完成后必须执行写完成流程，静态缓冲区的块跨越尾部时bufs有两段
+            // handle关闭时写请求还没完成的话，连接会等到写完成流程执行后再回收，所以关闭时后端要尽快取消未完成的写请求
+            int (*write)(io_stream_connection *connection, uv_write_t *req, const uv_buf_t *bufs, unsigned int nbufs);
+        };
+
         // 以下不是POD类型，所以不得不暴露出来
         struct io_stream_connection {
             typedef enum {
@@ -114,6 +139,9 @@ namespace atbus {
                 EN_CF_ACCEPT,
                 EN_CF_WRITING,
                 EN_CF_CLOSING,
+                EN_CF_SHUTDOWN, // handle已提交关闭，等待关闭回调后回收
+                EN_CF_TRIMMED,  // 空闲时已释放静态发送缓冲区，下次发送时重新分配
+                EN_CF_CLOSED,   // handle已关闭，还有未完成的写请求，写完成后回收
                 EN_CF_MAX,
             } flag_t;
 
@@ -125,23 +153,32 @@ namespace atbus {
             status_t status; // 状态
             int flags;       // flag
             io_stream_channel *channel;
+            uint32_t slot_index; // 在channel连接表中的下标
+            uint32_t ref_count;  // 侵入式引用计数，连接表持有一个引用
 
             // 事件响应
             io_stream_callback_evt_t evt;
             io_stream_callback_t act_disc_cbk; // 主动关闭连接的回调（为了减少额外分配而采用的缓存策略）
 
             // 数据区域
-            ::atbus::detail::buffer_manager read_buffers; // 读数据缓冲区(两种Buffer管理方式，一种动态，一种静态)
-                                                          /**
-                                                           * @brief 由于大多数数据包都比较小
-                                                           *        当数据包比较小时和动态直接放在动态int的数据包一起，这样可以减少内存拷贝次数
-                                                           */
+            /**
+             * @brief 由于大多数数据包都比较小
+             *        当数据包比较小时和动态直接放在动态int的数据包一起，这样可以减少内存拷贝次数
+             *        大数据包才从channel共享的接收缓冲池中申请缓冲区，回调后立即归还，所以空闲连接不占用接收缓冲区
+             */
             typedef struct {
                 char buffer[ATBUS_MACRO_DATA_SMALL_SIZE]; // varint数据暂存区和小数据包存储区
                 size_t len;                               // varint数据暂存区和小数据包存储区已使用长度
             } read_head_t;
             read_head_t read_head;
+            ::atbus::detail::buffer_block *read_block; // 正在接收的大数据包缓冲区(32位hash+数据)，为NULL时表示正在接收head
+            size_t read_block_len;                     // 大数据包总长度
+            size_t read_block_used;                    // 大数据包已接收长度
             ::atbus::detail::buffer_manager write_buffers; // 写数据缓冲区(两种Buffer管理方式，一种动态，一种静态)
+            uint64_t active_time;                          // 最后一次收发数据的时间(事件循环时间，毫秒)
+
+            // 后端数据区域
+            void *backend_data;
 
             // 自定义数据区域
             void *data;
@@ -153,10 +190,10 @@ namespace atbus {
             bool is_noblock;
             bool is_nodelay;
             size_t send_buffer_static;
-            size_t recv_buffer_static;
+            size_t recv_buffer_static; // 共享接收缓冲池最多缓存多少个recv_buffer_max_size的空闲内存
             size_t send_buffer_max_size;
             size_t send_buffer_limit_size;
-            size_t recv_buffer_max_size;
+            size_t recv_buffer_max_size; // 单个接收数据包(包含32位hash)的最大长度
             size_t recv_buffer_limit_size;
 
             int backlog; // backlog indicates the number of connections the kernel might queue
@@ -165,6 +202,47 @@ namespace atbus {
             size_t max_read_net_eagain_count;
             size_t max_read_check_block_size_failed_count;
             size_t max_read_check_hash_failed_count;
+
+            int backend;                        // IO后端类型，参见 io_stream_backend_t::type_t
+            size_t io_uring_queue_depth;        // io_uring 提交队列长度
+            size_t io_uring_recv_buffer_number; // io_uring 注册的接收缓冲区个数(会向上取整到2的幂)
+            size_t io_uring_recv_buffer_size;   // io_uring 注册的接收缓冲区单块大小
+        };
+
+        /**
+         * @brief 连接表的槽位，下标+代数组成连接ID，槽位复用时代数递增，用于识别过期的连接ID
+         */
+        struct io_stream_connection_slot {
+            io_stream_connection *conn; // 为NULL时表示空闲
+            uint32_t generation;        // 代数
+            uint32_t next_free;         // 空闲链表的下一个槽位
+        };
+
+        /**
+         * @brief 连接表，稠密数组+空闲链表复用，代替哈希表以减少连接创建和关闭时的哈希和内存分配开销
+         */
+        struct io_stream_connection_table {
+            typedef std::vector<io_stream_connection_slot> slot_array_t;
+            slot_array_t slots;
+            uint32_t free_head;   // 空闲链表头
+            size_t active_number; // 正常的连接数量
+            size_t gc_number;     // 等待关闭回调回收的连接数量
+        };
+
+#define ATBUS_CHANNEL_IOS_INVALID_SLOT 0xFFFFFFFFU
+
+#define ATBUS_CHANNEL_IOS_RECV_POOL_MIN_SHIFT 12
+#define ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER 12
+
+        /**
+         * @brief 共享接收缓冲池，按2的幂分级缓存空闲的大数据包缓冲区，所有连接共用
+         * @note 最小级别为 (1 << ATBUS_CHANNEL_IOS_RECV_POOL_MIN_SHIFT)，超出最大级别的缓冲区直接释放不缓存
+         */
+        struct io_stream_recv_buffer_pool {
+            std::vector< ::atbus::detail::buffer_block *> free_blocks[ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER];
+            size_t free_low_watermark[ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER]; // 上次回收后各级空闲缓冲区数量的最小值
+            size_t cached_size;                                                  // 池中空闲的缓冲区大小
+            size_t using_size;                                                   // 正在被连接使用的缓冲区大小
         };
 
         struct io_stream_channel {
@@ -180,10 +258,12 @@ namespace atbus {
 
             io_stream_conf conf;
 
-            typedef ATBUS_ADVANCE_TYPE_MAP(adapter::fd_t, std::shared_ptr<io_stream_connection>) conn_pool_t;
-            conn_pool_t conn_pool;
-            typedef ATBUS_ADVANCE_TYPE_MAP(uintptr_t, std::shared_ptr<io_stream_connection>) conn_gc_pool_t;
-            conn_gc_pool_t conn_gc_pool;
+            const io_stream_backend_t *backend; // 实际使用的IO后端
+            void *backend_data;                 // 后端数据区域
+
+            io_stream_connection_table conn_table; // 所有连接(包括等待回收的)
+            io_stream_recv_buffer_pool recv_pool;  // 共享接收缓冲池
+            size_t write_resident_size;            // 所有连接的发送缓冲区常驻内存，由各连接的write_buffers增量维护
 
             // 事件响应
             io_stream_callback_evt_t evt;
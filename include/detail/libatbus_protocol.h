@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstddef>
+#include <new>
 #include <ostream>
 #include <stdint.h>
 
@@ -14,6 +15,14 @@
 
 #include <msgpack.hpp>
 
+#include "detail/inline_vector.h"
+#include "detail/libatbus_allocator.h"
+
+// 路由表内联存储的节点数，超过时才分配内存
+#ifndef ATBUS_MACRO_ROUTER_INLINE_SIZE
+#define ATBUS_MACRO_ROUTER_INLINE_SIZE 8
+#endif
+
 enum ATBUS_PROTOCOL_CMD {
     ATBUS_CMD_INVALID = 0,
 
@@ -89,13 +98,14 @@ namespace atbus {
             int custom_route_type;
             std::string src_type_name;
             bool broadcast_cross_group; //
+            std::string routing_key; // 非空时单播按这个key一致性哈希，相同key总是发到同一个目标，有自定义路由回调时在回调的候选里哈希
             enum custom_route_type_t {
                 CUSTOM_ROUTE_UNICAST = 0,
                 CUSTOM_ROUTE_MULTICAST = 1,
                 CUSTOM_ROUTE_BROADCAST = 2, //通过服务发现方式广播
                 CUSTOM_ROUTE_BROADCAST2 = 3, //通过bus系统广播
             };
-            MSGPACK_DEFINE(type_name, tags, custom_route_type, src_type_name, broadcast_cross_group);
+            MSGPACK_DEFINE(type_name, tags, custom_route_type, src_type_name, broadcast_cross_group, routing_key);
             custom_route_data():custom_route_type(0), broadcast_cross_group(false){
 
             }
@@ -115,15 +125,22 @@ namespace atbus {
                 }
                 os << "      src_type_name: " << mbc.src_type_name << std::endl;
                 os << "      broadcast_cross_group: " << mbc.broadcast_cross_group << std::endl;
+                if (!mbc.routing_key.empty()) {
+                    os << "      routing_key: " << mbc.routing_key << std::endl;
+                }
                 os << "    }";
                 return os;
             }
         };
 
         struct forward_data {
+            // 不兼容改动: router以前是std::vector<ATBUS_MACRO_BUSID_TYPE>，现在是内联数组
+            // 支持下标、迭代器、size/push_back/pop_back/resize/clear，需要std::vector时用vec.assign(router.begin(), router.end())复制
+            typedef ::atbus::detail::inline_vector<ATBUS_MACRO_BUSID_TYPE, ATBUS_MACRO_ROUTER_INLINE_SIZE> router_t;
+
             ATBUS_MACRO_BUSID_TYPE from;                // ID: 0
             ATBUS_MACRO_BUSID_TYPE to;                  // ID: 1
-            std::vector<ATBUS_MACRO_BUSID_TYPE> router; // ID: 2
+            router_t router;                            // ID: 2
             bin_data_block content;                     // ID: 3
             int flags;                                  // ID: 4 | require a response message even success
             std::shared_ptr<custom_route_data> route_data;              // ID: 5
@@ -184,10 +201,15 @@ namespace atbus {
             bool flags;                    // ID: 2
             ATBUS_MACRO_BUSID_TYPE children_id_mask;
             std::vector<node_data> children;
+            bool removed;                       // ID: 5, 增量同步时表示节点已下线
+            std::string hostname;               // ID: 6
+            std::vector<channel_data> channels; // ID: 7, 节点的监听地址，用于全局路由时直连
+            std::string type_name;              // ID: 8, 节点类型，用于过滤广播
+            std::vector<std::string> tags;      // ID: 9, 节点tags，用于过滤广播
 
-            node_data() : bus_id(0), overwrite(false), flags(0), children_id_mask(0) {}
+            node_data() : bus_id(0), overwrite(false), flags(0), children_id_mask(0), removed(false) {}
 
-            MSGPACK_DEFINE(bus_id, overwrite, flags, children_id_mask, children);
+            MSGPACK_DEFINE(bus_id, overwrite, flags, children_id_mask, children, removed, hostname, channels, type_name, tags);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const node_data &mbc) {
@@ -196,6 +218,10 @@ namespace atbus {
                    << "        overwrite: " << mbc.overwrite << std::endl
                    << "        flags: " << mbc.flags << std::endl
                    << "        children_id_mask: " << mbc.children_id_mask << std::endl
+                   << "        removed: " << mbc.removed << std::endl
+                   << "        hostname: " << mbc.hostname << std::endl
+                   << "        type_name: " << mbc.type_name << std::endl
+                   << "        channels: (" << mbc.channels.size() << ")" << std::endl
                    << "        children: (" << mbc.children.size() << ")" << std::endl;
                 for (size_t i = 0; i < mbc.children.size(); ++i) {
                     os << "      " << mbc.children[i] << std::endl;
@@ -208,12 +234,18 @@ namespace atbus {
 
         struct node_tree {
             std::vector<node_data> nodes; // ID: 0
+            uint64_t version;             // ID: 1, 发送方路由表版本号(请求包里是请求方已收到的版本号)
+            uint64_t base_version;        // ID: 2, 增量的起始版本号，0表示全量
+
+            node_tree() : version(0), base_version(0) {}
 
-            MSGPACK_DEFINE(nodes);
+            MSGPACK_DEFINE(nodes, version, base_version);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const node_tree &mbc) {
                 os << "{" << std::endl;
+                os << "      version: " << mbc.version << std::endl;
+                os << "      base_version: " << mbc.base_version << std::endl;
                 for (size_t i = 0; i < mbc.nodes.size(); ++i) {
                     os << "      nodes: " << mbc.nodes[i] << std::endl;
                 }
@@ -301,29 +333,12 @@ namespace atbus {
 
             msg_body() : forward(NULL), sync(NULL), ping(NULL), reg(NULL), conn(NULL), custom(NULL) {}
             ~msg_body() {
-                if (NULL != forward) {
-                    delete forward;
-                }
-
-                if (NULL != sync) {
-                    delete sync;
-                }
-
-                if (NULL != ping) {
-                    delete ping;
-                }
-
-                if (NULL != reg) {
-                    delete reg;
-                }
-
-                if (NULL != conn) {
-                    delete conn;
-                }
-
-                if (NULL != custom) {
-                    delete custom;
-                }
+                destroy_body(forward);
+                destroy_body(sync);
+                destroy_body(ping);
+                destroy_body(reg);
+                destroy_body(conn);
+                destroy_body(custom);
             }
 
             template <typename TPtr>
@@ -332,7 +347,13 @@ namespace atbus {
                     return p;
                 }
 
-                return p = new TPtr();
+                // 消息体使用可替换的内存分配接口，并且释放后由当前线程缓存复用
+                void *buffer = ::atbus::detail::fn::allocate_object(sizeof(TPtr));
+                if (NULL == buffer) {
+                    return NULL;
+                }
+
+                return p = new (buffer) TPtr();
             }
 
             forward_data *make_forward(ATBUS_MACRO_BUSID_TYPE from, ATBUS_MACRO_BUSID_TYPE to, const void *buffer, size_t s) {
@@ -383,6 +404,17 @@ namespace atbus {
             }
 
         private:
+            template <typename TPtr>
+            static void destroy_body(TPtr *&p) {
+                if (NULL == p) {
+                    return;
+                }
+
+                p->~TPtr();
+                ::atbus::detail::fn::deallocate_object(p, sizeof(TPtr));
+                p = NULL;
+            }
+
             msg_body(const msg_body &);
             msg_body &operator=(const msg_body &);
         };
@@ -470,6 +502,65 @@ namespace msgpack {
 
 
 
+            template <typename T, size_t N>
+            struct convert<atbus::detail::inline_vector<T, N> > {
+                msgpack::object const &operator()(msgpack::object const &o, atbus::detail::inline_vector<T, N> &v) const {
+                    if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
+
+                    v.resize(o.via.array.size);
+                    for (uint32_t i = 0; i < o.via.array.size; ++i) {
+                        o.via.array.ptr[i].convert(v[i]);
+                    }
+                    return o;
+                }
+            };
+
+            template <typename T, size_t N>
+            struct pack<atbus::detail::inline_vector<T, N> > {
+                template <typename Stream>
+                packer<Stream> &operator()(msgpack::packer<Stream> &o, atbus::detail::inline_vector<T, N> const &v) const {
+                    o.pack_array(static_cast<uint32_t>(v.size()));
+                    for (size_t i = 0; i < v.size(); ++i) {
+                        o.pack(v[i]);
+                    }
+                    return o;
+                }
+            };
+
+            template <typename T, size_t N>
+            struct object_with_zone<atbus::detail::inline_vector<T, N> > {
+                void operator()(msgpack::object::with_zone &o, atbus::detail::inline_vector<T, N> const &v) const {
+                    o.type = type::ARRAY;
+                    if (v.empty()) {
+                        o.via.array.ptr  = NULL;
+                        o.via.array.size = 0;
+                        return;
+                    }
+
+                    o.via.array.size = static_cast<uint32_t>(v.size());
+                    o.via.array.ptr  = static_cast<msgpack::object *>(o.zone.allocate_align(sizeof(msgpack::object) * v.size()));
+                    for (size_t i = 0; i < v.size(); ++i) {
+                        o.via.array.ptr[i] = msgpack::object(v[i]);
+                    }
+                }
+            };
+
+            // 自定义路由数据使用可替换的内存分配接口
+            template <>
+            struct convert<std::shared_ptr<atbus::protocol::custom_route_data> > {
+                msgpack::object const &operator()(msgpack::object const &o, std::shared_ptr<atbus::protocol::custom_route_data> &v) const {
+                    if (o.is_nil()) {
+                        v.reset();
+                    } else {
+                        std::shared_ptr<atbus::protocol::custom_route_data> val = std::allocate_shared<atbus::protocol::custom_route_data>(
+                            atbus::detail::stl_allocator<atbus::protocol::custom_route_data>());
+                        o.convert(*val);
+                        v = val;
+                    }
+                    return o;
+                }
+            };
+
             template <>
             struct convert<atbus::protocol::bin_data_block> {
                 msgpack::object const &operator()(msgpack::object const &o, atbus::protocol::bin_data_block &v) const {
@@ -502,6 +593,14 @@ namespace msgpack {
 
             template <>
             struct convert<atbus::protocol::msg> {
+                // 消息体分配失败时抛出异常，和msgpack自身的解包错误走同一个流程
+                template <typename TPtr>
+                static void convert_body(msgpack::object const &o, atbus::protocol::msg_body &body, TPtr *&p) {
+                    TPtr *res = body.make_body(p);
+                    if (NULL == res) throw std::bad_alloc();
+                    o.convert(*res);
+                }
+
                 msgpack::object const &operator()(msgpack::object const &o, atbus::protocol::msg &v) const {
                     if (o.type != msgpack::type::MAP) throw msgpack::type_error();
                     msgpack::object body_obj;
@@ -521,35 +620,36 @@ namespace msgpack {
 
                         case ATBUS_CMD_DATA_TRANSFORM_REQ:
                         case ATBUS_CMD_DATA_TRANSFORM_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.forward));
+                            convert_body(body_obj, v.body, v.body.forward);
                             break;
                         }
 
                         case ATBUS_CMD_CUSTOM_CMD_REQ:
                         case ATBUS_CMD_CUSTOM_CMD_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.custom));
+                            convert_body(body_obj, v.body, v.body.custom);
                             break;
                         }
 
+                        case ATBUS_CMD_NODE_SYNC_REQ:
                         case ATBUS_CMD_NODE_SYNC_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.sync));
+                            convert_body(body_obj, v.body, v.body.sync);
                             break;
                         }
 
                         case ATBUS_CMD_NODE_REG_REQ:
                         case ATBUS_CMD_NODE_REG_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.reg));
+                            convert_body(body_obj, v.body, v.body.reg);
                             break;
                         }
 
                         case ATBUS_CMD_NODE_CONN_SYN: {
-                            body_obj.convert(*v.body.make_body(v.body.conn));
+                            convert_body(body_obj, v.body, v.body.conn);
                             break;
                         }
 
                         case ATBUS_CMD_NODE_PING:
                         case ATBUS_CMD_NODE_PONG: {
-                            body_obj.convert(*v.body.make_body(v.body.ping));
+                            convert_body(body_obj, v.body, v.body.ping);
                             break;
                         }
 
@@ -596,6 +696,7 @@ namespace msgpack {
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_SYNC_REQ:
                     case ATBUS_CMD_NODE_SYNC_RSP: {
                         if (NULL == v.body.sync) {
                             o.pack_nil();
@@ -678,6 +779,7 @@ namespace msgpack {
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_SYNC_REQ:
                     case ATBUS_CMD_NODE_SYNC_RSP: {
                         if (NULL == v.body.sync) {
                             o.via.map.ptr[1].val = msgpack::object();
@@ -0,0 +1,102 @@
+﻿/**
+ * @brief 数据转发消息的紧凑编码，固定长度的小端消息头后直接跟随路由表和数据
+ * @note 仅用于 ATBUS_CMD_DATA_TRANSFORM_REQ/ATBUS_CMD_DATA_TRANSFORM_RSP，其他消息仍然使用msgpack
+ * @note 需要在注册时协商双方都支持(endpoint::flag_t::COMPACT_DATA)才会发送，接收端总是可以解码
+ *
+ * 布局(小端):
+ *   0   magic (uint8_t, ATBUS_COMPACT_DATA_MAGIC)
+ *   1   cmd (uint8_t)
+ *   2   reserved (uint16_t)
+ *   4   head.type (int32_t)
+ *   8   head.ret (int32_t)
+ *   12  forward.flags (int32_t)
+ *   16  head.sequence (uint64_t)
+ *   24  head.src_bus_id (uint64_t)
+ *   32  forward.from (uint64_t)
+ *   40  forward.to (uint64_t)
+ *   48  router count (uint32_t)
+ *   52  content length (uint32_t)
+ *   56  router (uint64_t * router count)
+ *   ... content
+ */
+
+#ifndef LIBATBUS_DETAIL_LIBATBUS_PROTOCOL_COMPACT_H
+#define LIBATBUS_DETAIL_LIBATBUS_PROTOCOL_COMPACT_H
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "detail/libatbus_protocol.h"
+
+// 0xC1 是msgpack中永远不会使用的类型字节，用来区分紧凑编码和msgpack编码
+#ifndef ATBUS_COMPACT_DATA_MAGIC
+#define ATBUS_COMPACT_DATA_MAGIC 0xC1
+#endif
+
+#define ATBUS_COMPACT_DATA_HEAD_SIZE 56
+
+namespace atbus {
+    namespace detail {
+        namespace fn {
+            /**
+             * @brief 检查消息是否可以使用紧凑编码
+             * @note 必须是带forward数据的数据转发消息，并且没有自定义路由数据
+             */
+            bool compact_data_check(const protocol::msg &m);
+
+            /**
+             * @brief 检查数据是否是紧凑编码
+             */
+            bool compact_data_check_magic(const void *buffer, size_t s);
+
+            /**
+             * @brief 计算紧凑编码后的长度
+             * @return 紧凑编码后的长度，不能使用紧凑编码时返回0
+             */
+            size_t compact_data_packed_size(const protocol::msg &m);
+
+            /**
+             * @brief 使用紧凑编码打包消息
+             * @param m 消息
+             * @param buffer 输出缓冲区
+             * @param s 输出缓冲区长度
+             * @return 打包后的长度，不能使用紧凑编码或缓冲区不足时返回0
+             */
+            size_t compact_data_pack(const protocol::msg &m, void *buffer, size_t s);
+
+            /**
+             * @brief 计算紧凑编码的消息头和路由表的长度(不包含数据)
+             * @return 消息头和路由表的长度，不能使用紧凑编码时返回0
+             */
+            size_t compact_data_head_size(const protocol::msg &m);
+
+            /**
+             * @brief 只打包消息头和路由表，数据部分由调用方直接跟在后面发送(比如转发时直接引用接收到的数据)
+             * @param m 消息
+             * @param buffer 输出缓冲区
+             * @param s 输出缓冲区长度
+             * @return 打包后的长度，不能使用紧凑编码或缓冲区不足时返回0
+             */
+            size_t compact_data_pack_head(const protocol::msg &m, void *buffer, size_t s);
+
+            /**
+             * @brief 修改已打包数据里的forward.to，用于广播时多个目标共用一份打包数据
+             * @return 成功返回true
+             */
+            bool compact_data_set_to(void *buffer, size_t s, uint64_t to);
+
+            /**
+             * @brief 解码紧凑编码的消息
+             * @param m 输出消息，content直接引用buffer的数据
+             * @param buffer 数据
+             * @param s 数据长度
+             * @return 0或错误码
+             */
+            int compact_data_unpack(protocol::msg &m, const void *buffer, size_t s);
+        } // namespace fn
+    }     // namespace detail
+} // namespace atbus
+
+#endif
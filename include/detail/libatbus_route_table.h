@@ -0,0 +1,192 @@
+﻿/**
+ * @brief 全局路由表，由节点同步协议(ATBUS_CMD_NODE_SYNC_REQ/ATBUS_CMD_NODE_SYNC_RSP)维护
+ * @note 每条记录都带有本地版本号，下线的节点保留墓碑记录，这样可以按版本号生成增量
+ * @note 记录按来源节点区分，直连节点的信息优先于转发来的信息
+ * @note 同时按type_name和tag索引节点ID，用于判断某个子树里是否有广播的订阅者
+ */
+
+#ifndef LIBATBUS_DETAIL_LIBATBUS_ROUTE_TABLE_H
+#define LIBATBUS_DETAIL_LIBATBUS_ROUTE_TABLE_H
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "detail/libatbus_protocol.h"
+
+namespace atbus {
+    namespace detail {
+        class route_table {
+        public:
+            typedef ATBUS_MACRO_BUSID_TYPE bus_id_t;
+
+            struct entry_t {
+                bus_id_t bus_id;
+                uint32_t children_mask;
+                bus_id_t source;  // 信息来源节点，自身和直连节点的来源是自己
+                uint64_t version; // 最后一次变更时的本地版本号
+                bool removed;     // 墓碑标记，用于增量同步下线信息
+                std::string hostname;
+                std::vector<std::string> listen;
+                std::string type_name;
+                std::vector<std::string> tags;
+
+                entry_t();
+            };
+
+            /**
+             * @brief 节点ID范围，用于过滤同步的内容
+             * @note inside为true时表示范围内的节点，否则表示范围外的节点
+             */
+            struct scope_t {
+                bus_id_t id;
+                uint32_t children_mask;
+                bool inside;
+
+                scope_t();
+                scope_t(bus_id_t i, uint32_t m, bool in);
+
+                bool contains(bus_id_t tid) const;
+            };
+
+            /**
+             * @brief 同步对端的版本号状态
+             */
+            struct peer_t {
+                uint64_t sent_version;    // 最后一次发给对端的本地版本号
+                uint64_t recv_version;    // 最后一次收到的对端版本号
+                uint64_t checked_version; // 已确认没有需要发给对端的变更的版本号，生成增量时跳过这之前的记录
+
+                peer_t();
+            };
+
+            typedef std::map<bus_id_t, entry_t> entry_map_t;
+            typedef std::map<bus_id_t, peer_t> peer_map_t;
+
+        public:
+            route_table();
+
+            void reset(bus_id_t self_id);
+
+            inline bus_id_t get_self_id() const { return self_id_; }
+
+            /**
+             * @brief 获取当前版本号，每次有记录变更都会增加
+             */
+            inline uint64_t get_version() const { return version_; }
+
+            /**
+             * @brief 获取已清理的墓碑记录的最大版本号，比这个更早的增量只能用全量代替
+             */
+            inline uint64_t get_purged_version() const { return purged_version_; }
+
+            /**
+             * @brief 有效的记录数量(不包含墓碑)
+             */
+            inline size_t size() const { return live_count_; }
+
+            inline const entry_map_t &get_entries() const { return entries_; }
+
+            /**
+             * @brief 设置自身或直连节点的信息
+             * @note listen为空时保留已知的监听地址
+             * @return 是否有变更
+             */
+            bool update_direct(bus_id_t id, uint32_t children_mask, const std::string &hostname, const std::list<std::string> &listen,
+                               const std::string &type_name, const std::vector<std::string> &tags);
+
+            /**
+             * @brief 移除某个节点以及所有来源于它的信息，并移除它的同步状态
+             * @return 变更的记录数量
+             */
+            size_t remove_source(bus_id_t source);
+
+            /**
+             * @brief 应用对端发来的同步数据
+             * @param tree 同步数据，base_version为0时表示全量，会移除来源于source但不在tree中的记录
+             * @param source 来源节点
+             * @param scope 允许来源节点同步的范围，范围外的记录会被忽略
+             * @return 变更的记录数量
+             */
+            size_t apply(const protocol::node_tree &tree, bus_id_t source, const scope_t &scope);
+
+            /**
+             * @brief 生成从since开始的增量
+             * @param since 对端已收到的版本号，0或者早于已清理的墓碑时生成全量
+             * @param scope 同步范围
+             * @param out 输出的同步数据
+             * @param checked 已确认在范围外的版本号，不需要再遍历这之前的记录
+             * @return 输出的记录数量
+             */
+            size_t make_delta(uint64_t since, const scope_t &scope, protocol::node_tree &out, uint64_t checked = 0) const;
+
+            /**
+             * @brief 查找覆盖tid的子域最小的有效节点
+             */
+            const entry_t *find(bus_id_t tid) const;
+
+            /**
+             * @brief 按ID获取记录，可能是墓碑
+             */
+            const entry_t *get(bus_id_t id) const;
+
+            /**
+             * @brief 子域内是否有匹配的有效节点(包含子域节点自身)
+             * @param id 子域节点ID
+             * @param children_mask 子域位数
+             * @param type_name 要求的类型，为空时不限制
+             * @param tag 要求的tag，为空时不限制
+             * @note 类型和tag分别判断，可能是不同的节点匹配，只会多判定不会漏判定
+             */
+            bool has_subscriber(bus_id_t id, uint32_t children_mask, const std::string &type_name, const std::string &tag) const;
+
+            /**
+             * @brief 清理版本号不超过version的墓碑记录
+             * @return 清理的记录数量
+             */
+            size_t purge(uint64_t version);
+
+            peer_t &mutable_peer(bus_id_t id);
+            const peer_t *get_peer(bus_id_t id) const;
+            inline const peer_map_t &get_peers() const { return peers_; }
+
+        private:
+            bool set_entry(bus_id_t id, uint32_t children_mask, bus_id_t source, const std::string &hostname,
+                           const std::vector<std::string> &listen, const std::string &type_name, const std::vector<std::string> &tags);
+            void remove_entry(entry_t &ent);
+
+            void add_index(const entry_t &ent);
+            void remove_index(const entry_t &ent);
+
+        private:
+            bus_id_t self_id_;
+            uint64_t version_;
+            uint64_t purged_version_;
+            size_t live_count_;
+            entry_map_t entries_;
+            peer_map_t peers_;
+
+            // 有效记录的索引，key为(子域位数, 子域下界)，查找时按子域位数从小到大查找
+            typedef std::map<std::pair<uint32_t, bus_id_t>, bus_id_t> range_index_t;
+            range_index_t range_index_;
+            std::map<uint32_t, size_t> mask_counter_;
+
+            // 版本号索引，生成增量时只需要遍历变更过的记录
+            typedef std::map<uint64_t, bus_id_t> version_index_t;
+            version_index_t version_index_;
+
+            // 订阅索引，key为type_name或tag，value为有序的节点ID，可以按子域范围查找
+            typedef std::map<std::string, std::set<bus_id_t> > subscriber_index_t;
+            subscriber_index_t type_index_;
+            subscriber_index_t tag_index_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
@@ -0,0 +1,141 @@
+﻿/**
+ * @brief 服务索引，按type_name和tag索引已知的对端，用于内置的自定义路由选择
+ * @note 对端加入和移除时增量更新，选择时不分配内存
+ * @note 分组只在reset时清理，所以get_members返回的指针在遍历时发送消息也不会失效
+ */
+
+#ifndef LIBATBUS_DETAIL_LIBATBUS_SERVICE_INDEX_H
+#define LIBATBUS_DETAIL_LIBATBUS_SERVICE_INDEX_H
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "detail/libatbus_config.h"
+
+// 一致性哈希环上每个对端的虚拟节点数
+#ifndef ATBUS_MACRO_SERVICE_VIRTUAL_NODES
+#define ATBUS_MACRO_SERVICE_VIRTUAL_NODES 64
+#endif
+
+namespace atbus {
+    namespace detail {
+        class service_index {
+        public:
+            typedef ATBUS_MACRO_BUSID_TYPE bus_id_t;
+
+            struct select_mode_t {
+                enum type {
+                    EN_SSM_ROUND_ROBIN = 0,    /** 轮询 **/
+                    EN_SSM_LEAST_OUTSTANDING,  /** 未完成请求数最少，节点转发需要回包的请求时计数，回包或超时后减少 **/
+                    EN_SSM_CONSISTENT_HASH,    /** 按key一致性哈希，对端增减时只影响少量key **/
+                    EN_SSM_RANDOM,             /** 随机 **/
+                    EN_SSM_MAX
+                };
+            };
+
+            typedef std::vector<bus_id_t> member_list_t;
+
+        private:
+            struct group_t {
+                member_list_t members;
+                size_t round_robin;
+                std::set<std::pair<uint64_t, bus_id_t> > load_index; // (未完成请求数, ID)
+                std::vector<std::pair<uint64_t, bus_id_t> > ring;    // (哈希值, ID)，有序
+                bool ring_dirty;
+
+                group_t();
+            };
+
+            struct type_group_t {
+                group_t all;
+                std::map<std::string, group_t> by_tag;
+            };
+
+            struct endpoint_info_t {
+                std::string type_name;
+                std::vector<std::string> tags;
+                uint64_t outstanding;
+
+                endpoint_info_t();
+            };
+
+        public:
+            service_index();
+
+            void reset();
+
+            /**
+             * @brief 添加或更新对端，type_name和tags都为空时不索引
+             * @return 是否有变更
+             */
+            bool add(bus_id_t id, const std::string &type_name, const std::vector<std::string> &tags);
+
+            /**
+             * @brief 移除对端
+             * @return 是否有变更
+             */
+            bool remove(bus_id_t id);
+
+            /**
+             * @brief 选择一个对端
+             * @param type_name 服务类型，为空时只按tag选择
+             * @param tag 要求的tag，为空时不限制
+             * @param mode 选择方式，参见 select_mode_t
+             * @param key 一致性哈希的key，其他选择方式忽略
+             * @return 选中的对端ID，没有可选的对端时返回0
+             */
+            bus_id_t select(const std::string &type_name, const std::string &tag, int mode, uint64_t key);
+
+            /**
+             * @brief 获取分组的所有对端，用于广播
+             * @return 分组不存在时返回NULL
+             */
+            const member_list_t *get_members(const std::string &type_name, const std::string &tag) const;
+
+            /**
+             * @brief 更新对端的未完成请求数，用于 EN_SSM_LEAST_OUTSTANDING
+             */
+            void add_outstanding(bus_id_t id, int64_t delta);
+
+            uint64_t get_outstanding(bus_id_t id) const;
+
+            inline size_t size() const { return endpoints_.size(); }
+
+            /**
+             * @brief 把业务的路由key(用户ID、房间ID等)转换为一致性哈希使用的key
+             */
+            static uint64_t hash_routing_key(const void *data, size_t sz);
+
+            /**
+             * @brief 在候选对端里按key一致性哈希选择(最高随机权重)，候选增减时只影响少量key
+             * @note 用于自定义路由回调给出的候选列表，不依赖索引
+             * @return 没有候选时返回0
+             */
+            static bus_id_t select_by_key(const member_list_t &candidates, uint64_t key);
+
+        private:
+            group_t *mutable_group(const std::string &type_name, const std::string &tag);
+            const group_t *get_group(const std::string &type_name, const std::string &tag) const;
+
+            void add_member(group_t &group, bus_id_t id, uint64_t outstanding);
+            void remove_member(group_t &group, bus_id_t id, uint64_t outstanding);
+
+            void rebuild_ring(group_t &group);
+
+        private:
+            typedef std::map<std::string, type_group_t> type_map_t;
+            type_map_t types_;
+            std::map<bus_id_t, endpoint_info_t> endpoints_;
+            uint64_t random_seed_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
@@ -0,0 +1,51 @@
+﻿/**
+ * @brief 多生产者单消费者的无锁收件箱，节点侵入式地嵌入到使用者的对象里
+ * @note 生产者用CAS把节点压到链表头，消费者用一次exchange取走整个链表再反转成push顺序
+ * @note 消费者每次取走全部节点，不会出现ABA问题，消费者侧也不需要加锁
+ */
+
+#ifndef LIBATBUS_DETAIL_MPSC_INBOX_H
+#define LIBATBUS_DETAIL_MPSC_INBOX_H
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "lock/atomic_int_type.h"
+
+namespace atbus {
+    namespace detail {
+        class mpsc_inbox {
+        public:
+            struct node_t {
+                node_t *next;
+            };
+
+        public:
+            mpsc_inbox();
+
+            /**
+             * @brief 压入节点(任意线程)
+             * @return 压入前收件箱是否为空，为空时需要唤醒消费者
+             */
+            bool push(node_t *n);
+
+            /**
+             * @brief 取出所有节点(消费者线程)
+             * @return 按push顺序链接的节点，同一个生产者的节点保持顺序，没有节点时返回NULL
+             */
+            node_t *pop_all();
+
+            bool empty() const;
+
+        private:
+            mpsc_inbox(const mpsc_inbox &);
+            mpsc_inbox &operator=(const mpsc_inbox &);
+
+            util::lock::atomic_int_type<uintptr_t> head_; // 最后压入的节点
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
@@ -0,0 +1,91 @@
+﻿/**
+ * @brief 内存/共享内存通道的轮询调度，通道按添加顺序放在连续数组里
+ * @note 连续空闲的通道按2的幂次跳过若干轮，最多跳过max_backoff轮
+ * @note 有数据的通道按字节做赤字轮询(DRR)，每轮增加quantum字节配额，避免大消息的通道占满一帧
+ * @note 遍历期间移除的通道只做标记，下一轮开始前compact时才真正移除
+ */
+
+#ifndef LIBATBUS_DETAIL_POLL_SCHEDULER_H
+#define LIBATBUS_DETAIL_POLL_SCHEDULER_H
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+namespace atbus {
+    namespace detail {
+        class poll_scheduler {
+        public:
+            enum {
+                MAX_BACKOFF_SHIFT = 16,
+            };
+
+            struct channel_t {
+                void *data;         // 使用者的对象，NULL表示已移除
+                size_t idle_rounds; // 连续空闲的次数
+                size_t skip_left;   // 还要跳过的轮次
+                int64_t deficit;    // 剩余的字节配额，可能因为最后一条消息超出配额而为负数
+            };
+
+        public:
+            poll_scheduler();
+
+            /**
+             * @brief 移除所有通道并设置参数
+             * @param quantum 每轮增加的字节配额，0则不限制
+             * @param max_backoff 空闲通道最多跳过的轮次，0则每轮都检查
+             */
+            void reset(size_t quantum, size_t max_backoff);
+
+            void add(void *data);
+
+            /**
+             * @brief 移除通道，只做标记
+             * @return 是否找到
+             */
+            bool remove(void *data);
+
+            /**
+             * @brief 清理已移除的通道，不能在遍历期间调用
+             */
+            void compact();
+
+            inline size_t size() const { return channels_.size(); }
+            inline bool empty() const { return channels_.empty(); }
+            inline void *get(size_t idx) const { return channels_[idx].data; }
+            inline const channel_t &at(size_t idx) const { return channels_[idx]; }
+
+            /**
+             * @brief 本轮是否要检查这个通道，跳过时减少剩余的跳过次数
+             */
+            bool check(size_t idx);
+
+            /**
+             * @brief 通道没有数据，增加跳过的轮次并清空配额
+             */
+            void on_idle(size_t idx);
+
+            /**
+             * @brief 通道有数据，增加本轮配额
+             * @return 本轮可以接收的字节数，0表示上一轮超出的配额还没还完，本轮不接收
+             */
+            size_t grant(size_t idx);
+
+            /**
+             * @brief 扣除本轮接收的字节数
+             * @param drained 接收后通道是否已经没有数据，没有数据时清空配额
+             */
+            void consume(size_t idx, size_t bytes, bool drained);
+
+        private:
+            std::vector<channel_t> channels_;
+            size_t quantum_;
+            size_t max_backoff_;
+            bool has_removed_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
@@ -0,0 +1,109 @@
+﻿/**
+ * @brief 发给自己的消息队列，所有消息按顺序放在一块连续的环形内存里
+ * @note 每条消息由记录头、各段长度和数据组成，记录不会跨越缓冲区末尾
+ * @note 空间不足时扩容到两倍，正在读取的记录所在的旧缓冲区会保留到pop_front，所以回调里可以继续push
+ * @note 每次取空时，如果从上次取空到现在的已用空间峰值低于容量的1/SHRINK_RATIO就缩容，突发的大量消息处理完以后不会一直占用内存
+ * @note 缓冲区通过 stl_allocator 分配，和其他热路径内存一样可以替换分配器
+ */
+
+#ifndef LIBATBUS_DETAIL_SELF_MSG_RING_H
+#define LIBATBUS_DETAIL_SELF_MSG_RING_H
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+#include "detail/libatbus_allocator.h"
+
+namespace atbus {
+    namespace detail {
+        class self_msg_ring {
+        public:
+            enum {
+                ALIGN_SIZE      = 8,
+                MIN_BUFFER_SIZE = 4096,
+                SHRINK_RATIO    = 4,
+            };
+
+            struct segment_t {
+                const void *ptr;
+                size_t size;
+            };
+
+            /**
+             * @brief 记录头，后面紧跟segment_count个size_t的段长度，然后是连续存放的各段数据
+             */
+            struct record_t {
+                uint32_t type;
+                uint32_t segment_count;
+                size_t length; // 整条记录占用的字节数，包含记录头和对齐
+
+                inline const size_t *get_segment_sizes() const { return reinterpret_cast<const size_t *>(this + 1); }
+                inline const unsigned char *get_data() const {
+                    return reinterpret_cast<const unsigned char *>(get_segment_sizes() + segment_count);
+                }
+            };
+
+        public:
+            self_msg_ring();
+
+            /**
+             * @brief 移除所有消息并释放内存
+             */
+            void reset();
+
+            /**
+             * @brief 追加一条消息，各段数据会按顺序连续复制
+             * @param type 消息类型，由使用者定义
+             * @param segments 数据段
+             * @param count 数据段数量
+             */
+            void push(uint32_t type, const segment_t *segments, size_t count);
+
+            /**
+             * @brief 获取最早的消息，返回的记录在pop_front之前一直有效(即使期间push导致扩容)
+             * @return 没有消息时返回NULL
+             */
+            const record_t *front();
+
+            /**
+             * @brief 移除最早的消息
+             */
+            void pop_front();
+
+            inline size_t size() const { return count_; }
+            inline bool empty() const { return 0 == count_; }
+            inline size_t capacity() const { return buffer_.size(); }
+
+            /**
+             * @brief 按顺序取出记录中的数据段
+             * @param r 记录
+             * @param out 输出的数据段，至少有r.segment_count个
+             */
+            static void get_segments(const record_t &r, segment_t *out);
+
+        private:
+            void grow(size_t need);
+            void shrink();
+            void relocate(size_t cap);
+            size_t used_size() const;
+            void copy_to(unsigned char *dst) const;
+            unsigned char *alloc(size_t len);
+
+        private:
+            typedef std::vector<unsigned char, stl_allocator<unsigned char> > buffer_t;
+            buffer_t buffer_;
+            buffer_t reading_buffer_; // 扩容时正在读取的记录所在的旧缓冲区
+            size_t head_;     // 第一条记录的位置
+            size_t tail_;     // 下一条记录的写入位置
+            size_t wrap_end_; // 绕回后上半段有效数据的结束位置，0表示没有绕回
+            size_t count_;
+            size_t peak_used_; // 上次取空以后的已用空间峰值
+            bool reading_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
@@ -0,0 +1,72 @@
+﻿/**
+ * @brief 每个线程独立的缓存实例，线程退出时调用缓存的release()释放缓存的内存
+ * @note 缓存类型T需要可以零初始化，并提供 size_t release() 接口
+ */
+
+#ifndef LIBATBUS_DETAIL_THREAD_CACHE_H
+#define LIBATBUS_DETAIL_THREAD_CACHE_H
+
+#pragma once
+
+#include <cstddef>
+
+#include "config/compiler_features.h"
+
+#if (defined(THREAD_TLS_USE_PTHREAD) && THREAD_TLS_USE_PTHREAD) || !defined(UTIL_CONFIG_THREAD_LOCAL)
+#include <pthread.h>
+#endif
+
+namespace atbus {
+    namespace detail {
+        template <typename T>
+        class thread_cache {
+        public:
+#if !(defined(THREAD_TLS_USE_PTHREAD) && THREAD_TLS_USE_PTHREAD) && defined(UTIL_CONFIG_THREAD_LOCAL)
+            static T *get() {
+                static UTIL_CONFIG_THREAD_LOCAL holder_t ret;
+                return &ret.data;
+            }
+
+        private:
+            struct holder_t {
+                T data;
+
+                ~holder_t() { data.release(); }
+            };
+#else
+            static T *get() {
+                (void)pthread_once(&tls_once(), init_tls);
+                T *ret = reinterpret_cast<T *>(pthread_getspecific(tls_key()));
+                if (NULL == ret) {
+                    ret = new T();
+                    pthread_setspecific(tls_key(), ret);
+                }
+                return ret;
+            }
+
+        private:
+            static pthread_once_t &tls_once() {
+                static pthread_once_t ret = PTHREAD_ONCE_INIT;
+                return ret;
+            }
+
+            static pthread_key_t &tls_key() {
+                static pthread_key_t ret;
+                return ret;
+            }
+
+            static void init_tls() { (void)pthread_key_create(&tls_key(), dtor_tls); }
+
+            static void dtor_tls(void *p) {
+                T *res = reinterpret_cast<T *>(p);
+                if (NULL != res) {
+                    res->release();
+                    delete res;
+                }
+            }
+#endif
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif // LIBATBUS_DETAIL_THREAD_CACHE_H
@@ -0,0 +1,119 @@
+﻿/**
+ * @brief 分层时间轮，毫秒精度，定时器节点侵入式地嵌入到使用者的对象里
+ * @note 添加和取消都是O(1)，不分配内存
+ * @note 第一层256个槽位(1毫秒)，后面三层各64个槽位，覆盖约18.6小时，更长的定时器到达最后一层后重新放置
+ * @note 节点析构时会自动从时间轮里移除
+ */
+
+#ifndef LIBATBUS_DETAIL_TIMER_WHEEL_H
+#define LIBATBUS_DETAIL_TIMER_WHEEL_H
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace atbus {
+    namespace detail {
+        class timer_wheel {
+        public:
+            enum {
+                LEVEL0_BITS  = 8,
+                LEVELN_BITS  = 6,
+                LEVELN_COUNT = 3,
+                LEVEL0_SIZE  = 1 << LEVEL0_BITS,
+                LEVELN_SIZE  = 1 << LEVELN_BITS,
+                TOTAL_BITS   = LEVEL0_BITS + LEVELN_BITS * LEVELN_COUNT,
+            };
+
+            class node_t {
+            public:
+                node_t();
+                ~node_t();
+
+                inline bool is_active() const { return NULL != owner_; }
+                inline uint64_t get_expire() const { return expire_; }
+
+                void *data; // 使用者的对象
+
+            private:
+                node_t(const node_t &);
+                node_t &operator=(const node_t &);
+
+                friend class timer_wheel;
+                node_t *prev_;
+                node_t *next_;
+                timer_wheel *owner_;
+                uint64_t expire_;
+                int level_; // -1表示已到期列表
+            };
+
+            typedef void (*foreach_fn_t)(node_t &, void *);
+            typedef void (*const_foreach_fn_t)(const node_t &, void *);
+
+        public:
+            timer_wheel();
+            ~timer_wheel();
+
+            /**
+             * @brief 移除所有定时器并设置当前时间
+             */
+            void reset(uint64_t now);
+
+            /**
+             * @brief 添加定时器，已经在时间轮里时会重新设置到期时间
+             * @param n 定时器节点
+             * @param expire 到期时间，毫秒
+             */
+            void add(node_t &n, uint64_t expire);
+
+            /**
+             * @brief 取消定时器
+             */
+            void cancel(node_t &n);
+
+            /**
+             * @brief 推进到now，并取出一个到期的定时器(到期时间不晚于now)
+             * @return 没有到期的定时器时返回NULL
+             */
+            node_t *pop_expired(uint64_t now);
+
+            /**
+             * @brief 遍历所有定时器，回调里不能修改时间轮
+             */
+            void for_each(foreach_fn_t fn, void *priv);
+            void for_each(const_foreach_fn_t fn, void *priv) const;
+
+            inline size_t size() const { return size_; }
+            inline bool empty() const { return 0 == size_; }
+
+            /**
+             * @brief 下一个还没处理的时间点，毫秒
+             */
+            inline uint64_t get_current() const { return current_; }
+
+        private:
+            timer_wheel(const timer_wheel &);
+            timer_wheel &operator=(const timer_wheel &);
+
+            void link(node_t &n);
+            void unlink(node_t &n);
+            void advance(uint64_t now);
+            void cascade(int level, size_t index);
+            void expire_all(uint64_t now);
+
+            static void init_head(node_t &head);
+            static void push_back(node_t &head, node_t &n);
+
+        private:
+            node_t level0_[LEVEL0_SIZE];
+            node_t leveln_[LEVELN_COUNT][LEVELN_SIZE];
+            node_t expired_;
+            uint64_t current_;
+            size_t size_;
+            size_t level0_size_;
+        };
+    } // namespace detail
+} // namespace atbus
+
+#endif
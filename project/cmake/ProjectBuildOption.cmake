@@ -21,6 +21,10 @@ set(ATBUS_MACRO_CONNECTION_BACKLOG 128 CACHE STRING "tcp backlog")
 # libuv选项
 set(LIBUV_ROOT "" CACHE STRING "libuv root directory")
 
+# io_uring选项(仅Linux，需要liburing 2.4以上)
+option(ATBUS_MACRO_ENABLE_IO_URING "Enable io_uring backend of io_stream channel when liburing is found." ON)
+set(LIBURING_ROOT "" CACHE STRING "liburing root directory")
+
 # 测试配置选项
 set(GTEST_ROOT "" CACHE STRING "GTest root directory")
 set(BOOST_ROOT "" CACHE STRING "Boost root directory")
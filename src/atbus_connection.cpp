@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <limits>
 #include <stdint.h>
 
 
@@ -17,9 +18,19 @@
 #include "atbus_node.h"
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_compact.h"
 
 namespace atbus {
     namespace detail {
+        /**
+         * @brief 解包时二进制数据直接引用接收缓冲区，不再复制到zone里
+         * @note 接收缓冲区(io_stream通道的read_head或共享接收缓冲池中的大数据包缓冲区，内存和共享内存通道的节点临时缓冲区)
+         *       在接收回调结束前一直有效，解出的protocol::msg也只在接收回调期间使用
+         */
+        static bool connection_unpack_reference_fn(msgpack::type::object_type type, std::size_t, void *) {
+            return msgpack::type::BIN == type;
+        }
+
         struct connection_async_data {
             node *owner_node;
             connection::ptr_t conn;
@@ -67,6 +78,7 @@ namespace atbus {
         flags_.reset();
         memset(&conn_data_, 0, sizeof(conn_data_));
         memset(&stat_, 0, sizeof(stat_));
+        connecting_timer_.data = this;
     }
 
     connection::ptr_t connection::create(node *owner) {
@@ -125,18 +137,36 @@ namespace atbus {
         memset(&stat_, 0, sizeof(stat_));
     }
 
-    int connection::proc(node &n, time_t sec, time_t usec) {
+    int connection::proc(node &n, time_t sec, time_t usec) { return proc(n, sec, usec, std::numeric_limits<size_t>::max(), NULL); }
+
+    int connection::proc(node &n, time_t sec, time_t usec, size_t max_bytes, size_t *recv_bytes) {
+        if (NULL != recv_bytes) {
+            *recv_bytes = 0;
+        }
+
         if (state_t::CONNECTED != state_) {
             return 0;
         }
 
         if (NULL != conn_data_.proc_fn) {
-            return conn_data_.proc_fn(n, *this, sec, usec);
+            return conn_data_.proc_fn(n, *this, sec, usec, max_bytes, recv_bytes);
         }
 
         return 0;
     }
 
+    bool connection::has_pending_data() {
+        if (state_t::CONNECTED != state_ || NULL == conn_data_.proc_fn) {
+            return false;
+        }
+
+        if (NULL != conn_data_.check_fn) {
+            return conn_data_.check_fn(*this);
+        }
+
+        return true;
+    }
+
     int connection::listen(const char *addr_str) {
         if (state_t::DISCONNECTED != state_) {
             return EN_ATBUS_ERR_ALREADY_INITED;
@@ -165,8 +195,9 @@ namespace atbus {
                 return res;
             }
 
-            conn_data_.proc_fn = mem_proc_fn;
-            conn_data_.free_fn = mem_free_fn;
+            conn_data_.proc_fn  = mem_proc_fn;
+            conn_data_.check_fn = mem_check_fn;
+            conn_data_.free_fn  = mem_free_fn;
 
             // 加入轮询队列
             conn_data_.shared.mem.channel = mem_chann;
@@ -196,8 +227,9 @@ namespace atbus {
                 return res;
             }
 
-            conn_data_.proc_fn = shm_proc_fn;
-            conn_data_.free_fn = shm_free_fn;
+            conn_data_.proc_fn  = shm_proc_fn;
+            conn_data_.check_fn = shm_check_fn;
+            conn_data_.free_fn  = shm_free_fn;
 
             // 加入轮询队列
             conn_data_.shared.shm.channel = shm_chann;
@@ -435,6 +467,46 @@ namespace atbus {
         return conn_data_.push_fn(*this, buffer, s);
     }
 
+    int connection::push_v(const void *const *buffers, const size_t *sizes, size_t count) {
+        if (0 == count) {
+            return push(NULL, 0);
+        } else if (1 == count) {
+            return push(buffers[0], sizes[0]);
+        }
+
+        size_t s = 0;
+        for (size_t i = 0; i < count; ++i) {
+            s += sizes[i];
+        }
+
+        if (NULL != conn_data_.push_v_fn && (state_t::CONNECTED == state_ || state_t::HANDSHAKING == state_)) {
+            ++stat_.push_start_times;
+            stat_.push_start_size += s;
+            return conn_data_.push_v_fn(*this, buffers, sizes, count);
+        }
+
+        // 通道不支持多个数据块时先合并
+        if (NULL == owner_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        node::msg_arena_guard_t arena_guard(owner_);
+        void *buffer = owner_->get_msg_arena().allocate(s);
+        if (NULL == buffer) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (sizes[i] > 0) {
+                memcpy(reinterpret_cast<char *>(buffer) + offset, buffers[i], sizes[i]);
+                offset += sizes[i];
+            }
+        }
+
+        return push(buffer, s);
+    }
+
     bool connection::is_connected() const { return state_t::CONNECTED == state_; }
 
     endpoint *connection::get_binding() { return binding_; }
@@ -508,6 +580,8 @@ namespace atbus {
                                       "channel handshaking(connect callback)");
             } else {
                 async_data->conn->state_ = state_t::CONNECTED;
+                // 已绑定的连接可用后可能有更优的发送通道
+                async_data->owner_node->invalidate_route_cache();
                 ATBUS_FUNC_NODE_DEBUG(*async_data->conn->owner_, async_data->conn->binding_, async_data->conn.get(), NULL,
                                       "channel connected(connect callback)");
             }
@@ -516,8 +590,9 @@ namespace atbus {
             async_data->conn->conn_data_.shared.ios_fd.conn    = connection;
 
             async_data->conn->conn_data_.free_fn = ios_free_fn;
-            async_data->conn->conn_data_.push_fn = ios_push_fn;
-            connection->data                     = async_data->conn.get();
+            async_data->conn->conn_data_.push_fn   = ios_push_fn;
+            async_data->conn->conn_data_.push_v_fn = ios_push_v_fn;
+            connection->data                       = async_data->conn.get();
 
             async_data->owner_node->on_new_connection(async_data->conn.get());
         }
@@ -557,9 +632,9 @@ namespace atbus {
         conn->stat_.pull_size += s;
 
         // unpack
-        msgpack::unpacked result;
+        node::unpack_zone_guard_t zone_guard(conn->owner_);
         protocol::msg m;
-        if (false == unpack(&result, *conn, m, buffer, s)) {
+        if (false == unpack(zone_guard.zone, *conn, m, buffer, s)) {
             return;
         }
 
@@ -584,7 +659,8 @@ namespace atbus {
         conn->flags_.set(flag_t::REG_FD, true);
 
         conn->conn_data_.free_fn = ios_free_fn;
-        conn->conn_data_.push_fn = ios_push_fn;
+        conn->conn_data_.push_fn   = ios_push_fn;
+        conn->conn_data_.push_v_fn = ios_push_v_fn;
 
         conn->conn_data_.shared.ios_fd.channel = channel;
         conn->conn_data_.shared.ios_fd.conn    = conn_ios;
@@ -649,15 +725,17 @@ namespace atbus {
     }
 
 #ifdef ATBUS_CHANNEL_SHM
-    int connection::shm_proc_fn(node &n, connection &conn, time_t /*sec*/, time_t /*usec*/) {
+    int connection::shm_proc_fn(node &n, connection &conn, time_t /*sec*/, time_t /*usec*/, size_t max_bytes, size_t *recv_bytes) {
         int ret                             = 0;
         size_t left_times                   = n.get_conf().loop_times;
+        size_t total_len                    = 0;
         detail::buffer_block *static_buffer = n.get_temp_static_buffer();
         if (NULL == static_buffer) {
             return ATBUS_FUNC_NODE_ERROR(n, NULL, &conn, EN_ATBUS_ERR_NOT_INITED, 0);
         }
 
-        while (left_times-- > 0) {
+        // 回调里断开连接后通道已经释放，不能再接收
+        while (left_times-- > 0 && total_len < max_bytes && state_t::CONNECTED == conn.state_) {
             size_t recv_len;
             int res = channel::shm_recv(conn.conn_data_.shared.shm.channel, static_buffer->data(), static_buffer->size(), &recv_len);
 
@@ -674,11 +752,15 @@ namespace atbus {
                 // statistic
                 ++conn.stat_.pull_times;
                 conn.stat_.pull_size += recv_len;
+                total_len += recv_len;
+                if (NULL != recv_bytes) {
+                    *recv_bytes = total_len;
+                }
 
                 // unpack
-                msgpack::unpacked result;
+                node::unpack_zone_guard_t zone_guard(&n);
                 protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
+                if (false == unpack(zone_guard.zone, conn, m, static_buffer->data(), recv_len)) {
                     continue;
                 }
 
@@ -690,6 +772,8 @@ namespace atbus {
         return ret;
     }
 
+    bool connection::shm_check_fn(connection &conn) { return channel::shm_has_data(conn.conn_data_.shared.shm.channel); }
+
     int connection::shm_free_fn(node &, connection &conn) { return channel::shm_close(conn.conn_data_.shared.shm.shm_key); }
 
     int connection::shm_push_fn(connection &conn, const void *buffer, size_t s) {
@@ -706,15 +790,17 @@ namespace atbus {
     }
 #endif
 
-    int connection::mem_proc_fn(node &n, connection &conn, time_t /*sec*/, time_t /*usec*/) {
+    int connection::mem_proc_fn(node &n, connection &conn, time_t /*sec*/, time_t /*usec*/, size_t max_bytes, size_t *recv_bytes) {
         int ret                             = 0;
         size_t left_times                   = n.get_conf().loop_times;
+        size_t total_len                    = 0;
         detail::buffer_block *static_buffer = n.get_temp_static_buffer();
         if (NULL == static_buffer) {
             return ATBUS_FUNC_NODE_ERROR(n, NULL, &conn, EN_ATBUS_ERR_NOT_INITED, 0);
         }
 
-        while (left_times-- > 0) {
+        // 回调里断开连接后通道已经释放，不能再接收
+        while (left_times-- > 0 && total_len < max_bytes && state_t::CONNECTED == conn.state_) {
             size_t recv_len;
             int res = channel::mem_recv(conn.conn_data_.shared.mem.channel, static_buffer->data(), static_buffer->size(), &recv_len);
 
@@ -731,11 +817,15 @@ namespace atbus {
                 // statistic
                 ++conn.stat_.pull_times;
                 conn.stat_.pull_size += recv_len;
+                total_len += recv_len;
+                if (NULL != recv_bytes) {
+                    *recv_bytes = total_len;
+                }
 
                 // unpack
-                msgpack::unpacked result;
+                node::unpack_zone_guard_t zone_guard(&n);
                 protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
+                if (false == unpack(zone_guard.zone, conn, m, static_buffer->data(), recv_len)) {
                     continue;
                 }
 
@@ -747,6 +837,8 @@ namespace atbus {
         return ret;
     }
 
+    bool connection::mem_check_fn(connection &conn) { return channel::mem_has_data(conn.conn_data_.shared.mem.channel); }
+
     int connection::mem_free_fn(node &, connection &) { return 0; }
 
     int connection::mem_push_fn(connection &conn, const void *buffer, size_t s) {
@@ -778,11 +870,34 @@ namespace atbus {
         return ret;
     }
 
-    bool connection::unpack(void *res, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s) {
+    int connection::ios_push_v_fn(connection &conn, const void *const *buffers, const size_t *sizes, size_t count) {
+        int ret = channel::io_stream_send_v(conn.conn_data_.shared.ios_fd.conn, buffers, sizes, count);
+        if (ret < 0) {
+            ++conn.stat_.push_failed_times;
+            for (size_t i = 0; i < count; ++i) {
+                conn.stat_.push_failed_size += sizes[i];
+            }
+        }
+        return ret;
+    }
+
+    bool connection::unpack(void *zone_ptr, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s) {
+        // 紧凑编码的数据转发消息只需要检查长度，数据直接引用buffer
+        if (detail::fn::compact_data_check_magic(buffer, s)) {
+            int res = detail::fn::compact_data_unpack(m, buffer, s);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, res, EN_ATBUS_ERR_UNPACK);
+                return false;
+            }
+
+            return true;
+        }
+
         try {
-            msgpack::unpacked *result = reinterpret_cast<msgpack::unpacked *>(res);
-            msgpack::unpack(*result, reinterpret_cast<const char *>(buffer), s);
-            msgpack::object obj = result->get();
+            // 使用外部传入的zone，以便在多个消息之间复用内存
+            msgpack::zone *zone = reinterpret_cast<msgpack::zone *>(zone_ptr);
+            msgpack::object obj =
+                msgpack::unpack(*zone, reinterpret_cast<const char *>(buffer), s, detail::connection_unpack_reference_fn);
             if (obj.is_nil()) {
                 ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
                 return false;
@@ -40,7 +40,10 @@ namespace atbus {
         return ret;
     }
 
-    endpoint::endpoint() : id_(0), children_mask_(0), pid_(0), owner_(NULL) { flags_.reset(); }
+    endpoint::endpoint() : id_(0), children_mask_(0), pid_(0), owner_(NULL) {
+        flags_.reset();
+        ping_timer_.data = this;
+    }
 
     endpoint::~endpoint() {
         flags_.set(flag_t::DESTRUCTING, true);
@@ -55,6 +58,9 @@ namespace atbus {
             return;
         }
         flags_.set(flag_t::RESETTING, true);
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
 
         // 需要临时给自身加引用计数，否则后续移除的过程中可能导致数据被提前释放
         ptr_t tmp_holder = watcher_.lock();
@@ -140,6 +146,11 @@ namespace atbus {
             return false;
         }
 
+        // 可用连接有变化，路由缓存失效
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
+
         if (force_data || ctrl_conn_) {
 
             data_conn_.push_back(conn->watcher_.lock());
@@ -176,6 +187,10 @@ namespace atbus {
 
         assert(this == conn->binding_);
 
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
+
         // 重置流程会在reset里清理对象，不需要再进行一次查找
         if (flags_.test(flag_t::RESETTING)) {
             conn->binding_ = NULL;
@@ -1,4 +1,5 @@
-﻿#include <sstream>
+﻿#include <limits>
+#include <sstream>
 
 #include "common/string_oprs.h"
 
@@ -8,6 +9,7 @@
 #include "atbus_node.h"
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_compact.h"
 
 namespace atbus {
 
@@ -149,23 +151,262 @@ namespace atbus {
         return ret;
     }
 
+    int msg_handler::send_node_sync_req(node &n, endpoint &ep, uint64_t since) {
+        protocol::msg m;
+        m.init(n.get_id(), ATBUS_CMD_NODE_SYNC_REQ, 0, 0, n.alloc_msg_seq());
+        protocol::node_tree *sync = m.body.make_body(m.body.sync);
+        if (NULL == sync) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        sync->version = since;
+        return n.send_ctrl_msg(ep.get_id(), m);
+    }
+
+    int msg_handler::send_node_sync_rsp(node &n, endpoint &ep, uint64_t since, bool force) {
+        detail::route_table::scope_t push_scope;
+        if (!n.get_node_sync_scope(ep, &push_scope, NULL)) {
+            return force ? EN_ATBUS_ERR_ACCESS_DENY : EN_ATBUS_ERR_SUCCESS;
+        }
+
+        protocol::msg m;
+        m.init(n.get_id(), ATBUS_CMD_NODE_SYNC_RSP, 0, 0, n.alloc_msg_seq());
+        protocol::node_tree *sync = m.body.make_body(m.body.sync);
+        if (NULL == sync) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        // 推送时跳过已经确认过不需要发送的记录，回复请求时按请求的版本号生成
+        detail::route_table &table        = n.get_route_table();
+        detail::route_table::peer_t &peer = table.mutable_peer(ep.get_id());
+        if (0 == table.make_delta(since, push_scope, *sync, force ? 0 : peer.checked_version) && !force) {
+            peer.checked_version = sync->version;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        int ret = n.send_ctrl_msg(ep.get_id(), m);
+        if (ret >= 0) {
+            peer.sent_version    = sync->version;
+            peer.checked_version = sync->version;
+        }
+
+        return ret;
+    }
+
     int msg_handler::send_msg(node &n, connection &conn, const protocol::msg &m) {
-        std::stringstream ss;
-        msgpack::pack(ss, m);
-        std::string packed_buffer = ss.str();
+        // 双方都支持时数据转发消息使用紧凑编码，否则使用msgpack
+        // 紧凑编码只打包消息头和路由表，数据直接从原地址(转发时是接收缓冲区)复制到通道里，不需要重新序列化
+        bool use_compact   = false;
+        size_t packed_size = 0;
+        if (NULL != conn.get_binding() && conn.get_binding()->get_flag(endpoint::flag_t::COMPACT_DATA) &&
+            n.get_self_endpoint()->get_flag(endpoint::flag_t::COMPACT_DATA)) {
+            packed_size = detail::fn::compact_data_head_size(m);
+            use_compact = packed_size > 0;
+        }
+
+        if (use_compact) {
+            if (packed_size + m.body.forward->content.size >= n.get_conf().msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            // 消息头很小，在临时内存池里分配即可
+            node::msg_arena_guard_t arena_guard(&n);
+            void *head_buffer = n.get_msg_arena().allocate(packed_size);
+            if (NULL == head_buffer || detail::fn::compact_data_pack_head(m, head_buffer, packed_size) != packed_size) {
+                return NULL == head_buffer ? EN_ATBUS_ERR_MALLOC : EN_ATBUS_ERR_PACK;
+            }
+
+            ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m,
+                                  "node send msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%u, compact=1)",
+                                  detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, m.head.ret,
+                                  static_cast<unsigned int>(packed_size + m.body.forward->content.size));
+
+            const void *buffers[2] = {head_buffer, m.body.forward->content.ptr};
+            size_t sizes[2]        = {packed_size, m.body.forward->content.size};
+            return conn.push_v(buffers, sizes, 0 == sizes[1] ? 1 : 2);
+        }
 
-        if (packed_buffer.size() >= n.get_conf().msg_size) {
+        // 先计算打包后的长度，超出限制时不需要真正打包
+        detail::pack_size_counter packed_size_counter;
+        msgpack::pack(packed_size_counter, m);
+        packed_size = packed_size_counter.size();
+        if (packed_size >= n.get_conf().msg_size) {
             return EN_ATBUS_ERR_BUFF_LIMIT;
         }
 
+        // 优先直接打包到节点的打包缓冲区，发送过程中的回调里再次发送时外层还在使用，改用临时内存池
+        node::flag_guard_t packing_guard(&n, node::flag_t::EN_FT_PACKING);
+        node::msg_arena_guard_t arena_guard(&n);
+        void *buffer = NULL;
+        if (packing_guard && NULL != n.get_pack_buffer() && n.get_pack_buffer()->raw_size() >= packed_size) {
+            buffer = n.get_pack_buffer()->raw_data();
+        } else {
+            buffer = n.get_msg_arena().allocate(packed_size);
+        }
+
+        if (NULL == buffer) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        detail::pack_fixed_buffer packed_buffer(buffer, packed_size);
+        msgpack::pack(packed_buffer, m);
+        if (!packed_buffer.good()) {
+            return EN_ATBUS_ERR_PACK;
+        }
+
         ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m, "node send msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%u)",
                               detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, m.head.ret,
                               packed_buffer.size());
 
         return conn.push(packed_buffer.data(), packed_buffer.size());
-        ;
     }
 
+    struct msg_handler::broadcast_cache_t {
+        node &owner;
+        node::msg_arena_guard_t arena_guard; // 打包数据在临时内存池里，广播结束前不能重置
+
+        void *compact_head; // 紧凑编码的消息头和路由表，数据部分直接引用原消息
+        size_t compact_head_size;
+        void *packed; // msgpack编码的完整消息
+        size_t packed_size;
+        size_t packed_to_offset; // forward.to在msgpack数据中的偏移，占位用bus_id_t的最大值，按bus_id_t的宽度打包
+        int compact_error;       // 打包失败后不再重试，直接走普通流程
+        int packed_error;
+
+        broadcast_cache_t(node &n) : owner(n), arena_guard(&n) { reset(); }
+
+        void reset() {
+            compact_head      = NULL;
+            compact_head_size = 0;
+            packed            = NULL;
+            packed_size       = 0;
+            packed_to_offset  = 0;
+            compact_error     = EN_ATBUS_ERR_SUCCESS;
+            packed_error      = EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // bus_id_t的最大值在msgpack里固定打包成对应宽度的无符号整数: 0xcc/0xcd/0xce/0xcf + 1/2/4/8字节
+        static unsigned char packed_to_marker() {
+            static_assert(!std::numeric_limits<node::bus_id_t>::is_signed, "bus_id_t must be unsigned");
+            static_assert(1 == sizeof(node::bus_id_t) || 2 == sizeof(node::bus_id_t) || 4 == sizeof(node::bus_id_t) ||
+                              8 == sizeof(node::bus_id_t),
+                          "bus_id_t must be 1, 2, 4 or 8 bytes");
+
+            switch (sizeof(node::bus_id_t)) {
+            case 1:
+                return 0xcc;
+            case 2:
+                return 0xcd;
+            case 4:
+                return 0xce;
+            default:
+                return 0xcf;
+            }
+        }
+
+        // 和node::send_msg一样，在路由表里追加自己并设置发送源后打包，打包完恢复原消息
+        int pack(protocol::msg &m, bool use_compact) {
+            protocol::forward_data &fwd = *m.body.forward;
+            node::bus_id_t to           = fwd.to;
+            node::bus_id_t src_bus_id   = m.head.src_bus_id;
+
+            fwd.router.push_back(owner.get_id());
+            m.head.src_bus_id = owner.get_id();
+            fwd.to            = std::numeric_limits<node::bus_id_t>::max();
+
+            int ret = EN_ATBUS_ERR_SUCCESS;
+            if (use_compact) {
+                compact_head_size = detail::fn::compact_data_head_size(m);
+                compact_head      = 0 == compact_head_size ? NULL : owner.get_msg_arena().allocate(compact_head_size);
+                if (NULL == compact_head || detail::fn::compact_data_pack_head(m, compact_head, compact_head_size) != compact_head_size) {
+                    compact_head = NULL;
+                    ret          = EN_ATBUS_ERR_PACK;
+                }
+            } else {
+                detail::pack_size_counter packed_size_counter;
+                msgpack::pack(packed_size_counter, m);
+
+                // map头，key 1，key 2和forward的数组头各占1字节
+                detail::pack_size_counter prefix_size_counter;
+                msgpack::pack(prefix_size_counter, m.head);
+                msgpack::pack(prefix_size_counter, fwd.from);
+                packed_to_offset = prefix_size_counter.size() + 4;
+
+                packed_size = packed_size_counter.size();
+                packed      = packed_size >= owner.get_conf().msg_size ? NULL : owner.get_msg_arena().allocate(packed_size);
+                if (NULL != packed) {
+                    detail::pack_fixed_buffer packed_buffer(packed, packed_size);
+                    msgpack::pack(packed_buffer, m);
+
+                    // 检查占位的目标ID，格式不符合预期时不使用共享的打包数据
+                    const unsigned char *to_data = reinterpret_cast<const unsigned char *>(packed) + packed_to_offset;
+                    bool valid                   = packed_buffer.good() && packed_to_offset + 1 + sizeof(node::bus_id_t) <= packed_size &&
+                                 packed_to_marker() == to_data[0];
+                    for (size_t i = 1; valid && i <= sizeof(node::bus_id_t); ++i) {
+                        valid = 0xff == to_data[i];
+                    }
+
+                    if (!valid) {
+                        packed = NULL;
+                    }
+                }
+
+                if (NULL == packed) {
+                    ret = packed_size >= owner.get_conf().msg_size ? EN_ATBUS_ERR_BUFF_LIMIT : EN_ATBUS_ERR_PACK;
+                }
+            }
+
+            fwd.router.pop_back();
+            m.head.src_bus_id = src_bus_id;
+            fwd.to            = to;
+
+            (use_compact ? compact_error : packed_error) = ret;
+            return ret;
+        }
+
+        int push(connection &conn, protocol::msg &m, bool use_compact) {
+            node::bus_id_t to = m.body.forward->to;
+            if (use_compact) {
+                if (compact_error < 0) {
+                    return compact_error;
+                }
+
+                if (NULL == compact_head) {
+                    int res = pack(m, true);
+                    if (res < 0) {
+                        return res;
+                    }
+                }
+
+                detail::fn::compact_data_set_to(compact_head, compact_head_size, to);
+                const void *buffers[2] = {compact_head, m.body.forward->content.ptr};
+                size_t sizes[2]        = {compact_head_size, m.body.forward->content.size};
+                return conn.push_v(buffers, sizes, 0 == sizes[1] ? 1 : 2);
+            }
+
+            if (packed_error < 0) {
+                return packed_error;
+            }
+
+            if (NULL == packed) {
+                int res = pack(m, false);
+                if (res < 0) {
+                    return res;
+                }
+            }
+
+            unsigned char *to_data = reinterpret_cast<unsigned char *>(packed) + packed_to_offset + 1;
+            for (size_t i = 0; i < sizeof(node::bus_id_t); ++i) {
+                to_data[i] = static_cast<unsigned char>((static_cast<uint64_t>(to) >> ((sizeof(node::bus_id_t) - 1 - i) * 8)) & 0xFF);
+            }
+            return conn.push(packed, packed_size);
+        }
+
+    private:
+        broadcast_cache_t(const broadcast_cache_t &);
+        broadcast_cache_t &operator=(const broadcast_cache_t &);
+    };
+
     int msg_handler::on_recv_data_transfer_req(node &n, connection *conn, protocol::msg &m, int /*status*/, int /*errcode*/) {
         if (NULL == m.body.forward || NULL == conn) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
@@ -190,6 +431,7 @@ namespace atbus {
 
         if (m.body.forward->route_data){
             int  custom_route_type = m.body.forward->route_data->custom_route_type;
+            broadcast_cache_t broadcast_cache(n);
             if (custom_route_type == protocol::custom_route_data::CUSTOM_ROUTE_BROADCAST2){
                 m.body.forward->set_flag(protocol::forward_data::FLAG_IGNORE_ERROR_RSP);
                 atbus::node::bus_id_t src_bus_id = m.head.src_bus_id;
@@ -198,22 +440,29 @@ namespace atbus {
                     if (n.get_parent_endpoint()!= NULL && m.body.forward->route_data->broadcast_cross_group){
                         m.body.forward->to = n.get_parent_endpoint()->get_id();
                         ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "send to parent node ");
-                        send_transfer_req(n, m, true);
+                        send_broadcast_req(n, m, broadcast_cache);
                     }
                     //兄弟节点广播
                     for(atbus::node::endpoint_collection_t::const_iterator it= n.get_brother().begin(); it != n.get_brother().end(); ++it ){
+                        // 子树里没有订阅者时跳过
+                        if (!n.has_broadcast_subscriber(*it->second, *m.body.forward->route_data)) {
+                            continue;
+                        }
                         m.body.forward->to = it->second->get_id();
                         ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "send to brother node ");
-                        send_transfer_req(n, m, true);
+                        send_broadcast_req(n, m, broadcast_cache);
 
                     }
                 }else {
                     if(n.get_conf().pure_forward){
                         //向子节点发广播
                         for(atbus::node::endpoint_collection_t::const_iterator it= n.get_children().begin(); it != n.get_children().end(); ++it ){
+                            if (!n.has_broadcast_subscriber(*it->second, *m.body.forward->route_data)) {
+                                continue;
+                            }
                             m.body.forward->to = it->second->get_id();
                             ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "send to child node ");
-                            send_transfer_req(n, m, true);
+                            send_broadcast_req(n, m, broadcast_cache);
                         }
                     }
                 }
@@ -223,10 +472,12 @@ namespace atbus {
                     int res =  n.get_on_custom_route_handle()(n, m.body.forward->from, *(m.body.forward->route_data), bus_ids);
                     if (res >= 0 && bus_ids.size() > 0){
                         m.body.forward->route_data.reset();
+                        // 去掉了自定义路由数据，之前的打包数据不能再用
+                        broadcast_cache.reset();
                         int succ = 0;
                         for(std::vector<uint64_t >::iterator it = bus_ids.begin(); it != bus_ids.end(); ++it ){
                             m.body.forward->to = *it;
-                            if(send_transfer_req(n, m, true)==EN_ATBUS_ERR_SUCCESS){
+                            if(send_broadcast_req(n, m, broadcast_cache)==EN_ATBUS_ERR_SUCCESS){
                                 succ++;
                             }
                             if (succ==0){
@@ -242,18 +493,26 @@ namespace atbus {
                     std::vector<uint64_t > bus_ids;
                     int res =  n.get_on_custom_route_handle()(n, m.body.forward->from, *(m.body.forward->route_data), bus_ids);
                     if (res >= 0 && bus_ids.size() > 0){
-                        m.body.forward->route_data.reset();
                         if (custom_route_type == protocol::custom_route_data::CUSTOM_ROUTE_UNICAST){
-                            m.body.forward->to = bus_ids[0];
+                            // 回调给出的是候选列表，有路由key时在候选里按key一致性哈希，否则取第一个
+                            const std::string &routing_key = m.body.forward->route_data->routing_key;
+                            if (routing_key.empty()) {
+                                m.body.forward->to = bus_ids[0];
+                            } else {
+                                m.body.forward->to = detail::service_index::select_by_key(
+                                    bus_ids, detail::service_index::hash_routing_key(routing_key.data(), routing_key.size()));
+                            }
+                            m.body.forward->route_data.reset();
                             return send_transfer_req(n, m);
 
                         } else if(custom_route_type == protocol::custom_route_data::CUSTOM_ROUTE_BROADCAST){
+                            m.body.forward->route_data.reset();
                             //广播包设置不需要回复
                             m.body.forward->set_flag(protocol::forward_data::FLAG_IGNORE_ERROR_RSP);
                             int succ = 0;
                             for(std::vector<uint64_t >::iterator it = bus_ids.begin(); it != bus_ids.end(); ++it ){
                                 m.body.forward->to = *it;
-                                if(send_transfer_req(n, m, true)==EN_ATBUS_ERR_SUCCESS){
+                                if(send_broadcast_req(n, m, broadcast_cache)==EN_ATBUS_ERR_SUCCESS){
                                     succ++;
                                 }
                                 if (succ==0){
@@ -266,7 +525,7 @@ namespace atbus {
                         return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_CUSTOM_ROUTE_FAIL);
                     }
                 } else{
-                    return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_INVALID_ID);
+                    return send_custom_route_by_index(n, m, broadcast_cache);
                 }
             }
         } else{
@@ -277,6 +536,68 @@ namespace atbus {
 
     }
 
+    int msg_handler::send_custom_route_by_index(node &n, protocol::msg &m, broadcast_cache_t &cache) {
+        // 持有一份引用，清理消息里的自定义路由数据后type_name和tag仍然有效
+        std::shared_ptr<protocol::custom_route_data> route_data = m.body.forward->route_data;
+        static const std::string empty_tag;
+        // 有多个tag时只按第一个选择
+        const std::string &tag = route_data->tags.empty() ? empty_tag : route_data->tags[0];
+        detail::service_index &index = n.get_service_index();
+
+        if (route_data->custom_route_type == protocol::custom_route_data::CUSTOM_ROUTE_UNICAST) {
+            // 有路由key时总是按key一致性哈希，否则一致性哈希时按来源节点选择
+            int select_mode    = n.get_conf().custom_route_select_mode;
+            uint64_t route_key = static_cast<uint64_t>(m.body.forward->from);
+            if (!route_data->routing_key.empty()) {
+                select_mode = detail::service_index::select_mode_t::EN_SSM_CONSISTENT_HASH;
+                route_key   = detail::service_index::hash_routing_key(route_data->routing_key.data(), route_data->routing_key.size());
+            }
+
+            node::bus_id_t target = index.select(route_data->type_name, tag, select_mode, route_key);
+            if (0 == target) {
+                return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_CUSTOM_ROUTE_FAIL);
+            }
+
+            m.body.forward->route_data.reset();
+            m.body.forward->to = target;
+            int res            = send_transfer_req(n, m);
+
+            // 转发失败或者已经在本节点回包时不计数
+            if (res >= 0 && detail::service_index::select_mode_t::EN_SSM_LEAST_OUTSTANDING == select_mode &&
+                ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward->check_flag(protocol::forward_data::FLAG_REQUIRE_RSP)) {
+                n.add_outstanding_request(target, m);
+            }
+            return res;
+        }
+
+        if (route_data->custom_route_type == protocol::custom_route_data::CUSTOM_ROUTE_BROADCAST) {
+            const detail::service_index::member_list_t *members = index.get_members(route_data->type_name, tag);
+            if (NULL == members || members->empty()) {
+                return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_CUSTOM_ROUTE_FAIL);
+            }
+            // 发送失败移除对端时会从分组里删除成员，所以按快照发送，避免跳过后面的订阅者
+            const detail::service_index::member_list_t targets(*members);
+
+            m.body.forward->route_data.reset();
+            //广播包设置不需要回复
+            m.body.forward->set_flag(protocol::forward_data::FLAG_IGNORE_ERROR_RSP);
+            int succ = 0;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                m.body.forward->to = targets[i];
+                if (send_broadcast_req(n, m, cache) == EN_ATBUS_ERR_SUCCESS) {
+                    ++succ;
+                }
+            }
+
+            if (0 == succ) {
+                return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_BROADCAST_FAIL);
+            }
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_CUSTOM_ROUTE_FAIL);
+    }
+
     int msg_handler::send_transfer_req(node &n,  protocol::msg &m, bool broadcast){
         int res         = 0;
         endpoint *to_ep = NULL;
@@ -349,12 +670,44 @@ namespace atbus {
 
     }
 
+    int msg_handler::send_broadcast_req(node &n, protocol::msg &m, broadcast_cache_t &cache) {
+        endpoint *to_ep  = NULL;
+        connection *conn = NULL;
+        int res          = EN_ATBUS_ERR_SUCCESS;
+
+        // 发给自己的消息不需要打包
+        if (m.body.forward->to != n.get_id() && node::state_t::CREATED != n.get_state()) {
+            res = n.get_remote_channel(m.body.forward->to, &endpoint::get_data_connection, &to_ep, &conn);
+        }
+
+        if (res >= 0 && NULL != conn) {
+            bool use_compact = NULL != conn->get_binding() && conn->get_binding()->get_flag(endpoint::flag_t::COMPACT_DATA) &&
+                               n.get_self_endpoint()->get_flag(endpoint::flag_t::COMPACT_DATA) && detail::fn::compact_data_check(m);
+
+            ATBUS_FUNC_NODE_DEBUG(n, conn->get_binding(), conn, &m, "node send broadcast msg(cmd=%s, type=%d, sequence=%u, compact=%d)",
+                                  detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, use_compact ? 1 : 0);
+            res = cache.push(*conn, m, use_compact);
+            if (res >= 0) {
+                return res;
+            }
+        }
+
+        // 发给自己或者发送失败时走普通转发流程(重试或转发给父节点)，发送后恢复路由表给下一个目标用
+        size_t router_size = m.body.forward->router.size();
+        res                = send_transfer_req(n, m, true);
+        m.body.forward->router.resize(router_size);
+        return res;
+    }
+
     int msg_handler::on_recv_data_transfer_rsp(node &n, connection *conn, protocol::msg &m, int /*status*/, int /*errcode*/) {
         if (NULL == m.body.forward || NULL == conn) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
+        // 按服务索引转发的请求完成了
+        n.remove_outstanding_request(m);
+
         if (m.body.forward->to == n.get_id()) {
             ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, m.head.ret, 0);
             n.on_send_data_failed(conn->get_binding(), conn, &m);
@@ -441,11 +794,53 @@ namespace atbus {
         return n.on_custom_rsp(NULL == conn ? NULL : conn->get_binding(), conn, m.body.custom->from, cmd_args, m.head.sequence);
     }
 
-    int msg_handler::on_recv_node_sync_req(node &, connection *, protocol::msg &, int /*status*/, int /*errcode*/) {
-        return EN_ATBUS_ERR_SUCCESS;
+    int msg_handler::on_recv_node_sync_req(node &n, connection *conn, protocol::msg &m, int /*status*/, int /*errcode*/) {
+        endpoint *ep = NULL == conn ? NULL : conn->get_binding();
+        if (NULL == ep) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL, conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        // 请求包里的version是请求方已收到的版本号
+        uint64_t since = NULL == m.body.sync ? 0 : m.body.sync->version;
+        int ret        = send_node_sync_rsp(n, *ep, since, true);
+        if (ret < 0) {
+            ATBUS_FUNC_NODE_ERROR(n, ep, conn, ret, 0);
+        }
+
+        return ret;
     }
 
-    int msg_handler::on_recv_node_sync_rsp(node &, connection *, protocol::msg &, int /*status*/, int /*errcode*/) {
+    int msg_handler::on_recv_node_sync_rsp(node &n, connection *conn, protocol::msg &m, int /*status*/, int /*errcode*/) {
+        endpoint *ep = NULL == conn ? NULL : conn->get_binding();
+        if (NULL == ep || NULL == m.body.sync) {
+            ATBUS_FUNC_NODE_ERROR(n, ep, conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        detail::route_table::scope_t accept_scope;
+        if (!n.get_node_sync_scope(*ep, NULL, &accept_scope)) {
+            ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node sync from 0x%llx ignored", static_cast<unsigned long long>(ep->get_id()));
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        detail::route_table &table        = n.get_route_table();
+        detail::route_table::peer_t &peer = table.mutable_peer(ep->get_id());
+
+        // 增量不连续(丢包或者对端重启)则从上次收到的版本号重新拉取
+        if (0 != m.body.sync->base_version && m.body.sync->base_version != peer.recv_version) {
+            ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node sync base version %llu mismatch %llu, pull again",
+                                  static_cast<unsigned long long>(m.body.sync->base_version),
+                                  static_cast<unsigned long long>(peer.recv_version));
+            return send_node_sync_req(n, *ep, peer.recv_version);
+        }
+
+        peer.recv_version = m.body.sync->version;
+        if (table.apply(*m.body.sync, ep->get_id(), accept_scope) > 0) {
+            // 继续向其他节点传播
+            n.add_node_sync_push();
+        }
+
         return EN_ATBUS_ERR_SUCCESS;
     }
 
@@ -487,6 +882,8 @@ namespace atbus {
                     ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
                 }
                 rsp_code = res;
+                ep->set_flag(endpoint::flag_t::COMPACT_DATA,
+                             std::bitset<endpoint::flag_t::MAX>(m.body.reg->flags).test(endpoint::flag_t::COMPACT_DATA));
 
                 ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "connection added to existed endpoint, res: %d", res);
                 break;
@@ -521,6 +918,9 @@ namespace atbus {
                 break;
             }
             ep = new_ep.get();
+            // 添加前设置，有全局路由表的节点允许直连
+            ep->set_flag(endpoint::flag_t::GLOBAL_ROUTER, reg_flags.test(endpoint::flag_t::GLOBAL_ROUTER));
+            ep->set_flag(endpoint::flag_t::COMPACT_DATA, reg_flags.test(endpoint::flag_t::COMPACT_DATA));
 
             res = n.add_endpoint(new_ep);
             if (res < 0) {
@@ -528,7 +928,6 @@ namespace atbus {
                 rsp_code = res;
                 break;
             }
-            ep->set_flag(endpoint::flag_t::GLOBAL_ROUTER, reg_flags.test(endpoint::flag_t::GLOBAL_ROUTER));
 
             ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node add a new endpoint, res: %d", res);
             // 新的endpoint要建立所有连接
@@ -621,6 +1020,43 @@ namespace atbus {
         }
 
         endpoint *ep = conn->get_binding();
+
+        // 按全局路由表主动发起的直连，对端可能不会反向连接，所以在回包时创建endpoint
+        if (NULL == ep && m.head.ret >= 0 && NULL != m.body.reg && 0 != m.body.reg->bus_id &&
+            n.get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && !n.is_parent_node(m.body.reg->bus_id) &&
+            !n.is_brother_node(m.body.reg->bus_id) && !n.is_child_node(m.body.reg->bus_id)) {
+            endpoint::ptr_t global_ep;
+            ep = n.get_endpoint(m.body.reg->bus_id);
+            if (NULL == ep) {
+                global_ep = endpoint::create(&n, m.body.reg->bus_id, m.body.reg->children_id_mask, m.body.reg->pid, m.body.reg->hostname,
+                                             m.body.reg->type_name, m.body.reg->tags);
+                if (global_ep) {
+                    global_ep->set_flag(endpoint::flag_t::GLOBAL_ROUTER,
+                                        std::bitset<endpoint::flag_t::MAX>(m.body.reg->flags).test(endpoint::flag_t::GLOBAL_ROUTER));
+                    for (size_t i = 0; i < m.body.reg->channels.size(); ++i) {
+                        global_ep->add_listen(m.body.reg->channels[i].address);
+                    }
+
+                    int res = n.add_endpoint(global_ep);
+                    if (res < 0) {
+                        ATBUS_FUNC_NODE_ERROR(n, global_ep.get(), conn, res, 0);
+                    } else {
+                        ep = global_ep.get();
+                    }
+                }
+            }
+
+            if (NULL != ep) {
+                ep->add_connection(conn, false);
+                ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node connected to global route endpoint");
+            }
+        }
+
+        // 回包里也带了对端的能力标记
+        if (NULL != ep && NULL != m.body.reg && ep->get_id() == m.body.reg->bus_id) {
+            ep->set_flag(endpoint::flag_t::COMPACT_DATA,
+                         std::bitset<endpoint::flag_t::MAX>(m.body.reg->flags).test(endpoint::flag_t::COMPACT_DATA));
+        }
         n.on_reg(ep, conn, m.head.ret);
 
         if (m.head.ret < 0) {
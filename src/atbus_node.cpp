@@ -30,6 +30,7 @@
 #include <common/string_oprs.h>
 
 #include "detail/buffer.h"
+#include "detail/inline_vector.h"
 
 
 #include "atbus_msg_handler.h"
@@ -38,7 +39,81 @@
 #include "detail/libatbus_protocol.h"
 #include "time/time_utility.h"
 
+#include "lock/spin_lock.h"
+
 namespace atbus {
+    // 发给自己的消息在self_msg_ring里的类型
+    enum {
+        ATBUS_SELF_MSG_DATA = 1, // 消息头, flags, 数据
+        ATBUS_SELF_MSG_CMD  = 2, // 消息头, 命令参数...
+    };
+
+    // 其他线程发送的数据，数据紧跟在结构后面
+    struct node_inbox_msg_t {
+        detail::mpsc_inbox::node_t inbox_node; // 必须是第一个成员
+        ATBUS_MACRO_BUSID_TYPE tid;
+        int type;
+        bool require_rsp;
+        size_t size;
+    };
+
+    // 正在压入收件箱的线程计数
+    struct node_inbox_producer_guard_t {
+        util::lock::atomic_int_type<size_t> &counter;
+
+        explicit node_inbox_producer_guard_t(util::lock::atomic_int_type<size_t> &c) : counter(c) { counter.fetch_add(1); }
+        ~node_inbox_producer_guard_t() { counter.fetch_sub(1); }
+    };
+
+    static void node_inbox_msg_failed(node &n, const node_inbox_msg_t &msg, int errcode) {
+        ATBUS_FUNC_NODE_ERROR(n, n.get_self_endpoint(), NULL, errcode, 0);
+
+        // fake response
+        atbus::protocol::msg m;
+        m.init(n.get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, msg.type, errcode, 0);
+
+        protocol::forward_data data;
+        m.body.forward               = &data;
+        m.body.forward->from         = n.get_id();
+        m.body.forward->to           = msg.tid;
+        m.body.forward->content.ptr  = &msg + 1;
+        m.body.forward->content.size = msg.size;
+        if (msg.require_rsp) {
+            m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+        }
+
+        n.on_send_data_failed(n.get_self_endpoint(), NULL, &m);
+
+        // remove reference
+        m.body.forward = NULL;
+    }
+
+    static void node_collect_connecting(detail::timer_wheel::node_t &timer, void *priv) {
+        reinterpret_cast<std::vector<connection *> *>(priv)->push_back(static_cast<connection *>(timer.data));
+    }
+
+    struct node_connecting_finder_t {
+        const char *addr_str;
+        const endpoint *binding;
+        bool found;
+    };
+
+    static void node_find_connecting(const detail::timer_wheel::node_t &timer, void *priv) {
+        node_connecting_finder_t *finder = reinterpret_cast<node_connecting_finder_t *>(priv);
+        const connection *conn           = static_cast<const connection *>(timer.data);
+        if (finder->found || NULL == conn || conn->is_connected()) {
+            return;
+        }
+
+        if (NULL != finder->binding && conn->get_binding() != finder->binding) {
+            return;
+        }
+
+        if (0 == UTIL_STRFUNC_STRNCASE_CMP(finder->addr_str, conn->get_address().address.c_str(), conn->get_address().address.size())) {
+            finder->found = true;
+        }
+    }
+
     node::flag_guard_t::flag_guard_t(const node *o, flag_t::type f) : owner(const_cast<node *>(o)), flag(f), holder(false) {
         if (owner && !owner->flags_.test(flag)) {
             holder = true;
@@ -53,13 +128,55 @@ namespace atbus {
         }
     }
 
-    node::node() : state_(state_t::CREATED), ev_loop_(NULL), static_buffer_(NULL), on_debug(NULL) {
-        event_timer_.sec                   = 0;
-        event_timer_.usec                  = 0;
-        event_timer_.node_sync_push        = 0;
-        event_timer_.father_opr_time_point = 0;
+    node::msg_arena_guard_t::msg_arena_guard_t(node *o) : owner(o) {
+        if (NULL != owner) {
+            ++owner->msg_arena_depth_;
+        }
+    }
 
+    node::msg_arena_guard_t::~msg_arena_guard_t() {
+        if (NULL != owner && 0 == --owner->msg_arena_depth_) {
+            owner->msg_arena_.reset();
+        }
+    }
+
+    node::unpack_zone_guard_t::unpack_zone_guard_t(node *o) : owner(o), zone(NULL) {
+        if (NULL != owner && 0 == owner->unpack_zone_depth_++) {
+            zone = &owner->unpack_zone_;
+        } else {
+            zone = new msgpack::zone();
+        }
+    }
+
+    node::unpack_zone_guard_t::~unpack_zone_guard_t() {
+        if (NULL != owner && zone == &owner->unpack_zone_) {
+            // 保留第一个块，稳定状态下解包不再需要分配内存
+            owner->unpack_zone_.clear();
+        } else {
+            delete zone;
+        }
+
+        if (NULL != owner) {
+            --owner->unpack_zone_depth_;
+        }
+    }
+
+    node::node()
+        : state_(state_t::CREATED), ev_loop_(NULL), inbox_async_(NULL), static_buffer_(NULL), pack_buffer_(NULL), msg_arena_depth_(0), unpack_zone_depth_(0),
+          route_generation_(1), on_debug(NULL) {
+        event_timer_.sec                         = 0;
+        event_timer_.usec                        = 0;
+        event_timer_.node_sync_push              = 0;
+        event_timer_.father_opr_time_point       = 0;
+        event_timer_.idle_trim_time_point        = 0;
+        event_timer_.allocator_alloc_times       = 0;
+        event_timer_.allocator_active_time_point = 0;
+
+        memset(route_cache_, 0, sizeof(route_cache_));
         flags_.reset();
+
+        inbox_state_.store(inbox_state_t::EN_IS_CLOSED);
+        inbox_producers_.store(0);
     }
 
     void node::io_stream_channel_del::operator()(channel::io_stream_channel *p) const {
@@ -72,6 +189,9 @@ namespace atbus {
             reset();
         }
 
+        // reset只拒绝新的消息，唤醒句柄到这里才释放
+        destroy_inbox_async();
+
         ATBUS_FUNC_NODE_DEBUG(*this, NULL, NULL, NULL, "node destroyed");
     }
 
@@ -97,9 +217,17 @@ namespace atbus {
         // default for 32 times of ATBUS_MACRO_MSG_LIMIT = 2MB
         conf->send_buffer_size   = ATBUS_MACRO_MSG_LIMIT * 32;
         conf->send_buffer_number = 0; // 默认不使用静态缓冲区，所以设为0
+        conf->io_stream_backend  = channel::io_stream_backend_t::EN_BT_LIBUV;
+        conf->idle_trim_timeout  = 60; // 空闲1分钟后释放静态发送缓冲区
+        conf->msg_arena_size     = ATBUS_MACRO_MSG_LIMIT;
+        conf->proc_quantum_size  = ATBUS_MACRO_MSG_LIMIT * 4; // 每个通道每次proc约256KB
+        conf->proc_max_backoff   = 0; // 跳过期间到达的消息会延迟处理，默认每次都检查
 
         conf->flags.reset();
-        conf->pure_forward = false;
+        conf->flags.set(conf_flag_t::EN_CONF_COMPACT_DATA, true);
+        conf->pure_forward             = false;
+        conf->custom_route_select_mode = detail::service_index::select_mode_t::EN_SSM_ROUND_ROBIN;
+        conf->outstanding_timeout      = 16;
     }
 
     node::ptr_t node::create() {
@@ -130,12 +258,24 @@ namespace atbus {
         }
         // 复制配置
         self_->set_flag(endpoint::flag_t::GLOBAL_ROUTER, conf_.flags.test(conf_flag_t::EN_CONF_GLOBAL_ROUTER));
+        self_->set_flag(endpoint::flag_t::COMPACT_DATA, conf_.flags.test(conf_flag_t::EN_CONF_COMPACT_DATA));
+
+        // 全局路由表里总是有自身的信息
+        route_table_.reset(id);
+        update_route_endpoint(*self_, false);
 
         static_buffer_ = detail::buffer_block::malloc(conf_.msg_size + detail::buffer_block::head_size(conf_.msg_size) +
                                                       16); // 预留hash码32位长度和vint长度);
+        pack_buffer_ = detail::buffer_block::malloc(conf_.msg_size);
+        msg_arena_.set_chunk_size(conf_.msg_arena_size);
+        proc_scheduler_.reset(conf_.proc_quantum_size, conf_.proc_max_backoff);
+
+        self_msgs_.reset();
 
-        self_data_msgs_.clear();
-        self_cmd_msgs_.clear();
+        int res = open_inbox();
+        if (res < 0) {
+            return res;
+        }
 
         state_ = state_t::INITED;
         return EN_ATBUS_ERR_SUCCESS;
@@ -182,6 +322,9 @@ namespace atbus {
                 ;
         }
 
+        // 连接断开前发出收件箱里的消息
+        dispatch_inbox_msgs();
+
         // first save all connection, and then reset it
         typedef detail::auto_select_map<std::string, connection::ptr_t>::type auto_map_t;
         {
@@ -199,6 +342,7 @@ namespace atbus {
             }
         }
         proc_connections_.clear();
+        proc_scheduler_.reset(conf_.proc_quantum_size, conf_.proc_max_backoff);
 
         // 销毁endpoint
         if (node_father_.node_) {
@@ -207,20 +351,43 @@ namespace atbus {
         // endpoint 不应该游离在node以外，所以这里就应该要触发endpoint::reset
         remove_collection(node_brother_);
         remove_collection(node_children_);
+        remove_collection(node_global_);
+
+        // 清空全局路由表
+        route_table_.reset(0);
+        global_route_connecting_.clear();
+        service_index_.reset();
+        event_timer_.node_sync_push = 0;
+
+        // 服务索引已经清空，不需要再减少未完成请求数
+        outstanding_requests_.clear();
+        event_timer_.outstanding_timers.reset(0);
 
         // 清空检测列表和ping列表
         event_timer_.pending_check_list_.clear();
-        event_timer_.ping_list.clear();
+        event_timer_.ping_timers.reset(0);
 
         // 清空正在连接或握手的列表
         // 必须显式指定断开，以保证会主动断开正在进行的连接
         // 因为正在进行的连接会增加connection的引用计数
-        for (evt_timer_t::timer_desc_ls<connection::ptr_t>::type::iterator iter = event_timer_.connecting_list.begin();
-             iter != event_timer_.connecting_list.end(); ++iter) {
-            iter->second->disconnect();
-        }
+        {
+            std::vector<connection *> connecting;
+            connecting.reserve(event_timer_.connecting_timers.size());
+            event_timer_.connecting_timers.for_each(node_collect_connecting, &connecting);
+            event_timer_.connecting_timers.reset(0);
+
+            std::vector<connection::ptr_t> holders;
+            holders.resize(connecting.size());
+            for (size_t i = 0; i < connecting.size(); ++i) {
+                holders[i].swap(connecting[i]->connecting_holder_);
+            }
 
-        event_timer_.connecting_list.clear();
+            for (size_t i = 0; i < holders.size(); ++i) {
+                if (holders[i]) {
+                    holders[i]->disconnect();
+                }
+            }
+        }
 
         // 重置自身的endpoint
         if (self_) {
@@ -228,6 +395,8 @@ namespace atbus {
             self_->reset();
         }
 
+        close_inbox();
+
         // 引用的数据(正在进行的连接)也必须全部释放完成
         // 保证延迟释放的连接也释放完成
         while (!ref_objs_.empty()) {
@@ -249,12 +418,17 @@ namespace atbus {
             static_buffer_ = NULL;
         }
 
+        if (NULL != pack_buffer_) {
+            detail::buffer_block::free(pack_buffer_);
+            pack_buffer_ = NULL;
+        }
+        msg_arena_.release();
+
         conf_.flags.reset();
         state_ = state_t::CREATED;
         flags_.reset();
 
-        self_data_msgs_.clear();
-        self_cmd_msgs_.clear();
+        self_msgs_.reset();
 
         return EN_ATBUS_ERR_SUCCESS;
     }
@@ -280,33 +454,60 @@ namespace atbus {
             return ret;
         }
 
+        // 其他线程发送的数据，正常情况下已经在唤醒回调里发送
+        if (NULL != inbox_async_) {
+            ret += dispatch_inbox_msgs();
+        }
+
         // TODO 以后可以优化成event_fd通知，这样就不需要轮询了
-        // 点对点IO流通道
-        for (detail::auto_select_map<std::string, connection::ptr_t>::type::iterator iter = proc_connections_.begin();
-             iter != proc_connections_.end(); ++iter) {
-            ret += iter->second->proc(*this, sec, usec);
+        // 内存和共享内存通道，回调里移除的连接只会被标记，新增的连接追加到末尾
+        proc_scheduler_.compact();
+        for (size_t i = 0; i < proc_scheduler_.size(); ++i) {
+            if (!proc_scheduler_.check(i)) {
+                continue;
+            }
+
+            connection *conn = static_cast<connection *>(proc_scheduler_.get(i));
+            if (!conn->has_pending_data()) {
+                proc_scheduler_.on_idle(i);
+                continue;
+            }
+
+            size_t max_bytes = proc_scheduler_.grant(i);
+            if (0 == max_bytes) {
+                continue;
+            }
+
+            // 回调里可能断开并释放这个连接，接收结束前要持有引用
+            connection::ptr_t conn_holder = conn->watch();
+            size_t recv_bytes             = 0;
+            ret += conn->proc(*this, sec, usec, max_bytes, &recv_bytes);
+
+            // 回调里可能已经移除了这个连接
+            if (NULL != proc_scheduler_.get(i)) {
+                proc_scheduler_.consume(i, recv_bytes, !conn->has_pending_data());
+            }
         }
 
+        uint64_t now_ms                    = get_timer_msec();
+        detail::timer_wheel::node_t *timer = NULL;
+
         // connection超时下线
-        while (!event_timer_.connecting_list.empty()) {
-            evt_timer_t::timer_desc_ls<connection::ptr_t>::pair_type &top = event_timer_.connecting_list.front();
-            if (top.first < sec || (top.second && top.second->is_connected())) {
-                // 已无效对象则忽略
-                if (top.second && false == top.second->is_connected()) {
-                    if (event_msg_.on_invalid_connection) {
-                        flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
-                        event_msg_.on_invalid_connection(std::cref(*this), top.second.get(), EN_ATBUS_ERR_NODE_TIMEOUT);
-                    }
+        while (NULL != (timer = event_timer_.connecting_timers.pop_expired(now_ms))) {
+            connection::ptr_t conn;
+            conn.swap(static_cast<connection *>(timer->data)->connecting_holder_);
 
-                    if (atbus::connection::state_t::DISCONNECTED != top.second->get_status()) {
-                        top.second->reset();
-                        ATBUS_FUNC_NODE_ERROR(*this, NULL, top.second.get(), EN_ATBUS_ERR_NODE_TIMEOUT, 0);
-                    }
+            // 已完成握手的连接只需要释放引用
+            if (conn && false == conn->is_connected()) {
+                if (event_msg_.on_invalid_connection) {
+                    flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+                    event_msg_.on_invalid_connection(std::cref(*this), conn.get(), EN_ATBUS_ERR_NODE_TIMEOUT);
                 }
 
-                event_timer_.connecting_list.pop_front();
-            } else {
-                break;
+                if (atbus::connection::state_t::DISCONNECTED != conn->get_status()) {
+                    conn->reset();
+                    ATBUS_FUNC_NODE_ERROR(*this, NULL, conn.get(), EN_ATBUS_ERR_NODE_TIMEOUT, 0);
+                }
             }
         }
 
@@ -341,18 +542,58 @@ namespace atbus {
             }
         }
 
-        // Ping包
-        while (!event_timer_.ping_list.empty() && event_timer_.ping_list.front().first < sec) {
-            endpoint::ptr_t ep = event_timer_.ping_list.front().second.lock();
-            event_timer_.ping_list.pop_front();
+        // 转发的请求超时没有回包，不再计入未完成请求数
+        while (NULL != (timer = event_timer_.outstanding_timers.pop_expired(now_ms))) {
+            outstanding_request_t *req = static_cast<outstanding_request_t *>(timer->data);
+            service_index_.add_outstanding(req->target, -1);
+            outstanding_requests_.erase(req->key);
+        }
+
+        // Ping包，已释放的endpoint析构时会从时间轮里移除
+        while (NULL != (timer = event_timer_.ping_timers.pop_expired(now_ms))) {
+            endpoint::ptr_t ep = static_cast<endpoint *>(timer->data)->watch();
 
-            // 已移除对象则忽略
             if (ep) {
                 // 忽略错误
                 ping_endpoint(*ep);
 
-                event_timer_.ping_list.push_back(std::make_pair(sec + conf_.ping_interval, ep));
+                add_ping_timer(*ep);
+            }
+        }
+
+        // 空闲连接缓冲区回收，并刷新常驻缓冲区内存统计
+        if (event_timer_.idle_trim_time_point < sec) {
+            event_timer_.idle_trim_time_point = sec;
+
+            stat_.resident_buffer_size = 0;
+            if (iostream_channel_) {
+                if (conf_.idle_trim_timeout > 0) {
+                    channel::io_stream_trim_idle(iostream_channel_.get(), static_cast<uint64_t>(conf_.idle_trim_timeout) * 1000);
+                }
+                stat_.resident_buffer_size += channel::io_stream_get_resident_buffer_size(iostream_channel_.get());
+            }
+
+            if (NULL != static_buffer_) {
+                stat_.resident_buffer_size += detail::buffer_block::alloc_size(static_buffer_->raw_size());
+            }
+
+            // 线程的分级缓存不属于任何缓冲区管理器，一段时间内没有新的分配时也释放掉
+            if (conf_.idle_trim_timeout > 0) {
+                std::vector<detail::buffer_allocator_stats_t> allocator_stats;
+                detail::buffer_block::get_allocator_stats(allocator_stats);
+                size_t alloc_times = 0;
+                for (size_t i = 0; i < allocator_stats.size(); ++i) {
+                    alloc_times += allocator_stats[i].alloc_times;
+                }
+
+                if (alloc_times != event_timer_.allocator_alloc_times) {
+                    event_timer_.allocator_alloc_times       = alloc_times;
+                    event_timer_.allocator_active_time_point = sec;
+                } else if (event_timer_.allocator_active_time_point + conf_.idle_trim_timeout <= sec) {
+                    detail::buffer_block::shrink_allocator();
+                }
             }
+            stat_.resident_buffer_size += detail::buffer_block::get_allocator_cached_size();
         }
 
         // 节点同步协议-推送
@@ -369,10 +610,10 @@ namespace atbus {
 
         // 检测队列
         if (!event_timer_.pending_check_list_.empty()) {
-            std::list<endpoint::ptr_t> checked;
+            std::vector<endpoint::ptr_t> checked;
             checked.swap(event_timer_.pending_check_list_);
 
-            for (std::list<endpoint::ptr_t>::iterator iter = checked.begin(); iter != checked.end(); ++iter) {
+            for (std::vector<endpoint::ptr_t>::iterator iter = checked.begin(); iter != checked.end(); ++iter) {
                 if (*iter) {
                     if (false == (*iter)->is_available()) {
                         (*iter)->reset();
@@ -432,6 +673,7 @@ namespace atbus {
 
         // 记录监听地址
         self_->add_listen(conn->get_address().address);
+        update_route_endpoint(*self_, false);
 
         ATBUS_FUNC_NODE_DEBUG(*this, self_.get(), conn.get(), NULL, "listen to %s, res: %d", addr_str, ret);
 
@@ -444,16 +686,8 @@ namespace atbus {
         }
 
         // if there is already connection of this addr not completed, just return success
-        for (evt_timer_t::timer_desc_ls<connection::ptr_t>::type::iterator iter = event_timer_.connecting_list.begin();
-             iter != event_timer_.connecting_list.end(); ++iter) {
-            if (!iter->second || iter->second->is_connected()) {
-                continue;
-            }
-
-            if (0 == UTIL_STRFUNC_STRNCASE_CMP(addr_str, iter->second->get_address().address.c_str(),
-                                               iter->second->get_address().address.size())) {
-                return EN_ATBUS_ERR_SUCCESS;
-            }
+        if (is_connecting(addr_str, NULL)) {
+            return EN_ATBUS_ERR_SUCCESS;
         }
 
         connection::ptr_t conn = connection::create(this);
@@ -488,18 +722,8 @@ namespace atbus {
         }
 
         // if there is already connection of this addr not completed, just return success
-        for (evt_timer_t::timer_desc_ls<connection::ptr_t>::type::iterator iter = event_timer_.connecting_list.begin();
-             iter != event_timer_.connecting_list.end(); ++iter) {
-            if (!iter->second || iter->second->is_connected()) {
-                continue;
-            }
-
-            if (iter->second->get_binding() == ep) {
-                if (0 == UTIL_STRFUNC_STRNCASE_CMP(addr_str, iter->second->get_address().address.c_str(),
-                                                   iter->second->get_address().address.size())) {
-                    return EN_ATBUS_ERR_SUCCESS;
-                }
-            }
+        if (is_connecting(addr_str, ep)) {
+            return EN_ATBUS_ERR_SUCCESS;
         }
 
         connection::ptr_t conn = connection::create(this);
@@ -532,6 +756,7 @@ namespace atbus {
             endpoint::ptr_t ep_ptr;
 
             ep_ptr.swap(node_father_.node_);
+            update_route_endpoint(*ep_ptr, true);
 
             // event
             if (event_msg_.on_endpoint_removed) {
@@ -547,9 +772,8 @@ namespace atbus {
         if (NULL != ep && ep->get_id() == id) {
             endpoint::ptr_t ep_ptr = ep->watch();
 
-            // 移除连接关系
+            // 移除连接关系，全局路由表在remove_child里更新
             remove_child(node_brother_, id);
-            // TODO 移除全局表
 
             ep_ptr->reset();
             return EN_ATBUS_ERR_SUCCESS;
@@ -559,9 +783,18 @@ namespace atbus {
         if (NULL != ep && ep->get_id() == id) {
             endpoint::ptr_t ep_ptr = ep->watch();
 
-            // 移除连接关系
+            // 移除连接关系，全局路由表在remove_child里更新
             remove_child(node_children_, id);
-            // TODO 移除全局表
+
+            ep_ptr->reset();
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        ep = find_child(node_global_, id);
+        if (NULL != ep && ep->get_id() == id) {
+            endpoint::ptr_t ep_ptr = ep->watch();
+
+            remove_child(node_global_, id);
 
             ep_ptr->reset();
             return EN_ATBUS_ERR_SUCCESS;
@@ -625,6 +858,42 @@ namespace atbus {
     }
 
 
+    int node::send_data_thread_safe(bus_id_t tid, int type, const void *buffer, size_t s, bool require_rsp) {
+        // 先登记再检查状态，close_inbox修改状态后会等待已登记的线程完成，所以通过检查后压入的消息一定会被处理
+        node_inbox_producer_guard_t producer_guard(inbox_producers_);
+        int inbox_state = inbox_state_.load();
+        if (inbox_state_t::EN_IS_OPEN != inbox_state) {
+            return inbox_state_t::EN_IS_CLOSING == inbox_state ? EN_ATBUS_ERR_CLOSING : EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        // 这里只能读取init之后不再变化的数据，唤醒句柄在node析构前一直有效
+
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        node_inbox_msg_t *msg = reinterpret_cast<node_inbox_msg_t *>(malloc(sizeof(node_inbox_msg_t) + s));
+        if (NULL == msg) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        msg->inbox_node.next = NULL;
+        msg->tid             = tid;
+        msg->type            = type;
+        msg->require_rsp     = require_rsp;
+        msg->size            = s;
+        if (s > 0) {
+            memcpy(msg + 1, buffer, s);
+        }
+
+        // 收件箱从空变为非空时才需要唤醒，之后的消息会在同一次回调里一起发送
+        if (inbox_.push(&msg->inbox_node)) {
+            uv_async_send(inbox_async_);
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
     int node::send_data_msg(bus_id_t tid, atbus::protocol::msg &mb) { return send_data_msg(tid, mb, NULL, NULL); }
 
     int node::send_data_msg(bus_id_t tid, atbus::protocol::msg &mb, endpoint **ep_out, connection **conn_out) {
@@ -691,36 +960,31 @@ namespace atbus {
 
             assert((ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward) ||
                    ((ATBUS_CMD_CUSTOM_CMD_REQ == m.head.cmd || ATBUS_CMD_CUSTOM_CMD_RSP == m.head.cmd) && m.body.custom));
-            typedef std::vector<unsigned char> bin_data_block_t;
-
             const size_t msg_head_len = sizeof(::atbus::protocol::msg_head);
             // self data msg
             if (ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward) {
-                self_data_msgs_.push_back(bin_data_block_t());
-                bin_data_block_t &bin_data = self_data_msgs_.back();
-                bin_data.resize(sizeof(int) + msg_head_len + m.body.forward->content.size);
-                memcpy(&bin_data[0], &m.head, msg_head_len);
-                memcpy(&bin_data[msg_head_len], &m.body.forward->flags, sizeof(int));
-                memcpy(&bin_data[sizeof(int) + msg_head_len], m.body.forward->content.ptr, m.body.forward->content.size);
+                detail::self_msg_ring::segment_t segs[3];
+                segs[0].ptr  = &m.head;
+                segs[0].size = msg_head_len;
+                segs[1].ptr  = &m.body.forward->flags;
+                segs[1].size = sizeof(int);
+                segs[2].ptr  = m.body.forward->content.ptr;
+                segs[2].size = m.body.forward->content.size;
+                self_msgs_.push(ATBUS_SELF_MSG_DATA, segs, 3);
             }
 
             // self command msg
             if ((ATBUS_CMD_CUSTOM_CMD_REQ == m.head.cmd || ATBUS_CMD_CUSTOM_CMD_RSP == m.head.cmd) && m.body.custom) {
-                self_cmd_msgs_.push_back(std::vector<bin_data_block_t>());
-                std::vector<bin_data_block_t> &cmds = self_cmd_msgs_.back();
-                cmds.reserve(1 + m.body.custom->commands.size());
-                cmds.push_back(bin_data_block_t());
-                bin_data_block_t &head_data = cmds.back();
-                head_data.resize(msg_head_len);
-                memcpy(&head_data[0], &m.head, msg_head_len);
-
-                for (size_t i = 0; i < m.body.custom->commands.size(); ++i) {
-                    const ::atbus::protocol::bin_data_block &src_cmd_param = m.body.custom->commands[i];
-                    cmds.push_back(bin_data_block_t());
-                    bin_data_block_t &bin_data = cmds.back();
-                    bin_data.resize(src_cmd_param.size);
-                    memcpy(&bin_data[0], src_cmd_param.ptr, src_cmd_param.size);
+                std::vector<protocol::bin_data_block> &cmds = m.body.custom->commands;
+                detail::inline_vector<detail::self_msg_ring::segment_t, 8> segs;
+                segs.resize(1 + cmds.size());
+                segs[0].ptr  = &m.head;
+                segs[0].size = msg_head_len;
+                for (size_t i = 0; i < cmds.size(); ++i) {
+                    segs[i + 1].ptr  = cmds[i].ptr;
+                    segs[i + 1].size = cmds[i].size;
                 }
+                self_msgs_.push(ATBUS_SELF_MSG_CMD, segs.data(), segs.size());
             }
 
             dispatch_all_self_msgs();
@@ -752,6 +1016,38 @@ namespace atbus {
     }
 
     int node::get_remote_channel(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out) {
+        // 热点路径上的发送目标一般只有少数几个，命中缓存时只需要一次哈希查找
+        // generation不变时endpoint和connection都不会被释放，连接状态仍然需要检查
+        uint64_t hash_key    = static_cast<uint64_t>(tid) * 0x9E3779B97F4A7C15ULL;
+        route_cache_t &cache = route_cache_[static_cast<size_t>(hash_key >> 32) & (ATBUS_MACRO_ROUTE_CACHE_SIZE - 1)];
+        if (cache.generation == route_generation_ && cache.tid == tid && cache.fn == fn &&
+            connection::state_t::CONNECTED == cache.conn->get_status()) {
+            ++stat_.route_cache_hit_times;
+            if (NULL != ep_out) *ep_out = cache.ep;
+            if (NULL != conn_out) *conn_out = cache.conn;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        endpoint *target = NULL;
+        connection *conn = NULL;
+        bool cacheable   = true;
+        int ret          = resolve_remote_channel(tid, fn, &target, &conn, &cacheable);
+        if (NULL != ep_out) *ep_out = target;
+        if (NULL != conn_out) *conn_out = conn;
+
+        if (EN_ATBUS_ERR_SUCCESS == ret && cacheable && NULL != target && NULL != conn) {
+            cache.tid        = tid;
+            cache.fn         = fn;
+            cache.generation = route_generation_;
+            cache.ep         = target;
+            cache.conn       = conn;
+        }
+
+        return ret;
+    }
+
+    int node::resolve_remote_channel(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out,
+                                     bool *cacheable) {
 #define ASSIGN_EPCONN()                   \
     if (NULL != ep_out) *ep_out = target; \
     if (NULL != conn_out) *conn_out = conn
@@ -788,8 +1084,17 @@ namespace atbus {
 
                     ASSIGN_EPCONN();
                     break;
-                } else if (false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && node_father_.node_) {
-                    // 如果没有全量表则发给父节点
+                }
+
+                // 有全量表则按路由表直连，连接建立前仍然发给父节点
+                // 这时候不能缓存，否则直连失败后不会重试
+                if (get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                    connect_global_route(tid);
+                    *cacheable = false;
+                }
+
+                if (node_father_.node_) {
+                    // 如果没有全量表或未直连则发给父节点
                     /*
                     //       F1
                     //      /  \
@@ -818,14 +1123,29 @@ namespace atbus {
                 return EN_ATBUS_ERR_ATNODE_INVALID_ID;
             }
 
-            // 其他情况,如果没有全量表则发给父节点
+            // 通过全局路由表直连的节点
+            target = find_child(node_global_, tid);
+            if (NULL != target && target->is_child_node(tid)) {
+                conn = (self_.get()->*fn)(target);
+
+                ASSIGN_EPCONN();
+                break;
+            }
+            target = NULL;
+
+            if (get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                connect_global_route(tid);
+                *cacheable = false;
+            }
+
+            // 其他情况,如果没有全量表或未直连则发给父节点
             /*
             //       F1 ------------ F2
             //      /  \            /  \
             //    C11  C12        C21  C22
             // 当C11发往C21或C22时触发这种情况
             */
-            if (node_father_.node_ && false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            if (node_father_.node_) {
                 target = node_father_.node_.get();
                 conn   = (self_.get()->*fn)(target);
 
@@ -866,6 +1186,12 @@ namespace atbus {
             return NULL;
         }
 
+        // 通过全局路由表直连的节点
+        endpoint *res = find_child(node_global_, tid);
+        if (NULL != res && res->get_id() == tid) {
+            return res;
+        }
+
         return NULL;
     }
 
@@ -885,7 +1211,8 @@ namespace atbus {
             if (!node_father_.node_) {
                 node_father_.node_ = ep;
 
-                add_ping_timer(ep);
+                add_ping_timer(*ep);
+                update_route_endpoint(*ep, false);
 
                 if ((state_t::LOST_PARENT == get_state() || state_t::CONNECTING_PARENT == get_state()) &&
                     check_flag(flag_t::EN_FT_PARENT_REG_DONE)) {
@@ -909,7 +1236,7 @@ namespace atbus {
         if (0 == get_id() || is_brother_node(ep->get_id())) {
             // event will be triggered in insert_child()
             if (insert_child(node_brother_, ep)) {
-                add_ping_timer(ep);
+                add_ping_timer(*ep);
 
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
@@ -921,9 +1248,21 @@ namespace atbus {
         if (is_child_node(ep->get_id())) {
             // event will be triggered in insert_child()
             if (insert_child(node_children_, ep)) {
-                add_ping_timer(ep);
+                add_ping_timer(*ep);
+
+                // 子节点上线会在下一次proc时上报(push_node_sync)
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
+            }
+        }
+
+        // 其他节点只有在一方有全局路由表时才允许直连
+        if (ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER) || self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            // event will be triggered in insert_child()
+            if (insert_child(node_global_, ep)) {
+                add_ping_timer(*ep);
 
-                // TODO 子节点上线上报
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
                 return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
@@ -940,6 +1279,7 @@ namespace atbus {
 
             node_father_.node_.reset();
             state_ = state_t::LOST_PARENT;
+            update_route_endpoint(*ep, true);
 
             // set reconnect to father into retry interval
             event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
@@ -971,13 +1311,18 @@ namespace atbus {
         if (is_child_node(tid)) {
             // event will be triggered in remove_child()
             if (remove_child(node_children_, tid)) {
-                // TODO 子节点下线上报
+                // 子节点下线会在下一次proc时上报(push_node_sync)
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
                 return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
             }
         }
 
+        // 通过全局路由表直连的节点
+        if (remove_child(node_global_, tid)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
         return EN_ATBUS_ERR_ATNODE_INVALID_ID;
     }
 
@@ -1162,6 +1507,7 @@ namespace atbus {
         }
 
         proc_connections_[conn->get_address().address] = conn;
+        proc_scheduler_.add(conn.get());
         return true;
     }
 
@@ -1171,6 +1517,9 @@ namespace atbus {
             return false;
         }
 
+        if (iter->second) {
+            proc_scheduler_.remove(iter->second.get());
+        }
         proc_connections_.erase(iter);
         return true;
     }
@@ -1185,8 +1534,11 @@ namespace atbus {
         }
 
         // 如果处于握手阶段，发送节点关系逻辑并加入握手连接池并加入超时判定池
+        // 超时或握手完成前由定时器持有连接
         if (false == conn->is_connected()) {
-            event_timer_.connecting_list.push_back(std::make_pair(event_timer_.sec + conf_.first_idle_timeout, conn));
+            conn->connecting_holder_ = conn;
+            event_timer_.connecting_timers.add(conn->connecting_timer_,
+                                               get_timer_msec() + static_cast<uint64_t>(conf_.first_idle_timeout) * 1000);
         }
         return true;
     }
@@ -1195,6 +1547,10 @@ namespace atbus {
 
     time_t node::get_timer_usec() const { return event_timer_.usec; }
 
+    uint64_t node::get_timer_msec() const {
+        return static_cast<uint64_t>(event_timer_.sec) * 1000 + static_cast<uint64_t>(event_timer_.usec) / 1000;
+    }
+
     void node::on_recv(connection *conn, protocol::msg *m, int status, int errcode) {
         if (status < 0 || errcode < 0) {
             ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, status, errcode);
@@ -1208,7 +1564,8 @@ namespace atbus {
             return;
         }
 
-        // 内部协议处理
+        // 内部协议处理，处理期间的临时内存在处理完后统一回收
+        msg_arena_guard_t arena_guard(this);
         int res = msg_handler::dispatch_msg(*this, conn, m, status, errcode);
         if (res < 0) {
             if (NULL != conn) {
@@ -1274,6 +1631,8 @@ namespace atbus {
             return EN_ATBUS_ERR_PARAMS;
         }
 
+        invalidate_route_cache();
+
         // 父节点断线逻辑则重置状态
         if (state_t::CONNECTING_PARENT == state_ && !conf_.father_address.empty() && conf_.father_address == conn->get_address().address) {
             state_ = state_t::LOST_PARENT;
@@ -1336,6 +1695,9 @@ namespace atbus {
     int node::on_actived() {
         state_ = state_t::RUNNING;
 
+        // 每次连上父节点都拉取一次全局路由表，不需要等父节点的下一次推送
+        pull_node_sync();
+
         if (flags_.test(flag_t::EN_FT_ACTIVED)) {
             return EN_ATBUS_ERR_SUCCESS;
         }
@@ -1406,21 +1768,38 @@ namespace atbus {
 
         const size_t msg_head_len = sizeof(::atbus::protocol::msg_head);
 
-        typedef std::vector<unsigned char> bin_data_block_t;
-        while (loop_left-- > 0 && !self_data_msgs_.empty()) {
-            bin_data_block_t &bin_data = self_data_msgs_.front();
+        const detail::self_msg_ring::record_t *rec;
+        while (loop_left-- > 0 && NULL != (rec = self_msgs_.front())) {
+            if (ATBUS_SELF_MSG_CMD == rec->type) {
+                if (dispatch_self_cmd_msg(*rec)) {
+                    ++ret;
+                }
+                self_msgs_.pop_front();
+                continue;
+            }
+
+            if (ATBUS_SELF_MSG_DATA != rec->type || 3 != rec->segment_count) {
+                assert(ATBUS_SELF_MSG_DATA == rec->type && 3 == rec->segment_count);
+                self_msgs_.pop_front();
+                continue;
+            }
+
+            detail::self_msg_ring::segment_t segs[3];
+            detail::self_msg_ring::get_segments(*rec, segs);
+            assert(msg_head_len == segs[0].size && sizeof(int) == segs[1].size);
+
             atbus::protocol::msg m;
             // copy head
-            memcpy(&m.head, &bin_data[0], msg_head_len);
+            memcpy(&m.head, segs[0].ptr, msg_head_len);
 
             // fake body
             protocol::forward_data data;
             m.body.forward               = &data;
             m.body.forward->from         = get_id();
             m.body.forward->to           = get_id();
-            m.body.forward->content.ptr  = &bin_data[sizeof(int) + msg_head_len];
-            m.body.forward->content.size = bin_data.size() - sizeof(int) - msg_head_len;
-            memcpy(&m.body.forward->flags, &bin_data[msg_head_len], sizeof(int));
+            m.body.forward->content.ptr  = segs[2].ptr;
+            m.body.forward->content.size = segs[2].size;
+            memcpy(&m.body.forward->flags, segs[1].ptr, sizeof(int));
 
             on_recv_data(get_self_endpoint(), NULL, m, m.body.forward->content.ptr, m.body.forward->content.size);
             ++ret;
@@ -1435,42 +1814,146 @@ namespace atbus {
             m.body.forward = NULL;
 
             // pop front msg
-            self_data_msgs_.pop_front();
+            self_msgs_.pop_front();
         }
 
-        while (loop_left-- > 0 && !self_cmd_msgs_.empty()) {
-            std::vector<bin_data_block_t> &bin_datas = self_cmd_msgs_.front();
-            atbus::protocol::msg m;
-            // fake body
-            protocol::custom_command_data data;
-            m.body.custom       = &data;
-            m.body.custom->from = get_id();
+        return ret;
+    }
 
-            do {
-                if (bin_datas.empty() || msg_head_len != bin_datas[0].size()) {
-                    assert(!bin_datas.empty() && msg_head_len == bin_datas[0].size());
-                    break;
-                }
-                // copy head
-                memcpy(&m.head, &bin_datas[0][0], msg_head_len);
-                m.body.custom->commands.resize(bin_datas.size() - 1);
-                for (size_t i = 1; i < bin_datas.size(); ++i) {
-                    m.body.custom->commands[i - 1].ptr  = &bin_datas[i][0];
-                    m.body.custom->commands[i - 1].size = bin_datas[i].size();
-                }
+    int node::dispatch_inbox_msgs() {
+        int ret                       = 0;
+        detail::mpsc_inbox::node_t *n = inbox_.pop_all();
+        while (NULL != n) {
+            node_inbox_msg_t *msg = reinterpret_cast<node_inbox_msg_t *>(n);
+            n                     = n->next;
 
-                on_recv(NULL, &m, 0, 0);
+            int res = send_data(msg->tid, msg->type, msg + 1, msg->size, msg->require_rsp);
+            if (res < 0) {
+                node_inbox_msg_failed(*this, *msg, res);
+            } else {
                 ++ret;
+            }
 
-            } while (false);
+            free(msg);
+        }
 
-            // remove reference
-            m.body.custom = NULL;
+        return ret;
+    }
 
-            // pop front msg
-            self_cmd_msgs_.pop_front();
+    int node::open_inbox() {
+        if (!conf_.flags.test(conf_flag_t::EN_CONF_THREAD_SAFE_INBOX)) {
+            return EN_ATBUS_ERR_SUCCESS;
         }
-        return ret;
+
+        // 唤醒句柄绑定在创建时的事件循环上，更换事件循环时要重新创建
+        if (NULL != inbox_async_ && inbox_async_->loop != get_evloop()) {
+            destroy_inbox_async();
+        }
+
+        // 收件箱的唤醒句柄必须在事件循环线程创建
+        if (NULL == inbox_async_) {
+            inbox_async_ = reinterpret_cast<adapter::async_t *>(malloc(sizeof(adapter::async_t)));
+            if (NULL == inbox_async_) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            if (0 != uv_async_init(get_evloop(), inbox_async_, on_inbox_async)) {
+                free(inbox_async_);
+                inbox_async_ = NULL;
+                return EN_ATBUS_ERR_EV_RUN;
+            }
+            inbox_async_->data = this;
+        }
+
+        inbox_state_.store(inbox_state_t::EN_IS_OPEN);
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    void node::close_inbox() {
+        if (inbox_state_t::EN_IS_OPEN == inbox_state_.load()) {
+            inbox_state_.store(inbox_state_t::EN_IS_CLOSING);
+        }
+
+        // 已经通过状态检查的线程可能还在压入消息，等它们完成后收件箱里就是最终剩余的消息
+        size_t retry_times = 0;
+        while (0 != inbox_producers_.load()) {
+            ++retry_times;
+            __UTIL_LOCK_SPIN_LOCK_WAIT(retry_times);
+        }
+
+        detail::mpsc_inbox::node_t *n = inbox_.pop_all();
+        while (NULL != n) {
+            node_inbox_msg_t *msg = reinterpret_cast<node_inbox_msg_t *>(n);
+            n                     = n->next;
+
+            node_inbox_msg_failed(*this, *msg, EN_ATBUS_ERR_CLOSING);
+            free(msg);
+        }
+
+        inbox_state_.store(inbox_state_t::EN_IS_CLOSED);
+    }
+
+    void node::destroy_inbox_async() {
+        if (NULL == inbox_async_) {
+            return;
+        }
+
+        // 关闭完成前node不会析构
+        adapter::loop_t *loop = inbox_async_->loop;
+        ref_object(inbox_async_);
+        uv_close(reinterpret_cast<adapter::handle_t *>(inbox_async_), on_inbox_closed);
+        inbox_async_ = NULL;
+
+        while (!ref_objs_.empty()) {
+            uv_run(loop, UV_RUN_ONCE);
+        }
+    }
+
+    void node::on_inbox_async(adapter::async_t *handle) {
+        node *self = reinterpret_cast<node *>(handle->data);
+        if (NULL != self) {
+            self->dispatch_inbox_msgs();
+        }
+    }
+
+    void node::on_inbox_closed(adapter::handle_t *handle) {
+        node *self = reinterpret_cast<node *>(handle->data);
+        if (NULL != self) {
+            self->unref_object(handle);
+        }
+
+        free(handle);
+    }
+
+    bool node::dispatch_self_cmd_msg(const detail::self_msg_ring::record_t &rec) {
+        const size_t msg_head_len = sizeof(::atbus::protocol::msg_head);
+        detail::inline_vector<detail::self_msg_ring::segment_t, 8> segs;
+        segs.resize(rec.segment_count);
+        detail::self_msg_ring::get_segments(rec, segs.data());
+        if (segs.empty() || msg_head_len != segs[0].size) {
+            assert(!segs.empty() && msg_head_len == segs[0].size);
+            return false;
+        }
+
+        atbus::protocol::msg m;
+        // fake body
+        protocol::custom_command_data data;
+        m.body.custom       = &data;
+        m.body.custom->from = get_id();
+
+        // copy head
+        memcpy(&m.head, segs[0].ptr, msg_head_len);
+        m.body.custom->commands.resize(segs.size() - 1);
+        for (size_t i = 1; i < segs.size(); ++i) {
+            m.body.custom->commands[i - 1].ptr  = segs[i].ptr;
+            m.body.custom->commands[i - 1].size = segs[i].size;
+        }
+
+        on_recv(NULL, &m, 0, 0);
+
+        // remove reference
+        m.body.custom = NULL;
+        return true;
     }
 
     int node::ping_endpoint(endpoint &ep) {
@@ -1507,15 +1990,179 @@ namespace atbus {
     }
 
     int node::push_node_sync() {
-        // TODO 防止短时间内批量上报注册协议，所以合并上报数据包
+        if (state_t::CREATED == state_ || !self_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
 
-        // TODO 给所有需要全局路由表的子节点下发数据
-        return EN_ATBUS_ERR_SUCCESS;
+        // 短时间内的变更在add_node_sync_push中合并到一次推送，这里只需要发送增量
+        update_route_endpoint(*self_, false);
+
+        std::vector<endpoint *> peers;
+        if (node_father_.node_) {
+            peers.push_back(node_father_.node_.get());
+        } else {
+            for (endpoint_collection_t::iterator iter = node_brother_.begin(); iter != node_brother_.end(); ++iter) {
+                peers.push_back(iter->second.get());
+            }
+        }
+
+        // 给所有需要全局路由表的子节点下发数据
+        for (endpoint_collection_t::iterator iter = node_children_.begin(); iter != node_children_.end(); ++iter) {
+            if (iter->second->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                peers.push_back(iter->second.get());
+            }
+        }
+
+        int ret             = EN_ATBUS_ERR_SUCCESS;
+        uint64_t min_synced = route_table_.get_version();
+        for (size_t i = 0; i < peers.size(); ++i) {
+            // 和send_node_sync_rsp一样，没有推送范围的对端不会收到推送，也不影响墓碑清理
+            detail::route_table::scope_t push_scope;
+            if (!get_node_sync_scope(*peers[i], &push_scope, NULL)) {
+                continue;
+            }
+
+            detail::route_table::peer_t &peer = route_table_.mutable_peer(peers[i]->get_id());
+            int res                           = msg_handler::send_node_sync_rsp(*this, *peers[i], peer.sent_version, false);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, peers[i], NULL, res, 0);
+                ret = res;
+            }
+
+            // 确认过没有变更要发送的版本之前的墓碑对这个对端也没有用了
+            uint64_t synced = peer.sent_version > peer.checked_version ? peer.sent_version : peer.checked_version;
+            if (synced < min_synced) {
+                min_synced = synced;
+            }
+        }
+
+        // 所有对端都已经收到的墓碑可以清理了
+        route_table_.purge(min_synced);
+        return ret;
     }
 
     int node::pull_node_sync() {
-        // TODO 拉取全局节点信息表
-        return EN_ATBUS_ERR_SUCCESS;
+        if (!self_ || !node_father_.node_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        const detail::route_table::peer_t *peer = route_table_.get_peer(node_father_.node_->get_id());
+        return msg_handler::send_node_sync_req(*this, *node_father_.node_, NULL == peer ? 0 : peer->recv_version);
+    }
+
+    void node::add_node_sync_push() {
+        // 下一次proc时推送，同一秒内的变更会合并
+        time_t sec = get_timer_sec() > 0 ? get_timer_sec() : 1;
+        if (0 == event_timer_.node_sync_push || event_timer_.node_sync_push > sec) {
+            event_timer_.node_sync_push = sec;
+        }
+    }
+
+    void node::add_outstanding_request(bus_id_t target, const protocol::msg &m) {
+        if (NULL == m.body.forward) {
+            return;
+        }
+
+        outstanding_key_t key(m.body.forward->from, m.head.sequence);
+        outstanding_request_t &req = outstanding_requests_[key];
+        if (req.timer.is_active()) {
+            // 请求方重发了相同序号的请求，按最新的目标计数
+            service_index_.add_outstanding(req.target, -1);
+        }
+
+        req.key        = key;
+        req.target     = target;
+        req.timer.data = &req;
+        event_timer_.outstanding_timers.add(req.timer, get_timer_msec() + static_cast<uint64_t>(conf_.outstanding_timeout) * 1000);
+        service_index_.add_outstanding(target, 1);
+    }
+
+    void node::remove_outstanding_request(const protocol::msg &m) {
+        if (NULL == m.body.forward || outstanding_requests_.empty()) {
+            return;
+        }
+
+        // 回包的目标是请求方，来源是请求的目标
+        std::map<outstanding_key_t, outstanding_request_t>::iterator iter =
+            outstanding_requests_.find(outstanding_key_t(m.body.forward->to, m.head.sequence));
+        if (iter == outstanding_requests_.end() || iter->second.target != m.body.forward->from) {
+            return;
+        }
+
+        service_index_.add_outstanding(iter->second.target, -1);
+        outstanding_requests_.erase(iter);
+    }
+
+    bool node::get_node_sync_scope(const endpoint &peer, detail::route_table::scope_t *push_scope,
+                                   detail::route_table::scope_t *accept_scope) const {
+        if (!self_ || 0 == get_id() || 0 == peer.get_id() || get_endpoint(peer.get_id()) != &peer) {
+            return false;
+        }
+
+        bool has_push   = false;
+        bool has_accept = false;
+        detail::route_table::scope_t push;
+        detail::route_table::scope_t accept;
+
+        if (node_father_.node_.get() == &peer) {
+            // 父节点: 上报自身子树，接收自身子树以外的节点
+            has_push   = true;
+            has_accept = true;
+            push       = detail::route_table::scope_t(get_id(), self_->get_children_mask(), true);
+            accept     = detail::route_table::scope_t(get_id(), self_->get_children_mask(), false);
+        } else if (is_child_node(peer.get_id())) {
+            // 子节点: 接收子节点的子树，需要全局路由表的子节点下发它子树以外的节点
+            has_push   = peer.get_flag(endpoint::flag_t::GLOBAL_ROUTER);
+            has_accept = true;
+            push       = detail::route_table::scope_t(peer.get_id(), peer.get_children_mask(), false);
+            accept     = detail::route_table::scope_t(peer.get_id(), peer.get_children_mask(), true);
+        } else if (!node_father_.node_ && is_brother_node(peer.get_id())) {
+            // 顶层的兄弟节点: 互相同步各自的子树
+            has_push   = true;
+            has_accept = true;
+            push       = detail::route_table::scope_t(get_id(), self_->get_children_mask(), true);
+            accept     = detail::route_table::scope_t(peer.get_id(), peer.get_children_mask(), true);
+        }
+
+        if ((NULL != push_scope && !has_push) || (NULL != accept_scope && !has_accept)) {
+            return false;
+        }
+
+        if (NULL != push_scope) {
+            *push_scope = push;
+        }
+
+        if (NULL != accept_scope) {
+            *accept_scope = accept;
+        }
+
+        return has_push || has_accept;
+    }
+
+    bool node::has_broadcast_subscriber(const endpoint &peer, const protocol::custom_route_data &route_data) const {
+        if (!conf_.flags.test(conf_flag_t::EN_CONF_BROADCAST_FILTER) || !self_) {
+            return true;
+        }
+
+        if (route_data.type_name.empty() && route_data.tags.empty()) {
+            return true;
+        }
+
+        // 子节点和顶层兄弟节点会同步完整的子树，只有已经收到过对端的同步数据时它的子树才是已知的，其他情况不能过滤
+        detail::route_table::scope_t accept;
+        if (!get_node_sync_scope(peer, NULL, &accept) || !accept.inside) {
+            return true;
+        }
+
+        const detail::route_table::peer_t *sync_peer = route_table_.get_peer(peer.get_id());
+        if (NULL == sync_peer || 0 == sync_peer->recv_version) {
+            return true;
+        }
+
+        // 和服务索引一致，只按第一个tag过滤
+        static const std::string empty_tag;
+        return route_table_.has_subscriber(peer.get_id(), peer.get_children_mask(), route_data.type_name,
+                                           route_data.tags.empty() ? empty_tag : route_data.tags[0]);
     }
 
     uint64_t node::alloc_msg_seq() {
@@ -1623,6 +2270,7 @@ namespace atbus {
             }
 
             coll[maskv] = ep;
+            update_route_endpoint(*ep, false);
 
             // event
             if (event_msg_.on_endpoint_added) {
@@ -1651,6 +2299,7 @@ namespace atbus {
         }
 
         coll[maskv] = ep;
+        update_route_endpoint(*ep, false);
 
         // event
         if (event_msg_.on_endpoint_added) {
@@ -1672,6 +2321,7 @@ namespace atbus {
 
         endpoint::ptr_t ep = iter->second;
         coll.erase(iter);
+        update_route_endpoint(*ep, true);
 
         // event
         if (event_msg_.on_endpoint_removed) {
@@ -1684,6 +2334,7 @@ namespace atbus {
     bool node::remove_collection(endpoint_collection_t &coll) {
         endpoint_collection_t ec;
         ec.swap(coll);
+        invalidate_route_cache();
 
         if (event_msg_.on_endpoint_removed) {
             flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
@@ -1705,15 +2356,88 @@ namespace atbus {
         return false;
     }
 
-    void node::add_ping_timer(endpoint::ptr_t &ep) {
-        if (!ep) {
+    void node::update_route_endpoint(const endpoint &ep, bool removed) {
+        invalidate_route_cache();
+
+        // 重置过程中路由表会被整体清空
+        if (flags_.test(flag_t::EN_FT_RESETTING) || 0 == ep.get_id()) {
             return;
         }
 
+        // 服务索引里只有对端，不包含自身
+        if (self_.get() != &ep) {
+            if (removed) {
+                service_index_.remove(ep.get_id());
+            } else {
+                service_index_.add(ep.get_id(), ep.get_type_name(), ep.get_tags());
+            }
+        }
+
+        if (removed) {
+            if (route_table_.remove_source(ep.get_id()) > 0) {
+                add_node_sync_push();
+            }
+            return;
+        }
+
+        global_route_connecting_.erase(ep.get_id());
+
+        // 没有监听地址时update_direct会保留已知的地址
+        const std::list<std::string> &listen = (self_.get() == &ep) ? get_channels() : ep.get_listen();
+        if (route_table_.update_direct(ep.get_id(), ep.get_children_mask(), ep.get_hostname(), listen, ep.get_type_name(), ep.get_tags())) {
+            add_node_sync_push();
+        }
+    }
+
+    void node::connect_global_route(bus_id_t tid) {
+        const detail::route_table::entry_t *ent = route_table_.find(tid);
+        if (NULL == ent || ent->bus_id == get_id() || NULL != get_endpoint(ent->bus_id)) {
+            return;
+        }
+
+        // 连接失败或者正在连接时，重试间隔内不再发起
+        std::map<bus_id_t, time_t>::iterator iter = global_route_connecting_.find(ent->bus_id);
+        if (iter != global_route_connecting_.end() && iter->second + conf_.retry_interval > get_timer_sec()) {
+            return;
+        }
+        global_route_connecting_[ent->bus_id] = get_timer_sec();
+
+        for (size_t i = 0; i < ent->listen.size(); ++i) {
+            const std::string &addr = ent->listen[i];
+            // 内存和共享内存通道是单工通道，不能用于直连
+            if (0 == UTIL_STRFUNC_STRNCASE_CMP("mem:", addr.c_str(), 4) || 0 == UTIL_STRFUNC_STRNCASE_CMP("shm:", addr.c_str(), 4)) {
+                continue;
+            }
+
+            // unix sock only available in the same host
+            if (0 == UTIL_STRFUNC_STRNCASE_CMP("unix:", addr.c_str(), 5) && ent->hostname != get_hostname()) {
+                continue;
+            }
+
+            int res = connect(addr.c_str());
+            ATBUS_FUNC_NODE_DEBUG(*this, NULL, NULL, NULL, "connect to global route node 0x%llx by %s, res: %d",
+                                  static_cast<unsigned long long>(ent->bus_id), addr.c_str(), res);
+            if (res >= 0) {
+                break;
+            }
+        }
+    }
+
+    void node::add_ping_timer(endpoint &ep) {
         if (conf_.ping_interval <= 0) {
             return;
         }
-        event_timer_.ping_list.push_back(std::make_pair(event_timer_.sec + conf_.ping_interval, ep));
+
+        event_timer_.ping_timers.add(ep.get_ping_timer(), get_timer_msec() + static_cast<uint64_t>(conf_.ping_interval) * 1000);
+    }
+
+    bool node::is_connecting(const char *addr_str, const endpoint *binding) const {
+        node_connecting_finder_t finder;
+        finder.addr_str = addr_str;
+        finder.binding  = binding;
+        finder.found    = false;
+        event_timer_.connecting_timers.for_each(node_find_connecting, &finder);
+        return finder.found;
     }
 
     void node::stat_add_dispatch_times() { ++stat_.dispatch_times; }
@@ -1756,11 +2480,12 @@ namespace atbus {
         iostream_conf_->send_buffer_limit_size = conf_.msg_size;
         iostream_conf_->confirm_timeout        = conf_.first_idle_timeout;
         iostream_conf_->backlog                = conf_.backlog;
+        iostream_conf_->backend                = conf_.io_stream_backend;
 
         return iostream_conf_.get();
     }
 
 
 
-    node::stat_info_t::stat_info_t() : dispatch_times(0) {}
+    node::stat_info_t::stat_info_t() : dispatch_times(0), resident_buffer_size(0), route_cache_hit_times(0) {}
 } // namespace atbus
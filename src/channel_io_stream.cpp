@@ -35,6 +35,7 @@
 #include "algorithm/murmur_hash.h"
 
 #include "detail/buffer.h"
+#include "detail/libatbus_allocator.h"
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_error.h"
 
@@ -107,6 +108,10 @@ namespace atbus {
 
 namespace atbus {
     namespace channel {
+        namespace detail {
+            // io_uring后端，未启用时返回NULL(channel_io_stream_uring.cpp)
+            extern const io_stream_backend_t *io_stream_backend_io_uring();
+        } // namespace detail
 
 #ifdef ATBUS_MACRO_ENABLE_STATIC_ASSERT
         static_assert(std::is_pod<io_stream_conf>::value, "io_stream_conf should be a pod type");
@@ -196,8 +201,15 @@ namespace atbus {
             conf->max_read_net_eagain_count              = 256;
             conf->max_read_check_block_size_failed_count = 10;
             conf->max_read_check_hash_failed_count       = 10;
+
+            conf->backend                     = io_stream_backend_t::EN_BT_LIBUV;
+            conf->io_uring_queue_depth        = 256;
+            conf->io_uring_recv_buffer_number = 256;
+            conf->io_uring_recv_buffer_size   = ATBUS_MACRO_DATA_SMALL_SIZE;
         }
 
+        static const io_stream_backend_t *io_stream_get_backend(int type);
+
         static adapter::loop_t *io_stream_get_loop(io_stream_channel *channel) {
             if (NULL == channel) {
                 return NULL;
@@ -214,6 +226,183 @@ namespace atbus {
             return channel->ev_loop;
         }
 
+        // ============ 共享接收缓冲池 ============
+        static size_t io_stream_recv_pool_class(size_t s) {
+            size_t index = 0;
+            while (index < ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER &&
+                   (static_cast<size_t>(1) << (ATBUS_CHANNEL_IOS_RECV_POOL_MIN_SHIFT + index)) < s) {
+                ++index;
+            }
+
+            return index;
+        }
+
+        static inline size_t io_stream_recv_pool_class_size(size_t index) {
+            return static_cast<size_t>(1) << (ATBUS_CHANNEL_IOS_RECV_POOL_MIN_SHIFT + index);
+        }
+
+        static size_t io_stream_recv_pool_max_cached_size(const io_stream_channel *channel) {
+            size_t max_size = channel->conf.recv_buffer_max_size;
+            if (0 == max_size) {
+                max_size = ATBUS_MACRO_MSG_LIMIT;
+            }
+
+            return max_size * channel->conf.recv_buffer_static;
+        }
+
+        static bool io_stream_recv_block_alloc(io_stream_channel *channel, io_stream_connection *conn, size_t s) {
+            assert(NULL == conn->read_block);
+            if (channel->conf.recv_buffer_max_size > 0 && s > channel->conf.recv_buffer_max_size) {
+                return false;
+            }
+
+            io_stream_recv_buffer_pool &pool     = channel->recv_pool;
+            size_t index                         = io_stream_recv_pool_class(s);
+            ::atbus::detail::buffer_block *block = NULL;
+            if (index < ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER) {
+                if (!pool.free_blocks[index].empty()) {
+                    block = pool.free_blocks[index].back();
+                    pool.free_blocks[index].pop_back();
+                    pool.cached_size -= block->raw_size();
+                    if (pool.free_blocks[index].size() < pool.free_low_watermark[index]) {
+                        pool.free_low_watermark[index] = pool.free_blocks[index].size();
+                    }
+                } else {
+                    block = ::atbus::detail::buffer_block::malloc(io_stream_recv_pool_class_size(index));
+                }
+            } else {
+                block = ::atbus::detail::buffer_block::malloc(s);
+            }
+
+            if (NULL == block) {
+                return false;
+            }
+
+            pool.using_size += block->raw_size();
+            conn->read_block      = block;
+            conn->read_block_len  = s;
+            conn->read_block_used = 0;
+            return true;
+        }
+
+        static void io_stream_recv_block_release(io_stream_channel *channel, io_stream_connection *conn) {
+            ::atbus::detail::buffer_block *block = conn->read_block;
+            if (NULL == block) {
+                return;
+            }
+
+            conn->read_block      = NULL;
+            conn->read_block_len  = 0;
+            conn->read_block_used = 0;
+
+            io_stream_recv_buffer_pool &pool = channel->recv_pool;
+            assert(pool.using_size >= block->raw_size());
+            pool.using_size -= block->raw_size();
+
+            size_t index = io_stream_recv_pool_class(block->raw_size());
+            if (index < ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER && io_stream_recv_pool_class_size(index) == block->raw_size() &&
+                pool.cached_size + block->raw_size() <= io_stream_recv_pool_max_cached_size(channel)) {
+                pool.free_blocks[index].push_back(block);
+                pool.cached_size += block->raw_size();
+                return;
+            }
+
+            ::atbus::detail::buffer_block::free(block);
+        }
+
+        static void io_stream_recv_pool_clear(io_stream_channel *channel) {
+            io_stream_recv_buffer_pool &pool = channel->recv_pool;
+            for (size_t i = 0; i < ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER; ++i) {
+                for (size_t j = 0; j < pool.free_blocks[i].size(); ++j) {
+                    ::atbus::detail::buffer_block::free(pool.free_blocks[i][j]);
+                }
+                pool.free_blocks[i].clear();
+                pool.free_low_watermark[i] = 0;
+            }
+
+            pool.cached_size = 0;
+        }
+
+        static void io_stream_setup_write_buffers(io_stream_channel *channel, io_stream_connection *conn) {
+            conn->write_buffers.set_limit(channel->conf.send_buffer_max_size, 0);
+            if (channel->conf.send_buffer_max_size > 0 && channel->conf.send_buffer_static > 0) {
+                conn->write_buffers.set_mode(channel->conf.send_buffer_max_size, channel->conf.send_buffer_static);
+            }
+        }
+
+        static inline void io_stream_touch_connection(io_stream_connection *conn) {
+            if (NULL != conn->channel && NULL != conn->channel->ev_loop) {
+                conn->active_time = uv_now(conn->channel->ev_loop);
+            }
+        }
+
+        // ============ 连接表管理 ============
+        static inline void io_stream_connection_add_ref(io_stream_connection *conn) {
+            assert(conn && conn->ref_count > 0);
+            ++conn->ref_count;
+        }
+
+        static inline void io_stream_connection_release(io_stream_connection *conn) {
+            assert(conn && conn->ref_count > 0);
+            if (0 == --conn->ref_count) {
+                delete conn;
+            }
+        }
+
+        static bool io_stream_connection_alloc_slot(io_stream_channel *channel, io_stream_connection *conn) {
+            io_stream_connection_table &table = channel->conn_table;
+
+            uint32_t index;
+            if (ATBUS_CHANNEL_IOS_INVALID_SLOT != table.free_head) {
+                index           = table.free_head;
+                table.free_head = table.slots[index].next_free;
+            } else {
+                if (table.slots.size() >= ATBUS_CHANNEL_IOS_INVALID_SLOT) {
+                    return false;
+                }
+
+                index = static_cast<uint32_t>(table.slots.size());
+                io_stream_connection_slot slot;
+                slot.conn       = NULL;
+                slot.generation = 1; // 代数从1开始，保证有效的连接ID不为0
+                slot.next_free  = ATBUS_CHANNEL_IOS_INVALID_SLOT;
+                table.slots.push_back(slot);
+            }
+
+            io_stream_connection_slot &slot = table.slots[index];
+            slot.conn                       = conn;
+            slot.next_free                  = ATBUS_CHANNEL_IOS_INVALID_SLOT;
+
+            conn->slot_index = index;
+            conn->ref_count  = 1; // 连接表持有的引用
+            conn->write_buffers.bind_resident_counter(&channel->write_resident_size);
+            ++table.active_number;
+            return true;
+        }
+
+        static void io_stream_connection_free_slot(io_stream_channel *channel, io_stream_connection *conn) {
+            io_stream_connection_table &table = channel->conn_table;
+            assert(conn->slot_index < table.slots.size());
+
+            io_stream_connection_slot &slot = table.slots[conn->slot_index];
+            assert(slot.conn == conn);
+            slot.conn = NULL;
+            conn->write_buffers.bind_resident_counter(NULL);
+            if (0 == ++slot.generation) {
+                slot.generation = 1;
+            }
+            slot.next_free  = table.free_head;
+            table.free_head = conn->slot_index;
+
+            assert(table.gc_number > 0);
+            --table.gc_number;
+
+            io_stream_recv_block_release(channel, conn);
+
+            conn->slot_index = ATBUS_CHANNEL_IOS_INVALID_SLOT;
+            io_stream_connection_release(conn);
+        }
+
         int io_stream_init(io_stream_channel *channel, adapter::loop_t *ev_loop, const io_stream_conf *conf) {
             if (NULL == channel) {
                 return EN_ATBUS_ERR_PARAMS;
@@ -236,6 +425,24 @@ namespace atbus {
             channel->read_net_eagain_count              = 0;
             channel->read_check_block_size_failed_count = 0;
             channel->read_check_hash_failed_count       = 0;
+
+            channel->conn_table.slots.clear();
+            channel->conn_table.free_head     = ATBUS_CHANNEL_IOS_INVALID_SLOT;
+            channel->conn_table.active_number = 0;
+            channel->conn_table.gc_number     = 0;
+
+            io_stream_recv_pool_clear(channel);
+            channel->recv_pool.using_size = 0;
+            channel->write_resident_size  = 0;
+
+            // 后端初始化失败(比如内核不支持)则回退到libuv
+            channel->backend      = io_stream_get_backend(channel->conf.backend);
+            channel->backend_data = NULL;
+            if (io_stream_backend_t::EN_BT_LIBUV != channel->backend->type) {
+                if (NULL == io_stream_get_loop(channel) || 0 != channel->backend->init(channel)) {
+                    channel->backend = io_stream_get_backend(io_stream_backend_t::EN_BT_LIBUV);
+                }
+            }
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -254,14 +461,28 @@ namespace atbus {
             // 释放所有连接
             {
                 std::vector<io_stream_connection *> pending_release;
-                pending_release.reserve(channel->conn_pool.size());
-                for (io_stream_channel::conn_pool_t::iterator iter = channel->conn_pool.begin(); iter != channel->conn_pool.end(); ++iter) {
-                    pending_release.push_back(iter->second.get());
+                pending_release.reserve(channel->conn_table.active_number);
+                for (io_stream_connection *conn = io_stream_next_connection(channel, NULL); NULL != conn;
+                     conn                       = io_stream_next_connection(channel, conn)) {
+                    io_stream_connection_add_ref(conn);
+                    pending_release.push_back(conn);
                 }
 
                 for (size_t i = 0; i < pending_release.size(); ++i) {
                     io_stream_disconnect(channel, pending_release[i], NULL);
+                    io_stream_connection_release(pending_release[i]);
+                }
+            }
+
+            // 后端可能还有未完成的写操作，要等所有连接关闭后才能释放后端
+            // 后端的handle关闭会计入active的req
+            if (NULL != channel->backend) {
+                while (NULL != channel->ev_loop && (channel->conn_table.active_number > 0 || channel->conn_table.gc_number > 0)) {
+                    uv_run(channel->ev_loop, UV_RUN_ONCE);
                 }
+
+                channel->backend->close(channel);
+                channel->backend = NULL;
             }
 
             // 必须保证这个接口过后channel内的数据可以正常释放
@@ -283,7 +504,7 @@ namespace atbus {
                 free(channel->ev_loop);
             } else {
                 // both connection and pending gc connection should all be erased
-                while (!channel->conn_pool.empty() || !channel->conn_gc_pool.empty()) {
+                while (channel->conn_table.active_number > 0 || channel->conn_table.gc_number > 0) {
                     uv_run(channel->ev_loop, UV_RUN_ONCE);
                 }
 
@@ -294,6 +515,8 @@ namespace atbus {
                 }
             }
 
+            // 所有连接都已回收，释放共享接收缓冲池
+            io_stream_recv_pool_clear(channel);
             channel->ev_loop = NULL;
 
             return EN_ATBUS_ERR_SUCCESS;
@@ -330,16 +553,12 @@ namespace atbus {
             if (io_stream_connection::EN_ST_CONNECTED != conn_raw_ptr->status) {
                 buf->base = NULL;
                 buf->len  = 0;
-                uv_read_stop(conn_raw_ptr->handle.get());
+                conn_raw_ptr->channel->backend->read_stop(conn_raw_ptr);
                 return;
             }
 
-            void *data   = NULL;
-            size_t sread = 0, swrite = 0;
-            conn_raw_ptr->read_buffers.back(data, sread, swrite);
-
             // 正在读取vint时，指定缓冲区为head内存块
-            if (NULL == data || 0 == swrite) {
+            if (NULL == conn_raw_ptr->read_block) {
                 buf->len = sizeof(conn_raw_ptr->read_head.buffer) - conn_raw_ptr->read_head.len;
 
                 if (0 == buf->len) {
@@ -355,8 +574,9 @@ namespace atbus {
             }
 
             // 否则指定为大内存块缓冲区
-            buf->base = reinterpret_cast<char *>(data);
-            buf->len  = swrite;
+            assert(conn_raw_ptr->read_block_used < conn_raw_ptr->read_block_len);
+            buf->base = reinterpret_cast<char *>(conn_raw_ptr->read_block->raw_data()) + conn_raw_ptr->read_block_used;
+            buf->len  = conn_raw_ptr->read_block_len - conn_raw_ptr->read_block_used;
         }
 
         static void io_stream_on_recv_read_fn(uv_stream_t *stream, ssize_t nread, const uv_buf_t * /*buf*/) {
@@ -394,13 +614,11 @@ namespace atbus {
                 return;
             }
 
-            void *data   = NULL;
-            size_t sread = 0, swrite = 0;
-            conn_raw_ptr->read_buffers.back(data, sread, swrite);
+            io_stream_touch_connection(conn_raw_ptr);
             bool is_free = false;
 
             // head 阶段
-            if (NULL == data || 0 == swrite) {
+            if (NULL == conn_raw_ptr->read_block) {
                 assert(static_cast<size_t>(nread) <= sizeof(conn_raw_ptr->read_head.buffer) - conn_raw_ptr->read_head.len);
                 conn_raw_ptr->read_head.len += static_cast<size_t>(nread); // 写数据计数
 
@@ -453,11 +671,12 @@ namespace atbus {
                     } else {
                         // 大数据包，使用缓冲区，并且剩余数据一定是在一个包内
                         // 32位hash 也暂存在这里
-                        if (EN_ATBUS_ERR_SUCCESS == conn_raw_ptr->read_buffers.push_back(data, sizeof(uint32_t) + msg_len)) {
+                        if (io_stream_recv_block_alloc(channel, conn_raw_ptr, sizeof(uint32_t) + msg_len)) {
+                            char *data = reinterpret_cast<char *>(conn_raw_ptr->read_block->raw_data());
                             memcpy(data, buff_start, sizeof(uint32_t)); // 32位hash
-                            memcpy(reinterpret_cast<char *>(data) + sizeof(uint32_t), buff_start + sizeof(uint32_t) + vint_len,
+                            memcpy(data + sizeof(uint32_t), buff_start + sizeof(uint32_t) + vint_len,
                                    buff_left_len - sizeof(uint32_t) - vint_len);
-                            conn_raw_ptr->read_buffers.pop_back(buff_left_len - vint_len, false); // vint_len不用保存
+                            conn_raw_ptr->read_block_used = buff_left_len - vint_len; // vint_len不用保存
 
                             buff_start += buff_left_len;
                             buff_left_len = 0; // 循环退出
@@ -481,17 +700,17 @@ namespace atbus {
                 conn_raw_ptr->read_head.len = buff_left_len;
             } else {
                 size_t nread_s = static_cast<size_t>(nread);
-                assert(nread_s <= swrite);
+                assert(conn_raw_ptr->read_block_used + nread_s <= conn_raw_ptr->read_block_len);
 
-                // 写数据计数,但不释放缓冲区
-                conn_raw_ptr->read_buffers.pop_back(nread_s, false);
+                // 写数据计数
+                conn_raw_ptr->read_block_used += nread_s;
             }
 
             // 如果在大内存块缓冲区，判定回调
-            conn_raw_ptr->read_buffers.front(data, sread, swrite);
-            if (NULL != data && 0 == swrite) {
+            if (NULL != conn_raw_ptr->read_block && conn_raw_ptr->read_block_used >= conn_raw_ptr->read_block_len) {
                 channel->error_code = 0;
-                data                = ::atbus::detail::fn::buffer_prev(data, sread);
+                void *data          = conn_raw_ptr->read_block->raw_data();
+                size_t sread        = conn_raw_ptr->read_block_len;
 
                 // 32位Hash校验和
                 uint32_t check_hash = util::hash::murmur_hash3_x86_32(reinterpret_cast<char *>(data) + sizeof(uint32_t),
@@ -520,8 +739,8 @@ namespace atbus {
                                            // 由于buffer_block内取出的数据已经保证了字节对齐，所以这里一定是4字节对齐
                                            msg_len);
 
-                // 回调并释放缓冲区
-                conn_raw_ptr->read_buffers.pop_front(0, true);
+                // 回调并归还缓冲区
+                io_stream_recv_block_release(channel, conn_raw_ptr);
             }
 
             if (is_free) {
@@ -537,6 +756,82 @@ namespace atbus {
             }
         }
 
+        static void io_stream_on_written_fn(uv_write_t *req, int status);
+
+        // ============ libuv 后端 ============
+        static int io_stream_backend_libuv_init(io_stream_channel * /*channel*/) { return EN_ATBUS_ERR_SUCCESS; }
+
+        static void io_stream_backend_libuv_close(io_stream_channel * /*channel*/) {}
+
+        static int io_stream_backend_libuv_read_start(io_stream_connection *connection) {
+            return uv_read_start(connection->handle.get(), io_stream_on_recv_alloc_fn, io_stream_on_recv_read_fn);
+        }
+
+        static int io_stream_backend_libuv_read_stop(io_stream_connection *connection) {
+            return uv_read_stop(connection->handle.get());
+        }
+
+        static int io_stream_backend_libuv_write(io_stream_connection *connection, uv_write_t *req, const uv_buf_t *bufs, unsigned int nbufs) {
+            // bufs[] will be copied in libuv, but the real data will not
+            return uv_write(req, connection->handle.get(), bufs, nbufs, io_stream_on_written_fn);
+        }
+
+        static const io_stream_backend_t *io_stream_get_backend(int type) {
+            static io_stream_backend_t libuv_backend = {io_stream_backend_t::EN_BT_LIBUV,
+                                                        "libuv",
+                                                        io_stream_backend_libuv_init,
+                                                        io_stream_backend_libuv_close,
+                                                        io_stream_backend_libuv_read_start,
+                                                        io_stream_backend_libuv_read_stop,
+                                                        io_stream_backend_libuv_write};
+
+            if (io_stream_backend_t::EN_BT_IO_URING == type) {
+                const io_stream_backend_t *ret = detail::io_stream_backend_io_uring();
+                if (NULL != ret) {
+                    return ret;
+                }
+            }
+
+            return &libuv_backend;
+        }
+
+        namespace detail {
+            // 后端收到数据后，按libuv的alloc+read流程分段拷贝进接收缓冲区
+            void io_stream_backend_on_read(io_stream_connection *connection, const char *data, ssize_t nread) {
+                assert(connection && connection->handle);
+                if (nread <= 0 || NULL == data) {
+                    io_stream_on_recv_read_fn(connection->handle.get(), nread, NULL);
+                    return;
+                }
+
+                size_t left = static_cast<size_t>(nread);
+                while (left > 0 && io_stream_connection::EN_ST_CONNECTED == connection->status) {
+                    uv_buf_t buf;
+                    io_stream_on_recv_alloc_fn(reinterpret_cast<uv_handle_t *>(connection->handle.get()), left, &buf);
+                    if (NULL == buf.base || 0 == buf.len) {
+                        break;
+                    }
+
+                    size_t copy_len = buf.len < left ? buf.len : left;
+                    memcpy(buf.base, data, copy_len);
+                    data += copy_len;
+                    left -= copy_len;
+
+                    io_stream_on_recv_read_fn(connection->handle.get(), static_cast<ssize_t>(copy_len), &buf);
+                }
+            }
+
+            void io_stream_backend_on_written(uv_write_t *req, int status) { io_stream_on_written_fn(req, status); }
+
+            int io_stream_backend_libuv_read_start(io_stream_connection *connection) {
+                return ::atbus::channel::io_stream_backend_libuv_read_start(connection);
+            }
+
+            int io_stream_backend_libuv_read_stop(io_stream_connection *connection) {
+                return ::atbus::channel::io_stream_backend_libuv_read_stop(connection);
+            }
+        } // namespace detail
+
 
         static void io_stream_stream_init(io_stream_channel *channel, io_stream_connection *conn, adapter::stream_t *handle) {
             if (NULL == channel || NULL == handle) {
@@ -604,6 +899,24 @@ namespace atbus {
             size_t priv_size;
         };
 
+        // handle已关闭并且没有未完成的写请求，回调并回收槽位
+        static void io_stream_connection_on_closed(io_stream_channel *channel, io_stream_connection *conn_raw_ptr) {
+            assert(ATBUS_CHANNEL_IOS_CHECK_FLAG(conn_raw_ptr->flags, io_stream_connection::EN_CF_SHUTDOWN));
+            assert(!ATBUS_CHANNEL_IOS_CHECK_FLAG(conn_raw_ptr->flags, io_stream_connection::EN_CF_WRITING));
+            assert(conn_raw_ptr->slot_index < channel->conn_table.slots.size());
+            assert(channel->conn_table.slots[conn_raw_ptr->slot_index].conn == conn_raw_ptr);
+
+            conn_raw_ptr->status = io_stream_connection::EN_ST_DISCONNECTIED;
+            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_DISCONNECTED, channel, conn_raw_ptr, 0, EN_ATBUS_ERR_SUCCESS, NULL,
+                                       0);
+
+            if (NULL != conn_raw_ptr->act_disc_cbk) {
+                conn_raw_ptr->act_disc_cbk(channel, conn_raw_ptr, EN_ATBUS_ERR_SUCCESS, NULL, 0);
+            }
+
+            io_stream_connection_free_slot(channel, conn_raw_ptr);
+        }
+
         static void io_stream_connection_on_close(uv_handle_t *handle) {
             io_stream_connection *conn_raw_ptr = reinterpret_cast<io_stream_connection *>(handle->data);
             // connect not completed, directly exit
@@ -620,18 +933,14 @@ namespace atbus {
 
             io_stream_flag_guard flag_guard(channel->flags, io_stream_channel::EN_CF_IN_CALLBACK);
 
-            io_stream_channel::conn_gc_pool_t::iterator iter = channel->conn_gc_pool.find(reinterpret_cast<uintptr_t>(conn_raw_ptr));
-            assert(iter != channel->conn_gc_pool.end());
-
-            iter->second->status = io_stream_connection::EN_ST_DISCONNECTIED;
-            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_DISCONNECTED, channel, iter->second.get(), 0, EN_ATBUS_ERR_SUCCESS,
-                                       NULL, 0);
-
-            if (NULL != conn_raw_ptr->act_disc_cbk) {
-                conn_raw_ptr->act_disc_cbk(channel, conn_raw_ptr, EN_ATBUS_ERR_SUCCESS, NULL, 0);
+            // libuv在关闭回调前已经以UV_ECANCELED完成了所有写请求，但io_uring的sendmsg要等完成事件
+            // 写请求和待发送的数据都在连接上，所以等写完成流程执行后再回收，这样写回调也总是在断开回调之前
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(conn_raw_ptr->flags, io_stream_connection::EN_CF_WRITING)) {
+                ATBUS_CHANNEL_IOS_SET_FLAG(conn_raw_ptr->flags, io_stream_connection::EN_CF_CLOSED);
+                return;
             }
 
-            channel->conn_gc_pool.erase(iter);
+            io_stream_connection_on_closed(channel, conn_raw_ptr);
         }
 
         static void io_stream_async_data_on_close(uv_handle_t *handle) {
@@ -668,13 +977,20 @@ namespace atbus {
             assert(conn->handle->data == conn);
             assert(conn->channel);
 
-            // move to gc pool
+            // 标记为等待回收，关闭回调里释放槽位
             if (conn && conn->channel) {
-                io_stream_channel::conn_pool_t::iterator iter = conn->channel->conn_pool.find(conn->fd);
-                assert(iter != conn->channel->conn_pool.end());
+                assert(!ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_SHUTDOWN));
+                assert(conn->slot_index < conn->channel->conn_table.slots.size());
+                assert(conn->channel->conn_table.slots[conn->slot_index].conn == conn);
+
+                ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_SHUTDOWN);
+                --conn->channel->conn_table.active_number;
+                ++conn->channel->conn_table.gc_number;
+            }
 
-                conn->channel->conn_gc_pool[reinterpret_cast<uintptr_t>(conn)] = iter->second;
-                conn->channel->conn_pool.erase(iter);
+            // 后端可能还持有未完成的读写请求，关闭前先停止。后端通过EN_CF_SHUTDOWN判断是否需要取消正在进行的写请求
+            if (conn && conn->channel && NULL != conn->channel->backend) {
+                conn->channel->backend->read_stop(conn);
             }
 
             // ATBUS_CHANNEL_REQ_START(conn->channel);
@@ -707,52 +1023,53 @@ namespace atbus {
             return 0;
         }
 
-        static std::shared_ptr<io_stream_connection> io_stream_make_connection(io_stream_channel *channel,
-                                                                               std::shared_ptr<adapter::stream_t> handle) {
-            std::shared_ptr<io_stream_connection> ret;
+        static io_stream_connection *io_stream_make_connection(io_stream_channel *channel, std::shared_ptr<adapter::stream_t> handle) {
             if (NULL == channel) {
-                return ret;
+                return NULL;
             }
 
-            ret = std::make_shared<io_stream_connection>();
-            if (!ret) {
-                return ret;
+            io_stream_connection *ret = new io_stream_connection();
+            if (NULL == ret) {
+                return NULL;
             }
 
             if (0 != uv_fileno(reinterpret_cast<const uv_handle_t *>(handle.get()), &ret->fd)) {
-                ret.reset();
-                return ret;
+                delete ret;
+                return NULL;
+            }
+
+            if (!io_stream_connection_alloc_slot(channel, ret)) {
+                delete ret;
+                return NULL;
             }
 
-            ret->handle = handle;
-            ret->data   = NULL;
+            ret->handle       = handle;
+            ret->backend_data = NULL;
+            ret->data         = NULL;
             ATBUS_CHANNEL_IOS_CLEAR_FLAG(ret->flags);
-            handle->data = ret.get();
+            handle->data = ret;
 
             memset(ret->evt.callbacks, 0, sizeof(ret->evt.callbacks));
             ret->act_disc_cbk = NULL;
             ret->status       = io_stream_connection::EN_ST_CREATED;
 
 
-            ret->read_buffers.set_limit(channel->conf.recv_buffer_max_size, 0);
-            if (channel->conf.recv_buffer_max_size > 0 && channel->conf.recv_buffer_static > 0) {
-                ret->read_buffers.set_mode(channel->conf.recv_buffer_max_size, channel->conf.recv_buffer_static);
-            }
-            ret->read_head.len = 0;
+            ret->read_head.len   = 0;
+            ret->read_block      = NULL;
+            ret->read_block_len  = 0;
+            ret->read_block_used = 0;
 
-            ret->write_buffers.set_limit(channel->conf.send_buffer_max_size, 0);
-            if (channel->conf.send_buffer_max_size > 0 && channel->conf.send_buffer_static > 0) {
-                ret->write_buffers.set_mode(channel->conf.send_buffer_max_size, channel->conf.send_buffer_static);
-            }
+            io_stream_setup_write_buffers(channel, ret);
 
-            channel->conn_pool[ret->fd] = ret;
-            ret->channel                = channel;
+            ret->channel     = channel;
+            ret->active_time = 0;
+            io_stream_touch_connection(ret);
 
             // 监听关闭事件，用于释放资源
             handle->close_cb = io_stream_connection_on_close;
 
             // 监听可读事件
-            uv_read_start(handle.get(), io_stream_on_recv_alloc_fn, io_stream_on_recv_read_fn);
+            channel->backend->read_start(ret);
 
             return ret;
         }
@@ -777,7 +1094,7 @@ namespace atbus {
         }
 
         // tcp 收到连接通用逻辑
-        static adapter::tcp_t *io_stream_tcp_connection_common(std::shared_ptr<io_stream_connection> &conn,
+        static adapter::tcp_t *io_stream_tcp_connection_common(io_stream_connection *&conn,
                                                                std::shared_ptr<adapter::stream_t> &recv_conn, uv_stream_t *req,
                                                                int status) {
             io_stream_connection *conn_raw_ptr = reinterpret_cast<io_stream_connection *>(req->data);
@@ -812,7 +1129,7 @@ namespace atbus {
 
             // 后面不会再失败了
             io_stream_tcp_setup(channel, tcp_conn);
-            io_stream_tcp_init(channel, conn.get(), tcp_conn);
+            io_stream_tcp_init(channel, conn, tcp_conn);
             return tcp_conn;
         }
 
@@ -828,7 +1145,7 @@ namespace atbus {
             int res             = EN_ATBUS_ERR_SUCCESS;
 
             std::shared_ptr<adapter::stream_t> recv_conn;
-            std::shared_ptr<io_stream_connection> conn;
+            io_stream_connection *conn = NULL;
 
             do {
                 adapter::tcp_t *tcp_conn = io_stream_tcp_connection_common(conn, recv_conn, req, status);
@@ -861,7 +1178,7 @@ namespace atbus {
             } while (false);
 
             // 回调函数，如果发起连接接口调用成功一定要调用回调函数
-            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_ACCEPTED, channel, conn_raw_ptr, conn.get(), channel->error_code,
+            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_ACCEPTED, channel, conn_raw_ptr, conn, channel->error_code,
                                        res, NULL, 0);
 
             if (!conn && recv_conn) {
@@ -884,7 +1201,7 @@ namespace atbus {
             channel->error_code = status;
             int res             = EN_ATBUS_ERR_SUCCESS;
 
-            std::shared_ptr<io_stream_connection> conn;
+            io_stream_connection *conn = NULL;
             std::shared_ptr<adapter::stream_t> recv_conn;
 
             do {
@@ -923,7 +1240,7 @@ namespace atbus {
                 conn->status = io_stream_connection::EN_ST_CONNECTED;
 
                 io_stream_pipe_setup(channel, pipe_conn);
-                io_stream_pipe_init(channel, conn.get(), pipe_conn);
+                io_stream_pipe_init(channel, conn, pipe_conn);
 
                 char pipe_path[MAX_PATH] = {0};
                 size_t path_len          = sizeof(pipe_path);
@@ -933,7 +1250,7 @@ namespace atbus {
             } while (false);
 
             // 回调函数，如果发起连接接口调用成功一定要调用回调函数
-            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_ACCEPTED, channel, conn_raw_ptr, conn.get(), channel->error_code,
+            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_ACCEPTED, channel, conn_raw_ptr, conn, channel->error_code,
                                        res, NULL, 0);
 
             if (!conn && recv_conn) {
@@ -1042,7 +1359,7 @@ namespace atbus {
             if (0 == UTIL_STRFUNC_STRNCASE_CMP("ipv4", addr.scheme.c_str(), 4) ||
                 0 == UTIL_STRFUNC_STRNCASE_CMP("ipv6", addr.scheme.c_str(), 4)) {
                 std::shared_ptr<adapter::stream_t> listen_conn;
-                std::shared_ptr<io_stream_connection> conn;
+                io_stream_connection *conn = NULL;
                 adapter::tcp_t *handle = io_stream_make_stream_ptr<adapter::tcp_t>(listen_conn);
                 if (NULL == handle) {
                     return EN_ATBUS_ERR_MALLOC;
@@ -1091,14 +1408,14 @@ namespace atbus {
                     conn->status = io_stream_connection::EN_ST_CONNECTED;
                     ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_LISTEN);
 
-                    io_stream_tcp_init(channel, conn.get(), handle);
-                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, channel, callback, conn.get(), 0, ret, priv_data,
+                    io_stream_tcp_init(channel, conn, handle);
+                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, channel, callback, conn, 0, ret, priv_data,
                                                priv_size);
                     return ret;
                 } while (false);
 
                 if (conn) {
-                    io_stream_shutdown_ev_handle(conn.get());
+                    io_stream_shutdown_ev_handle(conn);
                 } else if (listen_conn) {
                     io_stream_shutdown_ev_handle(listen_conn);
                 }
@@ -1118,7 +1435,7 @@ namespace atbus {
                     }
                 }
                 std::shared_ptr<adapter::stream_t> listen_conn;
-                std::shared_ptr<io_stream_connection> conn;
+                io_stream_connection *conn = NULL;
                 adapter::pipe_t *handle = io_stream_make_stream_ptr<adapter::pipe_t>(listen_conn);
                 uv_pipe_init(ev_loop, handle, 1);
                 int ret = EN_ATBUS_ERR_SUCCESS;
@@ -1145,14 +1462,14 @@ namespace atbus {
                     conn->status = io_stream_connection::EN_ST_CONNECTED;
                     ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_LISTEN);
 
-                    io_stream_pipe_init(channel, conn.get(), handle);
-                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, channel, callback, conn.get(), 0, ret, priv_data,
+                    io_stream_pipe_init(channel, conn, handle);
+                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, channel, callback, conn, 0, ret, priv_data,
                                                priv_size);
                     return ret;
                 } while (false);
 
                 if (conn) {
-                    io_stream_shutdown_ev_handle(conn.get());
+                    io_stream_shutdown_ev_handle(conn);
                 } else if (listen_conn) {
                     io_stream_shutdown_ev_handle(listen_conn);
                 }
@@ -1192,7 +1509,7 @@ namespace atbus {
 
             int errcode                     = EN_ATBUS_ERR_SUCCESS;
             async_data->channel->error_code = status;
-            std::shared_ptr<io_stream_connection> conn;
+            io_stream_connection *conn = NULL;
             do {
                 if (0 != status) {
                     if (async_data->pipe) {
@@ -1218,16 +1535,16 @@ namespace atbus {
                 conn->addr = async_data->addr;
 
                 if (async_data->pipe) {
-                    io_stream_pipe_init(async_data->channel, conn.get(), reinterpret_cast<adapter::pipe_t *>(req->handle));
+                    io_stream_pipe_init(async_data->channel, conn, reinterpret_cast<adapter::pipe_t *>(req->handle));
                 } else {
-                    io_stream_tcp_init(async_data->channel, conn.get(), reinterpret_cast<adapter::tcp_t *>(req->handle));
+                    io_stream_tcp_init(async_data->channel, conn, reinterpret_cast<adapter::tcp_t *>(req->handle));
                 }
 
                 conn->status = io_stream_connection::EN_ST_CONNECTED;
                 ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_CONNECT);
             } while (false);
 
-            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, async_data->channel, async_data->callback, conn.get(),
+            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, async_data->channel, async_data->callback, conn,
                                        status, errcode, async_data->priv_data, async_data->priv_size);
 
             // 如果连接成功，async_data->stream的生命周期由conn接管
@@ -1486,12 +1803,100 @@ namespace atbus {
                 return EN_ATBUS_ERR_PARAMS;
             }
 
-            io_stream_channel::conn_pool_t::iterator iter = channel->conn_pool.find(fd);
-            if (iter == channel->conn_pool.end()) {
-                return EN_ATBUS_ERR_CONNECTION_NOT_FOUND;
+            // 按fd查找只用于这个低频接口，直接遍历连接表
+            for (io_stream_connection *conn = io_stream_next_connection(channel, NULL); NULL != conn;
+                 conn                       = io_stream_next_connection(channel, conn)) {
+                if (conn->fd == fd) {
+                    return io_stream_disconnect(channel, conn, callback);
+                }
+            }
+
+            return EN_ATBUS_ERR_CONNECTION_NOT_FOUND;
+        }
+
+        // 静态缓冲区的块可能跨越尾部被拆成两段，以下按逻辑偏移读写
+        static void io_stream_segments_write(const ::atbus::detail::buffer_manager::segment_t *segs, size_t offset, const void *src,
+                                             size_t len) {
+            for (size_t i = 0; i < 2 && len > 0; ++i) {
+                if (offset >= segs[i].size) {
+                    offset -= segs[i].size;
+                    continue;
+                }
+
+                size_t copy_len = segs[i].size - offset < len ? segs[i].size - offset : len;
+                memcpy(::atbus::detail::fn::buffer_next(segs[i].pointer, offset), src, copy_len);
+                src    = ::atbus::detail::fn::buffer_next(src, copy_len);
+                len    = len - copy_len;
+                offset = 0;
             }
+        }
+
+        static void io_stream_segments_read(void *dst, const ::atbus::detail::buffer_manager::segment_t *segs, size_t offset, size_t len) {
+            for (size_t i = 0; i < 2 && len > 0; ++i) {
+                if (offset >= segs[i].size) {
+                    offset -= segs[i].size;
+                    continue;
+                }
+
+                size_t copy_len = segs[i].size - offset < len ? segs[i].size - offset : len;
+                memcpy(dst, ::atbus::detail::fn::buffer_next(segs[i].pointer, offset), copy_len);
+                dst    = ::atbus::detail::fn::buffer_next(dst, copy_len);
+                len    = len - copy_len;
+                offset = 0;
+            }
+        }
+
+        // 数据在同一段内时返回地址，否则返回NULL
+        static void *io_stream_segments_find(const ::atbus::detail::buffer_manager::segment_t *segs, size_t offset, size_t len) {
+            for (size_t i = 0; i < 2; ++i) {
+                if (offset < segs[i].size || (0 == len && offset == segs[i].size)) {
+                    return offset + len <= segs[i].size ? ::atbus::detail::fn::buffer_next(segs[i].pointer, offset) : NULL;
+                }
+
+                offset -= segs[i].size;
+            }
+
+            return NULL;
+        }
+
+        // 对发送缓冲区块内的每个数据包执行写完成回调
+        static void io_stream_on_written_block(io_stream_connection *connection, ::atbus::detail::buffer_block *block, int status,
+                                               int errcode) {
+            // block = sizeof(uv_write_t) + [data block...]
+            // data block = 32bits hash+vint+data length
+            ::atbus::detail::buffer_manager::segment_t segs[2];
+            connection->write_buffers.raw_segments(block, segs);
+
+            size_t total_length = block->raw_size();
+            size_t offset       = sizeof(uv_write_t);
+            while (offset < total_length) {
+                size_t left_length = total_length - offset;
+
+                // 32bits hash+vint
+                char head[sizeof(uint32_t) + 16];
+                size_t head_length = left_length < sizeof(head) ? left_length : sizeof(head);
+                io_stream_segments_read(head, segs, offset, head_length);
+
+                uint64_t out    = 0;
+                size_t vint_len = 0;
+                if (head_length > sizeof(uint32_t)) {
+                    vint_len = ::atbus::detail::fn::read_vint(out, head + sizeof(uint32_t), head_length - sizeof(uint32_t));
+                }
+
+                // data length should be enough to hold all data
+                if (0 == vint_len || left_length < sizeof(uint32_t) + vint_len + static_cast<size_t>(out)) {
+                    assert(false);
+                    break;
+                }
+                offset += sizeof(uint32_t) + vint_len;
 
-            return io_stream_disconnect(channel, iter->second.get(), callback);
+                // 跨越缓冲区尾部的数据不再复制，回调时数据地址为NULL，只有长度
+                void *data = io_stream_segments_find(segs, offset, static_cast<size_t>(out));
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, status, errcode, data,
+                                           out);
+
+                offset += static_cast<size_t>(out);
+            }
         }
 
         static void io_stream_on_written_fn(uv_write_t *req, int status) {
@@ -1525,31 +1930,8 @@ namespace atbus {
                 }
 
                 // nwrite = sizeof(uv_write_t) + [data block...]
-                // data block = 32bits hash+vint+data length
-                char *buff_start   = reinterpret_cast<char *>(data) + sizeof(uv_write_t);
-                size_t left_length = nwrite - sizeof(uv_write_t);
-                while (left_length > 0) {
-                    // skip 32bits hash
-                    buff_start += sizeof(uint32_t);
-                    uint64_t out;
-                    size_t vint_len = ::atbus::detail::fn::read_vint(out, buff_start, left_length - sizeof(uint32_t));
-                    // skip varint
-                    buff_start += vint_len;
-
-                    // data length should be enough to hold all data
-                    if (left_length < sizeof(uint32_t) + vint_len + static_cast<size_t>(out)) {
-                        assert(false);
-                        left_length = 0;
-                    }
-
-                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, status,
-                                               req == data ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_NODE_TIMEOUT, buff_start, out);
-
-                    buff_start += static_cast<size_t>(out);
-
-                    // 32bits hash+vint+data length
-                    left_length -= sizeof(uint32_t) + vint_len + static_cast<size_t>(out);
-                }
+                io_stream_on_written_block(connection, connection->write_buffers.front(), status,
+                                           req == data ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_NODE_TIMEOUT);
 
                 // remove all cache buffer
                 connection->write_buffers.pop_front(nwrite, true);
@@ -1566,6 +1948,14 @@ namespace atbus {
             // write left data
             io_stream_try_write(connection);
 
+            // handle已经关闭，在等这个写请求完成后回收
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_CLOSED)) {
+                if (!ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING)) {
+                    io_stream_connection_on_closed(connection->channel, connection);
+                }
+                return;
+            }
+
             // if in disconnecting status and there is no more data to write, close it
             if (io_stream_connection::EN_ST_DISCONNECTING == connection->status &&
                 !ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING)) {
@@ -1595,30 +1985,7 @@ namespace atbus {
                     ::atbus::detail::buffer_block *bb = connection->write_buffers.front();
                     size_t nwrite                     = bb->raw_size();
                     // nwrite = sizeof(uv_write_t) + [data block...]
-                    // data block = 32bits hash+vint+data length
-                    char *buff_start   = reinterpret_cast<char *>(bb->raw_data()) + sizeof(uv_write_t);
-                    size_t left_length = nwrite - sizeof(uv_write_t);
-                    while (left_length > 0) {
-                        // skip 32bits hash
-                        buff_start += sizeof(uint32_t);
-                        uint64_t out;
-                        size_t vint_len = ::atbus::detail::fn::read_vint(out, buff_start, left_length - sizeof(uint32_t));
-                        // skip varint
-                        buff_start += vint_len;
-
-                        // data length should be enough to hold all data
-                        if (left_length < sizeof(uint32_t) + vint_len + static_cast<size_t>(out)) {
-                            assert(false);
-                            left_length = 0;
-                        }
-                        io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, UV_ECANCELED,
-                                                   EN_ATBUS_ERR_CLOSING, buff_start, out);
-
-                        buff_start += static_cast<size_t>(out);
-
-                        // 32bits hash+vint+data length
-                        left_length -= sizeof(uint32_t) + vint_len + static_cast<size_t>(out);
-                    }
+                    io_stream_on_written_block(connection, bb, UV_ECANCELED, EN_ATBUS_ERR_CLOSING);
 
                     // remove all cache buffer
                     connection->write_buffers.pop_front(nwrite, true);
@@ -1635,41 +2002,35 @@ namespace atbus {
                 char *buffer_start     = ::atbus::channel::detail::io_stream_get_msg_buffer();
                 char *free_buffer      = buffer_start;
 
-                ::atbus::detail::buffer_block *preview_bb = NULL;
+                // static circle buffer can split a block into two segments, so blocks across the bound can also be merged
+                ::atbus::detail::buffer_manager::segment_t segs[2];
                 while (!connection->write_buffers.empty() && available_bytes > 0) {
                     ::atbus::detail::buffer_block *bb = connection->write_buffers.front();
                     if (NULL == bb || bb->raw_size() > available_bytes) {
                         break;
                     }
 
-                    // if connection->write_buffers is a static circle buffer, can not merge the bound blocks
-                    if (connection->write_buffers.is_static_mode() && NULL != preview_bb && preview_bb > bb) {
-                        break;
-                    }
-                    preview_bb = bb;
-
                     // first sizeof(uv_write_t) is req, the rest is 32bits hash+varint+len
                     size_t bb_size = bb->raw_size() - sizeof(uv_write_t);
-                    memcpy(free_buffer, ::atbus::detail::fn::buffer_next(bb->raw_data(), sizeof(uv_write_t)), bb_size);
+                    connection->write_buffers.raw_segments(bb, segs);
+                    io_stream_segments_read(free_buffer, segs, sizeof(uv_write_t), bb_size);
                     free_buffer += bb_size;
                     available_bytes -= bb_size;
 
                     connection->write_buffers.pop_front(bb->raw_size(), true);
                 }
 
-                void *data = NULL;
-                connection->write_buffers.push_front(data, sizeof(uv_write_t) + (free_buffer - buffer_start));
+                connection->write_buffers.push_front_split(segs, sizeof(uv_write_t) + (free_buffer - buffer_start), sizeof(uv_write_t));
 
                 // already pop more data than sizeof(uv_write_t) + (free_buffer - buffer_start)
                 // so this push_front should always success
-                assert(data);
+                assert(segs[0].pointer);
                 // at least merge one block
                 assert(free_buffer > buffer_start);
                 assert(static_cast<size_t>(free_buffer - buffer_start) <= ATBUS_MACRO_TLS_MERGE_BUFFER_LEN);
 
-                data = ::atbus::detail::fn::buffer_next(data, sizeof(uv_write_t));
                 // copy back merged data
-                memcpy(data, buffer_start, free_buffer - buffer_start);
+                io_stream_segments_write(segs, sizeof(uv_write_t), buffer_start, free_buffer - buffer_start);
             }
 
 
@@ -1686,19 +2047,25 @@ namespace atbus {
                 return io_stream_try_write(connection);
             }
 
-            // 初始化req，填充vint，复制数据区
-            uv_write_t *req = reinterpret_cast<uv_write_t *>(writing_block->raw_data());
+            // 初始化req，req总是在第一段内
+            ::atbus::detail::buffer_manager::segment_t segs[2];
+            connection->write_buffers.raw_segments(writing_block, segs);
+            uv_write_t *req = reinterpret_cast<uv_write_t *>(segs[0].pointer);
             req->data       = connection;
 
-            char *buff_start = reinterpret_cast<char *>(writing_block->raw_data());
-            // req
-            buff_start += sizeof(uv_write_t);
-
-            // call write ，bufs[] will be copied in libuv, but the real data will not
-            uv_buf_t bufs[1] = {uv_buf_init(buff_start, static_cast<unsigned int>(writing_block->raw_size() - sizeof(uv_write_t)))};
+            // req之后的数据，跨越静态缓冲区尾部时分两段写出
+            uv_buf_t bufs[2];
+            unsigned int nbufs = 0;
+            if (segs[0].size > sizeof(uv_write_t)) {
+                bufs[nbufs++] = uv_buf_init(reinterpret_cast<char *>(segs[0].pointer) + sizeof(uv_write_t),
+                                            static_cast<unsigned int>(segs[0].size - sizeof(uv_write_t)));
+            }
+            if (segs[1].size > 0) {
+                bufs[nbufs++] = uv_buf_init(reinterpret_cast<char *>(segs[1].pointer), static_cast<unsigned int>(segs[1].size));
+            }
 
             ATBUS_CHANNEL_IOS_SET_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING);
-            int res = uv_write(req, connection->handle.get(), bufs, 1, io_stream_on_written_fn);
+            int res = connection->channel->backend->write(connection, req, bufs, nbufs);
             if (0 != res) {
                 connection->channel->error_code = res;
                 ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING);
@@ -1710,10 +2077,22 @@ namespace atbus {
         }
 
         int io_stream_send(io_stream_connection *connection, const void *buf, size_t len) {
-            if (NULL == connection) {
+            return io_stream_send_v(connection, &buf, &len, 1);
+        }
+
+        int io_stream_send_v(io_stream_connection *connection, const void *const *bufs, const size_t *lens, size_t nbufs) {
+            if (NULL == connection || (nbufs > 0 && (NULL == bufs || NULL == lens))) {
                 return EN_ATBUS_ERR_PARAMS;
             }
 
+            size_t len = 0;
+            for (size_t i = 0; i < nbufs; ++i) {
+                if (NULL == bufs[i] && lens[i] > 0) {
+                    return EN_ATBUS_ERR_PARAMS;
+                }
+                len += lens[i];
+            }
+
             if (connection->channel->conf.send_buffer_limit_size > 0 && len > connection->channel->conf.send_buffer_limit_size) {
                 return EN_ATBUS_ERR_INVALID_SIZE;
             }
@@ -1722,35 +2101,72 @@ namespace atbus {
                 return EN_ATBUS_ERR_CLOSING;
             }
 
+            // 空闲时释放了静态发送缓冲区，恢复
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_TRIMMED) && connection->write_buffers.empty()) {
+                ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_TRIMMED);
+                io_stream_setup_write_buffers(connection->channel, connection);
+            }
+            io_stream_touch_connection(connection);
+
             // push back message
-            if (NULL != buf && len > 0) {
+            if (len > 0) {
                 char vint[16];
                 size_t vint_len = ::atbus::detail::fn::write_vint(len, vint, sizeof(vint));
                 // 计算需要的内存块大小（uv_write_t的大小+32bits hash+vint的大小+len）
                 size_t total_buffer_size = sizeof(uv_write_t) + sizeof(uint32_t) + vint_len + len;
 
-                // 判定内存限制
-                void *data;
-                int res = connection->write_buffers.push_back(data, total_buffer_size);
+                // 判定内存限制，静态缓冲区尾部空间不足时拆成两段，但req必须在第一段内
+                ::atbus::detail::buffer_manager::segment_t segs[2];
+                int res = connection->write_buffers.push_back_split(segs, total_buffer_size, sizeof(uv_write_t));
                 if (res < 0) {
                     return res;
                 }
 
                 // 初始化req，填充vint，复制数据区
-                uv_write_t *req  = reinterpret_cast<uv_write_t *>(data);
-                req->data        = connection;
-                char *buff_start = reinterpret_cast<char *>(data);
+                uv_write_t *req = reinterpret_cast<uv_write_t *>(segs[0].pointer);
+                req->data       = connection;
                 // req
-                buff_start += sizeof(uv_write_t);
+                size_t offset = sizeof(uv_write_t);
 
-                // 32bits hash
-                uint32_t hash32 = util::hash::murmur_hash3_x86_32(reinterpret_cast<const char *>(buf), static_cast<int>(len), 0);
-                memcpy(buff_start, &hash32, sizeof(uint32_t));
+                // 32bits hash，数据复制完后再填充
+                size_t hash_offset = offset;
+                offset += sizeof(uint32_t);
 
                 // vint
-                memcpy(buff_start + sizeof(uint32_t), vint, vint_len);
-                // buffer
-                memcpy(buff_start + sizeof(uint32_t) + vint_len, buf, len);
+                io_stream_segments_write(segs, offset, vint, vint_len);
+                offset += vint_len;
+
+                // buffer，多段数据直接依次复制到发送缓冲区
+                size_t data_offset = offset;
+                for (size_t i = 0; i < nbufs; ++i) {
+                    io_stream_segments_write(segs, offset, bufs[i], lens[i]);
+                    offset += lens[i];
+                }
+
+                // 单段数据直接使用源数据计算hash，否则使用复制后的数据
+                uint32_t hash32         = 0;
+                const void *hash_buffer = NULL;
+                void *tmp_buffer        = NULL;
+                if (1 == nbufs) {
+                    hash_buffer = bufs[0];
+                } else {
+                    hash_buffer = io_stream_segments_find(segs, data_offset, len);
+                }
+                if (NULL == hash_buffer) {
+                    // 跨越静态缓冲区尾部，先合并
+                    tmp_buffer = ::atbus::detail::fn::allocate(len);
+                    if (NULL == tmp_buffer) {
+                        connection->write_buffers.pop_back(total_buffer_size);
+                        return EN_ATBUS_ERR_MALLOC;
+                    }
+                    io_stream_segments_read(tmp_buffer, segs, data_offset, len);
+                    hash_buffer = tmp_buffer;
+                }
+                hash32 = util::hash::murmur_hash3_x86_32(reinterpret_cast<const char *>(hash_buffer), static_cast<int>(len), 0);
+                if (NULL != tmp_buffer) {
+                    ::atbus::detail::fn::deallocate(tmp_buffer, len);
+                }
+                io_stream_segments_write(segs, hash_offset, &hash32, sizeof(uint32_t));
             }
 
             return io_stream_try_write(connection);
@@ -1763,12 +2179,131 @@ namespace atbus {
             return 0;
         }
 
+        size_t io_stream_get_connection_number(const io_stream_channel *channel) {
+            if (NULL == channel) {
+                return 0;
+            }
+
+            return channel->conn_table.active_number;
+        }
+
+        uint64_t io_stream_get_connection_id(const io_stream_connection *connection) {
+            if (NULL == connection || NULL == connection->channel) {
+                return 0;
+            }
+
+            const io_stream_connection_table &table = connection->channel->conn_table;
+            if (connection->slot_index >= table.slots.size()) {
+                return 0;
+            }
+
+            return (static_cast<uint64_t>(table.slots[connection->slot_index].generation) << 32) | connection->slot_index;
+        }
+
+        io_stream_connection *io_stream_find_connection(io_stream_channel *channel, uint64_t connection_id) {
+            if (NULL == channel) {
+                return NULL;
+            }
+
+            size_t index        = static_cast<size_t>(connection_id & 0xFFFFFFFFU);
+            uint32_t generation = static_cast<uint32_t>(connection_id >> 32);
+            if (index >= channel->conn_table.slots.size()) {
+                return NULL;
+            }
+
+            const io_stream_connection_slot &slot = channel->conn_table.slots[index];
+            if (slot.generation != generation || NULL == slot.conn ||
+                ATBUS_CHANNEL_IOS_CHECK_FLAG(slot.conn->flags, io_stream_connection::EN_CF_SHUTDOWN)) {
+                return NULL;
+            }
+
+            return slot.conn;
+        }
+
+        io_stream_connection *io_stream_next_connection(io_stream_channel *channel, const io_stream_connection *prev) {
+            if (NULL == channel) {
+                return NULL;
+            }
+
+            // prev已经被回收时slot_index是无效值，会直接结束遍历
+            size_t index = (NULL == prev) ? 0 : (static_cast<size_t>(prev->slot_index) + 1);
+            for (; index < channel->conn_table.slots.size(); ++index) {
+                io_stream_connection *conn = channel->conn_table.slots[index].conn;
+                if (NULL != conn && !ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_SHUTDOWN)) {
+                    return conn;
+                }
+            }
+
+            return NULL;
+        }
+
+        size_t io_stream_trim_idle(io_stream_channel *channel, uint64_t idle_timeout_ms) {
+            if (NULL == channel || NULL == channel->ev_loop) {
+                return 0;
+            }
+
+            size_t ret   = 0;
+            uint64_t now = uv_now(channel->ev_loop);
+            for (io_stream_connection *conn = io_stream_next_connection(channel, NULL); NULL != conn;
+                 conn                       = io_stream_next_connection(channel, conn)) {
+                // 只有静态模式的缓冲区需要释放，动态模式在数据发送完后就已经释放了
+                if (ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_LISTEN) ||
+                    ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_WRITING) ||
+                    ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_TRIMMED) ||
+                    !conn->write_buffers.is_static_mode() || !conn->write_buffers.empty()) {
+                    continue;
+                }
+
+                if (conn->active_time + idle_timeout_ms > now) {
+                    continue;
+                }
+
+                conn->write_buffers.set_mode(0, 0);
+                conn->write_buffers.set_limit(channel->conf.send_buffer_max_size, 0);
+                ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_TRIMMED);
+                ++ret;
+            }
+
+            // 上次回收后一直没被用到的空闲接收缓冲区直接释放
+            io_stream_recv_buffer_pool &pool = channel->recv_pool;
+            for (size_t i = 0; i < ATBUS_CHANNEL_IOS_RECV_POOL_CLASS_NUMBER; ++i) {
+                size_t release_number = pool.free_low_watermark[i];
+                assert(release_number <= pool.free_blocks[i].size());
+                for (; release_number > 0; --release_number) {
+                    ::atbus::detail::buffer_block *block = pool.free_blocks[i].back();
+                    pool.free_blocks[i].pop_back();
+                    pool.cached_size -= block->raw_size();
+                    ::atbus::detail::buffer_block::free(block);
+                }
+
+                pool.free_low_watermark[i] = pool.free_blocks[i].size();
+            }
+
+            return ret;
+        }
+
+        size_t io_stream_get_resident_buffer_size(const io_stream_channel *channel) {
+            if (NULL == channel) {
+                return 0;
+            }
+
+            return channel->recv_pool.using_size + channel->recv_pool.cached_size + channel->write_resident_size;
+        }
+
         void io_stream_show_channel(io_stream_channel *channel, std::ostream &out) {
             if (NULL == channel) {
                 return;
             }
 
-            out << "Summary:" << std::endl << "\tconnection number: " << channel->conn_pool.size() << std::endl << std::endl;
+            out << "Summary:" << std::endl
+                << "\tconnection number: " << channel->conn_table.active_number << std::endl
+                << "\tclosing connection number: " << channel->conn_table.gc_number << std::endl
+                << "\tconnection table slots: " << channel->conn_table.slots.size() << std::endl
+                << "\trecv buffer pool using(Bytes): " << channel->recv_pool.using_size << std::endl
+                << "\trecv buffer pool cached(Bytes): " << channel->recv_pool.cached_size << std::endl
+                << "\tresident buffer size(Bytes): " << io_stream_get_resident_buffer_size(channel) << std::endl
+                << "\tbackend: " << (NULL == channel->backend ? "none" : channel->backend->name) << std::endl
+                << std::endl;
 
             out << "Configure:" << std::endl
                 << "\tis_noblock: " << channel->conf.is_noblock << std::endl
@@ -1783,19 +2318,41 @@ namespace atbus {
                 << "\tsend_buffer_static_max_number: " << channel->conf.send_buffer_static << std::endl
                 << std::endl;
 
+            // 缓冲块分配器是按线程的，这里展示的是当前线程的统计
+            std::vector< ::atbus::detail::buffer_allocator_stats_t> allocator_stats;
+            ::atbus::detail::buffer_block::get_allocator_stats(allocator_stats);
+            out << "Buffer allocator(current thread):" << std::endl;
+            for (size_t i = 0; i < allocator_stats.size(); ++i) {
+                if (0 == allocator_stats[i].alloc_times) {
+                    continue;
+                }
+
+                out << "\tblock size(Bytes): ";
+                if (0 == allocator_stats[i].block_size) {
+                    out << "uncached";
+                } else {
+                    out << allocator_stats[i].block_size;
+                }
+                out << ", using: " << allocator_stats[i].using_number << ", cached: " << allocator_stats[i].cached_number
+                    << ", alloc times: " << allocator_stats[i].alloc_times << ", hit times: " << allocator_stats[i].hit_times << std::endl;
+            }
+            out << std::endl;
+
             out << "All connections:" << std::endl;
-            for (io_stream_channel::conn_pool_t::iterator iter = channel->conn_pool.begin(); iter != channel->conn_pool.end(); ++iter) {
-                out << "\t" << iter->second->addr.address << ":(status = " << iter->second->status << ")" << std::endl;
-
-                out << "\t\twrite_buffers.cost_number: " << iter->second->write_buffers.limit().cost_number_ << std::endl;
-                out << "\t\twrite_buffers.cost_size: " << iter->second->write_buffers.limit().cost_size_ << std::endl;
-                out << "\t\twrite_buffers.limit_number: " << iter->second->write_buffers.limit().limit_number_ << std::endl;
-                out << "\t\twrite_buffers.limit_size: " << iter->second->write_buffers.limit().limit_size_ << std::endl;
-
-                out << "\t\tread_buffers.cost_number: " << iter->second->read_buffers.limit().cost_number_ << std::endl;
-                out << "\t\tread_buffers.cost_size: " << iter->second->read_buffers.limit().cost_size_ << std::endl;
-                out << "\t\tread_buffers.limit_number: " << iter->second->read_buffers.limit().limit_number_ << std::endl;
-                out << "\t\tread_buffers.limit_size: " << iter->second->read_buffers.limit().limit_size_ << std::endl;
+            for (io_stream_connection *conn = io_stream_next_connection(channel, NULL); NULL != conn;
+                 conn                       = io_stream_next_connection(channel, conn)) {
+                out << "\t" << conn->addr.address << ":(status = " << conn->status << ", id = " << io_stream_get_connection_id(conn) << ")"
+                    << std::endl;
+
+                out << "\t\twrite_buffers.cost_number: " << conn->write_buffers.limit().cost_number_ << std::endl;
+                out << "\t\twrite_buffers.cost_size: " << conn->write_buffers.limit().cost_size_ << std::endl;
+                out << "\t\twrite_buffers.limit_number: " << conn->write_buffers.limit().limit_number_ << std::endl;
+                out << "\t\twrite_buffers.limit_size: " << conn->write_buffers.limit().limit_size_ << std::endl;
+                out << "\t\twrite_buffers.resident_size: " << conn->write_buffers.resident_size() << std::endl;
+
+                out << "\t\tread_head.len: " << conn->read_head.len << std::endl;
+                out << "\t\tread_block.len: " << conn->read_block_len << std::endl;
+                out << "\t\tread_block.used: " << conn->read_block_used << std::endl;
             }
         }
     } // namespace channel
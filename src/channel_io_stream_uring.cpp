@@ -0,0 +1,681 @@
+﻿/**
+ * @brief io_stream通道的io_uring后端<br />
+ *        连接的建立、监听和关闭依然由libuv负责，这里只接管已连接流上的收发<br />
+ *        接收使用multishot recv + 注册到内核的接收缓冲区环，发送时每个写请求的所有段用一个sendmsg请求<br />
+ *        提交队列在libuv的prepare阶段批量提交，完成队列通过uv_poll监听ring fd来驱动
+ */
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#include "detail/libatbus_config.h"
+
+#include "detail/libatbus_channel_export.h"
+#include "detail/libatbus_error.h"
+
+#if defined(ATBUS_MACRO_WITH_IO_URING) && ATBUS_MACRO_WITH_IO_URING
+#include <errno.h>
+#include <sys/socket.h>
+
+#include <liburing.h>
+
+// 接收缓冲区环的buffer group id，每个channel一个ring，所以固定值即可
+#define ATBUS_MACRO_IO_URING_BUFFER_GROUP 1
+#define ATBUS_MACRO_IO_URING_MAX_BUFFER_NUMBER 32768
+
+namespace atbus {
+    namespace channel {
+        namespace detail {
+            // channel_io_stream.cpp
+            extern void io_stream_backend_on_read(io_stream_connection *connection, const char *data, ssize_t nread);
+            extern void io_stream_backend_on_written(uv_write_t *req, int status);
+            extern int io_stream_backend_libuv_read_start(io_stream_connection *connection);
+            extern int io_stream_backend_libuv_read_stop(io_stream_connection *connection);
+        } // namespace detail
+
+        struct io_stream_uring_context;
+        struct io_stream_uring_conn;
+
+        struct io_stream_uring_op {
+            typedef enum {
+                EN_OP_RECV = 0,
+                EN_OP_SEND,
+            } type_t;
+
+            type_t type;
+            io_stream_uring_conn *owner;
+        };
+
+        struct io_stream_uring_conn {
+            io_stream_uring_context *ctx;
+            io_stream_connection *connection; // 连接关闭后置空，等未完成的请求结束后再释放
+            int fd;
+
+            io_stream_uring_op recv_op;
+            io_stream_uring_op send_op;
+
+            bool recv_armed;       // 已提交multishot recv
+            bool recv_pending_arm; // 在等待队列中，下一次提交时发起recv
+            bool recv_use_libuv;   // 内核不支持multishot recv，回退到libuv读
+            bool cancel_pending;   // 提交队列满时没能提交取消请求，在等待队列中
+            bool send_pending;     // 正在发送
+            bool handle_closing;   // handle已提交关闭，正在进行的发送要取消
+            bool send_canceled;    // 已提交取消发送的请求，完成后不再继续发送剩下的部分
+            bool in_callback;      // 正在回调，不能释放
+
+            uv_write_t *send_req;
+            uv_buf_t send_bufs[2]; // 静态缓冲区的块跨越尾部时有两段，用一个sendmsg一起发送
+            unsigned int send_buf_number;
+            struct iovec send_iov[2]; // 提交后到完成前内核会访问，所以和msghdr一起放在连接上
+            struct msghdr send_msg;
+            size_t send_len;
+            size_t send_offset;
+
+            io_stream_uring_conn *prev;
+            io_stream_uring_conn *next;
+        };
+
+        struct io_stream_uring_context {
+            io_stream_channel *channel;
+            struct io_uring ring;
+            uv_poll_t poll_handle;
+            uv_prepare_t prepare_handle;
+            int closing_handles;
+            bool multishot_supported;
+
+            struct io_uring_buf_ring *buf_ring;
+            char *buf_base;
+            unsigned int buf_number;
+            size_t buf_size;
+
+            std::vector<io_stream_uring_conn *> pending_arm;
+            std::vector<io_stream_uring_conn *> pending_cancel;
+            io_stream_uring_conn *conn_list;
+        };
+
+        static struct io_uring_sqe *io_stream_uring_get_sqe(io_stream_uring_context *ctx) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ctx->ring);
+            if (NULL == sqe) {
+                // 提交队列满了，先提交一次再取
+                io_uring_submit(&ctx->ring);
+                sqe = io_uring_get_sqe(&ctx->ring);
+            }
+
+            return sqe;
+        }
+
+        static io_stream_uring_conn *io_stream_uring_get_conn(io_stream_uring_context *ctx, io_stream_connection *connection) {
+            io_stream_uring_conn *ret = reinterpret_cast<io_stream_uring_conn *>(connection->backend_data);
+            if (NULL != ret) {
+                return ret;
+            }
+
+            ret = new io_stream_uring_conn();
+            if (NULL == ret) {
+                return ret;
+            }
+
+            ret->ctx              = ctx;
+            ret->connection       = connection;
+            ret->fd               = static_cast<int>(connection->fd);
+            ret->recv_op.type     = io_stream_uring_op::EN_OP_RECV;
+            ret->recv_op.owner    = ret;
+            ret->send_op.type     = io_stream_uring_op::EN_OP_SEND;
+            ret->send_op.owner    = ret;
+            ret->recv_armed       = false;
+            ret->recv_pending_arm = false;
+            ret->recv_use_libuv   = !ctx->multishot_supported;
+            ret->cancel_pending   = false;
+            ret->send_pending     = false;
+            ret->handle_closing   = false;
+            ret->send_canceled    = false;
+            ret->in_callback      = false;
+            ret->send_req         = NULL;
+            ret->send_buf_number  = 0;
+            ret->send_len         = 0;
+            ret->send_offset      = 0;
+
+            ret->prev = NULL;
+            ret->next = ctx->conn_list;
+            if (NULL != ctx->conn_list) {
+                ctx->conn_list->prev = ret;
+            }
+            ctx->conn_list = ret;
+
+            connection->backend_data = ret;
+            return ret;
+        }
+
+        static void io_stream_uring_try_release(io_stream_uring_conn *conn) {
+            if (NULL != conn->connection || conn->recv_armed || conn->recv_pending_arm || conn->cancel_pending || conn->send_pending ||
+                conn->in_callback) {
+                return;
+            }
+
+            io_stream_uring_context *ctx = conn->ctx;
+            if (NULL != conn->prev) {
+                conn->prev->next = conn->next;
+            } else {
+                ctx->conn_list = conn->next;
+            }
+
+            if (NULL != conn->next) {
+                conn->next->prev = conn->prev;
+            }
+
+            delete conn;
+        }
+
+        static void io_stream_uring_arm_recv(io_stream_uring_conn *conn) {
+            if (conn->recv_armed || conn->recv_pending_arm) {
+                return;
+            }
+
+            // 先放进等待队列，prepare阶段统一提交。这时候listen等标记也已经设置完毕
+            conn->recv_pending_arm = true;
+            conn->ctx->pending_arm.push_back(conn);
+        }
+
+        static bool io_stream_uring_prep_cancel(io_stream_uring_conn *conn, io_stream_uring_op *op) {
+            struct io_uring_sqe *sqe = io_stream_uring_get_sqe(conn->ctx);
+            if (NULL == sqe) {
+                // 提交后依然取不到，放进等待队列，下一次prepare时重试。否则请求一直不会完成，连接也不会释放
+                if (!conn->cancel_pending) {
+                    conn->cancel_pending = true;
+                    conn->ctx->pending_cancel.push_back(conn);
+                }
+                return false;
+            }
+
+            io_uring_prep_cancel(sqe, op, 0);
+            io_uring_sqe_set_data(sqe, NULL);
+            return true;
+        }
+
+        static void io_stream_uring_cancel_recv(io_stream_uring_conn *conn) {
+            if (!conn->recv_armed || conn->cancel_pending) {
+                return;
+            }
+
+            io_stream_uring_prep_cancel(conn, &conn->recv_op);
+        }
+
+        static void io_stream_uring_cancel_send(io_stream_uring_conn *conn) {
+            if (!conn->handle_closing || !conn->send_pending || conn->send_canceled || conn->cancel_pending) {
+                return;
+            }
+
+            // 对端不再接收时sendmsg可能一直等不到发送缓冲区，关闭fd也不会结束ring持有的请求
+            conn->send_canceled = io_stream_uring_prep_cancel(conn, &conn->send_op);
+        }
+
+        static void io_stream_uring_recycle_buffer(io_stream_uring_context *ctx, unsigned short bid) {
+            io_uring_buf_ring_add(ctx->buf_ring, ctx->buf_base + static_cast<size_t>(bid) * ctx->buf_size,
+                                  static_cast<unsigned int>(ctx->buf_size), bid, io_uring_buf_ring_mask(ctx->buf_number), 0);
+            io_uring_buf_ring_advance(ctx->buf_ring, 1);
+        }
+
+        static int io_stream_uring_submit_send(io_stream_uring_conn *conn) {
+            struct io_uring_sqe *sqe = io_stream_uring_get_sqe(conn->ctx);
+            if (NULL == sqe) {
+                return UV_EAGAIN;
+            }
+
+            // 从当前发送位置开始的所有段放进一个sendmsg，不会和其他写请求交错
+            size_t offset        = conn->send_offset;
+            unsigned int iov_len = 0;
+            for (unsigned int i = 0; i < conn->send_buf_number; ++i) {
+                if (offset >= conn->send_bufs[i].len) {
+                    offset -= conn->send_bufs[i].len;
+                    continue;
+                }
+
+                conn->send_iov[iov_len].iov_base = conn->send_bufs[i].base + offset;
+                conn->send_iov[iov_len].iov_len  = conn->send_bufs[i].len - offset;
+                offset                           = 0;
+                ++iov_len;
+            }
+
+            memset(&conn->send_msg, 0, sizeof(conn->send_msg));
+            conn->send_msg.msg_iov    = conn->send_iov;
+            conn->send_msg.msg_iovlen = iov_len;
+
+            io_uring_prep_sendmsg(sqe, conn->fd, &conn->send_msg, MSG_NOSIGNAL);
+            io_uring_sqe_set_data(sqe, &conn->send_op);
+            return 0;
+        }
+
+        static void io_stream_uring_on_recv(io_stream_uring_context *ctx, io_stream_uring_conn *conn, const struct io_uring_cqe *cqe) {
+            bool has_more   = 0 != (cqe->flags & IORING_CQE_F_MORE);
+            bool has_buffer = 0 != (cqe->flags & IORING_CQE_F_BUFFER);
+
+            unsigned short bid = 0;
+            const char *data   = NULL;
+            if (has_buffer) {
+                bid  = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                data = ctx->buf_base + static_cast<size_t>(bid) * ctx->buf_size;
+            }
+
+            if (!has_more) {
+                conn->recv_armed = false;
+            }
+
+            conn->in_callback = true;
+            if (NULL != conn->connection) {
+                if (cqe->res > 0) {
+                    detail::io_stream_backend_on_read(conn->connection, data, static_cast<ssize_t>(cqe->res));
+                } else if (0 == cqe->res) {
+                    detail::io_stream_backend_on_read(conn->connection, NULL, UV_EOF);
+                } else if (-ENOBUFS == cqe->res || -ECANCELED == cqe->res) {
+                    // 接收缓冲区耗尽时内核会终止multishot，下面会重新发起
+                } else if (-EINVAL == cqe->res && !has_more) {
+                    // 内核不支持multishot recv，后续连接都回退到libuv读
+                    ctx->multishot_supported = false;
+                    conn->recv_use_libuv     = true;
+                    detail::io_stream_backend_libuv_read_start(conn->connection);
+                } else {
+                    // Linux下libuv的错误码就是-errno
+                    detail::io_stream_backend_on_read(conn->connection, NULL, static_cast<ssize_t>(cqe->res));
+                }
+            }
+            conn->in_callback = false;
+
+            if (has_buffer) {
+                io_stream_uring_recycle_buffer(ctx, bid);
+            }
+
+            // multishot被内核终止但连接仍然有效，重新发起
+            if (!conn->recv_armed && !conn->recv_use_libuv && NULL != conn->connection &&
+                io_stream_connection::EN_ST_CONNECTED == conn->connection->status) {
+                io_stream_uring_arm_recv(conn);
+            }
+
+            io_stream_uring_try_release(conn);
+        }
+
+        static void io_stream_uring_on_send(io_stream_uring_conn *conn, const struct io_uring_cqe *cqe) {
+            int status = 0;
+            if (cqe->res > 0 && conn->send_offset + static_cast<size_t>(cqe->res) < conn->send_len) {
+                if (conn->send_canceled) {
+                    // 连接已经关闭，剩下的部分不再发送
+                    status = UV_ECANCELED;
+                } else {
+                    // 只发送了一部分，继续发送剩下的
+                    conn->send_offset += static_cast<size_t>(cqe->res);
+                    status = io_stream_uring_submit_send(conn);
+                    if (0 == status) {
+                        return;
+                    }
+                }
+            } else if (cqe->res < 0) {
+                status = cqe->res;
+            }
+
+            uv_write_t *req       = conn->send_req;
+            conn->send_pending    = false;
+            conn->send_canceled   = false;
+            conn->send_req        = NULL;
+            conn->send_buf_number = 0;
+            conn->send_len        = 0;
+            conn->send_offset     = 0;
+
+            // 写完成流程里可能发起下一次写，连接已关闭时会在这里回收
+            conn->in_callback = true;
+            detail::io_stream_backend_on_written(req, status);
+            conn->in_callback = false;
+
+            io_stream_uring_try_release(conn);
+        }
+
+        static void io_stream_uring_on_poll(uv_poll_t *handle, int status, int /*events*/) {
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(handle->data);
+            assert(ctx);
+            if (0 != status) {
+                ctx->channel->error_code = status;
+                return;
+            }
+
+            struct io_uring_cqe *cqe = NULL;
+            while (0 == io_uring_peek_cqe(&ctx->ring, &cqe) && NULL != cqe) {
+                // 先拷贝出来再标记完成，回调中可能会继续提交请求
+                struct io_uring_cqe cqe_copy;
+                cqe_copy.user_data = cqe->user_data;
+                cqe_copy.res       = cqe->res;
+                cqe_copy.flags     = cqe->flags;
+                io_stream_uring_op *op = reinterpret_cast<io_stream_uring_op *>(io_uring_cqe_get_data(cqe));
+                io_uring_cqe_seen(&ctx->ring, cqe);
+
+                // 取消请求的完成事件不需要处理
+                if (NULL == op) {
+                    continue;
+                }
+
+                if (io_stream_uring_op::EN_OP_RECV == op->type) {
+                    io_stream_uring_on_recv(ctx, op->owner, &cqe_copy);
+                } else {
+                    io_stream_uring_on_send(op->owner, &cqe_copy);
+                }
+            }
+
+            // 回调中产生的请求直接提交，减少一轮事件循环的延迟
+            if (io_uring_sq_ready(&ctx->ring) > 0) {
+                io_uring_submit(&ctx->ring);
+            }
+        }
+
+        static void io_stream_uring_on_prepare(uv_prepare_t *handle) {
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(handle->data);
+            assert(ctx);
+
+            if (!ctx->pending_cancel.empty()) {
+                std::vector<io_stream_uring_conn *> pending;
+                pending.swap(ctx->pending_cancel);
+
+                for (size_t i = 0; i < pending.size(); ++i) {
+                    io_stream_uring_conn *conn = pending[i];
+                    conn->cancel_pending       = false;
+
+                    // 等待期间multishot和发送可能已经结束
+                    io_stream_uring_cancel_recv(conn);
+                    io_stream_uring_cancel_send(conn);
+                    io_stream_uring_try_release(conn);
+                }
+            }
+
+            if (!ctx->pending_arm.empty()) {
+                std::vector<io_stream_uring_conn *> pending;
+                pending.swap(ctx->pending_arm);
+
+                for (size_t i = 0; i < pending.size(); ++i) {
+                    io_stream_uring_conn *conn = pending[i];
+                    conn->recv_pending_arm     = false;
+
+                    // listen的socket和已经关闭的连接不需要接收数据
+                    if (NULL == conn->connection || conn->recv_armed || conn->recv_use_libuv ||
+                        io_stream_connection::EN_ST_CONNECTED != conn->connection->status ||
+                        ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->connection->flags, io_stream_connection::EN_CF_LISTEN)) {
+                        io_stream_uring_try_release(conn);
+                        continue;
+                    }
+
+                    struct io_uring_sqe *sqe = io_stream_uring_get_sqe(ctx);
+                    if (NULL == sqe) {
+                        // 下一轮再试
+                        io_stream_uring_arm_recv(conn);
+                        continue;
+                    }
+
+                    io_uring_prep_recv_multishot(sqe, conn->fd, NULL, 0, 0);
+                    sqe->flags |= IOSQE_BUFFER_SELECT;
+                    sqe->buf_group = ATBUS_MACRO_IO_URING_BUFFER_GROUP;
+                    io_uring_sqe_set_data(sqe, &conn->recv_op);
+                    conn->recv_armed = true;
+                }
+            }
+
+            // 一轮事件循环里的所有请求合并成一次系统调用
+            if (io_uring_sq_ready(&ctx->ring) > 0) {
+                io_uring_submit(&ctx->ring);
+            }
+        }
+
+        static void io_stream_uring_destroy_context(io_stream_uring_context *ctx) {
+            if (NULL != ctx->buf_ring) {
+                io_uring_free_buf_ring(&ctx->ring, ctx->buf_ring, ctx->buf_number, ATBUS_MACRO_IO_URING_BUFFER_GROUP);
+                ctx->buf_ring = NULL;
+            }
+
+            // ring关闭时内核会终止所有未完成的请求，之后发送的数据就不会再被内核访问了
+            io_uring_queue_exit(&ctx->ring);
+
+            std::vector<uv_write_t *> canceled_reqs;
+            while (NULL != ctx->conn_list) {
+                io_stream_uring_conn *conn = ctx->conn_list;
+                ctx->conn_list             = conn->next;
+                if (NULL != conn->connection) {
+                    conn->connection->backend_data = NULL;
+                }
+                if (conn->send_pending && NULL != conn->send_req) {
+                    canceled_reqs.push_back(conn->send_req);
+                }
+                delete conn;
+            }
+
+            // 没有完成事件的写请求以UV_ECANCELED执行写完成流程，释放排队的写缓冲区并清除EN_CF_WRITING
+            // 这时所有连接都已经和后端分离，写完成流程里不会再访问ctx
+            for (size_t i = 0; i < canceled_reqs.size(); ++i) {
+                detail::io_stream_backend_on_written(canceled_reqs[i], UV_ECANCELED);
+            }
+
+            if (NULL != ctx->buf_base) {
+                free(ctx->buf_base);
+                ctx->buf_base = NULL;
+            }
+
+            delete ctx;
+        }
+
+        static void io_stream_uring_on_handle_closed(uv_handle_t *handle) {
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(handle->data);
+            assert(ctx);
+
+            ATBUS_CHANNEL_REQ_END(ctx->channel);
+            if (0 == --ctx->closing_handles) {
+                io_stream_uring_destroy_context(ctx);
+            }
+        }
+
+        static int io_stream_uring_init(io_stream_channel *channel) {
+            if (NULL == channel || NULL == channel->ev_loop) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            io_stream_uring_context *ctx = new io_stream_uring_context();
+            if (NULL == ctx) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            ctx->channel             = channel;
+            ctx->closing_handles     = 0;
+            ctx->multishot_supported = true;
+            ctx->buf_ring            = NULL;
+            ctx->buf_base            = NULL;
+            ctx->conn_list           = NULL;
+
+            unsigned int queue_depth = static_cast<unsigned int>(channel->conf.io_uring_queue_depth);
+            if (0 == queue_depth) {
+                queue_depth = 256;
+            }
+
+            int res = io_uring_queue_init(queue_depth, &ctx->ring, 0);
+            if (res < 0) {
+                channel->error_code = res;
+                delete ctx;
+                return EN_ATBUS_ERR_CHANNEL_NOT_SUPPORT;
+            }
+
+            // 缓冲区环的长度必须是2的幂
+            ctx->buf_number = 1;
+            while (ctx->buf_number < channel->conf.io_uring_recv_buffer_number &&
+                   ctx->buf_number < ATBUS_MACRO_IO_URING_MAX_BUFFER_NUMBER) {
+                ctx->buf_number <<= 1;
+            }
+            ctx->buf_size = channel->conf.io_uring_recv_buffer_size > 0 ? channel->conf.io_uring_recv_buffer_size : ATBUS_MACRO_DATA_SMALL_SIZE;
+            ctx->buf_base = reinterpret_cast<char *>(malloc(ctx->buf_number * ctx->buf_size));
+            if (NULL == ctx->buf_base) {
+                io_stream_uring_destroy_context(ctx);
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            // 低版本内核(<5.19)不支持注册接收缓冲区环
+            ctx->buf_ring = io_uring_setup_buf_ring(&ctx->ring, ctx->buf_number, ATBUS_MACRO_IO_URING_BUFFER_GROUP, 0, &res);
+            if (NULL == ctx->buf_ring) {
+                channel->error_code = res;
+                io_stream_uring_destroy_context(ctx);
+                return EN_ATBUS_ERR_CHANNEL_NOT_SUPPORT;
+            }
+
+            for (unsigned int i = 0; i < ctx->buf_number; ++i) {
+                io_uring_buf_ring_add(ctx->buf_ring, ctx->buf_base + static_cast<size_t>(i) * ctx->buf_size,
+                                      static_cast<unsigned int>(ctx->buf_size), static_cast<unsigned short>(i),
+                                      io_uring_buf_ring_mask(ctx->buf_number), static_cast<int>(i));
+            }
+            io_uring_buf_ring_advance(ctx->buf_ring, static_cast<int>(ctx->buf_number));
+
+            if (0 != (res = uv_poll_init(channel->ev_loop, &ctx->poll_handle, ctx->ring.ring_fd))) {
+                channel->error_code = res;
+                io_stream_uring_destroy_context(ctx);
+                return EN_ATBUS_ERR_CHANNEL_NOT_SUPPORT;
+            }
+            ctx->poll_handle.data = ctx;
+            uv_poll_start(&ctx->poll_handle, UV_READABLE, io_stream_uring_on_poll);
+
+            uv_prepare_init(channel->ev_loop, &ctx->prepare_handle);
+            ctx->prepare_handle.data = ctx;
+            uv_prepare_start(&ctx->prepare_handle, io_stream_uring_on_prepare);
+            // prepare只用于批量提交，不应该阻止事件循环退出
+            uv_unref(reinterpret_cast<uv_handle_t *>(&ctx->prepare_handle));
+
+            channel->backend_data = ctx;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        static void io_stream_uring_close(io_stream_channel *channel) {
+            if (NULL == channel || NULL == channel->backend_data) {
+                return;
+            }
+
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(channel->backend_data);
+            channel->backend_data        = NULL;
+
+            uv_poll_stop(&ctx->poll_handle);
+            uv_prepare_stop(&ctx->prepare_handle);
+
+            // 两个handle都关闭后再释放ring，要保证ring fd在uv_poll_t关闭之后再关闭
+            ctx->closing_handles = 2;
+            ATBUS_CHANNEL_REQ_START(channel);
+            uv_close(reinterpret_cast<uv_handle_t *>(&ctx->poll_handle), io_stream_uring_on_handle_closed);
+            ATBUS_CHANNEL_REQ_START(channel);
+            uv_close(reinterpret_cast<uv_handle_t *>(&ctx->prepare_handle), io_stream_uring_on_handle_closed);
+        }
+
+        static int io_stream_uring_read_start(io_stream_connection *connection) {
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(connection->channel->backend_data);
+            if (NULL == ctx) {
+                return detail::io_stream_backend_libuv_read_start(connection);
+            }
+
+            io_stream_uring_conn *conn = io_stream_uring_get_conn(ctx, connection);
+            if (NULL == conn) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            if (conn->recv_use_libuv) {
+                return detail::io_stream_backend_libuv_read_start(connection);
+            }
+
+            io_stream_uring_arm_recv(conn);
+            return 0;
+        }
+
+        static int io_stream_uring_read_stop(io_stream_connection *connection) {
+            io_stream_uring_conn *conn = reinterpret_cast<io_stream_uring_conn *>(connection->backend_data);
+            if (NULL == conn) {
+                return detail::io_stream_backend_libuv_read_stop(connection);
+            }
+
+            if (conn->recv_use_libuv) {
+                detail::io_stream_backend_libuv_read_stop(connection);
+            }
+
+            // 取消multishot recv，最后一个完成事件到达后才能释放
+            io_stream_uring_cancel_recv(conn);
+
+            // 写完成流程通过req->data找到连接，所以可以提前分离
+            // handle要关闭时取消正在进行的发送。连接要等写完成流程执行后才回收(EN_CF_CLOSED)，所以完成事件到达前req和数据都有效
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_SHUTDOWN)) {
+                conn->handle_closing = true;
+                io_stream_uring_cancel_send(conn);
+            }
+            conn->connection         = NULL;
+            connection->backend_data = NULL;
+            io_stream_uring_try_release(conn);
+            return 0;
+        }
+
+        static int io_stream_uring_write(io_stream_connection *connection, uv_write_t *req, const uv_buf_t *bufs, unsigned int nbufs) {
+            io_stream_uring_context *ctx = reinterpret_cast<io_stream_uring_context *>(connection->channel->backend_data);
+            if (NULL == ctx) {
+                return UV_EINVAL;
+            }
+
+            // handle已经提交关闭，fd随时会失效
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_SHUTDOWN)) {
+                return UV_ECANCELED;
+            }
+
+            io_stream_uring_conn *conn = io_stream_uring_get_conn(ctx, connection);
+            if (NULL == conn) {
+                return UV_ENOMEM;
+            }
+
+            // 同一个连接同时只会有一个写请求(EN_CF_WRITING)
+            if (conn->send_pending) {
+                return UV_EBUSY;
+            }
+
+            if (0 == nbufs || nbufs > sizeof(conn->send_bufs) / sizeof(conn->send_bufs[0])) {
+                return UV_EINVAL;
+            }
+
+            conn->send_req        = req;
+            conn->send_buf_number = nbufs;
+            conn->send_len        = 0;
+            conn->send_offset     = 0;
+            for (unsigned int i = 0; i < nbufs; ++i) {
+                conn->send_bufs[i] = bufs[i];
+                conn->send_len += bufs[i].len;
+            }
+
+            int res = io_stream_uring_submit_send(conn);
+            if (0 != res) {
+                conn->send_req        = NULL;
+                conn->send_buf_number = 0;
+                conn->send_len        = 0;
+                return res;
+            }
+
+            conn->send_pending = true;
+            return 0;
+        }
+
+        namespace detail {
+            const io_stream_backend_t *io_stream_backend_io_uring() {
+                static io_stream_backend_t ret = {io_stream_backend_t::EN_BT_IO_URING,
+                                                  "io_uring",
+                                                  io_stream_uring_init,
+                                                  io_stream_uring_close,
+                                                  io_stream_uring_read_start,
+                                                  io_stream_uring_read_stop,
+                                                  io_stream_uring_write};
+                return &ret;
+            }
+        } // namespace detail
+    }     // namespace channel
+} // namespace atbus
+
+#else
+
+namespace atbus {
+    namespace channel {
+        namespace detail {
+            const io_stream_backend_t *io_stream_backend_io_uring() { return NULL; }
+        } // namespace detail
+    }     // namespace channel
+} // namespace atbus
+
+#endif
@@ -824,6 +824,13 @@ namespace atbus {
             return ret;
         }
 
+        bool mem_has_data(mem_channel *channel) {
+            if (NULL == channel) return false;
+
+            // 读写游标相同时一定没有数据，不同时也可能是写出端还没写完，由mem_recv处理
+            return channel->atomic_read_cur.load() != channel->atomic_write_cur.load();
+        }
+
         std::pair<size_t, size_t> mem_last_action() {
             return std::make_pair(detail::last_action_channel_begin_node_index, detail::last_action_channel_end_node_index);
         }
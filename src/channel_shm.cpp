@@ -322,6 +322,12 @@ namespace atbus {
             return mem_recv(switcher.mem, buf, len, recv_size);
         }
 
+        bool shm_has_data(shm_channel *channel) {
+            shm_channel_switcher switcher;
+            switcher.shm = channel;
+            return mem_has_data(switcher.mem);
+        }
+
         std::pair<size_t, size_t> shm_last_action() { return mem_last_action(); }
 
         void shm_show_channel(shm_channel *channel, std::ostream &out, bool need_node_status, size_t need_node_data) {
@@ -6,8 +6,12 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "config/compiler_features.h"
+
 #include "detail/buffer.h"
+#include "detail/libatbus_allocator.h"
 #include "detail/libatbus_error.h"
+#include "detail/thread_cache.h"
 
 #if (defined(__cplusplus) && __cplusplus >= 201103L) || (defined(_MSC_VER) && _MSC_VER >= 1900)
 #include <type_traits>
@@ -16,6 +20,53 @@ static_assert(std::is_pod<atbus::detail::buffer_block>::value, "buffer_block mus
 
 namespace atbus {
     namespace detail {
+        // ================= buffer block allocator =================
+        // 按数据区大小分级缓存空闲块，每个线程独立，不需要加锁
+        // 线程退出时由thread_cache调用release()，把缓存的空闲块还给系统
+        struct buffer_allocator_cache_t {
+            buffer_block *free_list[ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER];
+            buffer_allocator_stats_t stats[ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER + 1];
+
+            size_t release() {
+                size_t ret = 0;
+                for (size_t i = 0; i < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER; ++i) {
+                    while (NULL != free_list[i]) {
+                        buffer_block *block = free_list[i];
+                        free_list[i]        = block->next_;
+                        ret += buffer_block::full_size(block->raw_size());
+                        fn::deallocate(block, buffer_block::full_size(block->raw_size()));
+                    }
+
+                    stats[i].cached_number = 0;
+                }
+
+                return ret;
+            }
+        };
+
+        static inline buffer_allocator_cache_t *buffer_allocator_get_cache() { return thread_cache<buffer_allocator_cache_t>::get(); }
+    } // namespace detail
+} // namespace atbus
+
+namespace atbus {
+    namespace detail {
+        static size_t buffer_allocator_class(size_t s) {
+            size_t index = 0;
+            while (index < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER && (static_cast<size_t>(1) << (ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT + index)) < s) {
+                ++index;
+            }
+
+            return index;
+        }
+
+        static inline size_t buffer_allocator_class_size(size_t index) {
+            return static_cast<size_t>(1) << (ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT + index);
+        }
+
+        static inline bool buffer_allocator_can_cache(size_t index, size_t cached_number) {
+            return 0 == cached_number ||
+                   (cached_number + 1) * buffer_block::full_size(buffer_allocator_class_size(index)) <= ATBUS_BUFFER_ALLOCATOR_CLASS_CACHE_SIZE;
+        }
 
         namespace fn {
             void *buffer_next(void *pointer, size_t step) { return reinterpret_cast<char *>(pointer) + step; }
@@ -87,13 +138,13 @@ namespace atbus {
             }
         } // namespace fn
 
-        void *buffer_block::data() { return fn::buffer_next(pointer_, used_); }
+        void *buffer_block::data() { return fn::buffer_next(raw_data(), used_); }
 
-        const void *buffer_block::data() const { return fn::buffer_next(pointer_, used_); }
+        const void *buffer_block::data() const { return fn::buffer_next(raw_data(), used_); }
 
-        void *buffer_block::raw_data() { return pointer_; }
+        void *buffer_block::raw_data() { return fn::buffer_next(this, head_size(size_)); }
 
-        const void *buffer_block::raw_data() const { return pointer_; }
+        const void *buffer_block::raw_data() const { return fn::buffer_next(this, head_size(size_)); }
 
         size_t buffer_block::size() const { return size_ - used_; }
 
@@ -113,14 +164,47 @@ namespace atbus {
 
         /** alloc and init buffer_block **/
         buffer_block *buffer_block::malloc(size_t s) {
-            size_t ms = full_size(s);
+            // 小块直接分配，不需要取线程缓存
+            if (s <= ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE) {
+                size_t ms = full_size(s);
+                void *ret = fn::allocate(ms);
+                if (NULL != ret && NULL == create(ret, ms, s)) {
+                    fn::deallocate(ret, ms);
+                    return NULL;
+                }
+
+                return reinterpret_cast<buffer_block *>(ret);
+            }
+
+            size_t index                    = buffer_allocator_class(s);
+            buffer_allocator_cache_t *cache = buffer_allocator_get_cache();
+            buffer_allocator_stats_t &stats = cache->stats[index];
+            size_t ms                       = full_size(s);
+            void *ret                       = NULL;
+
+            ++stats.alloc_times;
+            if (index < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER) {
+                // 同一级别的块大小相同，可以直接复用
+                ms = full_size(buffer_allocator_class_size(index));
+                if (NULL != cache->free_list[index]) {
+                    ret                     = cache->free_list[index];
+                    cache->free_list[index] = cache->free_list[index]->next_;
+                    --stats.cached_number;
+                    ++stats.hit_times;
+                }
+            }
+
+            if (NULL == ret) {
+                ret = fn::allocate(ms);
+            }
 
-            void *ret = ::malloc(ms);
             if (NULL != ret) {
                 if (NULL == create(ret, ms, s)) {
-                    ::free(ret);
+                    fn::deallocate(ret, ms);
                     return NULL;
                 }
+
+                ++stats.using_number;
             }
 
             return reinterpret_cast<buffer_block *>(ret);
@@ -128,10 +212,76 @@ namespace atbus {
 
         /** destroy and free buffer_block **/
         void buffer_block::free(buffer_block *p) {
-            if (NULL != p) {
+            if (NULL == p) {
+                return;
+            }
+
+            // 分配时直接走malloc的小块，raw_size不会变，这里同样直接释放
+            if (p->size_ <= ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE) {
+                size_t ms = full_size(p->size_);
                 destroy(p);
-                ::free(p);
+                fn::deallocate(p, ms);
+                return;
             }
+
+            size_t index                    = buffer_allocator_class(p->size_);
+            buffer_allocator_cache_t *cache = buffer_allocator_get_cache();
+            buffer_allocator_stats_t &stats = cache->stats[index];
+            size_t ms                       = full_size(p->size_);
+            destroy(p);
+
+            // 跨线程释放时本线程的计数可能不匹配
+            if (stats.using_number > 0) {
+                --stats.using_number;
+            }
+
+            if (index < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER && buffer_allocator_can_cache(index, stats.cached_number)) {
+                p->size_                = buffer_allocator_class_size(index);
+                p->next_                = cache->free_list[index];
+                cache->free_list[index] = p;
+                ++stats.cached_number;
+                return;
+            }
+
+            // 分级的块按级别大小分配，不缓存的大块按实际大小分配
+            if (index < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER) {
+                ms = full_size(buffer_allocator_class_size(index));
+            }
+            fn::deallocate(p, ms);
+        }
+
+        size_t buffer_block::shrink_allocator() { return buffer_allocator_get_cache()->release(); }
+
+        size_t buffer_block::get_allocator_cached_size() {
+            buffer_allocator_cache_t *cache = buffer_allocator_get_cache();
+            size_t ret                      = 0;
+            for (size_t i = 0; i < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER; ++i) {
+                ret += cache->stats[i].cached_number * full_size(buffer_allocator_class_size(i));
+            }
+
+            return ret;
+        }
+
+        size_t buffer_block::alloc_size(size_t s) {
+            if (s <= ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE) {
+                return full_size(s);
+            }
+
+            size_t index = buffer_allocator_class(s);
+            if (index < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER) {
+                return full_size(buffer_allocator_class_size(index));
+            }
+
+            return full_size(s);
+        }
+
+        void buffer_block::get_allocator_stats(std::vector<buffer_allocator_stats_t> &out) {
+            buffer_allocator_cache_t *cache = buffer_allocator_get_cache();
+            out.assign(cache->stats, cache->stats + ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER + 1);
+            for (size_t i = 0; i < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER; ++i) {
+                out[i].block_size = full_size(buffer_allocator_class_size(i));
+            }
+            out[ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER].block_size = 0;
         }
 
         /** init buffer_block as specify address **/
@@ -141,17 +291,17 @@ namespace atbus {
             }
 
             size_t fs = full_size(bs);
-            size_t hs = head_size(bs);
             if (fs > s) {
                 return NULL;
             }
 
             buffer_block *res = reinterpret_cast<buffer_block *>(pointer);
             res->size_        = bs;
-            res->pointer_     = fn::buffer_next(pointer, hs);
             res->used_        = 0;
+            res->next_        = NULL;
+            res->prev_        = NULL;
 
-            assert(fn::buffer_next(pointer, fs) >= fn::buffer_next(res->pointer_, res->size_));
+            assert(fn::buffer_next(pointer, fs) >= fn::buffer_next(res->raw_data(), res->size_));
             return fn::buffer_next(pointer, fs);
         }
 
@@ -166,7 +316,7 @@ namespace atbus {
             memset((void *)p, 0x5e5e5e5e, full_size(p->size_));
 #endif
 
-            return fn::buffer_next(p->pointer_, p->size_);
+            return fn::buffer_next(p->raw_data(), p->size_);
         }
 
         size_t buffer_block::padding_size(size_t s) {
@@ -183,8 +333,10 @@ namespace atbus {
         size_t buffer_block::full_size(size_t s) { return head_size(s) + padding_size(s); }
 
         // ================= buffer manager =================
-        buffer_manager::buffer_manager() {
+        buffer_manager::buffer_manager() : resident_size_(0), resident_counter_(NULL) {
             static_buffer_.buffer_ = NULL;
+            dynamic_buffer_.head_  = NULL;
+            dynamic_buffer_.tail_  = NULL;
 
             reset();
         }
@@ -319,8 +471,115 @@ namespace atbus {
             return res;
         }
 
+        int buffer_manager::push_back_split(segment_t segs[2], size_t s, size_t min_first_size) {
+            segs[0].pointer = segs[1].pointer = NULL;
+            segs[0].size = segs[1].size = 0;
+            if (limit_.limit_number_ > 0 && limit_.cost_number_ >= limit_.limit_number_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            if (limit_.limit_size_ > 0 && limit_.cost_size_ + s > limit_.limit_size_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            int res;
+            if (is_dynamic_mode()) {
+                res = dynamic_push_back(segs[0].pointer, s);
+                if (res >= 0) {
+                    segs[0].size = s;
+                }
+            } else {
+                res = static_push_back_split(segs, s, min_first_size);
+            }
+
+            if (res >= 0) {
+                ++limit_.cost_number_;
+                limit_.cost_size_ += s;
+            }
+
+            return res;
+        }
+
+        int buffer_manager::push_front_split(segment_t segs[2], size_t s, size_t min_first_size) {
+            segs[0].pointer = segs[1].pointer = NULL;
+            segs[0].size = segs[1].size = 0;
+            if (limit_.limit_number_ > 0 && limit_.cost_number_ >= limit_.limit_number_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            if (limit_.limit_size_ > 0 && limit_.cost_size_ + s > limit_.limit_size_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            int res;
+            if (is_dynamic_mode()) {
+                res = dynamic_push_front(segs[0].pointer, s);
+                if (res >= 0) {
+                    segs[0].size = s;
+                }
+            } else {
+                res = static_push_front_split(segs, s, min_first_size);
+            }
+
+            if (res >= 0) {
+                ++limit_.cost_number_;
+                limit_.cost_size_ += s;
+            }
+
+            return res;
+        }
+
+        size_t buffer_manager::raw_segments(const buffer_block *block, segment_t segs[2]) const {
+            segs[0].pointer = segs[1].pointer = NULL;
+            segs[0].size = segs[1].size = 0;
+            if (NULL == block) {
+                return 0;
+            }
+
+            segs[0].pointer = const_cast<void *>(block->raw_data());
+            if (is_static_mode() && static_is_split(block)) {
+                segs[0].size    = fn::buffer_offset(block->raw_data(), fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_));
+                segs[1].pointer = static_buffer_.buffer_;
+                segs[1].size    = block->raw_size() - segs[0].size;
+                return 2;
+            }
+
+            segs[0].size = block->raw_size();
+            return 1;
+        }
+
         bool buffer_manager::empty() const { return is_dynamic_mode() ? dynamic_empty() : static_empty(); }
 
+        void buffer_manager::bind_resident_counter(size_t *counter) {
+            if (counter == resident_counter_) {
+                return;
+            }
+
+            if (NULL != resident_counter_) {
+                *resident_counter_ -= resident_size_;
+            }
+
+            resident_counter_ = counter;
+            if (NULL != resident_counter_) {
+                *resident_counter_ += resident_size_;
+            }
+        }
+
+        void buffer_manager::add_resident_size(size_t s) {
+            resident_size_ += s;
+            if (NULL != resident_counter_) {
+                *resident_counter_ += s;
+            }
+        }
+
+        void buffer_manager::sub_resident_size(size_t s) {
+            assert(resident_size_ >= s);
+            resident_size_ -= s;
+            if (NULL != resident_counter_) {
+                *resident_counter_ -= s;
+            }
+        }
+
         buffer_block *buffer_manager::static_front() {
             if (static_empty()) {
                 return NULL;
@@ -519,7 +778,10 @@ namespace atbus {
 
             tail->pop(s);
             if (free_unwritable && 0 == tail->size()) {
-                buffer_block::destroy(tail);
+                // 拆分的块跨越了缓冲区尾部，不能按连续内存做填充
+                if (!static_is_split(tail)) {
+                    buffer_block::destroy(tail);
+                }
                 assign_tail(NULL);
                 sub_tail(tail_index);
 
@@ -563,7 +825,10 @@ namespace atbus {
 
             head->pop(s);
             if (free_unwritable && 0 == head->size()) {
-                buffer_block::destroy(head);
+                // 拆分的块跨越了缓冲区尾部，不能按连续内存做填充
+                if (!static_is_split(head)) {
+                    buffer_block::destroy(head);
+                }
                 assign_head(NULL);
                 add_head();
 
@@ -602,6 +867,11 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
+            // 拆分的块不支持合并
+            if (static_is_split(last_block)) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
 #define index_tail() ((static_buffer_.tail_ + static_buffer_.circle_index_.size() - 1) % static_buffer_.circle_index_.size())
 #define assign_tail(x) static_buffer_.circle_index_[static_buffer_.tail_] = reinterpret_cast<buffer_block *>(x)
 
@@ -613,7 +883,7 @@ namespace atbus {
                 assert(static_buffer_.size_ == free_len || fn::buffer_next(last_block->raw_data(), last_block->raw_size()) == tail);
 
                 if (free_len >= fs && tail >= head) { // .... head NNNNNN tail NN old_bound NN new_bound ....
-                    pointer = fn::buffer_next(last_block->pointer_, last_block->size_);
+                    pointer = fn::buffer_next(last_block->raw_data(), last_block->size_);
                     last_block->size_ += s;
 
                     assert(fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_) >=
@@ -657,7 +927,7 @@ namespace atbus {
                     return EN_ATBUS_ERR_BUFF_LIMIT;
                 }
 
-                pointer = fn::buffer_next(last_block->pointer_, last_block->size_);
+                pointer = fn::buffer_next(last_block->raw_data(), last_block->size_);
                 // NNN tail NN old_bound NN new_bound ....  head NNNNNN ....
                 last_block->size_ += s;
 
@@ -685,10 +955,16 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
+            // 拆分的块不支持合并
+            if (static_is_split(head)) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
             size_t fs = buffer_block::padding_size(s);
 
             // in case of cover buffer when relocate the header of head block
             buffer_block old_head = *head;
+            void *old_head_data   = head->raw_data(); // 头部拷贝后数据区地址不再能由拷贝计算
             size_t new_head_s     = s + old_head.raw_size();
             size_t new_head_fs    = buffer_block::full_size(new_head_s);
 
@@ -745,7 +1021,7 @@ namespace atbus {
             // memory move
             {
                 pointer = fn::buffer_next(head->data(), old_head.raw_size());
-                memmove(head->data(), old_head.raw_data(), old_head.raw_size());
+                memmove(head->data(), old_head_data, old_head.raw_size());
                 head->pop(old_head.raw_size() - old_head.size());
                 assign_head(head);
             }
@@ -754,6 +1030,102 @@ namespace atbus {
             return 0;
         }
 
+        int buffer_manager::static_push_back_split(segment_t segs[2], size_t s, size_t min_first_size) {
+            assert(static_buffer_.circle_index_.size() >= 2);
+
+            buffer_block *head = static_buffer_.circle_index_[static_buffer_.head_];
+            buffer_block *tail = static_buffer_.circle_index_[static_buffer_.tail_];
+            size_t fs          = buffer_block::full_size(s);
+            size_t hs          = buffer_block::head_size(s);
+
+            // 尾部剩余空间不够时拆分，头部和第一段放在尾部剩余空间，第二段从缓冲区起始位置开始
+            // .... head NNNNNN old_tail NN => NN new_tail ... head NNNNNN old_tail NN
+            if (!static_empty() && NULL != head && NULL != tail && tail >= head &&
+                (static_buffer_.tail_ + 1) % static_buffer_.circle_index_.size() != static_buffer_.head_) {
+                size_t tail_free = fn::buffer_offset(tail, fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_));
+                size_t head_free = fn::buffer_offset(static_buffer_.buffer_, head);
+
+                // 必须预留空区域，不能让new_tail == head
+                if (tail_free < fs && tail_free > hs && tail_free - hs >= min_first_size && tail_free + head_free > fs) {
+                    size_t first_size = tail_free - hs;
+                    tail->size_       = s;
+                    tail->used_       = 0;
+                    tail->next_       = NULL;
+                    tail->prev_       = NULL;
+
+                    segs[0].pointer = tail->raw_data();
+                    segs[0].size    = first_size;
+                    segs[1].pointer = static_buffer_.buffer_;
+                    segs[1].size    = s - first_size;
+
+                    static_buffer_.tail_ = (static_buffer_.tail_ + 1) % static_buffer_.circle_index_.size();
+                    static_buffer_.circle_index_[static_buffer_.tail_] =
+                        reinterpret_cast<buffer_block *>(fn::buffer_next(static_buffer_.buffer_, fs - tail_free));
+                    return EN_ATBUS_ERR_SUCCESS;
+                }
+            }
+
+            int res = static_push_back(segs[0].pointer, s);
+            if (res >= 0) {
+                segs[0].size = s;
+            }
+
+            return res;
+        }
+
+        int buffer_manager::static_push_front_split(segment_t segs[2], size_t s, size_t min_first_size) {
+            assert(static_buffer_.circle_index_.size() >= 2);
+
+            buffer_block *head = static_buffer_.circle_index_[static_buffer_.head_];
+            buffer_block *tail = static_buffer_.circle_index_[static_buffer_.tail_];
+            size_t fs          = buffer_block::full_size(s);
+            size_t hs          = buffer_block::head_size(s);
+
+            // head前的空间不够时拆分，第二段放在缓冲区起始位置并且尽量紧挨着head，头部和第一段放在缓冲区尾部
+            // NN old_head NNNNNN tail .... => NN old_head NNNNNN tail .... new_head NN
+            if (!static_empty() && NULL != head && NULL != tail && tail >= head &&
+                (static_buffer_.tail_ + 1) % static_buffer_.circle_index_.size() != static_buffer_.head_) {
+                size_t tail_free  = fn::buffer_offset(tail, fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_));
+                size_t head_free  = fn::buffer_offset(static_buffer_.buffer_, head);
+                size_t ps         = buffer_block::padding_size(s);
+                size_t first_size = ps > head_free ? ps - head_free : 0;
+                if (first_size < min_first_size || 0 == first_size) {
+                    first_size = buffer_block::padding_size(min_first_size > 0 ? min_first_size : 1);
+                }
+
+                // 必须预留空区域，不能让new_head == tail
+                if (head_free < fs && first_size < ps && hs + first_size < tail_free) {
+                    buffer_block *block = reinterpret_cast<buffer_block *>(
+                        fn::buffer_prev(fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_), hs + first_size));
+                    block->size_ = s;
+                    block->used_ = 0;
+                    block->next_ = NULL;
+                    block->prev_ = NULL;
+
+                    segs[0].pointer = block->raw_data();
+                    segs[0].size    = first_size;
+                    segs[1].pointer = static_buffer_.buffer_;
+                    segs[1].size    = s - first_size;
+
+                    static_buffer_.head_ =
+                        (static_buffer_.head_ + static_buffer_.circle_index_.size() - 1) % static_buffer_.circle_index_.size();
+                    static_buffer_.circle_index_[static_buffer_.head_] = block;
+                    return EN_ATBUS_ERR_SUCCESS;
+                }
+            }
+
+            int res = static_push_front(segs[0].pointer, s);
+            if (res >= 0) {
+                segs[0].size = s;
+            }
+
+            return res;
+        }
+
+        bool buffer_manager::static_is_split(const buffer_block *block) const {
+            return fn::buffer_offset(static_buffer_.buffer_, block) + buffer_block::full_size(block->raw_size()) > static_buffer_.size_;
+        }
+
         bool buffer_manager::static_empty() const { return static_buffer_.head_ == static_buffer_.tail_; }
 
 
@@ -762,7 +1134,7 @@ namespace atbus {
                 return NULL;
             }
 
-            return dynamic_buffer_.front();
+            return dynamic_buffer_.head_;
         }
 
         buffer_block *buffer_manager::dynamic_back() {
@@ -770,7 +1142,7 @@ namespace atbus {
                 return NULL;
             }
 
-            return dynamic_buffer_.back();
+            return dynamic_buffer_.tail_;
         }
 
         int buffer_manager::dynamic_push_back(void *&pointer, size_t s) {
@@ -779,9 +1151,16 @@ namespace atbus {
                 pointer = NULL;
                 return EN_ATBUS_ERR_MALLOC;
             }
+            add_resident_size(buffer_block::alloc_size(res->raw_size()));
 
-            dynamic_buffer_.push_back(res);
-            pointer = res->data();
+            res->prev_ = dynamic_buffer_.tail_;
+            if (NULL == dynamic_buffer_.tail_) {
+                dynamic_buffer_.head_ = res;
+            } else {
+                dynamic_buffer_.tail_->next_ = res;
+            }
+            dynamic_buffer_.tail_ = res;
+            pointer               = res->data();
 
             return EN_ATBUS_ERR_SUCCESS;
         }
@@ -792,9 +1171,16 @@ namespace atbus {
                 pointer = NULL;
                 return EN_ATBUS_ERR_MALLOC;
             }
+            add_resident_size(buffer_block::alloc_size(res->raw_size()));
 
-            dynamic_buffer_.push_front(res);
-            pointer = res->data();
+            res->next_ = dynamic_buffer_.head_;
+            if (NULL == dynamic_buffer_.head_) {
+                dynamic_buffer_.tail_ = res;
+            } else {
+                dynamic_buffer_.head_->prev_ = res;
+            }
+            dynamic_buffer_.head_ = res;
+            pointer               = res->data();
 
             return EN_ATBUS_ERR_SUCCESS;
         }
@@ -804,15 +1190,21 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *t = dynamic_buffer_.back();
+            buffer_block *t = dynamic_buffer_.tail_;
             if (s > t->size()) {
                 s = t->size();
             }
 
             t->pop(s);
             if (free_unwritable && t->size() <= 0) {
+                dynamic_buffer_.tail_ = t->prev_;
+                if (NULL == dynamic_buffer_.tail_) {
+                    dynamic_buffer_.head_ = NULL;
+                } else {
+                    dynamic_buffer_.tail_->next_ = NULL;
+                }
+                sub_resident_size(buffer_block::alloc_size(t->raw_size()));
                 buffer_block::free(t);
-                dynamic_buffer_.pop_back();
 
                 if (limit_.cost_number_ > 0) {
                     --limit_.cost_number_;
@@ -835,15 +1227,21 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *t = dynamic_buffer_.front();
+            buffer_block *t = dynamic_buffer_.head_;
             if (s > t->size()) {
                 s = t->size();
             }
 
             t->pop(s);
             if (free_unwritable && t->size() <= 0) {
+                dynamic_buffer_.head_ = t->next_;
+                if (NULL == dynamic_buffer_.head_) {
+                    dynamic_buffer_.tail_ = NULL;
+                } else {
+                    dynamic_buffer_.head_->prev_ = NULL;
+                }
+                sub_resident_size(buffer_block::alloc_size(t->raw_size()));
                 buffer_block::free(t);
-                dynamic_buffer_.pop_front();
 
                 if (limit_.cost_number_ > 0) {
                     --limit_.cost_number_;
@@ -875,17 +1273,26 @@ namespace atbus {
             if (NULL == res) {
                 return EN_ATBUS_ERR_MALLOC;
             }
+            add_resident_size(buffer_block::alloc_size(res->raw_size()));
 
             // reset pointer
             pointer = fn::buffer_next(res->data(), block->raw_size());
-            assert(dynamic_buffer_.back() == block);
-            dynamic_buffer_.back() = res;
+            assert(dynamic_buffer_.tail_ == block);
+            buffer_block *prev = block->prev_;
+            res->prev_         = prev;
+            if (NULL == prev) {
+                dynamic_buffer_.head_ = res;
+            } else {
+                prev->next_ = res;
+            }
+            dynamic_buffer_.tail_ = res;
 
             // move data
             memcpy(res->data(), block->raw_data(), block->raw_size());
             res->pop(block->raw_size() - block->size());
 
             // remove old block
+            sub_resident_size(buffer_block::alloc_size(block->raw_size()));
             buffer_block::free(block);
             return EN_ATBUS_ERR_SUCCESS;
         }
@@ -904,38 +1311,51 @@ namespace atbus {
             if (NULL == res) {
                 return EN_ATBUS_ERR_MALLOC;
             }
+            add_resident_size(buffer_block::alloc_size(res->raw_size()));
 
             // reset pointer
             pointer = fn::buffer_next(res->data(), block->raw_size());
-            assert(dynamic_buffer_.front() == block);
-            dynamic_buffer_.front() = res;
+            assert(dynamic_buffer_.head_ == block);
+            res->next_ = block->next_;
+            if (NULL == res->next_) {
+                dynamic_buffer_.tail_ = res;
+            } else {
+                res->next_->prev_ = res;
+            }
+            dynamic_buffer_.head_ = res;
 
             // move data
             memcpy(res->data(), block->raw_data(), block->raw_size());
             res->pop(block->raw_size() - block->size());
 
             // remove old block
+            sub_resident_size(buffer_block::alloc_size(block->raw_size()));
             buffer_block::free(block);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        bool buffer_manager::dynamic_empty() const { return dynamic_buffer_.empty(); }
+        bool buffer_manager::dynamic_empty() const { return NULL == dynamic_buffer_.head_; }
 
         void buffer_manager::reset() {
             static_buffer_.head_ = 0;
             static_buffer_.tail_ = 0;
-            static_buffer_.size_ = 0;
             static_buffer_.circle_index_.clear();
             if (NULL != static_buffer_.buffer_) {
-                ::free(static_buffer_.buffer_);
+                sub_resident_size(static_buffer_.size_);
+                fn::deallocate(static_buffer_.buffer_, static_buffer_.size_);
                 static_buffer_.buffer_ = NULL;
             }
+            static_buffer_.size_ = 0;
 
             // dynamic buffers
-            while (!dynamic_buffer_.empty()) {
-                buffer_block::free(dynamic_buffer_.front());
-                dynamic_buffer_.pop_front();
+            while (NULL != dynamic_buffer_.head_) {
+                buffer_block *t       = dynamic_buffer_.head_;
+                dynamic_buffer_.head_ = t->next_;
+                sub_resident_size(buffer_block::alloc_size(t->raw_size()));
+                buffer_block::free(t);
             }
+            dynamic_buffer_.tail_ = NULL;
+            assert(0 == resident_size_);
 
             limit_.cost_size_    = 0;
             limit_.cost_number_  = 0;
@@ -948,9 +1368,10 @@ namespace atbus {
 
             if (0 != max_size && max_number > 0) {
                 size_t bfs             = buffer_block::padding_size(max_size);
-                static_buffer_.buffer_ = ::malloc(bfs);
+                static_buffer_.buffer_ = fn::allocate(bfs);
                 if (NULL != static_buffer_.buffer_) {
                     static_buffer_.size_ = bfs;
+                    add_resident_size(bfs);
 
                     // left 1 empty bound
                     static_buffer_.circle_index_.resize(max_number + 1, NULL);
@@ -959,5 +1380,182 @@ namespace atbus {
                 }
             }
         }
+
+        // ================= spsc buffer manager =================
+        // ring_[head_, tail_) 内的块已提交给消费者，ring_[tail_]保持空位用于区分空和满
+        spsc_buffer_manager::spsc_buffer_manager() : limit_size_(0), pending_(NULL) {
+            head_.store(0);
+            tail_.store(0);
+            cost_size_.store(0);
+        }
+
+        spsc_buffer_manager::~spsc_buffer_manager() { reset(); }
+
+        spsc_buffer_manager::limit_t spsc_buffer_manager::limit() const {
+            limit_t ret;
+            size_t head = head_.load(util::lock::memory_order_acquire);
+            size_t tail = tail_.load(util::lock::memory_order_acquire);
+
+            ret.cost_number_  = ring_.empty() ? 0 : (tail + ring_.size() - head) % ring_.size();
+            ret.cost_size_    = cost_size_.load(util::lock::memory_order_acquire);
+            ret.limit_number_ = ring_.empty() ? 0 : ring_.size() - 1;
+            ret.limit_size_   = limit_size_;
+            return ret;
+        }
+
+        bool spsc_buffer_manager::set_limit(size_t max_size, size_t max_number) {
+            if (0 == max_number) {
+                return false;
+            }
+
+            reset();
+            ring_.resize(max_number + 1, NULL);
+            limit_size_ = max_size;
+            return true;
+        }
+
+        int spsc_buffer_manager::push_back(void *&pointer, size_t s) {
+            pointer = NULL;
+            if (ring_.empty()) {
+                return EN_ATBUS_ERR_NOT_INITED;
+            }
+
+            if (NULL != pending_) {
+                return EN_ATBUS_ERR_ACCESS_DENY;
+            }
+
+            // 只有消费者会修改head_和减少cost_size_，所以这里检查通过后提交时一定不会超限
+            size_t tail = tail_.load(util::lock::memory_order_relaxed);
+            if ((tail + 1) % ring_.size() == head_.load(util::lock::memory_order_acquire)) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            if (limit_size_ > 0 && cost_size_.load(util::lock::memory_order_acquire) + s > limit_size_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            pending_ = buffer_block::malloc(s);
+            if (NULL == pending_) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            pointer = pending_->data();
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        buffer_block *spsc_buffer_manager::back() { return pending_; }
+
+        int spsc_buffer_manager::back(void *&pointer, size_t &nread, size_t &nwrite) {
+            if (NULL == pending_) {
+                pointer = NULL;
+                nread = nwrite = 0;
+
+                return EN_ATBUS_ERR_NO_DATA;
+            }
+
+            pointer = pending_->data();
+            nwrite  = pending_->size();
+            nread   = pending_->raw_size() - nwrite;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        int spsc_buffer_manager::commit_back() {
+            if (NULL == pending_) {
+                return EN_ATBUS_ERR_NO_DATA;
+            }
+
+            size_t tail = tail_.load(util::lock::memory_order_relaxed);
+            ring_[tail] = pending_;
+            cost_size_.fetch_add(pending_->size(), util::lock::memory_order_acq_rel);
+            pending_ = NULL;
+
+            // 块的数据必须在tail_移动之前对消费者可见
+            tail_.store((tail + 1) % ring_.size(), util::lock::memory_order_release);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        int spsc_buffer_manager::cancel_back() {
+            if (NULL == pending_) {
+                return EN_ATBUS_ERR_NO_DATA;
+            }
+
+            buffer_block::free(pending_);
+            pending_ = NULL;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        buffer_block *spsc_buffer_manager::front() {
+            size_t head = head_.load(util::lock::memory_order_relaxed);
+            if (ring_.empty() || head == tail_.load(util::lock::memory_order_acquire)) {
+                return NULL;
+            }
+
+            return ring_[head];
+        }
+
+        int spsc_buffer_manager::front(void *&pointer, size_t &nread, size_t &nwrite) {
+            buffer_block *res = front();
+            if (NULL == res) {
+                pointer = NULL;
+                nread = nwrite = 0;
+
+                return EN_ATBUS_ERR_NO_DATA;
+            }
+
+            pointer = res->data();
+            nwrite  = res->size();
+            nread   = res->raw_size() - nwrite;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        int spsc_buffer_manager::pop_front(size_t s, bool free_unwritable) {
+            buffer_block *head_block = front();
+            if (NULL == head_block) {
+                return EN_ATBUS_ERR_NO_DATA;
+            }
+
+            if (s > head_block->size()) {
+                s = head_block->size();
+            }
+
+            head_block->pop(s);
+            cost_size_.fetch_sub(s, util::lock::memory_order_acq_rel);
+
+            if (free_unwritable && 0 == head_block->size()) {
+                size_t head = head_.load(util::lock::memory_order_relaxed);
+                ring_[head] = NULL;
+                buffer_block::free(head_block);
+
+                // 释放后再移动head_，生产者才能复用这个位置
+                head_.store((head + 1) % ring_.size(), util::lock::memory_order_release);
+            }
+
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        bool spsc_buffer_manager::empty() const {
+            return head_.load(util::lock::memory_order_acquire) == tail_.load(util::lock::memory_order_acquire);
+        }
+
+        void spsc_buffer_manager::reset() {
+            if (NULL != pending_) {
+                buffer_block::free(pending_);
+                pending_ = NULL;
+            }
+
+            size_t head = head_.load(util::lock::memory_order_acquire);
+            size_t tail = tail_.load(util::lock::memory_order_acquire);
+            while (!ring_.empty() && head != tail) {
+                buffer_block::free(ring_[head]);
+                ring_[head] = NULL;
+                head        = (head + 1) % ring_.size();
+            }
+
+            ring_.clear();
+            limit_size_ = 0;
+            head_.store(0, util::lock::memory_order_release);
+            tail_.store(0, util::lock::memory_order_release);
+            cost_size_.store(0, util::lock::memory_order_release);
+        }
     } // namespace detail
 } // namespace atbus
@@ -0,0 +1,262 @@
+﻿#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "config/compiler_features.h"
+
+#include "detail/libatbus_allocator.h"
+#include "detail/thread_cache.h"
+
+namespace atbus {
+    namespace detail {
+        namespace fn {
+            static void *default_allocate(void *, size_t s) { return ::malloc(s); }
+
+            static void default_deallocate(void *, void *p, size_t) { ::free(p); }
+
+            static allocator_t &allocator_instance() {
+                static allocator_t ret = {default_allocate, default_deallocate, NULL};
+                return ret;
+            }
+
+            void set_allocator(const allocator_t *alloc) {
+                allocator_t &inst = allocator_instance();
+                if (NULL == alloc || NULL == alloc->allocate || NULL == alloc->deallocate) {
+                    inst.allocate   = default_allocate;
+                    inst.deallocate = default_deallocate;
+                    inst.priv_data  = NULL;
+                    return;
+                }
+
+                inst = *alloc;
+            }
+
+            const allocator_t &get_allocator() { return allocator_instance(); }
+
+            void *allocate(size_t s) {
+                allocator_t &inst = allocator_instance();
+                return inst.allocate(inst.priv_data, s);
+            }
+
+            void deallocate(void *p, size_t s) {
+                if (NULL == p) {
+                    return;
+                }
+
+                allocator_t &inst = allocator_instance();
+                inst.deallocate(inst.priv_data, p, s);
+            }
+        } // namespace fn
+
+        // ================= small object cache =================
+        // 按 ATBUS_OBJECT_CACHE_ALIGN 分级缓存小对象的内存，每个线程独立，不需要加锁，线程退出时释放
+        struct object_cache_node_t {
+            object_cache_node_t *next;
+        };
+
+        struct object_cache_t {
+            object_cache_node_t *free_list[ATBUS_OBJECT_CACHE_CLASS_NUMBER];
+            size_t cached_number[ATBUS_OBJECT_CACHE_CLASS_NUMBER];
+
+            size_t release() {
+                size_t ret = 0;
+                for (size_t i = 0; i < ATBUS_OBJECT_CACHE_CLASS_NUMBER; ++i) {
+                    while (NULL != free_list[i]) {
+                        object_cache_node_t *node = free_list[i];
+                        free_list[i]              = node->next;
+                        ret += (i + 1) * ATBUS_OBJECT_CACHE_ALIGN;
+                        fn::deallocate(node, (i + 1) * ATBUS_OBJECT_CACHE_ALIGN);
+                    }
+
+                    cached_number[i] = 0;
+                }
+
+                return ret;
+            }
+        };
+
+        static inline object_cache_t *object_cache_get() { return thread_cache<object_cache_t>::get(); }
+    } // namespace detail
+} // namespace atbus
+
+namespace atbus {
+    namespace detail {
+        namespace fn {
+            void *allocate_object(size_t s) {
+                size_t index = (0 == s ? 0 : (s - 1) / ATBUS_OBJECT_CACHE_ALIGN);
+                if (index >= ATBUS_OBJECT_CACHE_CLASS_NUMBER) {
+                    return allocate(s);
+                }
+
+                object_cache_t *cache = object_cache_get();
+                if (NULL != cache->free_list[index]) {
+                    object_cache_node_t *ret = cache->free_list[index];
+                    cache->free_list[index]  = ret->next;
+                    --cache->cached_number[index];
+                    return ret;
+                }
+
+                return allocate((index + 1) * ATBUS_OBJECT_CACHE_ALIGN);
+            }
+
+            void deallocate_object(void *p, size_t s) {
+                if (NULL == p) {
+                    return;
+                }
+
+                size_t index = (0 == s ? 0 : (s - 1) / ATBUS_OBJECT_CACHE_ALIGN);
+                if (index >= ATBUS_OBJECT_CACHE_CLASS_NUMBER) {
+                    deallocate(p, s);
+                    return;
+                }
+
+                object_cache_t *cache = object_cache_get();
+                if (cache->cached_number[index] >= ATBUS_OBJECT_CACHE_MAX_NUMBER) {
+                    deallocate(p, (index + 1) * ATBUS_OBJECT_CACHE_ALIGN);
+                    return;
+                }
+
+                object_cache_node_t *node = reinterpret_cast<object_cache_node_t *>(p);
+                node->next                = cache->free_list[index];
+                cache->free_list[index]   = node;
+                ++cache->cached_number[index];
+            }
+
+            size_t shrink_object_cache() { return object_cache_get()->release(); }
+        } // namespace fn
+
+        // ================= arena allocator =================
+        // 按两个指针的大小对齐，足够放下所有协议结构
+        static size_t arena_align_size(size_t s) {
+            const size_t align = sizeof(void *) * 2;
+            return (s + align - 1) & ~(align - 1);
+        }
+
+        arena_allocator::arena_allocator()
+            : head_(NULL), current_(NULL), chunk_size_(ATBUS_ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE), used_size_(0), capacity_(0) {}
+
+        arena_allocator::~arena_allocator() { release(); }
+
+        void arena_allocator::set_chunk_size(size_t s) { chunk_size_ = 0 == s ? ATBUS_ARENA_ALLOCATOR_DEFAULT_CHUNK_SIZE : s; }
+
+        void *arena_allocator::allocate(size_t s) {
+            s = arena_align_size(0 == s ? 1 : s);
+
+            // 当前块不够时依次尝试后面已经分配的块
+            while (NULL != current_ && current_->used + s > current_->size) {
+                current_ = current_->next;
+            }
+
+            if (NULL == current_) {
+                chunk_t *chunk = alloc_chunk(s > chunk_size_ ? s : chunk_size_);
+                if (NULL == chunk) {
+                    return NULL;
+                }
+
+                // 新块放在链表头，已经跳过的块在reset后还可以继续使用
+                chunk->next = head_;
+                head_       = chunk;
+                current_    = chunk;
+            }
+
+            void *ret = reinterpret_cast<char *>(current_) + arena_align_size(sizeof(chunk_t)) + current_->used;
+            current_->used += s;
+            used_size_ += s;
+            return ret;
+        }
+
+        void arena_allocator::reset() {
+            // 使用了多个块时合并成一个大块，下一次处理同样大小的消息就只需要一个块
+            if (NULL != head_ && NULL != head_->next && used_size_ > 0) {
+                size_t merge_size = used_size_ > chunk_size_ ? used_size_ : chunk_size_;
+                release();
+
+                chunk_t *chunk = alloc_chunk(merge_size);
+                if (NULL != chunk) {
+                    chunk->next = NULL;
+                    head_       = chunk;
+                }
+            }
+
+            for (chunk_t *chunk = head_; NULL != chunk; chunk = chunk->next) {
+                chunk->used = 0;
+            }
+
+            current_   = head_;
+            used_size_ = 0;
+        }
+
+        void arena_allocator::release() {
+            while (NULL != head_) {
+                chunk_t *chunk = head_;
+                head_          = chunk->next;
+                fn::deallocate(chunk, arena_align_size(sizeof(chunk_t)) + chunk->size);
+            }
+
+            current_   = NULL;
+            used_size_ = 0;
+            capacity_  = 0;
+        }
+
+        arena_allocator::chunk_t *arena_allocator::alloc_chunk(size_t s) {
+            s              = arena_align_size(s);
+            chunk_t *chunk = reinterpret_cast<chunk_t *>(fn::allocate(arena_align_size(sizeof(chunk_t)) + s));
+            if (NULL == chunk) {
+                return NULL;
+            }
+
+            chunk->next = NULL;
+            chunk->size = s;
+            chunk->used = 0;
+            capacity_ += s;
+            return chunk;
+        }
+
+        // ================= arena buffer =================
+        arena_buffer::arena_buffer(arena_allocator &arena, size_t reserve_size)
+            : arena_(&arena), data_(NULL), size_(0), capacity_(0), good_(true) {
+            if (reserve_size > 0) {
+                reserve(reserve_size);
+            }
+        }
+
+        void arena_buffer::write(const char *buf, size_t len) {
+            if (!good_ || 0 == len) {
+                return;
+            }
+
+            if (size_ + len > capacity_ && !reserve(size_ + len)) {
+                good_ = false;
+                return;
+            }
+
+            memcpy(data_ + size_, buf, len);
+            size_ += len;
+        }
+
+        bool arena_buffer::reserve(size_t s) {
+            if (s <= capacity_) {
+                return true;
+            }
+
+            // 按2倍扩容，旧的内存在arena reset时统一回收
+            size_t new_capacity = capacity_ * 2;
+            if (new_capacity < s) {
+                new_capacity = s;
+            }
+
+            char *new_data = reinterpret_cast<char *>(arena_->allocate(new_capacity));
+            if (NULL == new_data) {
+                return false;
+            }
+
+            if (size_ > 0) {
+                memcpy(new_data, data_, size_);
+            }
+
+            data_     = new_data;
+            capacity_ = new_capacity;
+            return true;
+        }
+    } // namespace detail
+} // namespace atbus
@@ -0,0 +1,177 @@
+﻿#include <cstring>
+
+#include "detail/libatbus_error.h"
+#include "detail/libatbus_protocol_compact.h"
+
+namespace atbus {
+    namespace detail {
+        namespace fn {
+            static inline void compact_write_u16(unsigned char *out, uint16_t v) {
+                out[0] = static_cast<unsigned char>(v & 0xFF);
+                out[1] = static_cast<unsigned char>((v >> 8) & 0xFF);
+            }
+
+            static inline void compact_write_u32(unsigned char *out, uint32_t v) {
+                for (size_t i = 0; i < sizeof(v); ++i) {
+                    out[i] = static_cast<unsigned char>((v >> (i * 8)) & 0xFF);
+                }
+            }
+
+            static inline void compact_write_u64(unsigned char *out, uint64_t v) {
+                for (size_t i = 0; i < sizeof(v); ++i) {
+                    out[i] = static_cast<unsigned char>((v >> (i * 8)) & 0xFF);
+                }
+            }
+
+            static inline uint32_t compact_read_u32(const unsigned char *in) {
+                uint32_t ret = 0;
+                for (size_t i = 0; i < sizeof(ret); ++i) {
+                    ret |= static_cast<uint32_t>(in[i]) << (i * 8);
+                }
+                return ret;
+            }
+
+            static inline uint64_t compact_read_u64(const unsigned char *in) {
+                uint64_t ret = 0;
+                for (size_t i = 0; i < sizeof(ret); ++i) {
+                    ret |= static_cast<uint64_t>(in[i]) << (i * 8);
+                }
+                return ret;
+            }
+
+            bool compact_data_check(const protocol::msg &m) {
+                if (ATBUS_CMD_DATA_TRANSFORM_REQ != m.head.cmd && ATBUS_CMD_DATA_TRANSFORM_RSP != m.head.cmd) {
+                    return false;
+                }
+
+                if (NULL == m.body.forward || m.body.forward->route_data) {
+                    return false;
+                }
+
+                // 长度字段只有32位
+                if (static_cast<uint64_t>(m.body.forward->content.size) > 0xFFFFFFFFULL ||
+                    static_cast<uint64_t>(m.body.forward->router.size()) > 0xFFFFFFFFULL) {
+                    return false;
+                }
+
+                return NULL != m.body.forward->content.ptr || 0 == m.body.forward->content.size;
+            }
+
+            bool compact_data_check_magic(const void *buffer, size_t s) {
+                return NULL != buffer && s > 0 && ATBUS_COMPACT_DATA_MAGIC == *reinterpret_cast<const unsigned char *>(buffer);
+            }
+
+            size_t compact_data_packed_size(const protocol::msg &m) {
+                if (!compact_data_check(m)) {
+                    return 0;
+                }
+
+                return ATBUS_COMPACT_DATA_HEAD_SIZE + m.body.forward->router.size() * sizeof(uint64_t) + m.body.forward->content.size;
+            }
+
+            size_t compact_data_head_size(const protocol::msg &m) {
+                if (!compact_data_check(m)) {
+                    return 0;
+                }
+
+                return ATBUS_COMPACT_DATA_HEAD_SIZE + m.body.forward->router.size() * sizeof(uint64_t);
+            }
+
+            size_t compact_data_pack(const protocol::msg &m, void *buffer, size_t s) {
+                size_t head_size = compact_data_pack_head(m, buffer, s);
+                if (0 == head_size || s < head_size + m.body.forward->content.size) {
+                    return 0;
+                }
+
+                if (m.body.forward->content.size > 0) {
+                    memcpy(reinterpret_cast<unsigned char *>(buffer) + head_size, m.body.forward->content.ptr, m.body.forward->content.size);
+                }
+
+                return head_size + m.body.forward->content.size;
+            }
+
+            size_t compact_data_pack_head(const protocol::msg &m, void *buffer, size_t s) {
+                size_t head_size = compact_data_head_size(m);
+                if (0 == head_size || NULL == buffer || s < head_size) {
+                    return 0;
+                }
+
+                const protocol::forward_data &fwd = *m.body.forward;
+                unsigned char *out                = reinterpret_cast<unsigned char *>(buffer);
+
+                out[0] = static_cast<unsigned char>(ATBUS_COMPACT_DATA_MAGIC);
+                out[1] = static_cast<unsigned char>(m.head.cmd);
+                compact_write_u16(out + 2, 0);
+                compact_write_u32(out + 4, static_cast<uint32_t>(m.head.type));
+                compact_write_u32(out + 8, static_cast<uint32_t>(m.head.ret));
+                compact_write_u32(out + 12, static_cast<uint32_t>(fwd.flags));
+                compact_write_u64(out + 16, m.head.sequence);
+                compact_write_u64(out + 24, m.head.src_bus_id);
+                compact_write_u64(out + 32, fwd.from);
+                compact_write_u64(out + 40, fwd.to);
+                compact_write_u32(out + 48, static_cast<uint32_t>(fwd.router.size()));
+                compact_write_u32(out + 52, static_cast<uint32_t>(fwd.content.size));
+                out += ATBUS_COMPACT_DATA_HEAD_SIZE;
+
+                for (size_t i = 0; i < fwd.router.size(); ++i) {
+                    compact_write_u64(out, fwd.router[i]);
+                    out += sizeof(uint64_t);
+                }
+
+                return head_size;
+            }
+
+            bool compact_data_set_to(void *buffer, size_t s, uint64_t to) {
+                if (!compact_data_check_magic(buffer, s) || s < ATBUS_COMPACT_DATA_HEAD_SIZE) {
+                    return false;
+                }
+
+                compact_write_u64(reinterpret_cast<unsigned char *>(buffer) + 40, to);
+                return true;
+            }
+
+            int compact_data_unpack(protocol::msg &m, const void *buffer, size_t s) {
+                if (!compact_data_check_magic(buffer, s) || s < ATBUS_COMPACT_DATA_HEAD_SIZE) {
+                    return EN_ATBUS_ERR_UNPACK;
+                }
+
+                const unsigned char *in = reinterpret_cast<const unsigned char *>(buffer);
+                if (ATBUS_CMD_DATA_TRANSFORM_REQ != in[1] && ATBUS_CMD_DATA_TRANSFORM_RSP != in[1]) {
+                    return EN_ATBUS_ERR_UNPACK;
+                }
+
+                uint64_t router_size  = compact_read_u32(in + 48);
+                uint64_t content_size = compact_read_u32(in + 52);
+                if (static_cast<uint64_t>(s) != ATBUS_COMPACT_DATA_HEAD_SIZE + router_size * sizeof(uint64_t) + content_size) {
+                    return EN_ATBUS_ERR_UNPACK;
+                }
+
+                m.head.cmd        = static_cast<ATBUS_PROTOCOL_CMD>(in[1]);
+                m.head.type       = static_cast<int32_t>(compact_read_u32(in + 4));
+                m.head.ret        = static_cast<int32_t>(compact_read_u32(in + 8));
+                m.head.sequence   = compact_read_u64(in + 16);
+                m.head.src_bus_id = compact_read_u64(in + 24);
+
+                protocol::forward_data *fwd = m.body.make_body(m.body.forward);
+                if (NULL == fwd) {
+                    return EN_ATBUS_ERR_MALLOC;
+                }
+
+                fwd->flags = static_cast<int>(compact_read_u32(in + 12));
+                fwd->from  = compact_read_u64(in + 32);
+                fwd->to    = compact_read_u64(in + 40);
+                in += ATBUS_COMPACT_DATA_HEAD_SIZE;
+
+                fwd->router.resize(static_cast<size_t>(router_size));
+                for (size_t i = 0; i < fwd->router.size(); ++i) {
+                    fwd->router[i] = compact_read_u64(in);
+                    in += sizeof(uint64_t);
+                }
+
+                fwd->content.ptr  = in;
+                fwd->content.size = static_cast<size_t>(content_size);
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+        } // namespace fn
+    }     // namespace detail
+} // namespace atbus
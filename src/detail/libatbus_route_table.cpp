@@ -0,0 +1,364 @@
+﻿#include <set>
+
+#include "detail/libatbus_route_table.h"
+
+namespace atbus {
+    namespace detail {
+        static inline route_table::bus_id_t route_table_range_min(route_table::bus_id_t id, uint32_t mask) {
+            if (mask >= sizeof(route_table::bus_id_t) * 8) {
+                return 0;
+            }
+
+            route_table::bus_id_t maskv = (static_cast<route_table::bus_id_t>(1) << mask) - 1;
+            return id & (~maskv);
+        }
+
+        static inline route_table::bus_id_t route_table_range_max(route_table::bus_id_t id, uint32_t mask) {
+            if (mask >= sizeof(route_table::bus_id_t) * 8) {
+                return ~static_cast<route_table::bus_id_t>(0);
+            }
+
+            route_table::bus_id_t maskv = (static_cast<route_table::bus_id_t>(1) << mask) - 1;
+            return id | maskv;
+        }
+
+        static bool route_table_has_in_range(const std::map<std::string, std::set<route_table::bus_id_t> > &index, const std::string &key,
+                                             route_table::bus_id_t min_id, route_table::bus_id_t max_id) {
+            std::map<std::string, std::set<route_table::bus_id_t> >::const_iterator iter = index.find(key);
+            if (iter == index.end()) {
+                return false;
+            }
+
+            std::set<route_table::bus_id_t>::const_iterator id_iter = iter->second.lower_bound(min_id);
+            return id_iter != iter->second.end() && *id_iter <= max_id;
+        }
+
+        route_table::entry_t::entry_t() : bus_id(0), children_mask(0), source(0), version(0), removed(false) {}
+
+        route_table::scope_t::scope_t() : id(0), children_mask(0), inside(false) {}
+
+        route_table::scope_t::scope_t(bus_id_t i, uint32_t m, bool in) : id(i), children_mask(m), inside(in) {}
+
+        bool route_table::scope_t::contains(bus_id_t tid) const {
+            return inside == (route_table_range_min(tid, children_mask) == route_table_range_min(id, children_mask));
+        }
+
+        route_table::peer_t::peer_t() : sent_version(0), recv_version(0), checked_version(0) {}
+
+        route_table::route_table() : self_id_(0), version_(0), purged_version_(0), live_count_(0) {}
+
+        void route_table::reset(bus_id_t self_id) {
+            self_id_        = self_id;
+            version_        = 0;
+            purged_version_ = 0;
+            live_count_     = 0;
+            entries_.clear();
+            peers_.clear();
+            range_index_.clear();
+            mask_counter_.clear();
+            version_index_.clear();
+            type_index_.clear();
+            tag_index_.clear();
+        }
+
+        bool route_table::update_direct(bus_id_t id, uint32_t children_mask, const std::string &hostname,
+                                        const std::list<std::string> &listen, const std::string &type_name,
+                                        const std::vector<std::string> &tags) {
+            // 直连时不一定知道对端的监听地址(比如对端主动连接过来)，这时候保留已知的地址
+            entry_map_t::const_iterator iter = entries_.find(id);
+            if (listen.empty() && iter != entries_.end() && !iter->second.removed) {
+                // set_entry会修改记录，所以这里需要复制一份
+                std::vector<std::string> listen_vec = iter->second.listen;
+                return set_entry(id, children_mask, id, hostname, listen_vec, type_name, tags);
+            }
+
+            std::vector<std::string> listen_vec(listen.begin(), listen.end());
+            return set_entry(id, children_mask, id, hostname, listen_vec, type_name, tags);
+        }
+
+        size_t route_table::remove_source(bus_id_t source) {
+            size_t ret = 0;
+            for (entry_map_t::iterator iter = entries_.begin(); iter != entries_.end(); ++iter) {
+                if (!iter->second.removed && iter->second.source == source && iter->first != self_id_) {
+                    remove_entry(iter->second);
+                    ++ret;
+                }
+            }
+
+            peers_.erase(source);
+            return ret;
+        }
+
+        size_t route_table::apply(const protocol::node_tree &tree, bus_id_t source, const scope_t &scope) {
+            size_t ret = 0;
+
+            // 全量同步时，来源于source但不在全量数据中的记录都要移除
+            if (0 == tree.base_version) {
+                std::set<bus_id_t> exists;
+                for (size_t i = 0; i < tree.nodes.size(); ++i) {
+                    if (!tree.nodes[i].removed) {
+                        exists.insert(tree.nodes[i].bus_id);
+                    }
+                }
+
+                for (entry_map_t::iterator iter = entries_.begin(); iter != entries_.end(); ++iter) {
+                    entry_t &ent = iter->second;
+                    if (ent.removed || ent.source != source || ent.bus_id == source || exists.end() != exists.find(ent.bus_id)) {
+                        continue;
+                    }
+
+                    remove_entry(ent);
+                    ++ret;
+                }
+            }
+
+            std::vector<std::string> listen;
+            for (size_t i = 0; i < tree.nodes.size(); ++i) {
+                const protocol::node_data &node = tree.nodes[i];
+                if (node.bus_id == self_id_ || !scope.contains(node.bus_id)) {
+                    continue;
+                }
+
+                entry_map_t::iterator iter = entries_.find(node.bus_id);
+                if (node.removed) {
+                    if (iter != entries_.end() && !iter->second.removed && iter->second.source == source) {
+                        remove_entry(iter->second);
+                        ++ret;
+                    }
+                    continue;
+                }
+
+                // 其他来源的有效记录(包括直连节点)优先
+                if (iter != entries_.end() && !iter->second.removed && iter->second.source != source) {
+                    continue;
+                }
+
+                listen.clear();
+                listen.reserve(node.channels.size());
+                for (size_t j = 0; j < node.channels.size(); ++j) {
+                    listen.push_back(node.channels[j].address);
+                }
+
+                if (set_entry(node.bus_id, static_cast<uint32_t>(node.children_id_mask), source, node.hostname, listen, node.type_name,
+                              node.tags)) {
+                    ++ret;
+                }
+            }
+
+            return ret;
+        }
+
+        size_t route_table::make_delta(uint64_t since, const scope_t &scope, protocol::node_tree &out, uint64_t checked) const {
+            if (since > version_ || (0 != since && since < purged_version_)) {
+                since   = 0;
+                checked = 0;
+            }
+
+            if (checked < since) {
+                checked = since;
+            }
+
+            out.nodes.clear();
+            out.version      = version_;
+            out.base_version = since;
+
+            for (version_index_t::const_iterator iter = version_index_.upper_bound(checked); iter != version_index_.end(); ++iter) {
+                entry_map_t::const_iterator ent_iter = entries_.find(iter->second);
+                if (ent_iter == entries_.end()) {
+                    continue;
+                }
+
+                const entry_t &ent = ent_iter->second;
+                if (!scope.contains(ent.bus_id)) {
+                    continue;
+                }
+
+                // 全量数据不需要墓碑
+                if (ent.removed && 0 == since) {
+                    continue;
+                }
+
+                out.nodes.push_back(protocol::node_data());
+                protocol::node_data &node = out.nodes.back();
+                node.bus_id               = ent.bus_id;
+                node.removed              = ent.removed;
+                if (!ent.removed) {
+                    node.children_id_mask = ent.children_mask;
+                    node.hostname         = ent.hostname;
+                    node.type_name        = ent.type_name;
+                    node.tags             = ent.tags;
+                    node.channels.resize(ent.listen.size());
+                    for (size_t i = 0; i < ent.listen.size(); ++i) {
+                        node.channels[i].address = ent.listen[i];
+                    }
+                }
+            }
+
+            return out.nodes.size();
+        }
+
+        const route_table::entry_t *route_table::find(bus_id_t tid) const {
+            for (std::map<uint32_t, size_t>::const_iterator iter = mask_counter_.begin(); iter != mask_counter_.end(); ++iter) {
+                range_index_t::const_iterator index_iter = range_index_.find(std::make_pair(iter->first, route_table_range_min(tid, iter->first)));
+                if (index_iter == range_index_.end()) {
+                    continue;
+                }
+
+                entry_map_t::const_iterator ent_iter = entries_.find(index_iter->second);
+                if (ent_iter != entries_.end() && !ent_iter->second.removed) {
+                    return &ent_iter->second;
+                }
+            }
+
+            return NULL;
+        }
+
+        const route_table::entry_t *route_table::get(bus_id_t id) const {
+            entry_map_t::const_iterator iter = entries_.find(id);
+            if (iter == entries_.end()) {
+                return NULL;
+            }
+
+            return &iter->second;
+        }
+
+        bool route_table::has_subscriber(bus_id_t id, uint32_t children_mask, const std::string &type_name, const std::string &tag) const {
+            bus_id_t min_id = route_table_range_min(id, children_mask);
+            bus_id_t max_id = route_table_range_max(id, children_mask);
+
+            if (!type_name.empty() && !route_table_has_in_range(type_index_, type_name, min_id, max_id)) {
+                return false;
+            }
+
+            if (!tag.empty() && !route_table_has_in_range(tag_index_, tag, min_id, max_id)) {
+                return false;
+            }
+
+            return true;
+        }
+
+        size_t route_table::purge(uint64_t version) {
+            size_t ret = 0;
+            for (entry_map_t::iterator iter = entries_.begin(); iter != entries_.end();) {
+                if (iter->second.removed && iter->second.version <= version) {
+                    if (iter->second.version > purged_version_) {
+                        purged_version_ = iter->second.version;
+                    }
+                    version_index_.erase(iter->second.version);
+                    entries_.erase(iter++);
+                    ++ret;
+                } else {
+                    ++iter;
+                }
+            }
+
+            return ret;
+        }
+
+        route_table::peer_t &route_table::mutable_peer(bus_id_t id) { return peers_[id]; }
+
+        const route_table::peer_t *route_table::get_peer(bus_id_t id) const {
+            peer_map_t::const_iterator iter = peers_.find(id);
+            if (iter == peers_.end()) {
+                return NULL;
+            }
+
+            return &iter->second;
+        }
+
+        bool route_table::set_entry(bus_id_t id, uint32_t children_mask, bus_id_t source, const std::string &hostname,
+                                    const std::vector<std::string> &listen, const std::string &type_name,
+                                    const std::vector<std::string> &tags) {
+            entry_t &ent = entries_[id];
+            if (0 != ent.version && !ent.removed && ent.children_mask == children_mask && ent.source == source && ent.hostname == hostname &&
+                ent.listen == listen && ent.type_name == type_name && ent.tags == tags) {
+                return false;
+            }
+
+            if (0 != ent.version && !ent.removed) {
+                remove_index(ent);
+            } else {
+                ++live_count_;
+            }
+            version_index_.erase(ent.version);
+
+            ent.bus_id        = id;
+            ent.children_mask = children_mask;
+            ent.source        = source;
+            ent.version       = ++version_;
+            ent.removed       = false;
+
+            version_index_[ent.version] = id;
+            ent.hostname      = hostname;
+            ent.listen        = listen;
+            ent.type_name     = type_name;
+            ent.tags          = tags;
+
+            add_index(ent);
+            return true;
+        }
+
+        void route_table::remove_entry(entry_t &ent) {
+            remove_index(ent);
+            --live_count_;
+
+            version_index_.erase(ent.version);
+            ent.removed = true;
+            ent.version = ++version_;
+
+            version_index_[ent.version] = ent.bus_id;
+            ent.hostname.clear();
+            ent.listen.clear();
+            ent.type_name.clear();
+            ent.tags.clear();
+        }
+
+        void route_table::add_index(const entry_t &ent) {
+            range_index_[std::make_pair(ent.children_mask, route_table_range_min(ent.bus_id, ent.children_mask))] = ent.bus_id;
+            ++mask_counter_[ent.children_mask];
+
+            if (!ent.type_name.empty()) {
+                type_index_[ent.type_name].insert(ent.bus_id);
+            }
+            for (size_t i = 0; i < ent.tags.size(); ++i) {
+                tag_index_[ent.tags[i]].insert(ent.bus_id);
+            }
+        }
+
+        void route_table::remove_index(const entry_t &ent) {
+            range_index_t::iterator iter = range_index_.find(std::make_pair(ent.children_mask, route_table_range_min(ent.bus_id, ent.children_mask)));
+            if (iter != range_index_.end() && iter->second == ent.bus_id) {
+                range_index_.erase(iter);
+            }
+
+            std::map<uint32_t, size_t>::iterator counter_iter = mask_counter_.find(ent.children_mask);
+            if (counter_iter != mask_counter_.end()) {
+                if (counter_iter->second <= 1) {
+                    mask_counter_.erase(counter_iter);
+                } else {
+                    --counter_iter->second;
+                }
+            }
+
+            if (!ent.type_name.empty()) {
+                subscriber_index_t::iterator type_iter = type_index_.find(ent.type_name);
+                if (type_iter != type_index_.end()) {
+                    type_iter->second.erase(ent.bus_id);
+                    if (type_iter->second.empty()) {
+                        type_index_.erase(type_iter);
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < ent.tags.size(); ++i) {
+                subscriber_index_t::iterator tag_iter = tag_index_.find(ent.tags[i]);
+                if (tag_iter != tag_index_.end()) {
+                    tag_iter->second.erase(ent.bus_id);
+                    if (tag_iter->second.empty()) {
+                        tag_index_.erase(tag_iter);
+                    }
+                }
+            }
+        }
+    } // namespace detail
+} // namespace atbus
@@ -0,0 +1,280 @@
+﻿#include <algorithm>
+
+#include "detail/libatbus_service_index.h"
+
+namespace atbus {
+    namespace detail {
+        static inline uint64_t service_index_mix(uint64_t x) {
+            // splitmix64的混淆函数，分布足够均匀且不需要额外的状态
+            x += 0x9E3779B97F4A7C15ULL;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+        service_index::group_t::group_t() : round_robin(0), ring_dirty(false) {}
+
+        service_index::endpoint_info_t::endpoint_info_t() : outstanding(0) {}
+
+        service_index::service_index() : random_seed_(0x2545F4914F6CDD1DULL) {}
+
+        uint64_t service_index::hash_routing_key(const void *data, size_t sz) {
+            // FNV-1a，短key的分布靠后面的混淆保证
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+            uint64_t ret               = 0xCBF29CE484222325ULL;
+            for (size_t i = 0; i < sz; ++i) {
+                ret ^= bytes[i];
+                ret *= 0x100000001B3ULL;
+            }
+
+            return service_index_mix(ret);
+        }
+
+        service_index::bus_id_t service_index::select_by_key(const member_list_t &candidates, uint64_t key) {
+            bus_id_t ret        = 0;
+            uint64_t max_weight = 0;
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                uint64_t weight = service_index_mix(service_index_mix(static_cast<uint64_t>(candidates[i])) ^ key);
+                if (0 == ret || weight > max_weight) {
+                    ret        = candidates[i];
+                    max_weight = weight;
+                }
+            }
+
+            return ret;
+        }
+
+        void service_index::reset() {
+            types_.clear();
+            endpoints_.clear();
+        }
+
+        bool service_index::add(bus_id_t id, const std::string &type_name, const std::vector<std::string> &tags) {
+            if (0 == id || (type_name.empty() && tags.empty())) {
+                return remove(id);
+            }
+
+            std::map<bus_id_t, endpoint_info_t>::iterator iter = endpoints_.find(id);
+            uint64_t outstanding                                = 0;
+            if (iter != endpoints_.end()) {
+                if (iter->second.type_name == type_name && iter->second.tags == tags) {
+                    return false;
+                }
+
+                outstanding = iter->second.outstanding;
+                remove(id);
+            }
+
+            endpoint_info_t &info = endpoints_[id];
+            info.type_name        = type_name;
+            info.tags             = tags;
+            info.outstanding      = outstanding;
+
+            if (!type_name.empty()) {
+                add_member(*mutable_group(type_name, std::string()), id, outstanding);
+            }
+
+            for (size_t i = 0; i < tags.size(); ++i) {
+                // 重复的tag只索引一次
+                if (std::find(tags.begin(), tags.begin() + i, tags[i]) != tags.begin() + i) {
+                    continue;
+                }
+
+                if (!type_name.empty()) {
+                    add_member(*mutable_group(type_name, tags[i]), id, outstanding);
+                }
+                add_member(*mutable_group(std::string(), tags[i]), id, outstanding);
+            }
+
+            return true;
+        }
+
+        bool service_index::remove(bus_id_t id) {
+            std::map<bus_id_t, endpoint_info_t>::iterator iter = endpoints_.find(id);
+            if (iter == endpoints_.end()) {
+                return false;
+            }
+
+            const endpoint_info_t &info = iter->second;
+            if (!info.type_name.empty()) {
+                remove_member(*mutable_group(info.type_name, std::string()), id, info.outstanding);
+            }
+
+            for (size_t i = 0; i < info.tags.size(); ++i) {
+                if (std::find(info.tags.begin(), info.tags.begin() + i, info.tags[i]) != info.tags.begin() + i) {
+                    continue;
+                }
+
+                if (!info.type_name.empty()) {
+                    remove_member(*mutable_group(info.type_name, info.tags[i]), id, info.outstanding);
+                }
+                remove_member(*mutable_group(std::string(), info.tags[i]), id, info.outstanding);
+            }
+
+            endpoints_.erase(iter);
+            return true;
+        }
+
+        service_index::bus_id_t service_index::select(const std::string &type_name, const std::string &tag, int mode, uint64_t key) {
+            if (type_name.empty() && tag.empty()) {
+                return 0;
+            }
+
+            group_t *group = const_cast<group_t *>(get_group(type_name, tag));
+            if (NULL == group || group->members.empty()) {
+                return 0;
+            }
+
+            switch (mode) {
+            case select_mode_t::EN_SSM_LEAST_OUTSTANDING: {
+                return group->load_index.begin()->second;
+            }
+            case select_mode_t::EN_SSM_CONSISTENT_HASH: {
+                if (group->ring_dirty) {
+                    rebuild_ring(*group);
+                }
+
+                uint64_t hash_key = service_index_mix(key);
+                std::vector<std::pair<uint64_t, bus_id_t> >::const_iterator iter =
+                    std::lower_bound(group->ring.begin(), group->ring.end(), std::make_pair(hash_key, static_cast<bus_id_t>(0)));
+                if (iter == group->ring.end()) {
+                    iter = group->ring.begin();
+                }
+                return iter->second;
+            }
+            case select_mode_t::EN_SSM_RANDOM: {
+                // xorshift64
+                random_seed_ ^= random_seed_ << 13;
+                random_seed_ ^= random_seed_ >> 7;
+                random_seed_ ^= random_seed_ << 17;
+                return group->members[static_cast<size_t>(random_seed_ % group->members.size())];
+            }
+            default: {
+                if (group->round_robin >= group->members.size()) {
+                    group->round_robin = 0;
+                }
+                return group->members[group->round_robin++];
+            }
+            }
+        }
+
+        const service_index::member_list_t *service_index::get_members(const std::string &type_name, const std::string &tag) const {
+            const group_t *group = get_group(type_name, tag);
+            if (NULL == group) {
+                return NULL;
+            }
+
+            return &group->members;
+        }
+
+        void service_index::add_outstanding(bus_id_t id, int64_t delta) {
+            std::map<bus_id_t, endpoint_info_t>::iterator iter = endpoints_.find(id);
+            if (iter == endpoints_.end() || 0 == delta) {
+                return;
+            }
+
+            endpoint_info_t &info = iter->second;
+            uint64_t old_val      = info.outstanding;
+            if (delta < 0 && static_cast<uint64_t>(-delta) > old_val) {
+                info.outstanding = 0;
+            } else {
+                info.outstanding = static_cast<uint64_t>(static_cast<int64_t>(old_val) + delta);
+            }
+
+            if (old_val == info.outstanding) {
+                return;
+            }
+
+            std::pair<uint64_t, bus_id_t> old_key(old_val, id);
+            std::pair<uint64_t, bus_id_t> new_key(info.outstanding, id);
+            if (!info.type_name.empty()) {
+                group_t *group = mutable_group(info.type_name, std::string());
+                group->load_index.erase(old_key);
+                group->load_index.insert(new_key);
+            }
+
+            for (size_t i = 0; i < info.tags.size(); ++i) {
+                if (!info.type_name.empty()) {
+                    group_t *group = mutable_group(info.type_name, info.tags[i]);
+                    group->load_index.erase(old_key);
+                    group->load_index.insert(new_key);
+                }
+
+                group_t *group = mutable_group(std::string(), info.tags[i]);
+                group->load_index.erase(old_key);
+                group->load_index.insert(new_key);
+            }
+        }
+
+        uint64_t service_index::get_outstanding(bus_id_t id) const {
+            std::map<bus_id_t, endpoint_info_t>::const_iterator iter = endpoints_.find(id);
+            if (iter == endpoints_.end()) {
+                return 0;
+            }
+
+            return iter->second.outstanding;
+        }
+
+        service_index::group_t *service_index::mutable_group(const std::string &type_name, const std::string &tag) {
+            type_group_t &type_group = types_[type_name];
+            if (tag.empty()) {
+                return &type_group.all;
+            }
+
+            return &type_group.by_tag[tag];
+        }
+
+        const service_index::group_t *service_index::get_group(const std::string &type_name, const std::string &tag) const {
+            type_map_t::const_iterator type_iter = types_.find(type_name);
+            if (type_iter == types_.end()) {
+                return NULL;
+            }
+
+            if (tag.empty()) {
+                return &type_iter->second.all;
+            }
+
+            std::map<std::string, group_t>::const_iterator tag_iter = type_iter->second.by_tag.find(tag);
+            if (tag_iter == type_iter->second.by_tag.end()) {
+                return NULL;
+            }
+
+            return &tag_iter->second;
+        }
+
+        void service_index::add_member(group_t &group, bus_id_t id, uint64_t outstanding) {
+            group.members.push_back(id);
+            group.load_index.insert(std::make_pair(outstanding, id));
+            group.ring_dirty = true;
+        }
+
+        void service_index::remove_member(group_t &group, bus_id_t id, uint64_t outstanding) {
+            member_list_t::iterator iter = std::find(group.members.begin(), group.members.end(), id);
+            if (iter != group.members.end()) {
+                // 保持顺序，这样轮询的位置不会跳过其他对端
+                size_t index = static_cast<size_t>(iter - group.members.begin());
+                group.members.erase(iter);
+                if (group.round_robin > index) {
+                    --group.round_robin;
+                }
+            }
+
+            group.load_index.erase(std::make_pair(outstanding, id));
+            group.ring_dirty = true;
+        }
+
+        void service_index::rebuild_ring(group_t &group) {
+            group.ring.clear();
+            group.ring.reserve(group.members.size() * ATBUS_MACRO_SERVICE_VIRTUAL_NODES);
+            for (size_t i = 0; i < group.members.size(); ++i) {
+                uint64_t seed = service_index_mix(static_cast<uint64_t>(group.members[i]));
+                for (uint64_t j = 0; j < ATBUS_MACRO_SERVICE_VIRTUAL_NODES; ++j) {
+                    group.ring.push_back(std::make_pair(service_index_mix(seed + j), group.members[i]));
+                }
+            }
+
+            std::sort(group.ring.begin(), group.ring.end());
+            group.ring_dirty = false;
+        }
+    } // namespace detail
+} // namespace atbus
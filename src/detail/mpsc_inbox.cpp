@@ -0,0 +1,39 @@
+﻿#include "detail/mpsc_inbox.h"
+
+namespace atbus {
+    namespace detail {
+        mpsc_inbox::mpsc_inbox() { head_.store(0); }
+
+        bool mpsc_inbox::push(node_t *n) {
+            uintptr_t old_head = head_.load(util::lock::memory_order_relaxed);
+            do {
+                n->next = reinterpret_cast<node_t *>(old_head);
+                // 节点的数据必须在节点对消费者可见之前写完
+            } while (!head_.compare_exchange_weak(old_head, reinterpret_cast<uintptr_t>(n), util::lock::memory_order_release,
+                                                  util::lock::memory_order_relaxed));
+
+            return 0 == old_head;
+        }
+
+        mpsc_inbox::node_t *mpsc_inbox::pop_all() {
+            if (0 == head_.load(util::lock::memory_order_relaxed)) {
+                return NULL;
+            }
+
+            node_t *n = reinterpret_cast<node_t *>(head_.exchange(0, util::lock::memory_order_acquire));
+
+            // 链表是后进先出的，反转成push顺序
+            node_t *ret = NULL;
+            while (NULL != n) {
+                node_t *next = n->next;
+                n->next      = ret;
+                ret          = n;
+                n            = next;
+            }
+
+            return ret;
+        }
+
+        bool mpsc_inbox::empty() const { return 0 == head_.load(util::lock::memory_order_acquire); }
+    } // namespace detail
+} // namespace atbus
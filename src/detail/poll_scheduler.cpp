@@ -0,0 +1,117 @@
+﻿#include <limits>
+
+#include "detail/poll_scheduler.h"
+
+namespace atbus {
+    namespace detail {
+        poll_scheduler::poll_scheduler() : quantum_(0), max_backoff_(0), has_removed_(false) {}
+
+        void poll_scheduler::reset(size_t quantum, size_t max_backoff) {
+            channels_.clear();
+            quantum_     = quantum;
+            max_backoff_ = max_backoff;
+            has_removed_ = false;
+        }
+
+        void poll_scheduler::add(void *data) {
+            if (NULL == data) {
+                return;
+            }
+
+            channel_t ch;
+            ch.data        = data;
+            ch.idle_rounds = 0;
+            ch.skip_left   = 0;
+            ch.deficit     = 0;
+            channels_.push_back(ch);
+        }
+
+        bool poll_scheduler::remove(void *data) {
+            if (NULL == data) {
+                return false;
+            }
+
+            for (size_t i = 0; i < channels_.size(); ++i) {
+                if (channels_[i].data == data) {
+                    channels_[i].data = NULL;
+                    has_removed_      = true;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void poll_scheduler::compact() {
+            if (!has_removed_) {
+                return;
+            }
+
+            size_t n = 0;
+            for (size_t i = 0; i < channels_.size(); ++i) {
+                if (NULL != channels_[i].data) {
+                    if (n != i) {
+                        channels_[n] = channels_[i];
+                    }
+                    ++n;
+                }
+            }
+            channels_.resize(n);
+            has_removed_ = false;
+        }
+
+        bool poll_scheduler::check(size_t idx) {
+            channel_t &ch = channels_[idx];
+            if (NULL == ch.data) {
+                return false;
+            }
+
+            if (ch.skip_left > 0) {
+                --ch.skip_left;
+                return false;
+            }
+
+            return true;
+        }
+
+        void poll_scheduler::on_idle(size_t idx) {
+            channel_t &ch = channels_[idx];
+            ch.deficit    = 0;
+            if (0 == max_backoff_) {
+                return;
+            }
+
+            if (ch.idle_rounds < MAX_BACKOFF_SHIFT) {
+                ++ch.idle_rounds;
+            }
+
+            // 第1次空闲不跳过，之后跳过1、3、7...轮
+            size_t skip  = (static_cast<size_t>(1) << (ch.idle_rounds - 1)) - 1;
+            ch.skip_left = skip < max_backoff_ ? skip : max_backoff_;
+        }
+
+        size_t poll_scheduler::grant(size_t idx) {
+            channel_t &ch  = channels_[idx];
+            ch.idle_rounds = 0;
+            ch.skip_left   = 0;
+            if (0 == quantum_) {
+                return std::numeric_limits<size_t>::max();
+            }
+
+            ch.deficit += static_cast<int64_t>(quantum_);
+            return ch.deficit > 0 ? static_cast<size_t>(ch.deficit) : 0;
+        }
+
+        void poll_scheduler::consume(size_t idx, size_t bytes, bool drained) {
+            channel_t &ch = channels_[idx];
+            if (0 == quantum_ || NULL == ch.data) {
+                return;
+            }
+
+            ch.deficit -= static_cast<int64_t>(bytes);
+            if (drained && ch.deficit > 0) {
+                ch.deficit = 0;
+            }
+        }
+    } // namespace detail
+} // namespace atbus
@@ -0,0 +1,198 @@
+﻿#include <cstring>
+
+#include "detail/self_msg_ring.h"
+
+namespace atbus {
+    namespace detail {
+        namespace {
+            inline size_t self_msg_ring_align(size_t len) {
+                return (len + self_msg_ring::ALIGN_SIZE - 1) & ~static_cast<size_t>(self_msg_ring::ALIGN_SIZE - 1);
+            }
+        } // namespace
+
+        self_msg_ring::self_msg_ring() : head_(0), tail_(0), wrap_end_(0), count_(0), peak_used_(0), reading_(false) {}
+
+        void self_msg_ring::reset() {
+            buffer_t().swap(buffer_);
+            buffer_t().swap(reading_buffer_);
+            head_      = 0;
+            tail_      = 0;
+            wrap_end_  = 0;
+            count_     = 0;
+            peak_used_ = 0;
+            reading_   = false;
+        }
+
+        void self_msg_ring::push(uint32_t type, const segment_t *segments, size_t count) {
+            size_t data_len = 0;
+            for (size_t i = 0; i < count; ++i) {
+                data_len += segments[i].size;
+            }
+
+            size_t len        = self_msg_ring_align(sizeof(record_t) + sizeof(size_t) * count + data_len);
+            record_t *r       = reinterpret_cast<record_t *>(alloc(len));
+            r->type           = type;
+            r->segment_count  = static_cast<uint32_t>(count);
+            r->length         = len;
+            size_t *sizes     = reinterpret_cast<size_t *>(r + 1);
+            unsigned char *pd = reinterpret_cast<unsigned char *>(sizes + count);
+            for (size_t i = 0; i < count; ++i) {
+                sizes[i] = segments[i].size;
+                if (segments[i].size > 0) {
+                    memcpy(pd, segments[i].ptr, segments[i].size);
+                    pd += segments[i].size;
+                }
+            }
+
+            ++count_;
+            size_t used = used_size();
+            if (used > peak_used_) {
+                peak_used_ = used;
+            }
+        }
+
+        const self_msg_ring::record_t *self_msg_ring::front() {
+            if (0 == count_) {
+                return NULL;
+            }
+
+            reading_ = true;
+            return reinterpret_cast<const record_t *>(&buffer_[head_]);
+        }
+
+        void self_msg_ring::pop_front() {
+            reading_ = false;
+            if (!reading_buffer_.empty()) {
+                buffer_t().swap(reading_buffer_);
+            }
+
+            if (0 == count_) {
+                return;
+            }
+
+            head_ += reinterpret_cast<const record_t *>(&buffer_[head_])->length;
+            --count_;
+
+            if (0 == count_) {
+                head_     = 0;
+                tail_     = 0;
+                wrap_end_ = 0;
+                shrink();
+            } else if (0 != wrap_end_ && head_ >= wrap_end_) {
+                head_     = 0;
+                wrap_end_ = 0;
+            }
+        }
+
+        void self_msg_ring::get_segments(const record_t &r, segment_t *out) {
+            const size_t *sizes     = r.get_segment_sizes();
+            const unsigned char *pd = r.get_data();
+            for (uint32_t i = 0; i < r.segment_count; ++i) {
+                out[i].ptr  = pd;
+                out[i].size = sizes[i];
+                pd += sizes[i];
+            }
+        }
+
+        unsigned char *self_msg_ring::alloc(size_t len) {
+            if (0 == count_) {
+                head_     = 0;
+                tail_     = 0;
+                wrap_end_ = 0;
+            }
+
+            if (0 == wrap_end_) {
+                // 数据在[head_, tail_)，优先写在后面，不够时绕回开头
+                if (buffer_.size() - tail_ >= len) {
+                    unsigned char *ret = &buffer_[tail_];
+                    tail_ += len;
+                    return ret;
+                }
+
+                if (count_ > 0 && head_ >= len) {
+                    wrap_end_ = tail_;
+                    tail_     = len;
+                    return &buffer_[0];
+                }
+            } else if (head_ - tail_ >= len) {
+                // 数据在[head_, wrap_end_)和[0, tail_)
+                unsigned char *ret = &buffer_[tail_];
+                tail_ += len;
+                return ret;
+            }
+
+            grow(len);
+            unsigned char *ret = &buffer_[tail_];
+            tail_ += len;
+            return ret;
+        }
+
+        void self_msg_ring::grow(size_t need) {
+            size_t used = used_size();
+            size_t cap  = buffer_.size() < MIN_BUFFER_SIZE ? static_cast<size_t>(MIN_BUFFER_SIZE) : buffer_.size();
+            while (cap < used + need) {
+                cap <<= 1;
+            }
+            if (cap == buffer_.size()) {
+                cap <<= 1;
+            }
+
+            relocate(cap);
+        }
+
+        void self_msg_ring::shrink() {
+            // 按一轮的峰值而不是当前的已用空间判断，每批都会取空的用法不会反复扩容和缩容
+            size_t cap = buffer_.size();
+            while (cap > MIN_BUFFER_SIZE && peak_used_ * SHRINK_RATIO < cap) {
+                cap >>= 1;
+            }
+            if (cap < MIN_BUFFER_SIZE) {
+                cap = MIN_BUFFER_SIZE;
+            }
+            peak_used_ = 0;
+
+            if (cap < buffer_.size()) {
+                relocate(cap);
+            }
+        }
+
+        void self_msg_ring::relocate(size_t cap) {
+            size_t used = used_size();
+            buffer_t new_buffer;
+            new_buffer.resize(cap);
+            if (used > 0) {
+                copy_to(&new_buffer[0]);
+            }
+
+            // 正在读取的记录还被回调引用，旧缓冲区要保留到pop_front
+            if (reading_ && reading_buffer_.empty()) {
+                buffer_.swap(reading_buffer_);
+            }
+            buffer_.swap(new_buffer);
+
+            head_     = 0;
+            tail_     = used;
+            wrap_end_ = 0;
+        }
+
+        size_t self_msg_ring::used_size() const {
+            if (0 == count_) {
+                return 0;
+            }
+
+            return (0 == wrap_end_) ? (tail_ - head_) : (wrap_end_ - head_ + tail_);
+        }
+
+        void self_msg_ring::copy_to(unsigned char *dst) const {
+            if (0 == wrap_end_) {
+                memcpy(dst, &buffer_[head_], tail_ - head_);
+                return;
+            }
+
+            memcpy(dst, &buffer_[head_], wrap_end_ - head_);
+            if (tail_ > 0) {
+                memcpy(dst + wrap_end_ - head_, &buffer_[0], tail_);
+            }
+        }
+    } // namespace detail
+} // namespace atbus
@@ -0,0 +1,295 @@
+﻿#include "detail/timer_wheel.h"
+
+namespace atbus {
+    namespace detail {
+        timer_wheel::node_t::node_t() : data(NULL), prev_(NULL), next_(NULL), owner_(NULL), expire_(0), level_(-1) {}
+
+        timer_wheel::node_t::~node_t() {
+            if (NULL != owner_) {
+                owner_->cancel(*this);
+            }
+        }
+
+        timer_wheel::timer_wheel() : current_(0), size_(0), level0_size_(0) {
+            for (size_t i = 0; i < LEVEL0_SIZE; ++i) {
+                init_head(level0_[i]);
+            }
+
+            for (size_t i = 0; i < LEVELN_COUNT; ++i) {
+                for (size_t j = 0; j < LEVELN_SIZE; ++j) {
+                    init_head(leveln_[i][j]);
+                }
+            }
+
+            init_head(expired_);
+        }
+
+        timer_wheel::~timer_wheel() { reset(0); }
+
+        void timer_wheel::reset(uint64_t now) {
+            for (size_t i = 0; i < LEVEL0_SIZE; ++i) {
+                while (level0_[i].next_ != &level0_[i]) {
+                    cancel(*level0_[i].next_);
+                }
+            }
+
+            for (size_t i = 0; i < LEVELN_COUNT; ++i) {
+                for (size_t j = 0; j < LEVELN_SIZE; ++j) {
+                    while (leveln_[i][j].next_ != &leveln_[i][j]) {
+                        cancel(*leveln_[i][j].next_);
+                    }
+                }
+            }
+
+            while (expired_.next_ != &expired_) {
+                cancel(*expired_.next_);
+            }
+
+            current_ = now;
+        }
+
+        void timer_wheel::add(node_t &n, uint64_t expire) {
+            if (NULL != n.owner_) {
+                n.owner_->cancel(n);
+            }
+
+            n.owner_  = this;
+            n.expire_ = expire;
+            link(n);
+            ++size_;
+        }
+
+        void timer_wheel::cancel(node_t &n) {
+            if (this != n.owner_) {
+                return;
+            }
+
+            unlink(n);
+            n.owner_ = NULL;
+            --size_;
+        }
+
+        timer_wheel::node_t *timer_wheel::pop_expired(uint64_t now) {
+            if (expired_.next_ == &expired_ && now >= current_) {
+                advance(now);
+            }
+
+            if (expired_.next_ == &expired_) {
+                return NULL;
+            }
+
+            node_t *ret = expired_.next_;
+            cancel(*ret);
+            return ret;
+        }
+
+        void timer_wheel::for_each(foreach_fn_t fn, void *priv) {
+            if (NULL == fn) {
+                return;
+            }
+
+            for (size_t i = 0; i < LEVEL0_SIZE; ++i) {
+                for (node_t *iter = level0_[i].next_; iter != &level0_[i]; iter = iter->next_) {
+                    fn(*iter, priv);
+                }
+            }
+
+            for (size_t i = 0; i < LEVELN_COUNT; ++i) {
+                for (size_t j = 0; j < LEVELN_SIZE; ++j) {
+                    for (node_t *iter = leveln_[i][j].next_; iter != &leveln_[i][j]; iter = iter->next_) {
+                        fn(*iter, priv);
+                    }
+                }
+            }
+
+            for (node_t *iter = expired_.next_; iter != &expired_; iter = iter->next_) {
+                fn(*iter, priv);
+            }
+        }
+
+        void timer_wheel::for_each(const_foreach_fn_t fn, void *priv) const {
+            if (NULL == fn) {
+                return;
+            }
+
+            for (size_t i = 0; i < LEVEL0_SIZE; ++i) {
+                for (const node_t *iter = level0_[i].next_; iter != &level0_[i]; iter = iter->next_) {
+                    fn(*iter, priv);
+                }
+            }
+
+            for (size_t i = 0; i < LEVELN_COUNT; ++i) {
+                for (size_t j = 0; j < LEVELN_SIZE; ++j) {
+                    for (const node_t *iter = leveln_[i][j].next_; iter != &leveln_[i][j]; iter = iter->next_) {
+                        fn(*iter, priv);
+                    }
+                }
+            }
+
+            for (const node_t *iter = expired_.next_; iter != &expired_; iter = iter->next_) {
+                fn(*iter, priv);
+            }
+        }
+
+        void timer_wheel::link(node_t &n) {
+            uint64_t expire = n.expire_;
+            if (expire < current_) {
+                n.level_ = -1;
+                push_back(expired_, n);
+                return;
+            }
+
+            uint64_t delta = expire - current_;
+            if (delta < LEVEL0_SIZE) {
+                n.level_ = 0;
+                push_back(level0_[expire & (LEVEL0_SIZE - 1)], n);
+                ++level0_size_;
+                return;
+            }
+
+            // 超出范围的放在最后一层的最远的槽位，到时候再重新放置
+            if (delta >= (static_cast<uint64_t>(1) << TOTAL_BITS)) {
+                expire = current_ + (static_cast<uint64_t>(1) << TOTAL_BITS) - 1;
+                delta  = expire - current_;
+            }
+
+            for (int i = 0; i < LEVELN_COUNT; ++i) {
+                int shift = LEVEL0_BITS + LEVELN_BITS * i;
+                if (delta < (static_cast<uint64_t>(1) << (shift + LEVELN_BITS))) {
+                    n.level_ = i + 1;
+                    push_back(leveln_[i][(expire >> shift) & (LEVELN_SIZE - 1)], n);
+                    return;
+                }
+            }
+        }
+
+        void timer_wheel::unlink(node_t &n) {
+            if (NULL == n.next_) {
+                return;
+            }
+
+            n.prev_->next_ = n.next_;
+            n.next_->prev_ = n.prev_;
+            n.prev_        = NULL;
+            n.next_        = NULL;
+
+            if (0 == n.level_) {
+                --level0_size_;
+            }
+        }
+
+        void timer_wheel::advance(uint64_t now) {
+            // 跨度超过时间轮范围时，直接处理所有的定时器
+            if (now - current_ >= (static_cast<uint64_t>(1) << TOTAL_BITS)) {
+                expire_all(now);
+                return;
+            }
+
+            while (current_ <= now) {
+                size_t index = static_cast<size_t>(current_ & (LEVEL0_SIZE - 1));
+                if (0 == index) {
+                    for (int i = 0; i < LEVELN_COUNT; ++i) {
+                        size_t leveln_index = static_cast<size_t>((current_ >> (LEVEL0_BITS + LEVELN_BITS * i)) & (LEVELN_SIZE - 1));
+                        cascade(i, leveln_index);
+                        if (0 != leveln_index) {
+                            break;
+                        }
+                    }
+                }
+
+                // 第一层没有定时器时直接跳到下一次需要展开上层的时间点
+                if (0 == level0_size_) {
+                    uint64_t next_round = (current_ | (LEVEL0_SIZE - 1)) + 1;
+                    current_            = next_round <= now ? next_round : now + 1;
+                    continue;
+                }
+
+                node_t &head = level0_[index];
+                while (head.next_ != &head) {
+                    node_t &n = *head.next_;
+                    unlink(n);
+                    n.level_ = -1;
+                    push_back(expired_, n);
+                }
+
+                ++current_;
+            }
+        }
+
+        void timer_wheel::cascade(int level, size_t index) {
+            node_t &head = leveln_[level][index];
+            if (head.next_ == &head) {
+                return;
+            }
+
+            // 先摘下来再重新放置，重新放置时可能还会放回这个槽位
+            node_t tmp;
+            init_head(tmp);
+            tmp.next_        = head.next_;
+            tmp.prev_        = head.prev_;
+            tmp.next_->prev_ = &tmp;
+            tmp.prev_->next_ = &tmp;
+            init_head(head);
+
+            while (tmp.next_ != &tmp) {
+                node_t &n = *tmp.next_;
+                unlink(n);
+                link(n);
+            }
+
+            tmp.next_ = NULL;
+            tmp.prev_ = NULL;
+        }
+
+        void timer_wheel::expire_all(uint64_t now) {
+            node_t tmp;
+            init_head(tmp);
+
+            for (size_t i = 0; i < LEVEL0_SIZE; ++i) {
+                while (level0_[i].next_ != &level0_[i]) {
+                    node_t &n = *level0_[i].next_;
+                    unlink(n);
+                    n.level_ = -1;
+                    push_back(tmp, n);
+                }
+            }
+
+            for (size_t i = 0; i < LEVELN_COUNT; ++i) {
+                for (size_t j = 0; j < LEVELN_SIZE; ++j) {
+                    while (leveln_[i][j].next_ != &leveln_[i][j]) {
+                        node_t &n = *leveln_[i][j].next_;
+                        unlink(n);
+                        push_back(tmp, n);
+                    }
+                }
+            }
+
+            current_ = now + 1;
+            while (tmp.next_ != &tmp) {
+                node_t &n = *tmp.next_;
+                unlink(n);
+                if (n.expire_ <= now) {
+                    n.level_ = -1;
+                    push_back(expired_, n);
+                } else {
+                    link(n);
+                }
+            }
+
+            tmp.next_ = NULL;
+            tmp.prev_ = NULL;
+        }
+
+        void timer_wheel::init_head(node_t &head) {
+            head.prev_ = &head;
+            head.next_ = &head;
+        }
+
+        void timer_wheel::push_back(node_t &head, node_t &n) {
+            n.prev_            = head.prev_;
+            n.next_            = &head;
+            head.prev_->next_  = &n;
+            head.prev_         = &n;
+        }
+    } // namespace detail
+} // namespace atbus
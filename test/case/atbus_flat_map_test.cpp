@@ -0,0 +1,122 @@
+﻿#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <detail/flat_map.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_flat_map, insert_find_erase) {
+    atbus::detail::flat_map<uint64_t, int> m;
+    CASE_EXPECT_TRUE(m.empty());
+
+    m[30] = 3;
+    m[10] = 1;
+    CASE_EXPECT_TRUE(m.insert(std::make_pair(20, 2)).second);
+    CASE_EXPECT_FALSE(m.insert(std::make_pair(20, 4)).second);
+    CASE_EXPECT_EQ(3, m.size());
+
+    // 保持有序
+    int expect = 1;
+    for (atbus::detail::flat_map<uint64_t, int>::const_iterator iter = m.begin(); iter != m.end(); ++iter) {
+        CASE_EXPECT_EQ(expect * 10, iter->first);
+        CASE_EXPECT_EQ(expect, iter->second);
+        ++expect;
+    }
+    CASE_EXPECT_EQ(30, m.rbegin()->first);
+
+    CASE_EXPECT_TRUE(m.lower_bound(11) != m.end());
+    CASE_EXPECT_EQ(20, m.lower_bound(11)->first);
+    CASE_EXPECT_EQ(20, m.lower_bound(20)->first);
+    CASE_EXPECT_EQ(30, m.upper_bound(20)->first);
+    CASE_EXPECT_TRUE(m.lower_bound(31) == m.end());
+    CASE_EXPECT_TRUE(m.find(15) == m.end());
+    CASE_EXPECT_EQ(1, m.count(10));
+
+    CASE_EXPECT_EQ(1, m.erase(20));
+    CASE_EXPECT_EQ(0, m.erase(20));
+    m.erase(m.begin());
+    CASE_EXPECT_EQ(1, m.size());
+    CASE_EXPECT_EQ(3, m.begin()->second);
+
+    atbus::detail::flat_map<uint64_t, int> other;
+    other.swap(m);
+    CASE_EXPECT_TRUE(m.empty());
+    CASE_EXPECT_EQ(1, other.size());
+}
+
+namespace {
+    template <typename TMAP>
+    static size_t flat_map_test_find_children(TMAP &coll, const std::vector<uint64_t> &ids) {
+        // 和node::find_child一样，key 为子域上界
+        size_t ret = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            typename TMAP::iterator iter = coll.lower_bound(ids[i]);
+            if (iter != coll.end() && *iter->second == static_cast<int>(ids[i] >> 8)) {
+                ++ret;
+            }
+        }
+        return ret;
+    }
+
+    template <typename TMAP>
+    static size_t flat_map_test_iterate_children(const TMAP &coll) {
+        size_t ret = 0;
+        for (typename TMAP::const_iterator iter = coll.begin(); iter != coll.end(); ++iter) {
+            ret += static_cast<size_t>(*iter->second);
+        }
+        return ret;
+    }
+} // namespace
+
+CASE_TEST(atbus_flat_map, children_10k_benchmark) {
+    const size_t children_number = 10000;
+    const size_t loop_times      = 100;
+
+    std::map<uint64_t, std::shared_ptr<int> > tree_coll;
+    atbus::detail::flat_map<uint64_t, std::shared_ptr<int> > flat_coll;
+    std::vector<uint64_t> ids;
+    ids.reserve(children_number);
+
+    // 乱序插入，子节点的子域为8位
+    for (size_t i = 0; i < children_number; ++i) {
+        uint64_t child = static_cast<uint64_t>((i * 7919) % children_number);
+        std::shared_ptr<int> ep(new int(static_cast<int>(child)));
+        tree_coll[(child << 8) | 0xFF] = ep;
+        flat_coll[(child << 8) | 0xFF] = ep;
+        ids.push_back((child << 8) | static_cast<uint64_t>(i & 0xFF));
+    }
+    CASE_EXPECT_EQ(tree_coll.size(), flat_coll.size());
+
+    size_t tree_found = 0, flat_found = 0, tree_sum = 0, flat_sum = 0;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loop_times; ++i) {
+        tree_found += flat_map_test_find_children(tree_coll, ids);
+    }
+    std::chrono::steady_clock::time_point tree_find_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loop_times; ++i) {
+        flat_found += flat_map_test_find_children(flat_coll, ids);
+    }
+    std::chrono::steady_clock::time_point flat_find_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loop_times; ++i) {
+        tree_sum += flat_map_test_iterate_children(tree_coll);
+    }
+    std::chrono::steady_clock::time_point tree_iter_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loop_times; ++i) {
+        flat_sum += flat_map_test_iterate_children(flat_coll);
+    }
+    std::chrono::steady_clock::time_point flat_iter_end = std::chrono::steady_clock::now();
+
+    CASE_EXPECT_EQ(children_number * loop_times, tree_found);
+    CASE_EXPECT_EQ(tree_found, flat_found);
+    CASE_EXPECT_EQ(tree_sum, flat_sum);
+
+    CASE_MSG_INFO() << "find " << children_number << " children " << loop_times << " times: std::map "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(tree_find_end - begin).count() << "us, flat_map "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(flat_find_end - tree_find_end).count() << "us" << std::endl;
+    CASE_MSG_INFO() << "iterate " << children_number << " children " << loop_times << " times: std::map "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(tree_iter_end - flat_find_end).count() << "us, flat_map "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(flat_iter_end - tree_iter_end).count() << "us" << std::endl;
+}
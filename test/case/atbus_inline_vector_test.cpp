@@ -0,0 +1,45 @@
+﻿#include <cstring>
+
+#include <detail/inline_vector.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_inline_vector, inline_and_heap_storage) {
+    atbus::detail::inline_vector<uint64_t, 4> vec;
+    CASE_EXPECT_TRUE(vec.empty());
+    CASE_EXPECT_EQ(4, vec.capacity());
+
+    // inline storage
+    for (uint64_t v = 0; v < 4; ++v) {
+        vec.push_back(v + 100);
+    }
+    CASE_EXPECT_TRUE(vec.is_inline());
+    CASE_EXPECT_EQ(4, vec.size());
+    CASE_EXPECT_EQ(100, vec.front());
+    CASE_EXPECT_EQ(103, vec.back());
+
+    // grow to heap and keep data
+    vec.push_back(vec[0]);
+    CASE_EXPECT_FALSE(vec.is_inline());
+    CASE_EXPECT_EQ(5, vec.size());
+    CASE_EXPECT_EQ(100, vec.back());
+    for (uint64_t v = 0; v < 4; ++v) {
+        CASE_EXPECT_EQ(v + 100, vec[static_cast<size_t>(v)]);
+    }
+
+    atbus::detail::inline_vector<uint64_t, 4> copy = vec;
+    CASE_EXPECT_EQ(5, copy.size());
+    CASE_EXPECT_EQ(0, memcmp(vec.data(), copy.data(), sizeof(uint64_t) * 5));
+
+    vec.pop_back();
+    vec.resize(6);
+    CASE_EXPECT_EQ(6, vec.size());
+    CASE_EXPECT_EQ(0, vec[4]);
+    CASE_EXPECT_EQ(0, vec[5]);
+
+    copy = atbus::detail::inline_vector<uint64_t, 4>();
+    CASE_EXPECT_TRUE(copy.empty());
+    copy.push_back(1);
+    CASE_EXPECT_EQ(1, copy.size());
+}
+
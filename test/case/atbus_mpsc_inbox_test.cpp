@@ -0,0 +1,96 @@
+﻿#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <detail/mpsc_inbox.h>
+
+#include "frame/test_macros.h"
+
+namespace {
+    struct mpsc_inbox_test_msg_t {
+        atbus::detail::mpsc_inbox::node_t inbox_node;
+        size_t producer;
+        size_t seq;
+    };
+} // namespace
+
+CASE_TEST(atbus_mpsc_inbox, push_pop_order) {
+    atbus::detail::mpsc_inbox inbox;
+    CASE_EXPECT_TRUE(inbox.empty());
+    CASE_EXPECT_TRUE(NULL == inbox.pop_all());
+
+    std::vector<mpsc_inbox_test_msg_t> msgs(8);
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        msgs[i].seq = i;
+        // 只有第一次压入时需要唤醒
+        CASE_EXPECT_EQ(0 == i, inbox.push(&msgs[i].inbox_node));
+    }
+    CASE_EXPECT_FALSE(inbox.empty());
+
+    size_t count = 0;
+    for (atbus::detail::mpsc_inbox::node_t *n = inbox.pop_all(); NULL != n; n = n->next) {
+        CASE_EXPECT_EQ(count, reinterpret_cast<mpsc_inbox_test_msg_t *>(n)->seq);
+        ++count;
+    }
+    CASE_EXPECT_EQ(msgs.size(), count);
+    CASE_EXPECT_TRUE(inbox.empty());
+
+    // 取空后再次压入需要重新唤醒
+    CASE_EXPECT_TRUE(inbox.push(&msgs[0].inbox_node));
+    CASE_EXPECT_TRUE(&msgs[0].inbox_node == inbox.pop_all());
+}
+
+CASE_TEST(atbus_mpsc_inbox, multi_producer) {
+    const size_t producer_count = 4;
+    const size_t msg_count      = 50000;
+
+    atbus::detail::mpsc_inbox inbox;
+    std::vector<std::vector<mpsc_inbox_test_msg_t> > msgs(producer_count);
+    for (size_t i = 0; i < producer_count; ++i) {
+        msgs[i].resize(msg_count);
+    }
+
+    std::vector<std::thread *> producers;
+    for (size_t i = 0; i < producer_count; ++i) {
+        producers.push_back(new std::thread([&msgs, &inbox, i, msg_count] {
+            for (size_t j = 0; j < msg_count; ++j) {
+                msgs[i][j].producer = i;
+                msgs[i][j].seq      = j;
+                inbox.push(&msgs[i][j].inbox_node);
+            }
+        }));
+    }
+
+    // 消费者和生产者同时运行，每个生产者的消息保持顺序
+    std::vector<size_t> next_seq(producer_count, 0);
+    size_t received  = 0;
+    bool order_error = false;
+    while (received < producer_count * msg_count) {
+        atbus::detail::mpsc_inbox::node_t *n = inbox.pop_all();
+        if (NULL == n) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (; NULL != n; n = n->next) {
+            mpsc_inbox_test_msg_t *msg = reinterpret_cast<mpsc_inbox_test_msg_t *>(n);
+            if (msg->seq != next_seq[msg->producer]) {
+                order_error = true;
+            }
+            next_seq[msg->producer] = msg->seq + 1;
+            ++received;
+        }
+    }
+
+    for (size_t i = 0; i < producers.size(); ++i) {
+        producers[i]->join();
+        delete producers[i];
+    }
+
+    CASE_EXPECT_FALSE(order_error);
+    CASE_EXPECT_EQ(producer_count * msg_count, received);
+    CASE_EXPECT_TRUE(inbox.empty());
+    for (size_t i = 0; i < producer_count; ++i) {
+        CASE_EXPECT_EQ(msg_count, next_seq[i]);
+    }
+}
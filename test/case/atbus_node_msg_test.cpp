@@ -1,8 +1,11 @@
-﻿#include <cstdlib>
+﻿#include <atomic>
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <thread>
 
 #include "common/string_oprs.h"
 
@@ -17,6 +20,7 @@
 #include <atbus_node.h>
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_compact.h"
 
 #include "frame/test_macros.h"
 
@@ -90,7 +94,7 @@ static int node_msg_test_recv_msg_test_record_fn(const atbus::node &n, const atb
     recv_msg_history.status = m.head.ret;
     ++recv_msg_history.count;
     if (NULL != m.body.forward) {
-        recv_msg_history.last_msg_router = m.body.forward->router;
+        recv_msg_history.last_msg_router.assign(m.body.forward->router.begin(), m.body.forward->router.end());
     } else {
         recv_msg_history.last_msg_router.clear();
     }
@@ -121,7 +125,7 @@ static int node_msg_test_send_data_failed_fn(const atbus::node &n, const atbus::
     recv_msg_history.status = NULL == m ? 0 : m->head.ret;
     ++recv_msg_history.failed_count;
     if (NULL != m && NULL != m->body.forward) {
-        recv_msg_history.last_msg_router = m->body.forward->router;
+        recv_msg_history.last_msg_router.assign(m->body.forward->router.begin(), m->body.forward->router.end());
     } else {
         recv_msg_history.last_msg_router.clear();
     }
@@ -397,6 +401,194 @@ CASE_TEST(atbus_node_msg, reset_and_send) {
     unit_test_setup_exit(&ev_loop);
 }
 
+// 其他线程发送,事件循环线程里回调
+CASE_TEST(atbus_node_msg, send_data_thread_safe) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_THREAD_SAFE_INBOX, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug          = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        std::string send_data;
+        send_data.assign("thread\0hello world!\n", sizeof("thread\0hello world!\n") - 1);
+
+        int count = recv_msg_history.count;
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        const int send_times = 16;
+        int send_failed      = 0;
+        std::thread sender([&node1, &send_data, &send_failed, send_times] {
+            for (int i = 0; i < send_times; ++i) {
+                if (EN_ATBUS_ERR_SUCCESS != node1->send_data_thread_safe(node1->get_id(), 0, send_data.data(), send_data.size())) {
+                    ++send_failed;
+                }
+            }
+        });
+        sender.join();
+        CASE_EXPECT_EQ(0, send_failed);
+
+        // 在唤醒回调里发送
+        CASE_EXPECT_EQ(count, recv_msg_history.count);
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + send_times <= recv_msg_history.count, 8000, 0) {}
+
+        CASE_EXPECT_EQ(count + send_times, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 未开启EN_CONF_THREAD_SAFE_INBOX时不允许其他线程发送
+CASE_TEST(atbus_node_msg, send_data_thread_safe_disabled) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->init(0x12345678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_INITED, node1->send_data_thread_safe(node1->get_id(), 0, "hello", 5));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 其他线程发送的同时事件循环线程在执行proc和uv_run
+CASE_TEST(atbus_node_msg, send_data_thread_safe_while_running) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_THREAD_SAFE_INBOX, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug          = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        std::string send_data = "thread safe while running";
+        int count             = recv_msg_history.count;
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        const int send_times = 4096;
+        std::atomic<int> send_failed(0);
+        std::thread sender([&node1, &send_data, &send_failed, send_times] {
+            for (int i = 0; i < send_times; ++i) {
+                if (EN_ATBUS_ERR_SUCCESS != node1->send_data_thread_safe(node1->get_id(), 0, send_data.data(), send_data.size())) {
+                    ++send_failed;
+                }
+            }
+        });
+
+        // 唤醒回调和proc都会取出收件箱，和发送线程同时进行
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + send_times <= recv_msg_history.count, 8000, 0) { node1->proc(proc_t, 0); }
+        sender.join();
+
+        CASE_EXPECT_EQ(0, send_failed.load());
+        CASE_EXPECT_EQ(count + send_times, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 其他线程发送的同时重置，发送成功的消息要么送达，要么按发送失败回调，不会丢失或泄漏
+CASE_TEST(atbus_node_msg, send_data_thread_safe_and_reset) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_THREAD_SAFE_INBOX, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug          = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        std::string send_data = "thread safe and reset";
+        int count             = recv_msg_history.count;
+        int failed_count      = recv_msg_history.failed_count;
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->set_on_send_data_failed_handle(node_msg_test_send_data_failed_fn);
+
+        int accepted   = 0;
+        int last_error = EN_ATBUS_ERR_SUCCESS;
+        std::thread sender([&node1, &send_data, &accepted, &last_error] {
+            // 一直发送到被拒绝为止
+            while (accepted < 1000000) {
+                int res = node1->send_data_thread_safe(node1->get_id(), 0, send_data.data(), send_data.size());
+                if (EN_ATBUS_ERR_SUCCESS != res) {
+                    last_error = res;
+                    break;
+                }
+                ++accepted;
+            }
+        });
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + 16 <= recv_msg_history.count, 8000, 0) { node1->proc(proc_t, 0); }
+        node1->reset();
+        sender.join();
+
+        CASE_EXPECT_TRUE(EN_ATBUS_ERR_CLOSING == last_error || EN_ATBUS_ERR_NOT_INITED == last_error);
+        CASE_EXPECT_EQ(accepted, recv_msg_history.count - count + recv_msg_history.failed_count - failed_count);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_INITED, node1->send_data_thread_safe(node1->get_id(), 0, send_data.data(), send_data.size()));
+
+        // 重新初始化后可以继续发送
+        node1->init(0x12345678, &conf);
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data_thread_safe(node1->get_id(), 0, send_data.data(), send_data.size()));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + 1 <= recv_msg_history.count, 8000, 0) {}
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
 static int node_msg_test_recv_and_send_msg_on_failed_fn(const atbus::node &, const atbus::endpoint *, const atbus::connection *,
                                                         const atbus::protocol::msg *) {
     ++recv_msg_history.count;
@@ -479,6 +671,98 @@ CASE_TEST(atbus_node_msg, send_msg_to_self_and_need_rsp) {
 }
 
 
+static std::vector<std::string> self_msg_order;
+
+static int node_msg_test_self_order_cmd_fn(const atbus::node &, const atbus::endpoint *, const atbus::connection *, atbus::node::bus_id_t,
+                                           const std::vector<std::pair<const void *, size_t> > &data, std::list<std::string> &rsp) {
+    std::string cmd;
+    if (!data.empty()) {
+        cmd.assign(static_cast<const char *>(data[0].first), data[0].second);
+    }
+    self_msg_order.push_back("cmd:" + cmd);
+    rsp.push_back(cmd);
+    return 0;
+}
+
+static int node_msg_test_self_order_rsp_fn(const atbus::node &, const atbus::endpoint *, const atbus::connection *, atbus::node::bus_id_t,
+                                           const std::vector<std::pair<const void *, size_t> > &data, uint64_t) {
+    std::string cmd;
+    if (!data.empty()) {
+        cmd.assign(static_cast<const char *>(data[0].first), data[0].second);
+    }
+    self_msg_order.push_back("rsp:" + cmd);
+    return 0;
+}
+
+static int node_msg_test_self_order_recv_fn(const atbus::node &n, const atbus::endpoint *, const atbus::connection *,
+                                            const atbus::protocol::msg &, const void *buffer, size_t len) {
+    std::string data(reinterpret_cast<const char *>(buffer), len);
+    // 大的数据只记录长度，它会让队列在回调里扩容
+    self_msg_order.push_back("data:" + (data.size() > 64 ? std::to_string(data.size()) : data));
+    if ("start" != data) {
+        return 0;
+    }
+
+    // 回调里发给自己的数据和命令都进入同一个队列，按发送顺序派发
+    atbus::node *np = const_cast<atbus::node *>(&n);
+    std::string big(12288, 'b');
+    const char *cmds[] = {"c1", "c2"};
+    const void *cmd_in[1];
+    size_t cmd_len[1];
+
+    np->send_data(n.get_id(), 0, "d1", 2);
+    cmd_in[0]  = cmds[0];
+    cmd_len[0] = strlen(cmds[0]);
+    np->send_custom_cmd(n.get_id(), cmd_in, cmd_len, 1);
+    np->send_data(n.get_id(), 0, big.data(), big.size());
+    cmd_in[0]  = cmds[1];
+    cmd_len[0] = strlen(cmds[1]);
+    np->send_custom_cmd(n.get_id(), cmd_in, cmd_len, 1);
+    np->send_data(n.get_id(), 0, "d3", 2);
+    return 0;
+}
+
+// 发给自己的数据和命令共用一个队列，交替发送时按发送顺序收到
+CASE_TEST(atbus_node_msg, send_data_and_cmd_to_self_in_order) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug          = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        node1->set_on_recv_handle(node_msg_test_self_order_recv_fn);
+        node1->set_on_custom_cmd_handle(node_msg_test_self_order_cmd_fn);
+        node1->set_on_custom_rsp_handle(node_msg_test_self_order_rsp_fn);
+        self_msg_order.clear();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, "start", 5));
+
+        // 命令的回包在处理命令时才发出，排在已经发送的消息后面
+        const char *expect[] = {"data:start", "data:d1", "cmd:c1", "data:12288", "cmd:c2", "data:d3", "rsp:c1", "rsp:c2"};
+        std::vector<std::string> expect_order(expect, expect + sizeof(expect) / sizeof(expect[0]));
+        CASE_EXPECT_EQ(expect_order.size(), self_msg_order.size());
+        for (size_t i = 0; i < expect_order.size() && i < self_msg_order.size(); ++i) {
+            CASE_EXPECT_EQ(expect_order[i], self_msg_order[i]);
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
 // 父子节点消息转发测试
 CASE_TEST(atbus_node_msg, parent_and_child) {
     atbus::node::conf_t conf;
@@ -723,6 +1007,443 @@ CASE_TEST(atbus_node_msg, transfer_only) {
     unit_test_setup_exit(&ev_loop);
 }
 
+// 中间节点转发数据时只重新打包紧凑编码的消息头，数据部分原样通过push_v写出
+CASE_TEST(atbus_node_msg, transfer_cut_through) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1  = atbus::node::create();
+        atbus::node::ptr_t node_child_2  = atbus::node::create();
+        node_parent_1->on_debug          = node_msg_test_on_debug;
+        node_parent_2->on_debug          = node_msg_test_on_debug;
+        node_child_1->on_debug           = node_msg_test_on_debug;
+        node_child_2->on_debug           = node_msg_test_on_debug;
+        node_parent_1->set_on_error_handle(node_msg_test_on_error);
+        node_parent_2->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask  = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_child_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_child_2->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_parent_1->get_id()),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        // 所有节点都协商了紧凑编码
+        CASE_EXPECT_TRUE(node_parent_1->get_endpoint(node_parent_2->get_id())->get_flag(atbus::endpoint::flag_t::COMPACT_DATA));
+        CASE_EXPECT_TRUE(node_parent_2->get_endpoint(node_child_2->get_id())->get_flag(atbus::endpoint::flag_t::COMPACT_DATA));
+
+        atbus::endpoint *relay_ep     = NULL;
+        atbus::connection *relay_conn = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->get_remote_channel(node_child_2->get_id(), &atbus::endpoint::get_data_connection,
+                                                                               &relay_ep, &relay_conn));
+        CASE_EXPECT_NE(NULL, relay_conn);
+        if (NULL == relay_conn) {
+            unit_test_setup_exit(&ev_loop);
+            return;
+        }
+
+        // 覆盖所有字节值的二进制数据，中间节点重新序列化就会被发现
+        std::string send_data;
+        send_data.resize(4096);
+        for (size_t i = 0; i < send_data.size(); ++i) {
+            send_data[i] = static_cast<char>(i & 0xFF);
+        }
+
+        size_t push_times = relay_conn->get_statistic().push_start_times;
+        size_t push_size  = relay_conn->get_statistic().push_start_size;
+
+        recv_msg_history.data.clear();
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count != recv_msg_history.count, 8000, 0) {}
+
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+
+        // 经过两个父节点转发
+        CASE_EXPECT_EQ(3, recv_msg_history.last_msg_router.size());
+        if (3 == recv_msg_history.last_msg_router.size()) {
+            CASE_EXPECT_EQ(node_child_1->get_id(), recv_msg_history.last_msg_router[0]);
+            CASE_EXPECT_EQ(node_parent_1->get_id(), recv_msg_history.last_msg_router[1]);
+            CASE_EXPECT_EQ(node_parent_2->get_id(), recv_msg_history.last_msg_router[2]);
+        }
+
+        // 最后一跳只写出了一次：紧凑编码的头部+路由表，加上原样的数据
+        CASE_EXPECT_EQ(push_times + 1, relay_conn->get_statistic().push_start_times);
+        CASE_EXPECT_EQ(push_size + ATBUS_COMPACT_DATA_HEAD_SIZE + recv_msg_history.last_msg_router.size() * sizeof(uint64_t) +
+                           send_data.size(),
+                       relay_conn->get_statistic().push_start_size);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_target_record_t {
+    std::string data;
+    std::vector<ATBUS_MACRO_BUSID_TYPE> router;
+    int count;
+
+    node_msg_test_target_record_t() : count(0) {}
+};
+
+static std::map<ATBUS_MACRO_BUSID_TYPE, node_msg_test_target_record_t> target_recv_history;
+
+static int node_msg_test_target_recv_fn(const atbus::node &n, const atbus::endpoint *, const atbus::connection *,
+                                        const atbus::protocol::msg &m, const void *buffer, size_t len) {
+    node_msg_test_target_record_t &record = target_recv_history[n.get_id()];
+    ++record.count;
+    if (NULL != buffer && len > 0) {
+        record.data.assign(reinterpret_cast<const char *>(buffer), len);
+    } else {
+        record.data.clear();
+    }
+
+    if (NULL != m.body.forward) {
+        // 每个目标收到的消息里目标ID都应该是自己
+        CASE_EXPECT_EQ(n.get_id(), m.body.forward->to);
+        record.router.assign(m.body.forward->router.begin(), m.body.forward->router.end());
+    } else {
+        record.router.clear();
+    }
+
+    return 0;
+}
+
+// 按服务索引广播时只打包一次，对每个目标只改写目标ID，紧凑编码和msgpack编码的目标都要能正确收到
+// 某个目标发送失败走普通转发流程后，后面的目标收到的路由表不能受影响
+CASE_TEST(atbus_node_msg, broadcast_by_service_index) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_root   = atbus::node::create();
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_sender = atbus::node::create();
+        atbus::node::ptr_t node_targets[3];
+        for (int i = 0; i < 3; ++i) {
+            node_targets[i] = atbus::node::create();
+        }
+
+        node_root->on_debug = node_msg_test_on_debug;
+        node_root->set_on_error_handle(node_msg_test_on_error);
+        node_root->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_root->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_root->start());
+
+        conf.children_mask  = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_parent->init(0x12346789, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+
+        conf.children_mask  = 0;
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_sender->on_debug = node_msg_test_on_debug;
+        node_sender->set_on_error_handle(node_msg_test_on_error);
+        node_sender->init(0x12346701, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_sender->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_sender->start());
+
+        const char *target_listen[3] = {"ipv4://127.0.0.1:16390", "ipv4://127.0.0.1:16391", "ipv4://127.0.0.1:16392"};
+        conf.type_name                = "broadcast_svc";
+        for (int i = 0; i < 3; ++i) {
+            // 最后一个目标不支持紧凑编码，父节点发给它时使用msgpack
+            conf.flags.set(atbus::node::conf_flag_t::EN_CONF_COMPACT_DATA, i < 2);
+            node_targets[i]->on_debug = node_msg_test_on_debug;
+            node_targets[i]->set_on_error_handle(node_msg_test_on_error);
+            node_targets[i]->set_on_recv_handle(node_msg_test_target_recv_fn);
+            node_targets[i]->init(0x12346702 + i, &conf);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_targets[i]->listen(target_listen[i]));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_targets[i]->start());
+        }
+
+        time_t proc_t = time(NULL) + 1;
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_parent->is_endpoint_available(node_root->get_id()) &&
+                                node_root->is_endpoint_available(node_parent->get_id()) &&
+                                node_sender->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_sender->get_id()) &&
+                                node_targets[0]->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_targets[0]->get_id()) &&
+                                node_targets[1]->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_targets[1]->get_id()) &&
+                                node_targets[2]->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_targets[2]->get_id()),
+                            8000, 64) {
+            node_root->proc(proc_t, 0);
+            node_parent->proc(proc_t, 0);
+            node_sender->proc(proc_t, 0);
+            for (int i = 0; i < 3; ++i) {
+                node_targets[i]->proc(proc_t, 0);
+            }
+
+            ++proc_t;
+        }
+
+        // 没有连接的兄弟节点，发给它时会失败并转发给父节点，转发时路由表会追加一次自己
+        const atbus::node::bus_id_t brother_id = 0x12341001;
+        std::vector<std::string> no_tags;
+        atbus::endpoint::ptr_t brother_ep =
+            atbus::endpoint::create(node_parent.get(), brother_id, 0, node_parent->get_pid(), node_parent->get_hostname(), "broadcast_svc", no_tags);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->add_endpoint(brother_ep));
+
+        // 调整服务索引的顺序，让失败的兄弟节点排在最前面
+        atbus::detail::service_index &index = node_parent->get_service_index();
+        for (int i = 0; i < 3; ++i) {
+            index.remove(node_targets[i]->get_id());
+            index.add(node_targets[i]->get_id(), "broadcast_svc", no_tags);
+        }
+
+        const atbus::detail::service_index::member_list_t *members = index.get_members("broadcast_svc", "");
+        CASE_EXPECT_NE(NULL, members);
+        if (NULL != members) {
+            CASE_EXPECT_EQ(4, members->size());
+            CASE_EXPECT_EQ(brother_id, (*members)[0]);
+        }
+
+        atbus::connection *target_conns[3] = {NULL, NULL, NULL};
+        size_t push_times[3]               = {0, 0, 0};
+        size_t push_size[3]                = {0, 0, 0};
+        for (int i = 0; i < 3; ++i) {
+            atbus::endpoint *ep = NULL;
+            node_parent->get_remote_channel(node_targets[i]->get_id(), &atbus::endpoint::get_data_connection, &ep, &target_conns[i]);
+            CASE_EXPECT_NE(NULL, target_conns[i]);
+            CASE_EXPECT_NE(NULL, ep);
+            if (NULL == target_conns[i] || NULL == ep) {
+                unit_test_setup_exit(&ev_loop);
+                return;
+            }
+
+            CASE_EXPECT_EQ(i < 2, ep->get_flag(atbus::endpoint::flag_t::COMPACT_DATA));
+            push_times[i] = target_conns[i]->get_statistic().push_start_times;
+            push_size[i]  = target_conns[i]->get_statistic().push_start_size;
+        }
+
+        atbus::connection *root_conn = NULL;
+        node_parent->get_remote_channel(node_root->get_id(), &atbus::endpoint::get_data_connection, NULL, &root_conn);
+        CASE_EXPECT_NE(NULL, root_conn);
+        if (NULL == root_conn) {
+            unit_test_setup_exit(&ev_loop);
+            return;
+        }
+        size_t root_push_times = root_conn->get_statistic().push_start_times;
+
+        std::string send_data = "broadcast by service index";
+        std::shared_ptr<atbus::protocol::custom_route_data> route_data = std::make_shared<atbus::protocol::custom_route_data>();
+        route_data->type_name                                           = "broadcast_svc";
+        route_data->custom_route_type = atbus::protocol::custom_route_data::CUSTOM_ROUTE_BROADCAST;
+
+        target_recv_history.clear();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node_sender->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size(), false, route_data));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            target_recv_history[node_targets[0]->get_id()].count > 0 &&
+                                target_recv_history[node_targets[1]->get_id()].count > 0 &&
+                                target_recv_history[node_targets[2]->get_id()].count > 0,
+                            8000, 0) {}
+
+        // 兄弟节点的消息转发给了父节点
+        CASE_EXPECT_LE(root_push_times + 1, root_conn->get_statistic().push_start_times);
+
+        for (int i = 0; i < 3; ++i) {
+            node_msg_test_target_record_t &record = target_recv_history[node_targets[i]->get_id()];
+            CASE_EXPECT_EQ(1, record.count);
+            CASE_EXPECT_EQ(send_data, record.data);
+
+            // 转发后路由表已经恢复，所有目标收到的路由都是发送者和父节点
+            CASE_EXPECT_EQ(2, record.router.size());
+            if (2 == record.router.size()) {
+                CASE_EXPECT_EQ(node_sender->get_id(), record.router[0]);
+                CASE_EXPECT_EQ(node_parent->get_id(), record.router[1]);
+            }
+
+            // 每个目标只写出一次
+            CASE_EXPECT_EQ(push_times[i] + 1, target_conns[i]->get_statistic().push_start_times);
+        }
+
+        // 紧凑编码的目标共享同一份消息头，只改写了目标ID，所以写出的长度相同
+        size_t compact_size = ATBUS_COMPACT_DATA_HEAD_SIZE + 2 * sizeof(uint64_t) + send_data.size();
+        CASE_EXPECT_EQ(push_size[0] + compact_size, target_conns[0]->get_statistic().push_start_size);
+        CASE_EXPECT_EQ(push_size[1] + compact_size, target_conns[1]->get_statistic().push_start_size);
+        CASE_EXPECT_NE(push_size[2] + compact_size, target_conns[2]->get_statistic().push_start_size);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 按未完成请求数选择目标: 转发需要回包的请求时计数，回包经过本节点或者超时后减少
+CASE_TEST(atbus_node_msg, least_outstanding_by_service_index) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_sender = atbus::node::create();
+        atbus::node::ptr_t node_targets[2];
+        for (int i = 0; i < 2; ++i) {
+            node_targets[i] = atbus::node::create();
+        }
+
+        conf.custom_route_select_mode = atbus::detail::service_index::select_mode_t::EN_SSM_LEAST_OUTSTANDING;
+        conf.outstanding_timeout      = 4;
+        node_parent->on_debug         = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_parent->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+
+        conf.children_mask  = 0;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_sender->on_debug = node_msg_test_on_debug;
+        node_sender->set_on_error_handle(node_msg_test_on_error);
+        node_sender->set_on_send_data_failed_handle(node_msg_test_send_data_failed_fn);
+        node_sender->init(0x12340001, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_sender->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_sender->start());
+
+        const char *target_listen[2] = {"ipv4://127.0.0.1:16389", "ipv4://127.0.0.1:16390"};
+        conf.type_name                = "outstanding_svc";
+        for (int i = 0; i < 2; ++i) {
+            node_targets[i]->on_debug = node_msg_test_on_debug;
+            node_targets[i]->set_on_error_handle(node_msg_test_on_error);
+            node_targets[i]->set_on_recv_handle(node_msg_test_target_recv_fn);
+            node_targets[i]->init(0x12340002 + i, &conf);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_targets[i]->listen(target_listen[i]));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_targets[i]->start());
+        }
+
+        time_t proc_t = time(NULL) + 1;
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_sender->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_sender->get_id()) &&
+                                node_targets[0]->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_targets[0]->get_id()) &&
+                                node_targets[1]->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_targets[1]->get_id()),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_sender->proc(proc_t, 0);
+            for (int i = 0; i < 2; ++i) {
+                node_targets[i]->proc(proc_t, 0);
+            }
+
+            ++proc_t;
+        }
+
+        atbus::detail::service_index &index = node_parent->get_service_index();
+        std::string send_data               = "least outstanding";
+        std::shared_ptr<atbus::protocol::custom_route_data> route_data = std::make_shared<atbus::protocol::custom_route_data>();
+        route_data->type_name                                           = "outstanding_svc";
+        route_data->custom_route_type = atbus::protocol::custom_route_data::CUSTOM_ROUTE_UNICAST;
+
+        // 还没有直连时回包经过父节点，收到回包后计数已经减少
+        target_recv_history.clear();
+        int failed_count = recv_msg_history.failed_count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node_sender->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size(), true, route_data));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, failed_count != recv_msg_history.failed_count, 8000, 0) {}
+
+        CASE_EXPECT_EQ(0, recv_msg_history.status);
+        CASE_EXPECT_EQ(1, target_recv_history[node_targets[0]->get_id()].count + target_recv_history[node_targets[1]->get_id()].count);
+        CASE_EXPECT_EQ(0, index.get_outstanding(node_targets[0]->get_id()));
+        CASE_EXPECT_EQ(0, index.get_outstanding(node_targets[1]->get_id()));
+
+        // 和目标直连后回包不再经过父节点，计数只能等超时后减少
+        for (int i = 0; i < 2; ++i) {
+            if (!node_sender->is_endpoint_available(node_targets[i]->get_id())) {
+                node_sender->connect(target_listen[i]);
+            }
+        }
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_sender->is_endpoint_available(node_targets[0]->get_id()) &&
+                                node_targets[0]->is_endpoint_available(node_sender->get_id()) &&
+                                node_sender->is_endpoint_available(node_targets[1]->get_id()) &&
+                                node_targets[1]->is_endpoint_available(node_sender->get_id()),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_sender->proc(proc_t, 0);
+            for (int i = 0; i < 2; ++i) {
+                node_targets[i]->proc(proc_t, 0);
+            }
+        }
+
+        // 第一个请求还没完成，第二个请求会发给另一个目标
+        target_recv_history.clear();
+        failed_count = recv_msg_history.failed_count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node_sender->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size(), true, route_data));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node_sender->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size(), true, route_data));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, failed_count + 2 <= recv_msg_history.failed_count, 8000, 0) {}
+
+        CASE_EXPECT_EQ(1, target_recv_history[node_targets[0]->get_id()].count);
+        CASE_EXPECT_EQ(1, target_recv_history[node_targets[1]->get_id()].count);
+        CASE_EXPECT_EQ(1, index.get_outstanding(node_targets[0]->get_id()));
+        CASE_EXPECT_EQ(1, index.get_outstanding(node_targets[1]->get_id()));
+
+        // 超时后不再计数
+        proc_t += conf.outstanding_timeout + 1;
+        node_parent->proc(proc_t, 0);
+        CASE_EXPECT_EQ(0, index.get_outstanding(node_targets[0]->get_id()));
+        CASE_EXPECT_EQ(0, index.get_outstanding(node_targets[1]->get_id()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
 // 直连节点发送失败测试
 CASE_TEST(atbus_node_msg, send_failed) {
     atbus::node::conf_t conf;
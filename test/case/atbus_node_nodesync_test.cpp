@@ -1,85 +1,433 @@
-﻿#include <cstdlib>
-#include <cstring>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
-
-#include "common/string_oprs.h"
-
-#ifdef max
-#undef max
-#endif
-
-#ifdef min
-#undef min
-#endif
-
-#include <atbus_node.h>
-
-#include "detail/libatbus_protocol.h"
-
-#include "frame/test_macros.h"
-
-#include <stdarg.h>
-
-#if 0
-static void node_nodesync_test_on_debug(const char* file_path, size_t line, const atbus::node& n, const atbus::endpoint* ep, const atbus::connection* conn, const char* fmt, ...) {
-    size_t offset = 0;
-    for (size_t i = 0; file_path[i]; ++i) {
-        if ('/' == file_path[i] || '\\' == file_path[i]) {
-            offset = i + 1;
-        }
-    }
-    file_path += offset;
-
-    std::streamsize w = std::cout.width();
-    CASE_MSG_INFO() << "[Log Debug][" << std::setw(24) << file_path << ":" << std::setw(4) << line << "] node=0x" << 
-        std::setfill('0')<< std::hex<< std::setw(8)<< n.get_id() <<
-        ", ep=0x" << std::setw(8)<< (NULL == ep ? 0 : ep->get_id()) <<
-        ", c=" << conn<< std::setfill(' ')<< std::setw(w)<<  std::dec<<
-        "\t";
-
-    va_list ap;
-    va_start(ap, fmt);
-
-    vprintf(fmt, ap);
-
-    va_end(ap);
-
-    puts("");
-}
-
-struct node_nodesync_test_recv_msg_record_t {
-    const atbus::node* n;
-    const atbus::endpoint* ep;
-    const atbus::connection* conn;
-    std::string data;
-    int status;
-    int count;
-
-    node_nodesync_test_recv_msg_record_t(): n(NULL), ep(NULL), conn(NULL), status(0), count(0) {}
-};
-
-static node_nodesync_test_recv_msg_record_t recv_msg_history;
-
-static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node& n, const atbus::endpoint& ep, const atbus::connection& conn, 
-    int status, const void* buffer, size_t len) {
-    recv_msg_history.n = &n;
-    recv_msg_history.ep = &ep;
-    recv_msg_history.conn = &conn;
-    recv_msg_history.status = status;
-    ++recv_msg_history.count;
-
-    if (NULL != buffer && len > 0) {
-        recv_msg_history.data.assign(reinterpret_cast<const char*>(buffer), len);
-    } else {
-        recv_msg_history.data.clear();
-    }
-
-    return 0;
-}
-
-// TODO 全量表第一次拉取测试
-// TODO 全量表通知给父节点和子节点测试
-
-#endif
+﻿#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <common/string_oprs.h>
+#include <std/explicit_declare.h>
+
+#ifdef max
+#undef max
+#endif
+
+#ifdef min
+#undef min
+#endif
+
+#include <atbus_node.h>
+
+#include "detail/libatbus_protocol.h"
+
+#include "atbus_test_utils.h"
+#include "frame/test_macros.h"
+
+#include <stdarg.h>
+
+static void node_nodesync_test_on_debug(const char *file_path, size_t line, const atbus::node &n, const atbus::endpoint *ep,
+                                        const atbus::connection *conn, EXPLICIT_UNUSED_ATTR const atbus::protocol::msg *m, const char *fmt,
+                                        ...) {
+    size_t offset = 0;
+    for (size_t i = 0; file_path[i]; ++i) {
+        if ('/' == file_path[i] || '\\' == file_path[i]) {
+            offset = i + 1;
+        }
+    }
+    file_path += offset;
+
+    std::streamsize w = std::cout.width();
+    CASE_MSG_INFO() << "[Log Debug][" << std::setw(24) << file_path << ":" << std::setw(4) << line << "] node=0x" << std::setfill('0')
+                    << std::hex << std::setw(8) << n.get_id() << ", ep=0x" << std::setw(8) << (NULL == ep ? 0 : ep->get_id())
+                    << ", c=" << conn << std::setfill(' ') << std::setw(w) << std::dec << "\t";
+
+    va_list ap;
+    va_start(ap, fmt);
+
+    vprintf(fmt, ap);
+
+    va_end(ap);
+
+    puts("");
+}
+
+static int node_nodesync_test_on_error(const atbus::node &n, const atbus::endpoint *ep, const atbus::connection *conn, int status,
+                                       int errcode) {
+    if (0 == errcode || UV_EOF == errcode) {
+        return 0;
+    }
+
+    std::streamsize w = std::cout.width();
+    CASE_MSG_INFO() << "[Log Error] node=0x" << std::setfill('0') << std::hex << std::setw(8) << n.get_id() << ", ep=0x" << std::setw(8)
+                    << (NULL == ep ? 0 : ep->get_id()) << ", c=" << conn << std::setfill(' ') << std::setw(w) << std::dec
+                    << "=> status: " << status << ", errcode: " << errcode << std::endl;
+    return 0;
+}
+
+struct node_nodesync_test_recv_msg_record_t {
+    std::string data;
+    std::vector<ATBUS_MACRO_BUSID_TYPE> router;
+    int count;
+    int register_count;
+    int register_status;
+
+    node_nodesync_test_recv_msg_record_t() : count(0), register_count(0), register_status(0) {}
+};
+
+static std::map<ATBUS_MACRO_BUSID_TYPE, node_nodesync_test_recv_msg_record_t> recv_msg_history;
+
+static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node &n, const atbus::endpoint *, const atbus::connection *,
+                                                      const atbus::protocol::msg &m, const void *buffer, size_t len) {
+    node_nodesync_test_recv_msg_record_t &record = recv_msg_history[n.get_id()];
+    ++record.count;
+
+    if (NULL != buffer && len > 0) {
+        record.data.assign(reinterpret_cast<const char *>(buffer), len);
+    } else {
+        record.data.clear();
+    }
+
+    if (NULL != m.body.forward) {
+        record.router.assign(m.body.forward->router.begin(), m.body.forward->router.end());
+    } else {
+        record.router.clear();
+    }
+
+    return 0;
+}
+
+static int node_nodesync_test_on_register_fn(const atbus::node &n, const atbus::endpoint *, const atbus::connection *, int status) {
+    node_nodesync_test_recv_msg_record_t &record = recv_msg_history[n.get_id()];
+    ++record.register_count;
+    record.register_status = status;
+    return 0;
+}
+
+static bool node_nodesync_test_is_live(const atbus::node &n, atbus::node::bus_id_t tid) {
+    const atbus::detail::route_table::entry_t *ent = n.get_route_table().get(tid);
+    return NULL != ent && !ent->removed;
+}
+
+static bool node_nodesync_test_has_global(const atbus::node &n, atbus::node::bus_id_t tid) {
+    for (atbus::node::endpoint_collection_t::const_iterator iter = n.get_global().begin(); iter != n.get_global().end(); ++iter) {
+        if (iter->second->get_id() == tid) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * 测试用的三层节点树，只有左边一支有全局路由表
+ *              root(G)
+ *             /       \
+ *      parent_g(G)   parent_p
+ *          |            |
+ *      child_g(G)    child_p
+ */
+struct node_nodesync_test_tree_t {
+    atbus::node::ptr_t root;
+    atbus::node::ptr_t parent_g;
+    atbus::node::ptr_t parent_p;
+    atbus::node::ptr_t child_g;
+    atbus::node::ptr_t child_p;
+
+    void proc(time_t sec) {
+        root->proc(sec, 0);
+        parent_g->proc(sec, 0);
+        parent_p->proc(sec, 0);
+        child_g->proc(sec, 0);
+        child_p->proc(sec, 0);
+    }
+};
+
+static void node_nodesync_test_init_node(atbus::node::ptr_t &n, atbus::node::bus_id_t id, const char *listen_address,
+                                         const atbus::node::conf_t &conf) {
+    n           = atbus::node::create();
+    n->on_debug = node_nodesync_test_on_debug;
+    n->set_on_error_handle(node_nodesync_test_on_error);
+    n->set_on_recv_handle(node_nodesync_test_recv_msg_test_record_fn);
+    n->set_on_register_handle(node_nodesync_test_on_register_fn);
+    n->init(id, &conf);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, n->listen(listen_address));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, n->start());
+}
+
+static void node_nodesync_test_setup_tree(uv_loop_t *ev_loop, node_nodesync_test_tree_t &tree, time_t &proc_t) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.ev_loop = ev_loop;
+
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER, true);
+    node_nodesync_test_init_node(tree.root, 0x12345678, "ipv4://127.0.0.1:16387", conf);
+
+    conf.children_mask  = 8;
+    conf.father_address = "ipv4://127.0.0.1:16387";
+    node_nodesync_test_init_node(tree.parent_g, 0x12346789, "ipv4://127.0.0.1:16388", conf);
+
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER, false);
+    node_nodesync_test_init_node(tree.parent_p, 0x12347890, "ipv4://127.0.0.1:16389", conf);
+
+    conf.children_mask  = 0;
+    conf.father_address = "ipv4://127.0.0.1:16388";
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER, true);
+    node_nodesync_test_init_node(tree.child_g, 0x12346701, "ipv4://127.0.0.1:16390", conf);
+
+    conf.father_address = "ipv4://127.0.0.1:16389";
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER, false);
+    node_nodesync_test_init_node(tree.child_p, 0x12347801, "ipv4://127.0.0.1:16391", conf);
+
+    // 右边叶子节点的信息要经过 child_p -> parent_p -> root -> parent_g -> child_g 同步过去
+    UNITTEST_WAIT_UNTIL(ev_loop,
+                        tree.parent_g->is_endpoint_available(tree.root->get_id()) &&
+                            tree.parent_p->is_endpoint_available(tree.root->get_id()) &&
+                            tree.child_g->is_endpoint_available(tree.parent_g->get_id()) &&
+                            tree.child_p->is_endpoint_available(tree.parent_p->get_id()) &&
+                            node_nodesync_test_is_live(*tree.child_g, tree.child_p->get_id()),
+                        8000, 64) {
+        tree.proc(proc_t);
+        ++proc_t;
+    }
+}
+
+// 节点同步: 子树信息上报给父节点，父节点下发给需要全局路由表的子节点，下线时同步墓碑
+CASE_TEST(atbus_node_nodesync, sync_req_and_rsp) {
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    {
+        recv_msg_history.clear();
+        node_nodesync_test_tree_t tree;
+        time_t proc_t = time(NULL) + 1;
+        node_nodesync_test_setup_tree(&ev_loop, tree, proc_t);
+
+        // 根节点有所有节点的信息，并且来源是上报的子节点
+        CASE_EXPECT_TRUE(node_nodesync_test_is_live(*tree.root, tree.child_g->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_is_live(*tree.root, tree.child_p->get_id()));
+        if (node_nodesync_test_is_live(*tree.root, tree.child_p->get_id())) {
+            CASE_EXPECT_EQ(tree.parent_p->get_id(), tree.root->get_route_table().get(tree.child_p->get_id())->source);
+        }
+
+        // 有全局路由表的子节点收到了子树以外的节点，来源是父节点
+        CASE_EXPECT_TRUE(node_nodesync_test_is_live(*tree.child_g, tree.root->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_is_live(*tree.child_g, tree.parent_p->get_id()));
+        if (node_nodesync_test_is_live(*tree.child_g, tree.child_p->get_id())) {
+            const atbus::detail::route_table::entry_t *ent = tree.child_g->get_route_table().get(tree.child_p->get_id());
+            CASE_EXPECT_EQ(tree.parent_g->get_id(), ent->source);
+            CASE_EXPECT_FALSE(ent->listen.empty());
+        }
+
+        // 没有全局路由表的子节点不会收到下发的数据，只有自己的信息
+        CASE_EXPECT_FALSE(node_nodesync_test_is_live(*tree.child_p, tree.child_g->get_id()));
+        CASE_EXPECT_FALSE(node_nodesync_test_is_live(*tree.child_p, tree.root->get_id()));
+
+        // 收发双方记录的版本号一致
+        const atbus::detail::route_table::peer_t *sent = tree.parent_g->get_route_table().get_peer(tree.child_g->get_id());
+        const atbus::detail::route_table::peer_t *recv = tree.child_g->get_route_table().get_peer(tree.parent_g->get_id());
+        CASE_EXPECT_NE(NULL, sent);
+        CASE_EXPECT_NE(NULL, recv);
+        if (NULL != sent && NULL != recv) {
+            CASE_EXPECT_NE(0, recv->recv_version);
+            CASE_EXPECT_EQ(sent->sent_version, recv->recv_version);
+        }
+
+        // 右边叶子节点下线后，墓碑同步到左边的叶子节点
+        uint64_t old_version = tree.child_g->get_route_table().get_version();
+        tree.child_p->reset();
+        UNITTEST_WAIT_UNTIL(&ev_loop, !node_nodesync_test_is_live(*tree.child_g, tree.child_p->get_id()), 8000, 64) {
+            tree.proc(proc_t);
+            ++proc_t;
+        }
+
+        CASE_EXPECT_FALSE(node_nodesync_test_is_live(*tree.root, tree.child_p->get_id()));
+        CASE_EXPECT_FALSE(node_nodesync_test_is_live(*tree.child_g, tree.child_p->get_id()));
+        CASE_EXPECT_LT(old_version, tree.child_g->get_route_table().get_version());
+
+        // 其他节点不受影响
+        CASE_EXPECT_TRUE(node_nodesync_test_is_live(*tree.child_g, tree.parent_p->get_id()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 全局路由表直连: 第一次发送经过父节点转发并发起直连，回包时创建endpoint，之后直接发送
+CASE_TEST(atbus_node_nodesync, global_route_direct_connect) {
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    {
+        recv_msg_history.clear();
+        node_nodesync_test_tree_t tree;
+        time_t proc_t = time(NULL) + 1;
+        node_nodesync_test_setup_tree(&ev_loop, tree, proc_t);
+
+        // 直连建立前发给父节点，这时候不能缓存，否则直连失败后不会重试
+        size_t hit_times             = tree.child_g->get_route_cache_hit_times();
+        atbus::endpoint *test_ep     = NULL;
+        atbus::connection *test_conn = NULL;
+        for (int i = 0; i < 2; ++i) {
+            int res = tree.child_g->get_remote_channel(tree.child_p->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, res);
+            CASE_EXPECT_NE(NULL, test_conn);
+            CASE_EXPECT_NE(NULL, test_ep);
+            if (NULL != test_ep) {
+                CASE_EXPECT_EQ(tree.parent_g->get_id(), test_ep->get_id());
+            }
+        }
+        CASE_EXPECT_EQ(hit_times, tree.child_g->get_route_cache_hit_times());
+
+        std::string send_data = "global route";
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, tree.child_g->send_data(tree.child_p->get_id(), 0, send_data.data(), send_data.size()));
+
+        UNITTEST_WAIT_UNTIL(&ev_loop,
+                            recv_msg_history[tree.child_p->get_id()].count > 0 &&
+                                NULL != tree.child_g->get_endpoint(tree.child_p->get_id()) &&
+                                NULL != tree.child_p->get_endpoint(tree.child_g->get_id()),
+                            8000, 64) {
+            tree.proc(proc_t);
+            ++proc_t;
+        }
+
+        // 直连建立前经过两边的父节点和根节点转发
+        CASE_EXPECT_EQ(send_data, recv_msg_history[tree.child_p->get_id()].data);
+        CASE_EXPECT_EQ(4, recv_msg_history[tree.child_p->get_id()].router.size());
+
+        // 对端不一定会反向连接，发起方在注册回包时创建endpoint
+        CASE_EXPECT_TRUE(node_nodesync_test_has_global(*tree.child_g, tree.child_p->get_id()));
+
+        // 对端自己没有全局路由表，因为发起方有所以也允许直连
+        CASE_EXPECT_TRUE(node_nodesync_test_has_global(*tree.child_p, tree.child_g->get_id()));
+
+        UNITTEST_WAIT_UNTIL(&ev_loop, tree.child_g->is_endpoint_available(tree.child_p->get_id()), 8000, 64) {
+            tree.proc(proc_t);
+            ++proc_t;
+        }
+
+        // 直连后的结果可以缓存
+        for (int i = 0; i < 2; ++i) {
+            int res = tree.child_g->get_remote_channel(tree.child_p->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, res);
+            CASE_EXPECT_NE(NULL, test_ep);
+            if (NULL != test_ep) {
+                CASE_EXPECT_EQ(tree.child_p->get_id(), test_ep->get_id());
+            }
+        }
+        hit_times = tree.child_g->get_route_cache_hit_times();
+        tree.child_g->get_remote_channel(tree.child_p->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn);
+        CASE_EXPECT_EQ(hit_times + 1, tree.child_g->get_route_cache_hit_times());
+
+        int count = recv_msg_history[tree.child_p->get_id()].count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, tree.child_g->send_data(tree.child_p->get_id(), 0, send_data.data(), send_data.size()));
+        UNITTEST_WAIT_UNTIL(&ev_loop, count != recv_msg_history[tree.child_p->get_id()].count, 8000, 0) {}
+
+        // 直连后不再经过父节点
+        CASE_EXPECT_EQ(send_data, recv_msg_history[tree.child_p->get_id()].data);
+        CASE_EXPECT_EQ(1, recv_msg_history[tree.child_p->get_id()].router.size());
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 双方都没有全局路由表时，非父子兄弟关系的节点不允许直连
+CASE_TEST(atbus_node_nodesync, global_route_access_deny) {
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    {
+        recv_msg_history.clear();
+        node_nodesync_test_tree_t tree;
+        time_t proc_t = time(NULL) + 1;
+        node_nodesync_test_setup_tree(&ev_loop, tree, proc_t);
+
+        atbus::node::conf_t conf;
+        atbus::node::default_conf(&conf);
+        conf.ev_loop        = &ev_loop;
+        conf.children_mask  = 0;
+        conf.father_address = "ipv4://127.0.0.1:16388";
+
+        atbus::node::ptr_t child_x;
+        node_nodesync_test_init_node(child_x, 0x12346702, "ipv4://127.0.0.1:16392", conf);
+        UNITTEST_WAIT_UNTIL(&ev_loop, child_x->is_endpoint_available(tree.parent_g->get_id()), 8000, 64) {
+            tree.proc(proc_t);
+            child_x->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        int register_count = recv_msg_history[child_x->get_id()].register_count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, child_x->connect("ipv4://127.0.0.1:16391"));
+        UNITTEST_WAIT_UNTIL(&ev_loop, register_count != recv_msg_history[child_x->get_id()].register_count, 8000, 64) {
+            tree.proc(proc_t);
+            child_x->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        CASE_EXPECT_LT(recv_msg_history[child_x->get_id()].register_status, 0);
+        CASE_EXPECT_FALSE(node_nodesync_test_has_global(*tree.child_p, child_x->get_id()));
+        CASE_EXPECT_FALSE(node_nodesync_test_has_global(*child_x, tree.child_p->get_id()));
+        CASE_EXPECT_EQ(NULL, tree.child_p->get_endpoint(child_x->get_id()));
+        CASE_EXPECT_EQ(NULL, child_x->get_endpoint(tree.child_p->get_id()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 广播过滤: 只有收到过对端子树的同步数据后才按订阅过滤，还没同步的对端总是转发
+CASE_TEST(atbus_node_nodesync, broadcast_filter_synced_peer) {
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    {
+        recv_msg_history.clear();
+        atbus::node::conf_t conf;
+        atbus::node::default_conf(&conf);
+        conf.ev_loop       = &ev_loop;
+        conf.children_mask = 16;
+        conf.flags.set(atbus::node::conf_flag_t::EN_CONF_BROADCAST_FILTER, true);
+
+        atbus::node::ptr_t root;
+        node_nodesync_test_init_node(root, 0x12345678, "ipv4://127.0.0.1:16387", conf);
+
+        conf.children_mask  = 0;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        conf.type_name      = "filter_svc";
+        atbus::node::ptr_t child;
+        node_nodesync_test_init_node(child, 0x12346701, "ipv4://127.0.0.1:16388", conf);
+
+        time_t proc_t = time(NULL) + 1;
+        UNITTEST_WAIT_UNTIL(&ev_loop,
+                            child->is_endpoint_available(root->get_id()) && NULL != root->get_route_table().get_peer(child->get_id()) &&
+                                0 != root->get_route_table().get_peer(child->get_id())->recv_version,
+                            8000, 64) {
+            root->proc(proc_t, 0);
+            child->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        atbus::protocol::custom_route_data match_data;
+        match_data.type_name = "filter_svc";
+        atbus::protocol::custom_route_data other_data;
+        other_data.type_name = "other_svc";
+
+        // 已同步的子节点按订阅过滤
+        const atbus::endpoint *child_ep = root->get_endpoint(child->get_id());
+        CASE_EXPECT_NE(NULL, child_ep);
+        if (NULL != child_ep) {
+            CASE_EXPECT_TRUE(root->has_broadcast_subscriber(*child_ep, match_data));
+            CASE_EXPECT_FALSE(root->has_broadcast_subscriber(*child_ep, other_data));
+        }
+
+        // 还没有发过同步数据的子节点，路由表里没有它的子树，不能过滤
+        std::vector<std::string> no_tags;
+        atbus::endpoint::ptr_t unsynced_ep =
+            atbus::endpoint::create(root.get(), 0x12346702, 0, root->get_pid(), root->get_hostname(), "filter_svc", no_tags);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, root->add_endpoint(unsynced_ep));
+        CASE_EXPECT_EQ(NULL, root->get_route_table().get_peer(unsynced_ep->get_id()));
+        CASE_EXPECT_TRUE(root->has_broadcast_subscriber(*unsynced_ep, match_data));
+        CASE_EXPECT_TRUE(root->has_broadcast_subscriber(*unsynced_ep, other_data));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
@@ -833,6 +833,223 @@ CASE_TEST(atbus_node_reg, mem_and_send) {
     free(memory_chan_buf);
 }
 
+// 路由缓存测试: 命中、更好的连接加入后失效、endpoint重置和移除后失效
+CASE_TEST(atbus_node_reg, route_cache) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    const size_t memory_chan_len = conf.recv_buffer_size;
+    char *memory_chan_buf        = reinterpret_cast<char *>(malloc(memory_chan_len));
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug          = node_reg_test_on_debug;
+        node2->on_debug          = node_reg_test_on_debug;
+        node1->set_on_error_handle(node_reg_test_on_error);
+        node2->set_on_error_handle(node_reg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+        char mem_chan_addr[64] = {0};
+        UTIL_STRFUNC_SNPRINTF(mem_chan_addr, sizeof(mem_chan_addr), "mem://0x%llx", reinterpret_cast<unsigned long long>(memory_chan_buf));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen(mem_chan_addr));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, node1->is_endpoint_available(node2->get_id()) && node2->is_endpoint_available(node1->get_id()),
+                            8000, 64) {
+            ++proc_t;
+            node1->proc(proc_t, 0);
+            node2->proc(proc_t, 0);
+        }
+
+        // 连续查询时第二次命中缓存，结果不变
+        atbus::endpoint *first_ep     = NULL;
+        atbus::connection *first_conn = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, &first_ep, &first_conn));
+        size_t hit_times             = node1->get_route_cache_hit_times();
+        atbus::endpoint *test_ep     = NULL;
+        atbus::connection *test_conn = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn));
+        CASE_EXPECT_EQ(hit_times + 1, node1->get_route_cache_hit_times());
+        CASE_EXPECT_EQ(first_ep, test_ep);
+        CASE_EXPECT_EQ(first_conn, test_conn);
+        if (NULL == first_ep || NULL == first_conn) {
+            unit_test_setup_exit(&ev_loop);
+            free(memory_chan_buf);
+            return;
+        }
+
+        // 内存通道连接完成前一直查询保持缓存有效，连接完成后不能再返回缓存的旧连接
+        for (time_t i = 1; i <= 32; ++i) {
+            node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn);
+            node1->proc(proc_t, i * 16);
+            node2->proc(proc_t, i * 16);
+        }
+
+        atbus::connection *best_conn = node1->get_self_endpoint()->get_data_connection(first_ep);
+        CASE_EXPECT_NE(NULL, best_conn);
+        if (NULL != best_conn) {
+            CASE_EXPECT_EQ(0, UTIL_STRFUNC_STRNCASE_CMP("mem:", best_conn->get_address().address.c_str(), 4));
+        }
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn));
+        CASE_EXPECT_EQ(best_conn, test_conn);
+
+        // endpoint重置后缓存失效
+        atbus::endpoint *node1_ep = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node2->get_remote_channel(node1->get_id(), &atbus::endpoint::get_data_connection, &node1_ep, &test_conn));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node2->get_remote_channel(node1->get_id(), &atbus::endpoint::get_data_connection, &node1_ep, &test_conn));
+        hit_times = node2->get_route_cache_hit_times();
+        CASE_EXPECT_NE(NULL, node1_ep);
+        if (NULL != node1_ep) {
+            node1_ep->reset();
+            test_conn = NULL;
+            CASE_EXPECT_GT(0, node2->get_remote_channel(node1->get_id(), &atbus::endpoint::get_data_connection, NULL, &test_conn));
+            CASE_EXPECT_EQ(NULL, test_conn);
+            CASE_EXPECT_EQ(hit_times, node2->get_route_cache_hit_times());
+        }
+
+        // endpoint移除后缓存失效
+        hit_times = node1->get_route_cache_hit_times();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->remove_endpoint(node2->get_id()));
+        test_conn = NULL;
+        CASE_EXPECT_GT(0, node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, NULL, &test_conn));
+        CASE_EXPECT_EQ(NULL, test_conn);
+        CASE_EXPECT_EQ(hit_times, node1->get_route_cache_hit_times());
+    }
+
+    unit_test_setup_exit(&ev_loop);
+
+    free(memory_chan_buf);
+}
+
+static int node_reg_test_recv_and_remove_conn_fn(const atbus::node &n, const atbus::endpoint *ep, const atbus::connection *conn,
+                                                 const atbus::protocol::msg &m, const void *buffer, size_t len) {
+    node_reg_test_recv_msg_test_record_fn(n, ep, conn, m, buffer, len);
+
+    // 在接收回调里断开正在接收的内存通道
+    if (NULL != conn && 0 == UTIL_STRFUNC_STRNCASE_CMP("mem:", conn->get_address().address.c_str(), 4)) {
+        const_cast<atbus::connection *>(conn)->reset();
+    }
+    return 0;
+}
+
+// 内存通道: 连续空闲后收到数据最多延迟proc_max_backoff次proc，接收回调里移除连接后不再接收
+CASE_TEST(atbus_node_reg, mem_idle_recv_and_remove) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    CASE_EXPECT_EQ(0, conf.proc_max_backoff);
+    conf.children_mask    = 16;
+    conf.proc_max_backoff = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    const size_t memory_chan_len = conf.recv_buffer_size;
+    char *memory_chan_buf        = reinterpret_cast<char *>(malloc(memory_chan_len));
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug          = node_reg_test_on_debug;
+        node2->on_debug          = node_reg_test_on_debug;
+        node1->set_on_error_handle(node_reg_test_on_error);
+        node2->set_on_error_handle(node_reg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+        char mem_chan_addr[64] = {0};
+        UTIL_STRFUNC_SNPRINTF(mem_chan_addr, sizeof(mem_chan_addr), "mem://0x%llx", reinterpret_cast<unsigned long long>(memory_chan_buf));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen(mem_chan_addr));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, node1->is_endpoint_available(node2->get_id()) && node2->is_endpoint_available(node1->get_id()),
+                            8000, 64) {
+            ++proc_t;
+            node1->proc(proc_t, 0);
+            node2->proc(proc_t, 0);
+        }
+
+        // wait memory channel to complete
+        for (time_t i = 1; i <= 32; ++i) {
+            node1->proc(proc_t, i * 16);
+            node2->proc(proc_t, i * 16);
+        }
+
+        atbus::endpoint *test_ep     = NULL;
+        atbus::connection *test_conn = NULL;
+        node1->get_remote_channel(node2->get_id(), &atbus::endpoint::get_data_connection, &test_ep, &test_conn);
+        CASE_EXPECT_NE(NULL, test_conn);
+        if (NULL == test_conn || 0 != UTIL_STRFUNC_STRNCASE_CMP("mem:", test_conn->get_address().address.c_str(), 4)) {
+            CASE_MSG_INFO() << "memory channel is not ready, skip" << std::endl;
+            unit_test_setup_exit(&ev_loop);
+            free(memory_chan_buf);
+            return;
+        }
+
+        // 连续空闲，内存通道的跳过轮次达到上限
+        for (time_t i = 1; i <= 64; ++i) {
+            node2->proc(proc_t, i);
+        }
+
+        int count = recv_msg_history.count;
+        node2->set_on_recv_handle(node_reg_test_recv_and_remove_conn_fn);
+        std::string first_data  = "first message";
+        std::string second_data = "second message";
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, first_data.data(), first_data.size()));
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, second_data.data(), second_data.size()));
+
+        size_t proc_times = 0;
+        while (count == recv_msg_history.count && proc_times <= 2 * conf.proc_max_backoff) {
+            ++proc_times;
+            node2->proc(proc_t, 0);
+        }
+
+        CASE_EXPECT_LE(proc_times, conf.proc_max_backoff + 1);
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(first_data, recv_msg_history.data);
+
+        // 连接已经在回调里移除，剩下的数据不会再被接收
+        for (time_t i = 1; i <= 32; ++i) {
+            node2->proc(proc_t, i);
+        }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+
+        node2->set_on_recv_handle(node_reg_test_recv_msg_test_record_fn);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+
+    free(memory_chan_buf);
+}
+
 #if defined(ATBUS_CHANNEL_SHM) && ATBUS_CHANNEL_SHM
 
 static bool node_reg_test_is_shm_available(const atbus::node::conf_t &conf) {
@@ -0,0 +1,121 @@
+﻿#include <cstddef>
+#include <vector>
+
+#include <detail/poll_scheduler.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_poll_scheduler, idle_backoff) {
+    atbus::detail::poll_scheduler sched;
+    sched.reset(0, 8);
+
+    int channel = 0;
+    sched.add(&channel);
+    CASE_EXPECT_EQ(1, sched.size());
+
+    // 连续空闲时检查的间隔按0、1、3、7、8、8...增长
+    std::vector<size_t> checked_rounds;
+    for (size_t round = 0; round < 40; ++round) {
+        if (sched.check(0)) {
+            checked_rounds.push_back(round);
+            sched.on_idle(0);
+        }
+    }
+
+    const size_t expect_rounds[] = {0, 1, 3, 7, 15, 24, 33};
+    CASE_EXPECT_EQ(sizeof(expect_rounds) / sizeof(expect_rounds[0]), checked_rounds.size());
+    for (size_t i = 0; i < checked_rounds.size() && i < sizeof(expect_rounds) / sizeof(expect_rounds[0]); ++i) {
+        CASE_EXPECT_EQ(expect_rounds[i], checked_rounds[i]);
+    }
+
+    // 有数据后立刻恢复每轮检查
+    CASE_EXPECT_GT(sched.at(0).skip_left, 0);
+    sched.grant(0);
+    CASE_EXPECT_EQ(0, sched.at(0).skip_left);
+    CASE_EXPECT_TRUE(sched.check(0));
+
+    // max_backoff为0时不跳过
+    sched.reset(0, 0);
+    sched.add(&channel);
+    for (int i = 0; i < 10; ++i) {
+        CASE_EXPECT_TRUE(sched.check(0));
+        sched.on_idle(0);
+    }
+}
+
+CASE_TEST(atbus_poll_scheduler, deficit_round_robin) {
+    atbus::detail::poll_scheduler sched;
+    const size_t quantum = 1000;
+    sched.reset(quantum, 0);
+
+    // 两个一直有数据的通道，一个每条100字节，一个每条1500字节
+    int channels[2];
+    const size_t msg_size[2] = {100, 1500};
+    size_t total[2]          = {0, 0};
+    sched.add(&channels[0]);
+    sched.add(&channels[1]);
+
+    for (int round = 0; round < 300; ++round) {
+        for (size_t i = 0; i < sched.size(); ++i) {
+            if (!sched.check(i)) {
+                continue;
+            }
+
+            size_t budget = sched.grant(i);
+            size_t used   = 0;
+            // 和proc一样，配额没用完就继续接收，最后一条可以超出
+            while (used < budget) {
+                used += msg_size[i];
+            }
+            total[i] += used;
+            sched.consume(i, used, false);
+        }
+    }
+
+    // 按字节平均分配，和单条消息大小无关
+    CASE_EXPECT_LE(total[0], 300 * quantum + msg_size[0]);
+    CASE_EXPECT_LE(total[1], 300 * quantum + msg_size[1]);
+    CASE_EXPECT_GE(total[1], 300 * quantum - msg_size[1]);
+    CASE_EXPECT_GE(total[0], 300 * quantum - msg_size[0]);
+
+    // 通道清空后不保留剩余配额
+    sched.consume(0, 0, true);
+    CASE_EXPECT_LE(sched.at(0).deficit, 0);
+    CASE_EXPECT_EQ(quantum, sched.grant(0));
+}
+
+CASE_TEST(atbus_poll_scheduler, remove_while_iterating) {
+    atbus::detail::poll_scheduler sched;
+    sched.reset(0, 0);
+
+    int channels[4];
+    for (int i = 0; i < 4; ++i) {
+        sched.add(&channels[i]);
+    }
+
+    size_t visited = 0;
+    for (size_t i = 0; i < sched.size(); ++i) {
+        if (!sched.check(i)) {
+            continue;
+        }
+        ++visited;
+
+        // 遍历期间移除自身和后面的通道，并追加新通道
+        if (0 == i) {
+            CASE_EXPECT_TRUE(sched.remove(&channels[0]));
+            CASE_EXPECT_TRUE(sched.remove(&channels[2]));
+            CASE_EXPECT_FALSE(sched.remove(&channels[2]));
+            sched.add(&channels[2]);
+        }
+    }
+
+    // 0、1、3和新追加的2
+    CASE_EXPECT_EQ(4, visited);
+    CASE_EXPECT_EQ(5, sched.size());
+
+    sched.compact();
+    CASE_EXPECT_EQ(3, sched.size());
+    CASE_EXPECT_TRUE(&channels[1] == sched.get(0));
+    CASE_EXPECT_TRUE(&channels[3] == sched.get(1));
+    CASE_EXPECT_TRUE(&channels[2] == sched.get(2));
+}
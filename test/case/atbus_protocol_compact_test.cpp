@@ -0,0 +1,107 @@
+﻿#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <detail/libatbus_error.h>
+#include <detail/libatbus_protocol.h>
+#include <detail/libatbus_protocol_compact.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_protocol_compact, pack_and_unpack) {
+    const char content[] = "hello compact data";
+
+    atbus::protocol::msg m;
+    m.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, -7, 0x87654321);
+    m.body.make_forward(0x12345678, 0x12356789, content, sizeof(content));
+    m.body.forward->router.push_back(0x12345678);
+    m.body.forward->router.push_back(0x12340000);
+    m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+
+    CASE_EXPECT_TRUE(atbus::detail::fn::compact_data_check(m));
+    size_t packed_size = atbus::detail::fn::compact_data_packed_size(m);
+    CASE_EXPECT_EQ(ATBUS_COMPACT_DATA_HEAD_SIZE + 2 * sizeof(uint64_t) + sizeof(content), packed_size);
+
+    std::vector<unsigned char> buffer;
+    buffer.resize(packed_size);
+    CASE_EXPECT_EQ(0, atbus::detail::fn::compact_data_pack(m, &buffer[0], packed_size - 1));
+    CASE_EXPECT_EQ(packed_size, atbus::detail::fn::compact_data_pack(m, &buffer[0], packed_size));
+    CASE_EXPECT_TRUE(atbus::detail::fn::compact_data_check_magic(&buffer[0], buffer.size()));
+
+    atbus::protocol::msg res;
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::detail::fn::compact_data_unpack(res, &buffer[0], buffer.size()));
+    CASE_EXPECT_EQ(ATBUS_CMD_DATA_TRANSFORM_REQ, res.head.cmd);
+    CASE_EXPECT_EQ(123, res.head.type);
+    CASE_EXPECT_EQ(-7, res.head.ret);
+    CASE_EXPECT_EQ(0x87654321, res.head.sequence);
+    CASE_EXPECT_EQ(0x12345678, res.head.src_bus_id);
+    CASE_EXPECT_NE(NULL, res.body.forward);
+    if (NULL == res.body.forward) {
+        return;
+    }
+
+    CASE_EXPECT_EQ(0x12345678, res.body.forward->from);
+    CASE_EXPECT_EQ(0x12356789, res.body.forward->to);
+    CASE_EXPECT_TRUE(res.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP));
+    CASE_EXPECT_EQ(2, res.body.forward->router.size());
+    if (2 == res.body.forward->router.size()) {
+        CASE_EXPECT_EQ(0x12345678, res.body.forward->router[0]);
+        CASE_EXPECT_EQ(0x12340000, res.body.forward->router[1]);
+    }
+
+    // 数据直接引用接收缓冲区
+    CASE_EXPECT_EQ(sizeof(content), res.body.forward->content.size);
+    CASE_EXPECT_EQ(&buffer[packed_size - sizeof(content)], res.body.forward->content.ptr);
+    CASE_EXPECT_EQ(0, memcmp(content, res.body.forward->content.ptr, sizeof(content)));
+
+    // 广播时共用打包数据，只修改目标ID
+    CASE_EXPECT_TRUE(atbus::detail::fn::compact_data_set_to(&buffer[0], buffer.size(), 0x12356790));
+    atbus::protocol::msg patched;
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::detail::fn::compact_data_unpack(patched, &buffer[0], buffer.size()));
+    if (NULL != patched.body.forward) {
+        CASE_EXPECT_EQ(0x12356790, patched.body.forward->to);
+        CASE_EXPECT_EQ(0x12345678, patched.body.forward->from);
+        CASE_EXPECT_EQ(2, patched.body.forward->router.size());
+    }
+    CASE_EXPECT_FALSE(atbus::detail::fn::compact_data_set_to(&buffer[0], ATBUS_COMPACT_DATA_HEAD_SIZE - 1, 0x12356790));
+}
+
+CASE_TEST(atbus_protocol_compact, fallback_and_bad_data) {
+    const char content[] = "bad data";
+
+    // 非数据转发消息和带自定义路由数据的消息不使用紧凑编码
+    atbus::protocol::msg ping;
+    ping.init(0x12345678, ATBUS_CMD_NODE_PING, 0, 0, 1);
+    ping.body.make_body(ping.body.ping);
+    CASE_EXPECT_FALSE(atbus::detail::fn::compact_data_check(ping));
+    CASE_EXPECT_EQ(0, atbus::detail::fn::compact_data_packed_size(ping));
+
+    atbus::protocol::msg m;
+    m.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_RSP, 0, 0, 2);
+    m.body.make_forward(0x12345678, 0x12356789, content, sizeof(content));
+    m.body.forward->route_data = std::make_shared<atbus::protocol::custom_route_data>();
+    CASE_EXPECT_FALSE(atbus::detail::fn::compact_data_check(m));
+
+    m.body.forward->route_data.reset();
+    CASE_EXPECT_TRUE(atbus::detail::fn::compact_data_check(m));
+
+    std::vector<unsigned char> buffer;
+    buffer.resize(atbus::detail::fn::compact_data_packed_size(m));
+    CASE_EXPECT_EQ(buffer.size(), atbus::detail::fn::compact_data_pack(m, &buffer[0], buffer.size()));
+
+    // 长度和头部不匹配
+    atbus::protocol::msg res1;
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_UNPACK, atbus::detail::fn::compact_data_unpack(res1, &buffer[0], buffer.size() - 1));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_UNPACK, atbus::detail::fn::compact_data_unpack(res1, &buffer[0], ATBUS_COMPACT_DATA_HEAD_SIZE - 1));
+
+    // 不支持的命令
+    buffer[1] = static_cast<unsigned char>(ATBUS_CMD_NODE_PING);
+    atbus::protocol::msg res2;
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_UNPACK, atbus::detail::fn::compact_data_unpack(res2, &buffer[0], buffer.size()));
+
+    // msgpack数据不会被识别为紧凑编码
+    buffer[0] = 0x82;
+    CASE_EXPECT_FALSE(atbus::detail::fn::compact_data_check_magic(&buffer[0], buffer.size()));
+    CASE_EXPECT_FALSE(atbus::detail::fn::compact_data_check_magic(NULL, 0));
+}
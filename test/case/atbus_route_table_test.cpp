@@ -0,0 +1,347 @@
+﻿#include <chrono>
+#include <cstdlib>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <detail/libatbus_route_table.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_route_table, delta_and_find) {
+    atbus::detail::route_table table;
+    table.reset(0x12345678);
+
+    std::list<std::string> listen;
+    listen.push_back("ipv4://127.0.0.1:16387");
+    CASE_EXPECT_TRUE(table.update_direct(0x12345678, 16, "localhost", listen, "router", std::vector<std::string>()));
+    CASE_EXPECT_FALSE(table.update_direct(0x12345678, 16, "localhost", listen, "router", std::vector<std::string>()));
+    CASE_EXPECT_EQ(1, table.get_version());
+
+    atbus::protocol::node_tree tree;
+    tree.base_version = 0;
+    tree.version      = 3;
+    tree.nodes.resize(3);
+    tree.nodes[0].bus_id           = 0x12350000;
+    tree.nodes[0].children_id_mask = 16;
+    tree.nodes[0].channels.resize(1);
+    tree.nodes[0].channels[0].address = "ipv4://127.0.0.1:16388";
+    tree.nodes[1].bus_id              = 0x12350001;
+    tree.nodes[2].bus_id              = 0x12345679; // 在自身子树内，不接受
+
+    atbus::detail::route_table::scope_t outside(0x12345678, 16, false);
+    CASE_EXPECT_EQ(2, table.apply(tree, 0x12350000, outside));
+    CASE_EXPECT_EQ(3, table.size());
+
+    // 覆盖目标的子域最小的节点
+    CASE_EXPECT_NE(NULL, table.find(0x12350001));
+    if (NULL != table.find(0x12350001)) {
+        CASE_EXPECT_EQ(0x12350001, table.find(0x12350001)->bus_id);
+    }
+    CASE_EXPECT_NE(NULL, table.find(0x12350002));
+    if (NULL != table.find(0x12350002)) {
+        CASE_EXPECT_EQ(0x12350000, table.find(0x12350002)->bus_id);
+    }
+    CASE_EXPECT_EQ(NULL, table.find(0x12360000));
+
+    // 增量只包含变更的记录
+    uint64_t synced = table.get_version();
+    tree.base_version = 3;
+    tree.version      = 4;
+    tree.nodes.resize(1);
+    tree.nodes[0]         = atbus::protocol::node_data();
+    tree.nodes[0].bus_id  = 0x12350001;
+    tree.nodes[0].removed = true;
+    CASE_EXPECT_EQ(1, table.apply(tree, 0x12350000, outside));
+    CASE_EXPECT_EQ(2, table.size());
+    CASE_EXPECT_NE(NULL, table.find(0x12350001));
+    if (NULL != table.find(0x12350001)) {
+        CASE_EXPECT_EQ(0x12350000, table.find(0x12350001)->bus_id);
+    }
+
+    atbus::protocol::node_tree delta;
+    atbus::detail::route_table::scope_t all(0, 64, true);
+    CASE_EXPECT_EQ(1, table.make_delta(synced, all, delta));
+    CASE_EXPECT_EQ(synced, delta.base_version);
+    CASE_EXPECT_EQ(table.get_version(), delta.version);
+    CASE_EXPECT_TRUE(delta.nodes[0].removed);
+
+    // 全量不包含墓碑
+    CASE_EXPECT_EQ(2, table.make_delta(0, all, delta));
+    CASE_EXPECT_EQ(0, delta.base_version);
+
+    // 清理墓碑后，更早的增量只能用全量代替
+    CASE_EXPECT_EQ(1, table.purge(table.get_version()));
+    CASE_EXPECT_EQ(2, table.make_delta(synced, all, delta));
+    CASE_EXPECT_EQ(0, delta.base_version);
+
+    // 移除来源节点
+    CASE_EXPECT_EQ(1, table.remove_source(0x12350000));
+    CASE_EXPECT_EQ(1, table.size());
+    CASE_EXPECT_EQ(NULL, table.find(0x12350002));
+}
+
+CASE_TEST(atbus_route_table, subscriber) {
+    // 子节点上报自身子树，父节点按子树过滤广播
+    atbus::detail::route_table child;
+    child.reset(0x12350000);
+    std::vector<std::string> tags;
+    tags.push_back("zone1");
+    child.update_direct(0x12350000, 8, "localhost", std::list<std::string>(), "router", std::vector<std::string>());
+    child.update_direct(0x12350001, 0, "localhost", std::list<std::string>(), "gamesvr", tags);
+    child.update_direct(0x12350002, 0, "localhost", std::list<std::string>(), "dbsvr", std::vector<std::string>());
+
+    atbus::detail::route_table parent;
+    parent.reset(0x12000000);
+    parent.update_direct(0x12350000, 8, "localhost", std::list<std::string>(), "router", std::vector<std::string>());
+    parent.update_direct(0x12360000, 8, "localhost", std::list<std::string>(), "router", std::vector<std::string>());
+
+    atbus::protocol::node_tree tree;
+    atbus::detail::route_table::scope_t child_scope(0x12350000, 8, true);
+    CASE_EXPECT_EQ(3, child.make_delta(0, child_scope, tree));
+    CASE_EXPECT_EQ(2, parent.apply(tree, 0x12350000, child_scope));
+
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12350000, 8, "gamesvr", ""));
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12350000, 8, "gamesvr", "zone1"));
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12350000, 8, "", "zone1"));
+    CASE_EXPECT_FALSE(parent.has_subscriber(0x12350000, 8, "gamesvr", "zone2"));
+    CASE_EXPECT_FALSE(parent.has_subscriber(0x12360000, 8, "gamesvr", ""));
+    // 子域节点自身也算
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12360000, 8, "router", ""));
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12360000, 8, "", ""));
+
+    // 下线后不再是订阅者
+    uint64_t synced = child.get_version();
+    child.remove_source(0x12350001);
+    CASE_EXPECT_EQ(1, child.make_delta(synced, child_scope, tree));
+    CASE_EXPECT_EQ(1, parent.apply(tree, 0x12350000, child_scope));
+    CASE_EXPECT_FALSE(parent.has_subscriber(0x12350000, 8, "gamesvr", ""));
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12350000, 8, "dbsvr", ""));
+
+    // 类型变更
+    parent.update_direct(0x12360000, 8, "localhost", std::list<std::string>(), "proxy", std::vector<std::string>());
+    CASE_EXPECT_FALSE(parent.has_subscriber(0x12360000, 8, "router", ""));
+    CASE_EXPECT_TRUE(parent.has_subscriber(0x12360000, 8, "proxy", ""));
+}
+
+namespace {
+    struct route_sim_node {
+        atbus::detail::route_table::bus_id_t id;
+        uint32_t mask;
+        int parent;
+        bool global_router;
+        std::vector<int> children;
+        atbus::detail::route_table table;
+    };
+
+    struct route_sim_msg {
+        int from;
+        int to;
+        atbus::protocol::node_tree tree;
+    };
+
+    struct route_sim_tree {
+        std::vector<route_sim_node> nodes;
+        std::vector<int> tops;
+        size_t msg_count;
+        size_t entry_count;
+
+        route_sim_tree() : msg_count(0), entry_count(0) {}
+
+        int add_node(atbus::detail::route_table::bus_id_t id, uint32_t mask, int parent, bool global_router) {
+            nodes.push_back(route_sim_node());
+            route_sim_node &n = nodes.back();
+            n.id              = id;
+            n.mask            = mask;
+            n.parent          = parent;
+            n.global_router   = global_router;
+            n.table.reset(id);
+
+            int idx = static_cast<int>(nodes.size() - 1);
+            if (parent >= 0) {
+                nodes[parent].children.push_back(idx);
+            } else {
+                tops.push_back(idx);
+            }
+            return idx;
+        }
+
+        static std::list<std::string> make_listen(atbus::detail::route_table::bus_id_t id) {
+            std::stringstream ss;
+            ss << "ipv4://127.0.0.1:" << (id & 0xFFFF);
+            std::list<std::string> ret;
+            ret.push_back(ss.str());
+            return ret;
+        }
+
+        void add_direct(int self, int peer) {
+            route_sim_node &p = nodes[peer];
+            nodes[self].table.update_direct(p.id, p.mask, "localhost", make_listen(p.id), "", std::vector<std::string>());
+        }
+
+        // 和atbus::node::get_node_sync_scope一致的同步关系
+        void connect_all() {
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                int self = static_cast<int>(i);
+                add_direct(self, self);
+                if (nodes[i].parent >= 0) {
+                    add_direct(self, nodes[i].parent);
+                } else {
+                    for (size_t j = 0; j < tops.size(); ++j) {
+                        if (tops[j] != self) {
+                            add_direct(self, tops[j]);
+                        }
+                    }
+                }
+                for (size_t j = 0; j < nodes[i].children.size(); ++j) {
+                    add_direct(self, nodes[i].children[j]);
+                }
+            }
+        }
+
+        void push_to(int self, int peer, const atbus::detail::route_table::scope_t &scope, std::vector<route_sim_msg> &out) {
+            atbus::detail::route_table::peer_t &state = nodes[self].table.mutable_peer(nodes[peer].id);
+            route_sim_msg msg;
+            msg.from = self;
+            msg.to   = peer;
+            if (0 == nodes[self].table.make_delta(state.sent_version, scope, msg.tree, state.checked_version)) {
+                state.checked_version = msg.tree.version;
+                return;
+            }
+
+            state.sent_version    = msg.tree.version;
+            state.checked_version = msg.tree.version;
+            entry_count += msg.tree.nodes.size();
+            ++msg_count;
+            out.push_back(msg);
+        }
+
+        void push(int self, std::vector<route_sim_msg> &out) {
+            route_sim_node &n = nodes[self];
+            if (n.parent >= 0) {
+                push_to(self, n.parent, atbus::detail::route_table::scope_t(n.id, n.mask, true), out);
+            } else {
+                for (size_t i = 0; i < tops.size(); ++i) {
+                    if (tops[i] != self) {
+                        push_to(self, tops[i], atbus::detail::route_table::scope_t(n.id, n.mask, true), out);
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < n.children.size(); ++i) {
+                route_sim_node &c = nodes[n.children[i]];
+                if (c.global_router) {
+                    push_to(self, n.children[i], atbus::detail::route_table::scope_t(c.id, c.mask, false), out);
+                }
+            }
+        }
+
+        bool recv(const route_sim_msg &msg) {
+            route_sim_node &self = nodes[msg.to];
+            route_sim_node &from = nodes[msg.from];
+
+            atbus::detail::route_table::scope_t scope;
+            if (self.parent == msg.from) {
+                scope = atbus::detail::route_table::scope_t(self.id, self.mask, false);
+            } else if (from.parent == msg.to) {
+                scope = atbus::detail::route_table::scope_t(from.id, from.mask, true);
+            } else {
+                scope = atbus::detail::route_table::scope_t(from.id, from.mask, true);
+            }
+
+            atbus::detail::route_table::peer_t &state = self.table.mutable_peer(from.id);
+            if (0 != msg.tree.base_version && msg.tree.base_version != state.recv_version) {
+                return false;
+            }
+            state.recv_version = msg.tree.version;
+            return self.table.apply(msg.tree, from.id, scope) > 0;
+        }
+
+        // 每一轮所有节点推送一次增量，返回收敛需要的轮数
+        size_t run_until_stable(size_t max_round) {
+            for (size_t round = 1; round <= max_round; ++round) {
+                std::vector<route_sim_msg> msgs;
+                for (size_t i = 0; i < nodes.size(); ++i) {
+                    push(static_cast<int>(i), msgs);
+                }
+
+                if (msgs.empty()) {
+                    return round - 1;
+                }
+
+                for (size_t i = 0; i < msgs.size(); ++i) {
+                    recv(msgs[i]);
+                }
+            }
+
+            return max_round + 1;
+        }
+
+        bool all_global_router_know(atbus::detail::route_table::bus_id_t id, bool exists) {
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (!nodes[i].global_router) {
+                    continue;
+                }
+
+                const atbus::detail::route_table::entry_t *ent = nodes[i].table.get(id);
+                bool found                                      = NULL != ent && !ent->removed;
+                if (found != exists) {
+                    return false;
+                }
+
+                if (exists && ent->listen.empty()) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
+} // namespace
+
+CASE_TEST(atbus_route_table, convergence_benchmark) {
+    // 三层树: 4个顶层节点，每个下面16个子节点，每个子节点下面8个孙节点，所有子节点和一半的孙节点需要全局路由表
+    route_sim_tree sim;
+    for (int i = 0; i < 4; ++i) {
+        atbus::detail::route_table::bus_id_t top_id = static_cast<atbus::detail::route_table::bus_id_t>(i + 1) << 16;
+        int top                                       = sim.add_node(top_id, 16, -1, false);
+        for (int j = 0; j < 16; ++j) {
+            atbus::detail::route_table::bus_id_t mid_id = top_id | (static_cast<atbus::detail::route_table::bus_id_t>(j + 1) << 8);
+            int mid                                       = sim.add_node(mid_id, 8, top, true);
+            for (int k = 0; k < 8; ++k) {
+                sim.add_node(mid_id | static_cast<atbus::detail::route_table::bus_id_t>(k + 1), 0, mid, 0 == (k & 1));
+            }
+        }
+    }
+    sim.connect_all();
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    size_t rounds                               = sim.run_until_stable(32);
+    std::chrono::steady_clock::time_point end   = std::chrono::steady_clock::now();
+
+    CASE_EXPECT_LE(rounds, 8);
+    for (size_t i = 0; i < sim.nodes.size(); ++i) {
+        CASE_EXPECT_TRUE(sim.all_global_router_know(sim.nodes[i].id, true));
+    }
+    CASE_MSG_INFO() << "route table of " << sim.nodes.size() << " nodes converged in " << rounds << " rounds, " << sim.msg_count
+                    << " messages, " << sim.entry_count << " entries, cost "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "us" << std::endl;
+
+    // 一个孙节点下线，只需要同步墓碑
+    size_t full_entry_count = sim.entry_count;
+    int leaf                = sim.nodes[sim.tops[1]].children[3];
+    leaf                    = sim.nodes[leaf].children[5];
+    int leaf_parent         = sim.nodes[leaf].parent;
+    sim.nodes[leaf_parent].table.remove_source(sim.nodes[leaf].id);
+
+    begin  = std::chrono::steady_clock::now();
+    rounds = sim.run_until_stable(32);
+    end    = std::chrono::steady_clock::now();
+
+    CASE_EXPECT_LE(rounds, 8);
+    CASE_EXPECT_TRUE(sim.all_global_router_know(sim.nodes[leaf].id, false));
+    CASE_EXPECT_LT(sim.entry_count - full_entry_count, sim.nodes.size());
+    CASE_MSG_INFO() << "node down converged in " << rounds << " rounds, " << (sim.entry_count - full_entry_count) << " entries, cost "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "us" << std::endl;
+}
@@ -0,0 +1,185 @@
+﻿#include <chrono>
+#include <cstring>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <detail/self_msg_ring.h>
+
+#include "frame/test_macros.h"
+
+namespace {
+    std::string self_msg_ring_test_segment(const atbus::detail::self_msg_ring::segment_t &seg) {
+        return std::string(reinterpret_cast<const char *>(seg.ptr), seg.size);
+    }
+} // namespace
+
+CASE_TEST(atbus_self_msg_ring, push_pop_wrap) {
+    atbus::detail::self_msg_ring ring;
+    CASE_EXPECT_TRUE(ring.empty());
+    CASE_EXPECT_TRUE(NULL == ring.front());
+
+    // 每次进两条出一条，反复绕回缓冲区开头，顺序和内容保持不变
+    std::list<std::string> expect;
+    size_t seq    = 0;
+    size_t popped = 0;
+    for (size_t round = 0; round < 2000; ++round) {
+        for (int j = 0; j < 2; ++j) {
+            std::string head = "head-" + std::to_string(seq);
+            std::string body(seq % 97, static_cast<char>('a' + seq % 26));
+            atbus::detail::self_msg_ring::segment_t segs[3];
+            segs[0].ptr  = head.data();
+            segs[0].size = head.size();
+            segs[1].ptr  = NULL;
+            segs[1].size = 0;
+            segs[2].ptr  = body.data();
+            segs[2].size = body.size();
+            ring.push(static_cast<uint32_t>(seq % 3), segs, 3);
+            expect.push_back(head + "|" + body);
+            ++seq;
+        }
+
+        const atbus::detail::self_msg_ring::record_t *r = ring.front();
+        CASE_EXPECT_TRUE(NULL != r);
+        if (NULL == r) {
+            break;
+        }
+        CASE_EXPECT_EQ(popped % 3, r->type);
+        CASE_EXPECT_EQ(3, r->segment_count);
+
+        atbus::detail::self_msg_ring::segment_t segs[3];
+        atbus::detail::self_msg_ring::get_segments(*r, segs);
+        CASE_EXPECT_EQ(0, segs[1].size);
+        CASE_EXPECT_EQ(expect.front(), self_msg_ring_test_segment(segs[0]) + "|" + self_msg_ring_test_segment(segs[2]));
+        expect.pop_front();
+        ring.pop_front();
+        ++popped;
+
+        // 保持队列长度有限，让写入位置绕回
+        if (ring.size() > 64) {
+            while (ring.size() > 8) {
+                r = ring.front();
+                atbus::detail::self_msg_ring::get_segments(*r, segs);
+                CASE_EXPECT_EQ(expect.front(), self_msg_ring_test_segment(segs[0]) + "|" + self_msg_ring_test_segment(segs[2]));
+                expect.pop_front();
+                ring.pop_front();
+                ++popped;
+            }
+        }
+    }
+
+    CASE_EXPECT_EQ(expect.size(), ring.size());
+    CASE_EXPECT_LE(ring.capacity(), 8192);
+
+    ring.reset();
+    CASE_EXPECT_TRUE(ring.empty());
+    CASE_EXPECT_EQ(0, ring.capacity());
+}
+
+CASE_TEST(atbus_self_msg_ring, grow_while_reading) {
+    atbus::detail::self_msg_ring ring;
+    std::string first(100, 'x');
+    atbus::detail::self_msg_ring::segment_t seg;
+    seg.ptr  = first.data();
+    seg.size = first.size();
+    ring.push(1, &seg, 1);
+
+    const atbus::detail::self_msg_ring::record_t *r = ring.front();
+    CASE_EXPECT_TRUE(NULL != r);
+    atbus::detail::self_msg_ring::segment_t reading;
+    atbus::detail::self_msg_ring::get_segments(*r, &reading);
+
+    // 回调里继续发送，触发多次扩容，正在读取的数据仍然有效
+    std::string big(20000, 'y');
+    seg.ptr  = big.data();
+    seg.size = big.size();
+    for (int i = 0; i < 8; ++i) {
+        ring.push(2, &seg, 1);
+    }
+    CASE_EXPECT_EQ(9, ring.size());
+    CASE_EXPECT_GE(ring.capacity(), 8 * big.size());
+    CASE_EXPECT_EQ(first, self_msg_ring_test_segment(reading));
+
+    ring.pop_front();
+    while (!ring.empty()) {
+        r = ring.front();
+        CASE_EXPECT_EQ(2, r->type);
+        atbus::detail::self_msg_ring::get_segments(*r, &reading);
+        CASE_EXPECT_EQ(big, self_msg_ring_test_segment(reading));
+        ring.pop_front();
+    }
+
+    // 这一轮的峰值接近容量，取空后不缩容；下一轮只有少量消息，取空后缩容
+    size_t peak_capacity = ring.capacity();
+    CASE_EXPECT_GE(peak_capacity, 8 * big.size());
+    seg.ptr  = first.data();
+    seg.size = first.size();
+    ring.push(1, &seg, 1);
+    CASE_EXPECT_EQ(peak_capacity, ring.capacity());
+    r = ring.front();
+    atbus::detail::self_msg_ring::get_segments(*r, &reading);
+    CASE_EXPECT_EQ(first, self_msg_ring_test_segment(reading));
+    ring.pop_front();
+    CASE_EXPECT_EQ(atbus::detail::self_msg_ring::MIN_BUFFER_SIZE, ring.capacity());
+}
+
+CASE_TEST(atbus_self_msg_ring, benchmark_1m) {
+    const size_t count = 1000000;
+    const size_t batch = 64;
+    char head[64]      = {0};
+    char body[128]     = {0};
+
+    // 和原来的 std::list<std::vector<unsigned char> > 方式对比: 每批发送batch条再全部派发
+    atbus::detail::self_msg_ring ring;
+    size_t ring_sum                                  = 0;
+    std::chrono::steady_clock::time_point ring_begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i += batch) {
+        for (size_t j = 0; j < batch; ++j) {
+            atbus::detail::self_msg_ring::segment_t segs[3];
+            segs[0].ptr  = head;
+            segs[0].size = sizeof(head);
+            segs[1].ptr  = &j;
+            segs[1].size = sizeof(int);
+            segs[2].ptr  = body;
+            segs[2].size = (i + j) % sizeof(body);
+            ring.push(1, segs, 3);
+        }
+
+        const atbus::detail::self_msg_ring::record_t *r;
+        while (NULL != (r = ring.front())) {
+            atbus::detail::self_msg_ring::segment_t segs[3];
+            atbus::detail::self_msg_ring::get_segments(*r, segs);
+            ring_sum += segs[2].size;
+            ring.pop_front();
+        }
+    }
+    std::chrono::steady_clock::time_point ring_end = std::chrono::steady_clock::now();
+
+    std::list<std::vector<unsigned char> > msg_list;
+    size_t list_sum                                  = 0;
+    std::chrono::steady_clock::time_point list_begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i += batch) {
+        for (size_t j = 0; j < batch; ++j) {
+            size_t body_len = (i + j) % sizeof(body);
+            msg_list.push_back(std::vector<unsigned char>());
+            std::vector<unsigned char> &bin_data = msg_list.back();
+            bin_data.resize(sizeof(head) + sizeof(int) + body_len);
+            memcpy(&bin_data[0], head, sizeof(head));
+            memcpy(&bin_data[sizeof(head)], &j, sizeof(int));
+            memcpy(&bin_data[sizeof(head) + sizeof(int)], body, body_len);
+        }
+
+        while (!msg_list.empty()) {
+            list_sum += msg_list.front().size() - sizeof(head) - sizeof(int);
+            msg_list.pop_front();
+        }
+    }
+    std::chrono::steady_clock::time_point list_end = std::chrono::steady_clock::now();
+    CASE_EXPECT_EQ(list_sum, ring_sum);
+
+    CASE_MSG_INFO() << "self_msg_ring with " << count << " messages: "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(ring_end - ring_begin).count() << "us, capacity "
+                    << ring.capacity() << std::endl;
+    CASE_MSG_INFO() << "std::list with " << count << " messages: "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(list_end - list_begin).count() << "us" << std::endl;
+}
@@ -0,0 +1,221 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <detail/libatbus_service_index.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_service_index, add_remove_select) {
+    atbus::detail::service_index index;
+    typedef atbus::detail::service_index::select_mode_t select_mode_t;
+
+    std::vector<std::string> tags;
+    tags.push_back("zone1");
+    CASE_EXPECT_TRUE(index.add(0x12345001, "gamesvr", tags));
+    CASE_EXPECT_FALSE(index.add(0x12345001, "gamesvr", tags));
+    CASE_EXPECT_TRUE(index.add(0x12345002, "gamesvr", std::vector<std::string>()));
+    CASE_EXPECT_TRUE(index.add(0x12345003, "dbsvr", tags));
+    // 没有类型和tag的对端不索引
+    CASE_EXPECT_FALSE(index.add(0x12345004, "", std::vector<std::string>()));
+    CASE_EXPECT_EQ(3, index.size());
+
+    const atbus::detail::service_index::member_list_t *members = index.get_members("gamesvr", "");
+    CASE_EXPECT_TRUE(NULL != members);
+    if (NULL != members) {
+        CASE_EXPECT_EQ(2, members->size());
+    }
+
+    members = index.get_members("", "zone1");
+    CASE_EXPECT_TRUE(NULL != members);
+    if (NULL != members) {
+        CASE_EXPECT_EQ(2, members->size());
+    }
+
+    CASE_EXPECT_EQ(0x12345001, index.select("gamesvr", "zone1", select_mode_t::EN_SSM_ROUND_ROBIN, 0));
+    CASE_EXPECT_EQ(0, index.select("gamesvr", "zone2", select_mode_t::EN_SSM_ROUND_ROBIN, 0));
+    CASE_EXPECT_EQ(0, index.select("unknown", "", select_mode_t::EN_SSM_RANDOM, 0));
+
+    // 轮询
+    std::map<atbus::detail::service_index::bus_id_t, int> counter;
+    for (int i = 0; i < 10; ++i) {
+        ++counter[index.select("gamesvr", "", select_mode_t::EN_SSM_ROUND_ROBIN, 0)];
+    }
+    CASE_EXPECT_EQ(5, counter[0x12345001]);
+    CASE_EXPECT_EQ(5, counter[0x12345002]);
+
+    // 未完成请求数最少
+    index.add_outstanding(0x12345001, 3);
+    CASE_EXPECT_EQ(0x12345002, index.select("gamesvr", "", select_mode_t::EN_SSM_LEAST_OUTSTANDING, 0));
+    index.add_outstanding(0x12345002, 5);
+    CASE_EXPECT_EQ(0x12345001, index.select("gamesvr", "", select_mode_t::EN_SSM_LEAST_OUTSTANDING, 0));
+    index.add_outstanding(0x12345002, -10);
+    CASE_EXPECT_EQ(0, index.get_outstanding(0x12345002));
+    CASE_EXPECT_EQ(0x12345002, index.select("gamesvr", "", select_mode_t::EN_SSM_LEAST_OUTSTANDING, 0));
+
+    // 随机
+    for (int i = 0; i < 10; ++i) {
+        atbus::detail::service_index::bus_id_t id = index.select("gamesvr", "", select_mode_t::EN_SSM_RANDOM, 0);
+        CASE_EXPECT_TRUE(0x12345001 == id || 0x12345002 == id);
+    }
+
+    // 移除后分组仍然有效
+    CASE_EXPECT_TRUE(index.remove(0x12345001));
+    CASE_EXPECT_FALSE(index.remove(0x12345001));
+    members = index.get_members("gamesvr", "zone1");
+    CASE_EXPECT_TRUE(NULL != members);
+    if (NULL != members) {
+        CASE_EXPECT_TRUE(members->empty());
+    }
+    CASE_EXPECT_EQ(0, index.select("gamesvr", "zone1", select_mode_t::EN_SSM_CONSISTENT_HASH, 1));
+    CASE_EXPECT_EQ(0x12345002, index.select("gamesvr", "", select_mode_t::EN_SSM_CONSISTENT_HASH, 1));
+
+    // 更新类型
+    CASE_EXPECT_TRUE(index.add(0x12345003, "gamesvr", tags));
+    CASE_EXPECT_EQ(0, index.select("dbsvr", "", select_mode_t::EN_SSM_ROUND_ROBIN, 0));
+    CASE_EXPECT_EQ(0x12345003, index.select("gamesvr", "zone1", select_mode_t::EN_SSM_ROUND_ROBIN, 0));
+}
+
+CASE_TEST(atbus_service_index, consistent_hash) {
+    atbus::detail::service_index index;
+    typedef atbus::detail::service_index::select_mode_t select_mode_t;
+
+    for (atbus::detail::service_index::bus_id_t i = 1; i <= 10; ++i) {
+        index.add(0x10000 + i, "gamesvr", std::vector<std::string>());
+    }
+
+    const uint64_t key_count = 10000;
+    std::vector<atbus::detail::service_index::bus_id_t> before;
+    std::map<atbus::detail::service_index::bus_id_t, uint64_t> counter;
+    before.reserve(key_count);
+    for (uint64_t key = 0; key < key_count; ++key) {
+        before.push_back(index.select("gamesvr", "", select_mode_t::EN_SSM_CONSISTENT_HASH, key));
+        ++counter[before.back()];
+        // 相同的key总是选中相同的对端
+        CASE_EXPECT_EQ(before.back(), index.select("gamesvr", "", select_mode_t::EN_SSM_CONSISTENT_HASH, key));
+    }
+
+    // 有虚拟节点时分布大致均匀
+    CASE_EXPECT_EQ(10, counter.size());
+    for (std::map<atbus::detail::service_index::bus_id_t, uint64_t>::iterator iter = counter.begin(); iter != counter.end(); ++iter) {
+        CASE_EXPECT_GT(iter->second, key_count / 20);
+        CASE_EXPECT_LT(iter->second, key_count / 5);
+    }
+
+    // 移除一个对端时只有它的key会变
+    index.remove(0x10001);
+    uint64_t moved = 0;
+    for (uint64_t key = 0; key < key_count; ++key) {
+        atbus::detail::service_index::bus_id_t id = index.select("gamesvr", "", select_mode_t::EN_SSM_CONSISTENT_HASH, key);
+        CASE_EXPECT_NE(0x10001, id);
+        if (id != before[key]) {
+            ++moved;
+            CASE_EXPECT_EQ(0x10001, before[key]);
+        }
+    }
+    CASE_EXPECT_EQ(counter[0x10001], moved);
+
+    CASE_MSG_INFO() << "consistent hash: " << moved << " of " << key_count << " keys moved after removing 1 of 10 endpoints" << std::endl;
+}
+
+static atbus::detail::service_index::bus_id_t service_index_test_select_room(atbus::detail::service_index &index,
+                                                                             const atbus::detail::service_index::member_list_t &candidates,
+                                                                             size_t room) {
+    std::stringstream ss;
+    ss << "room_" << room;
+    std::string key   = ss.str();
+    uint64_t hash_key = atbus::detail::service_index::hash_routing_key(key.data(), key.size());
+    if (candidates.empty()) {
+        return index.select("roomsvr", "", atbus::detail::service_index::select_mode_t::EN_SSM_CONSISTENT_HASH, hash_key);
+    }
+
+    return atbus::detail::service_index::select_by_key(candidates, hash_key);
+}
+
+// 同一个路由key在对端增减前后的选择: 只有新增对端分走的key和被移除对端的key会变，移除新增的对端后恢复原来的选择
+CASE_TEST(atbus_service_index, routing_key_stability) {
+    atbus::detail::service_index index;
+    // 自定义路由回调给出的候选列表，和索引同步增减
+    atbus::detail::service_index::member_list_t candidates;
+    const atbus::detail::service_index::member_list_t no_candidates;
+
+    for (atbus::detail::service_index::bus_id_t i = 1; i <= 10; ++i) {
+        index.add(0x10000 + i, "roomsvr", std::vector<std::string>());
+        candidates.push_back(0x10000 + i);
+    }
+
+    const size_t key_count = 10000;
+    std::vector<atbus::detail::service_index::bus_id_t> before_index;
+    std::vector<atbus::detail::service_index::bus_id_t> before_candidates;
+    before_index.reserve(key_count);
+    before_candidates.reserve(key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        before_index.push_back(service_index_test_select_room(index, no_candidates, i));
+        before_candidates.push_back(service_index_test_select_room(index, candidates, i));
+        // 相同key多次选择结果不变
+        CASE_EXPECT_EQ(before_index.back(), service_index_test_select_room(index, no_candidates, i));
+        CASE_EXPECT_EQ(before_candidates.back(), service_index_test_select_room(index, candidates, i));
+    }
+
+    // 新增对端时只有分给它的key会变
+    index.add(0x10011, "roomsvr", std::vector<std::string>());
+    candidates.push_back(0x10011);
+    size_t moved_index      = 0;
+    size_t moved_candidates = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        atbus::detail::service_index::bus_id_t id = service_index_test_select_room(index, no_candidates, i);
+        if (id != before_index[i]) {
+            ++moved_index;
+            CASE_EXPECT_EQ(0x10011, id);
+        }
+
+        id = service_index_test_select_room(index, candidates, i);
+        if (id != before_candidates[i]) {
+            ++moved_candidates;
+            CASE_EXPECT_EQ(0x10011, id);
+        }
+    }
+
+    CASE_EXPECT_GT(moved_index, key_count / 22);
+    CASE_EXPECT_LT(moved_index, key_count / 5);
+    CASE_EXPECT_GT(moved_candidates, key_count / 22);
+    CASE_EXPECT_LT(moved_candidates, key_count / 5);
+    CASE_MSG_INFO() << "routing key: " << moved_index << " (index) and " << moved_candidates << " (candidates) of " << key_count
+                    << " keys moved after adding the 11th endpoint" << std::endl;
+
+    // 移除新增的对端后所有key都回到原来的目标
+    index.remove(0x10011);
+    candidates.pop_back();
+    for (size_t i = 0; i < key_count; ++i) {
+        CASE_EXPECT_EQ(before_index[i], service_index_test_select_room(index, no_candidates, i));
+        CASE_EXPECT_EQ(before_candidates[i], service_index_test_select_room(index, candidates, i));
+    }
+
+    // 移除原有对端时只有它的key会变
+    index.remove(0x10005);
+    candidates.erase(std::find(candidates.begin(), candidates.end(), 0x10005));
+    moved_index      = 0;
+    moved_candidates = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        atbus::detail::service_index::bus_id_t id = service_index_test_select_room(index, no_candidates, i);
+        CASE_EXPECT_NE(0x10005, id);
+        if (id != before_index[i]) {
+            ++moved_index;
+            CASE_EXPECT_EQ(0x10005, before_index[i]);
+        }
+
+        id = service_index_test_select_room(index, candidates, i);
+        CASE_EXPECT_NE(0x10005, id);
+        if (id != before_candidates[i]) {
+            ++moved_candidates;
+            CASE_EXPECT_EQ(0x10005, before_candidates[i]);
+        }
+    }
+
+    CASE_EXPECT_EQ(static_cast<size_t>(std::count(before_index.begin(), before_index.end(), 0x10005)), moved_index);
+    CASE_EXPECT_EQ(static_cast<size_t>(std::count(before_candidates.begin(), before_candidates.end(), 0x10005)), moved_candidates);
+    CASE_EXPECT_EQ(0, atbus::detail::service_index::select_by_key(no_candidates, 0));
+}
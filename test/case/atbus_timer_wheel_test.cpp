@@ -0,0 +1,189 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <detail/timer_wheel.h>
+
+#include "frame/test_macros.h"
+
+CASE_TEST(atbus_timer_wheel, add_cancel_expire) {
+    atbus::detail::timer_wheel wheel;
+    wheel.reset(1000);
+
+    // 覆盖第一层、上层和超出范围的定时器
+    const uint64_t delays[] = {0, 1, 255, 256, 1000, 16384, 1048577, 67108864 + 5};
+    const size_t count      = sizeof(delays) / sizeof(delays[0]);
+    std::vector<atbus::detail::timer_wheel::node_t> nodes(count);
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i].data = &nodes[i];
+        wheel.add(nodes[i], 1000 + delays[i]);
+        CASE_EXPECT_TRUE(nodes[i].is_active());
+    }
+    CASE_EXPECT_EQ(count, wheel.size());
+
+    atbus::detail::timer_wheel::node_t canceled;
+    wheel.add(canceled, 1500);
+    wheel.cancel(canceled);
+    CASE_EXPECT_FALSE(canceled.is_active());
+    CASE_EXPECT_EQ(count, wheel.size());
+
+    {
+        // 析构时自动移除
+        atbus::detail::timer_wheel::node_t temp;
+        wheel.add(temp, 1200);
+        CASE_EXPECT_EQ(count + 1, wheel.size());
+    }
+    CASE_EXPECT_EQ(count, wheel.size());
+
+    // 推进时间，每个定时器都在到期时间点被取出
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t expire = 1000 + delays[i];
+        if (expire > 1000) {
+            CASE_EXPECT_EQ(NULL, wheel.pop_expired(expire - 1));
+        }
+
+        atbus::detail::timer_wheel::node_t *n = wheel.pop_expired(expire);
+        CASE_EXPECT_EQ(&nodes[i], n);
+        if (NULL != n) {
+            CASE_EXPECT_EQ(expire, n->get_expire());
+            CASE_EXPECT_FALSE(n->is_active());
+        }
+        CASE_EXPECT_EQ(NULL, wheel.pop_expired(expire));
+    }
+    CASE_EXPECT_TRUE(wheel.empty());
+
+    // 重新设置到期时间
+    wheel.add(nodes[0], 100000000);
+    wheel.add(nodes[0], 100000010);
+    CASE_EXPECT_EQ(1, wheel.size());
+    CASE_EXPECT_EQ(NULL, wheel.pop_expired(100000009));
+    CASE_EXPECT_EQ(&nodes[0], wheel.pop_expired(100000010));
+}
+
+CASE_TEST(atbus_timer_wheel, random_order) {
+    atbus::detail::timer_wheel wheel;
+    wheel.reset(0);
+
+    const size_t count = 10000;
+    std::vector<atbus::detail::timer_wheel::node_t> nodes(count);
+    std::multimap<uint64_t, size_t> expect;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t expire = static_cast<uint64_t>(rand() % 100000);
+        nodes[i].data   = reinterpret_cast<void *>(i);
+        wheel.add(nodes[i], expire);
+        expect.insert(std::make_pair(expire, i));
+    }
+
+    // 取消一部分
+    for (size_t i = 0; i < count; i += 7) {
+        wheel.cancel(nodes[i]);
+    }
+
+    size_t popped = 0;
+    uint64_t now  = 0;
+    while (!wheel.empty()) {
+        now += static_cast<uint64_t>(rand() % 50);
+        atbus::detail::timer_wheel::node_t *n;
+        while (NULL != (n = wheel.pop_expired(now))) {
+            CASE_EXPECT_LE(n->get_expire(), now);
+            // 按步长推进时，取出时间不会比到期时间晚一个步长以上
+            CASE_EXPECT_GT(n->get_expire() + 50, now);
+            ++popped;
+        }
+    }
+
+    CASE_EXPECT_EQ(count - (count + 6) / 7, popped);
+}
+
+static void timer_wheel_test_collect(const atbus::detail::timer_wheel::node_t &n, void *priv) {
+    reinterpret_cast<std::vector<const void *> *>(priv)->push_back(n.data);
+}
+
+CASE_TEST(atbus_timer_wheel, for_each_const) {
+    atbus::detail::timer_wheel wheel;
+    wheel.reset(1000);
+
+    // 已到期列表、第一层和上层都要遍历到
+    const uint64_t expires[] = {500, 1000, 1255, 1256, 17384, 67109000};
+    const size_t count       = sizeof(expires) / sizeof(expires[0]);
+    std::vector<atbus::detail::timer_wheel::node_t> nodes(count);
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i].data = &nodes[i];
+        wheel.add(nodes[i], expires[i]);
+    }
+
+    const atbus::detail::timer_wheel &const_wheel = wheel;
+    std::vector<const void *> visited;
+    const_wheel.for_each(timer_wheel_test_collect, &visited);
+    CASE_EXPECT_EQ(count, visited.size());
+    for (size_t i = 0; i < count; ++i) {
+        CASE_EXPECT_EQ(1, std::count(visited.begin(), visited.end(), &nodes[i]));
+    }
+
+    visited.clear();
+    wheel.cancel(nodes[0]);
+    const_wheel.for_each(timer_wheel_test_collect, &visited);
+    CASE_EXPECT_EQ(count - 1, visited.size());
+    CASE_EXPECT_EQ(0, std::count(visited.begin(), visited.end(), &nodes[0]));
+}
+
+CASE_TEST(atbus_timer_wheel, benchmark_100k) {
+    const size_t count = 100000;
+    const uint64_t interval = 8000;
+
+    // 和原来的 std::list<std::pair<time_t, T> > 方式对比: 所有定时器到期后重新加入
+    std::vector<atbus::detail::timer_wheel::node_t> nodes(count);
+    atbus::detail::timer_wheel wheel;
+    wheel.reset(0);
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        wheel.add(nodes[i], static_cast<uint64_t>(i * interval / count));
+    }
+    std::chrono::steady_clock::time_point added = std::chrono::steady_clock::now();
+
+    size_t fired = 0;
+    for (uint64_t now = 0; now < interval * 2; now += 10) {
+        atbus::detail::timer_wheel::node_t *n;
+        while (NULL != (n = wheel.pop_expired(now))) {
+            ++fired;
+            wheel.add(*n, now + interval);
+        }
+    }
+    std::chrono::steady_clock::time_point fired_end = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < count; ++i) {
+        wheel.cancel(nodes[i]);
+    }
+    std::chrono::steady_clock::time_point canceled = std::chrono::steady_clock::now();
+    CASE_EXPECT_TRUE(wheel.empty());
+
+    typedef std::list<std::pair<uint64_t, size_t> > timer_list_t;
+    timer_list_t timer_list;
+    std::chrono::steady_clock::time_point list_begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        timer_list.push_back(std::make_pair(static_cast<uint64_t>(i * interval / count), i));
+    }
+    size_t list_fired = 0;
+    for (uint64_t now = 0; now < interval * 2; now += 10) {
+        while (!timer_list.empty() && timer_list.front().first <= now) {
+            size_t idx = timer_list.front().second;
+            timer_list.pop_front();
+            timer_list.push_back(std::make_pair(now + interval, idx));
+            ++list_fired;
+        }
+    }
+    timer_list.clear();
+    std::chrono::steady_clock::time_point list_end = std::chrono::steady_clock::now();
+    CASE_EXPECT_EQ(list_fired, fired);
+
+    CASE_MSG_INFO() << "timer wheel with " << count << " timers: add "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(added - begin).count() << "us, fire and re-add " << fired
+                    << " times " << std::chrono::duration_cast<std::chrono::microseconds>(fired_end - added).count() << "us, cancel "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(canceled - fired_end).count() << "us" << std::endl;
+    CASE_MSG_INFO() << "std::list with " << count << " timers: fire and re-add " << list_fired << " times "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(list_end - list_begin).count() << "us" << std::endl;
+}
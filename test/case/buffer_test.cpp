@@ -7,9 +7,13 @@
 #include <memory>
 #include <limits>
 #include <numeric>
+#include <thread>
 
 #include <detail/libatbus_error.h>
 #include <detail/buffer.h>
+#include <detail/flat_map.h>
+#include <detail/inline_vector.h>
+#include <detail/libatbus_allocator.h>
 
 #include "detail/libatbus_channel_export.h"
 #include "frame/test_macros.h"
@@ -122,6 +126,70 @@ CASE_TEST(buffer, buffer_block)
     CASE_EXPECT_EQ(buf[fs - 1], -1);
 }
 
+CASE_TEST(buffer, buffer_block_allocator)
+{
+    std::vector<atbus::detail::buffer_allocator_stats_t> stats;
+    atbus::detail::buffer_block::shrink_allocator();
+    atbus::detail::buffer_block::get_allocator_stats(stats);
+    CASE_EXPECT_EQ(ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER + 1, stats.size());
+    CASE_EXPECT_EQ(0, stats.back().block_size);
+
+    size_t small_alloc_times = 0, small_hit_times = 0, large_alloc_times = stats.back().alloc_times;
+    for (size_t i = 0; i < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER; ++i) {
+        CASE_EXPECT_EQ(0, stats[i].cached_number);
+        small_alloc_times += stats[i].alloc_times;
+        small_hit_times += stats[i].hit_times;
+    }
+
+    // tiny blocks bypass the size class cache
+    atbus::detail::buffer_block* p0 = atbus::detail::buffer_block::malloc(ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE);
+    CASE_EXPECT_NE(NULL, p0);
+    CASE_EXPECT_EQ(ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE, p0->raw_size());
+    memset(p0->raw_data(), 0x3c, p0->raw_size());
+    atbus::detail::buffer_block::free(p0);
+
+    // blocks in the same size class are reused
+    size_t class_size = static_cast<size_t>(1) << (ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT + 3);
+    atbus::detail::buffer_block* p1 = atbus::detail::buffer_block::malloc(class_size - 20);
+    CASE_EXPECT_EQ(class_size - 20, p1->raw_size());
+    memset(p1->raw_data(), 0x3c, p1->raw_size());
+    atbus::detail::buffer_block::free(p1);
+
+    atbus::detail::buffer_block* p2 = atbus::detail::buffer_block::malloc(class_size - 8);
+    CASE_EXPECT_EQ(p1, p2);
+    CASE_EXPECT_EQ(class_size - 8, p2->raw_size());
+    CASE_EXPECT_EQ(class_size - 8, p2->size());
+
+    // blocks too large are not cached
+    size_t large_size = static_cast<size_t>(1) << (ATBUS_BUFFER_ALLOCATOR_MIN_SHIFT + ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER);
+    atbus::detail::buffer_block* p3 = atbus::detail::buffer_block::malloc(large_size);
+    CASE_EXPECT_NE(NULL, p3);
+
+    atbus::detail::buffer_block::get_allocator_stats(stats);
+    size_t using_number = 0, alloc_times = 0, hit_times = 0;
+    for (size_t i = 0; i < ATBUS_BUFFER_ALLOCATOR_CLASS_NUMBER; ++i) {
+        using_number += stats[i].using_number;
+        alloc_times += stats[i].alloc_times;
+        hit_times += stats[i].hit_times;
+    }
+    CASE_EXPECT_EQ(small_alloc_times + 2, alloc_times);
+    CASE_EXPECT_EQ(small_hit_times + 1, hit_times);
+    CASE_EXPECT_EQ(large_alloc_times + 1, stats.back().alloc_times);
+    CASE_EXPECT_LE(1, using_number);
+    CASE_EXPECT_LE(1, stats.back().using_number);
+
+    atbus::detail::buffer_block::free(p2);
+    atbus::detail::buffer_block::free(p3);
+
+    atbus::detail::buffer_block::get_allocator_stats(stats);
+    CASE_EXPECT_EQ(0, stats.back().cached_number);
+    size_t cached_size = atbus::detail::buffer_block::get_allocator_cached_size();
+    CASE_EXPECT_LE(atbus::detail::buffer_block::alloc_size(class_size - 8), cached_size);
+    CASE_EXPECT_EQ(cached_size, atbus::detail::buffer_block::shrink_allocator());
+    CASE_EXPECT_EQ(0, atbus::detail::buffer_block::get_allocator_cached_size());
+    CASE_EXPECT_EQ(0, atbus::detail::buffer_block::shrink_allocator());
+}
+
 
 // push back ============== pop front
 CASE_TEST(buffer, dynamic_buffer_manager_bf)
@@ -871,6 +939,94 @@ CASE_TEST(buffer, dynamic_buffer_manager_merge)
     }
 }
 
+// push front/back ============== pop back, merge back
+CASE_TEST(buffer, dynamic_buffer_manager_tail_links)
+{
+    atbus::detail::buffer_manager mgr;
+    void* pointer;
+
+    // 1 0 2 3
+    for (int i = 0; i < 4; ++i) {
+        int res = (1 == i) ? mgr.push_front(pointer, 16) : mgr.push_back(pointer, 16);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, res);
+        memset(pointer, i, 16);
+    }
+
+    // 1 0 2 3+3
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_back(pointer, 16));
+    memset(pointer, 3, 16);
+    CASE_EXPECT_EQ(32, mgr.back()->size());
+
+    const int expect_back[] = {3, 2, 0, 1};
+    for (size_t i = 0; i < sizeof(expect_back) / sizeof(expect_back[0]); ++i) {
+        CASE_EXPECT_FALSE(mgr.empty());
+        if (mgr.empty()) {
+            break;
+        }
+
+        CASE_EXPECT_EQ(expect_back[i], static_cast<int>(*reinterpret_cast<unsigned char*>(mgr.back()->data())));
+        CASE_EXPECT_EQ(1, static_cast<int>(*reinterpret_cast<unsigned char*>(mgr.front()->data())));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(mgr.back()->size(), true));
+    }
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(0, mgr.resident_size());
+
+    // 头部合并后从尾部弹出也能找到新的头部
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 16));
+    memset(pointer, 4, 16);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 16));
+    memset(pointer, 5, 16);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_front(pointer, 16));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(16, true));
+    CASE_EXPECT_EQ(mgr.front(), mgr.back());
+    CASE_EXPECT_EQ(4, static_cast<int>(*reinterpret_cast<unsigned char*>(mgr.back()->data())));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(32, true));
+    CASE_EXPECT_TRUE(mgr.empty());
+}
+
+CASE_TEST(buffer, buffer_manager_resident_size)
+{
+    size_t total = 0;
+    {
+        atbus::detail::buffer_manager mgr;
+        mgr.bind_resident_counter(&total);
+        CASE_EXPECT_EQ(0, mgr.resident_size());
+
+        void* pointer;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 200));
+        // 分级的块按级别大小计算
+        size_t expect = atbus::detail::buffer_block::alloc_size(100) + atbus::detail::buffer_block::alloc_size(200);
+        CASE_EXPECT_EQ(atbus::detail::buffer_block::full_size(100), atbus::detail::buffer_block::alloc_size(100));
+        CASE_EXPECT_EQ(atbus::detail::buffer_block::full_size(256), atbus::detail::buffer_block::alloc_size(200));
+        CASE_EXPECT_EQ(expect, mgr.resident_size());
+        CASE_EXPECT_EQ(expect, total);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_back(pointer, 56));
+        expect = atbus::detail::buffer_block::alloc_size(100) + atbus::detail::buffer_block::alloc_size(256);
+        CASE_EXPECT_EQ(expect, mgr.resident_size());
+        CASE_EXPECT_EQ(expect, total);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(100, true));
+        CASE_EXPECT_EQ(atbus::detail::buffer_block::alloc_size(256), mgr.resident_size());
+        CASE_EXPECT_EQ(atbus::detail::buffer_block::alloc_size(256), total);
+
+        // 切换到静态模式会清空动态块，只保留整块缓冲区
+        mgr.set_mode(1024, 4);
+        CASE_EXPECT_EQ(atbus::detail::buffer_block::padding_size(1024), mgr.resident_size());
+        CASE_EXPECT_EQ(mgr.resident_size(), total);
+
+        // 解绑后外部计数器不再包含该管理器
+        mgr.bind_resident_counter(NULL);
+        CASE_EXPECT_EQ(0, total);
+        mgr.bind_resident_counter(&total);
+        CASE_EXPECT_EQ(mgr.resident_size(), total);
+    }
+
+    // 析构时释放的内存也会同步到外部计数器
+    CASE_EXPECT_EQ(0, total);
+}
+
 
 CASE_TEST(buffer, static_buffer_manager_merge_back)
 {
@@ -1125,3 +1281,446 @@ CASE_TEST(buffer, static_buffer_manager_merge_front)
         CHECK_BUFFER(mgr.front()->raw_data(), sr, 0xea);
     }
 }
+
+// block wraps the end of static circle buffer ============== split into two segments
+CASE_TEST(buffer, static_buffer_manager_split)
+{
+    typedef atbus::detail::buffer_manager::segment_t segment_t;
+    size_t hs = atbus::detail::buffer_block::head_size(0);
+
+    // push back : ... head NNNNNN tail NN => NN new_tail ... head NNNNNN old_tail NN
+    {
+        atbus::detail::buffer_manager mgr;
+        mgr.set_mode(1024, 10);
+
+        void* pointer = NULL;
+        void* buffer_start = NULL;
+        for (int i = 0; i < 4; ++ i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 200));
+            if (NULL == buffer_start) {
+                buffer_start = atbus::detail::fn::buffer_prev(pointer, hs);
+            }
+        }
+        mgr.pop_front(200);
+        mgr.pop_front(200);
+
+        // 4 blocks of 200 bytes, the rest at the end is less than 300
+        size_t tail_offset = 4 * (200 + hs);
+        segment_t segs[2];
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back_split(segs, 300, 64));
+        CASE_EXPECT_EQ(atbus::detail::fn::buffer_next(buffer_start, tail_offset + hs), segs[0].pointer);
+        CASE_EXPECT_EQ(1024 - tail_offset - hs, segs[0].size);
+        CASE_EXPECT_EQ(buffer_start, segs[1].pointer);
+        CASE_EXPECT_EQ(300 - segs[0].size, segs[1].size);
+        CASE_EXPECT_EQ(3, mgr.limit().cost_number_);
+        CASE_EXPECT_EQ(700, mgr.limit().cost_size_);
+        memset(segs[0].pointer, 0x5a, segs[0].size);
+        memset(segs[1].pointer, 0xa5, segs[1].size);
+
+        segment_t check_segs[2];
+        CASE_EXPECT_EQ(2, mgr.raw_segments(mgr.back(), check_segs));
+        CASE_EXPECT_EQ(segs[0].pointer, check_segs[0].pointer);
+        CASE_EXPECT_EQ(segs[0].size, check_segs[0].size);
+        CASE_EXPECT_EQ(segs[1].pointer, check_segs[1].pointer);
+        CASE_EXPECT_EQ(segs[1].size, check_segs[1].size);
+
+        // the split block can not be merged
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.merge_back(pointer, 8));
+
+        // next block is after the second segment
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back_split(segs, 100, 64));
+        CASE_EXPECT_EQ(atbus::detail::fn::buffer_next(buffer_start, atbus::detail::buffer_block::padding_size(300 - (1024 - tail_offset - hs)) + hs),
+                       segs[0].pointer);
+        CASE_EXPECT_EQ(100, segs[0].size);
+        CASE_EXPECT_EQ(0, segs[1].size);
+        CASE_EXPECT_EQ(1, mgr.raw_segments(mgr.back(), check_segs));
+
+        mgr.pop_front(200);
+        mgr.pop_front(200);
+        CASE_EXPECT_EQ(2, mgr.raw_segments(mgr.front(), check_segs));
+        CHECK_BUFFER(check_segs[0].pointer, check_segs[0].size, 0x5a);
+        CHECK_BUFFER(check_segs[1].pointer, check_segs[1].size, 0xa5);
+
+        mgr.pop_front(300);
+        CASE_EXPECT_EQ(1, mgr.limit().cost_number_);
+        CASE_EXPECT_EQ(1, mgr.raw_segments(mgr.front(), check_segs));
+        CASE_EXPECT_EQ(100, check_segs[0].size);
+        mgr.pop_front(100);
+        CASE_EXPECT_TRUE(mgr.empty());
+    }
+
+    // push front : NN old_head NNNNNN tail .... => NN old_head NNNNNN tail .... new_head NN
+    {
+        atbus::detail::buffer_manager mgr;
+        mgr.set_mode(1024, 10);
+
+        void* pointer = NULL;
+        mgr.push_back(pointer, 200);
+        void* buffer_start = atbus::detail::fn::buffer_prev(pointer, hs);
+        mgr.push_back(pointer, 200);
+        mgr.pop_front(200);
+
+        segment_t segs[2];
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_front_split(segs, 400, 64));
+        // second segment fills the space before old head(200 + hs), the rest is at the end
+        CASE_EXPECT_EQ(200 - hs, segs[0].size);
+        CASE_EXPECT_EQ(atbus::detail::fn::buffer_next(buffer_start, 1024 - (200 - hs)), segs[0].pointer);
+        CASE_EXPECT_EQ(buffer_start, segs[1].pointer);
+        CASE_EXPECT_EQ(200 + hs, segs[1].size);
+        CASE_EXPECT_EQ(2, mgr.limit().cost_number_);
+        CASE_EXPECT_EQ(segs[0].pointer, mgr.front()->raw_data());
+
+        segment_t check_segs[2];
+        CASE_EXPECT_EQ(2, mgr.raw_segments(mgr.front(), check_segs));
+        CASE_EXPECT_EQ(400, check_segs[0].size + check_segs[1].size);
+
+        // no need to split
+        mgr.pop_front(400);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_front_split(segs, 100, 64));
+        CASE_EXPECT_EQ(100, segs[0].size);
+        CASE_EXPECT_EQ(0, segs[1].size);
+        CASE_EXPECT_EQ(segs[0].pointer, mgr.front()->raw_data());
+    }
+
+    // dynamic mode : always one segment
+    {
+        atbus::detail::buffer_manager mgr;
+        segment_t segs[2];
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back_split(segs, 300, 64));
+        CASE_EXPECT_EQ(300, segs[0].size);
+        CASE_EXPECT_EQ(0, segs[1].size);
+        CASE_EXPECT_EQ(segs[0].pointer, mgr.back()->raw_data());
+    }
+}
+
+CASE_TEST(buffer, spsc_buffer_manager) {
+    atbus::detail::spsc_buffer_manager mgr;
+    void *pointer = NULL;
+    size_t nread, nwrite;
+
+    // not inited
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_INITED, mgr.push_back(pointer, 16));
+    CASE_EXPECT_FALSE(mgr.set_limit(1024, 0));
+    CASE_EXPECT_TRUE(mgr.set_limit(1024, 4));
+    CASE_EXPECT_EQ(4, mgr.limit().limit_number_);
+    CASE_EXPECT_EQ(1024, mgr.limit().limit_size_);
+
+    // uncommitted block is invisible to consumer
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+    memset(pointer, 1, 100);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_ACCESS_DENY, mgr.push_back(pointer, 100));
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(NULL, mgr.front());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.back(pointer, nread, nwrite));
+    CASE_EXPECT_EQ(0, nread);
+    CASE_EXPECT_EQ(100, nwrite);
+
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.commit_back());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NO_DATA, mgr.commit_back());
+    CASE_EXPECT_FALSE(mgr.empty());
+    CASE_EXPECT_EQ(1, mgr.limit().cost_number_);
+    CASE_EXPECT_EQ(100, mgr.limit().cost_size_);
+
+    // cancel
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 200));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.cancel_back());
+    CASE_EXPECT_EQ(NULL, mgr.back());
+
+    // size limit
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.push_back(pointer, 1000));
+
+    // number limit
+    for (int i = 2; i <= 4; ++i) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+        memset(pointer, i, 100);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.commit_back());
+    }
+    CASE_EXPECT_EQ(4, mgr.limit().cost_number_);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.push_back(pointer, 10));
+
+    // partly pop
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(40));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.front(pointer, nread, nwrite));
+    CASE_EXPECT_EQ(40, nread);
+    CASE_EXPECT_EQ(60, nwrite);
+    CHECK_BUFFER(pointer, nwrite, 1);
+    CASE_EXPECT_EQ(360, mgr.limit().cost_size_);
+
+    for (int v = 1; v <= 4; ++v) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.front(pointer, nread, nwrite));
+        CHECK_BUFFER(pointer, nwrite, v);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(nwrite));
+    }
+
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NO_DATA, mgr.pop_front(1));
+    CASE_EXPECT_EQ(0, mgr.limit().cost_number_);
+    CASE_EXPECT_EQ(0, mgr.limit().cost_size_);
+
+    // reset free all blocks
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.commit_back());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+    mgr.reset();
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(NULL, mgr.back());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_INITED, mgr.push_back(pointer, 16));
+}
+
+// one thread produce frames and another one consume them
+CASE_TEST(buffer, spsc_buffer_manager_thread) {
+    atbus::detail::spsc_buffer_manager mgr;
+    CASE_EXPECT_TRUE(mgr.set_limit(64 * 1024, 64));
+
+    const size_t frame_number = 100000;
+    size_t sum_send_len       = 0;
+    std::thread producer([&mgr, &sum_send_len, frame_number] {
+        for (size_t i = 0; i < frame_number; ++i) {
+            size_t s      = sizeof(size_t) + (i * 7) % 1024;
+            void *pointer = NULL;
+            while (EN_ATBUS_ERR_BUFF_LIMIT == mgr.push_back(pointer, s)) {
+                std::this_thread::yield();
+            }
+
+            if (NULL == pointer) {
+                break;
+            }
+
+            memcpy(pointer, &i, sizeof(size_t));
+            memset(reinterpret_cast<char *>(pointer) + sizeof(size_t), static_cast<int>(i & 0xFF), s - sizeof(size_t));
+            mgr.commit_back();
+            sum_send_len += s;
+        }
+    });
+
+    size_t sum_recv_len = 0;
+    size_t recv_times   = 0;
+    size_t error_times  = 0;
+    while (recv_times < frame_number) {
+        void *pointer = NULL;
+        size_t nread, nwrite;
+        if (EN_ATBUS_ERR_SUCCESS != mgr.front(pointer, nread, nwrite)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t seq = 0;
+        memcpy(&seq, pointer, sizeof(size_t));
+        if (seq != recv_times || nwrite != sizeof(size_t) + (seq * 7) % 1024) {
+            ++error_times;
+        }
+
+        for (size_t i = sizeof(size_t); i < nwrite; ++i) {
+            if (reinterpret_cast<unsigned char *>(pointer)[i] != static_cast<unsigned char>(seq & 0xFF)) {
+                ++error_times;
+                break;
+            }
+        }
+
+        sum_recv_len += nwrite;
+        ++recv_times;
+        mgr.pop_front(nwrite);
+    }
+
+    producer.join();
+    CASE_EXPECT_EQ(0, error_times);
+    CASE_EXPECT_EQ(sum_send_len, sum_recv_len);
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(0, mgr.limit().cost_size_);
+}
+
+struct buffer_test_allocator_stats_t {
+    size_t alloc_times;
+    size_t free_times;
+    size_t using_size;
+};
+
+static void *buffer_test_allocate(void *priv_data, size_t s) {
+    buffer_test_allocator_stats_t *stats = reinterpret_cast<buffer_test_allocator_stats_t *>(priv_data);
+    ++stats->alloc_times;
+    stats->using_size += s;
+    return malloc(s);
+}
+
+static void buffer_test_deallocate(void *priv_data, void *p, size_t s) {
+    buffer_test_allocator_stats_t *stats = reinterpret_cast<buffer_test_allocator_stats_t *>(priv_data);
+    ++stats->free_times;
+    stats->using_size -= s;
+    free(p);
+}
+
+CASE_TEST(buffer, allocator_hooks) {
+    buffer_test_allocator_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    atbus::detail::allocator_t hooks;
+    hooks.allocate   = buffer_test_allocate;
+    hooks.deallocate = buffer_test_deallocate;
+    hooks.priv_data  = &stats;
+    atbus::detail::buffer_block::shrink_allocator();
+    atbus::detail::fn::set_allocator(&hooks);
+    CASE_EXPECT_EQ(&stats, atbus::detail::fn::get_allocator().priv_data);
+
+    // large blocks are not cached
+    atbus::detail::buffer_block *block = atbus::detail::buffer_block::malloc(1024 * 1024);
+    CASE_EXPECT_NE(NULL, block);
+    CASE_EXPECT_EQ(1, stats.alloc_times);
+    atbus::detail::buffer_block::free(block);
+    CASE_EXPECT_EQ(1, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    // blocks in size classes are cached and released by shrink_allocator
+    block = atbus::detail::buffer_block::malloc(300);
+    atbus::detail::buffer_block::free(block);
+    CASE_EXPECT_EQ(2, stats.alloc_times);
+    CASE_EXPECT_EQ(1, stats.free_times);
+    atbus::detail::buffer_block::shrink_allocator();
+    CASE_EXPECT_EQ(2, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    // tiny blocks are not cached
+    block = atbus::detail::buffer_block::malloc(ATBUS_BUFFER_ALLOCATOR_BYPASS_SIZE);
+    CASE_EXPECT_EQ(3, stats.alloc_times);
+    atbus::detail::buffer_block::free(block);
+    CASE_EXPECT_EQ(3, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    // static circle buffer
+    {
+        atbus::detail::buffer_manager mgr;
+        mgr.set_mode(4096, 8);
+        CASE_EXPECT_EQ(4, stats.alloc_times);
+        CASE_EXPECT_NE(0, stats.using_size);
+    }
+    CASE_EXPECT_EQ(4, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    // stl containers
+    {
+        std::vector<int, atbus::detail::stl_allocator<int> > vec;
+        vec.resize(128);
+        CASE_EXPECT_EQ(5, stats.alloc_times);
+    }
+    CASE_EXPECT_EQ(5, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    atbus::detail::fn::set_allocator(NULL);
+    CASE_EXPECT_EQ(NULL, atbus::detail::fn::get_allocator().priv_data);
+}
+
+CASE_TEST(buffer, arena_allocator) {
+    atbus::detail::arena_allocator arena;
+    arena.set_chunk_size(1024);
+    CASE_EXPECT_EQ(1024, arena.get_chunk_size());
+    CASE_EXPECT_EQ(0, arena.capacity());
+
+    void *p1 = arena.allocate(100);
+    void *p2 = arena.allocate(100);
+    CASE_EXPECT_NE(NULL, p1);
+    CASE_EXPECT_NE(NULL, p2);
+    CASE_EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p1) % (sizeof(void *) * 2));
+    CASE_EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p2) % (sizeof(void *) * 2));
+    CASE_EXPECT_GE(reinterpret_cast<char *>(p2) - reinterpret_cast<char *>(p1), 100);
+    CASE_EXPECT_EQ(1024, arena.capacity());
+
+    // reuse chunk after reset
+    arena.reset();
+    CASE_EXPECT_EQ(0, arena.used_size());
+    CASE_EXPECT_EQ(p1, arena.allocate(100));
+
+    // chunks are merged into one after reset
+    CASE_EXPECT_NE(NULL, arena.allocate(2000));
+    CASE_EXPECT_NE(NULL, arena.allocate(1000));
+    size_t used_size = arena.used_size();
+    CASE_EXPECT_GT(arena.capacity(), 1024);
+    arena.reset();
+    CASE_EXPECT_GE(arena.capacity(), used_size);
+    CASE_EXPECT_NE(NULL, arena.allocate(used_size));
+    CASE_EXPECT_LE(arena.used_size(), arena.capacity());
+
+    // arena buffer
+    arena.reset();
+    {
+        atbus::detail::arena_buffer buffer(arena, 16);
+        const char *data = "0123456789abcdef";
+        for (int i = 0; i < 100; ++i) {
+            buffer.write(data, 16);
+        }
+
+        CASE_EXPECT_TRUE(buffer.good());
+        CASE_EXPECT_EQ(1600, buffer.size());
+        CASE_EXPECT_EQ(0, memcmp(buffer.data() + 1584, data, 16));
+    }
+
+    arena.release();
+    CASE_EXPECT_EQ(0, arena.capacity());
+}
+
+CASE_TEST(buffer, pack_fixed_buffer) {
+    atbus::detail::pack_size_counter counter;
+    counter.write("0123456789", 10);
+    counter.write("abc", 3);
+    CASE_EXPECT_EQ(13, counter.size());
+
+    char buffer[16] = {0};
+    atbus::detail::pack_fixed_buffer writer(buffer, counter.size());
+    writer.write("0123456789", 10);
+    writer.write("abc", 3);
+    CASE_EXPECT_TRUE(writer.good());
+    CASE_EXPECT_EQ(13, writer.size());
+    CASE_EXPECT_EQ(buffer, writer.data());
+    CASE_EXPECT_EQ(0, memcmp(buffer, "0123456789abc", 13));
+
+    // out of range
+    writer.write("d", 1);
+    CASE_EXPECT_FALSE(writer.good());
+    CASE_EXPECT_EQ(13, writer.size());
+    CASE_EXPECT_EQ(0, buffer[13]);
+}
+
+CASE_TEST(buffer, object_cache) {
+    atbus::detail::fn::shrink_object_cache();
+
+    // same size class reuse the freed memory
+    void *p1 = atbus::detail::fn::allocate_object(100);
+    CASE_EXPECT_NE(NULL, p1);
+    memset(p1, 0x5e, 100);
+    atbus::detail::fn::deallocate_object(p1, 100);
+    void *p2 = atbus::detail::fn::allocate_object(ATBUS_OBJECT_CACHE_ALIGN * (100 / ATBUS_OBJECT_CACHE_ALIGN) + 1);
+    CASE_EXPECT_EQ(p1, p2);
+    atbus::detail::fn::deallocate_object(p2, 100);
+
+    // large objects are not cached
+    size_t large_size = ATBUS_OBJECT_CACHE_ALIGN * ATBUS_OBJECT_CACHE_CLASS_NUMBER + 1;
+    void *p3          = atbus::detail::fn::allocate_object(large_size);
+    CASE_EXPECT_NE(NULL, p3);
+    atbus::detail::fn::deallocate_object(p3, large_size);
+
+    CASE_EXPECT_EQ(ATBUS_OBJECT_CACHE_ALIGN * ((100 + ATBUS_OBJECT_CACHE_ALIGN - 1) / ATBUS_OBJECT_CACHE_ALIGN),
+                   atbus::detail::fn::shrink_object_cache());
+    CASE_EXPECT_EQ(0, atbus::detail::fn::shrink_object_cache());
+}
+
+CASE_TEST(buffer, thread_cache_release_on_exit) {
+    buffer_test_allocator_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    atbus::detail::allocator_t hooks;
+    hooks.allocate   = buffer_test_allocate;
+    hooks.deallocate = buffer_test_deallocate;
+    hooks.priv_data  = &stats;
+    atbus::detail::fn::set_allocator(&hooks);
+
+    // 子线程缓存的空闲块和小对象在线程退出时释放
+    std::thread worker([]() {
+        atbus::detail::buffer_block::free(atbus::detail::buffer_block::malloc(300));
+        atbus::detail::fn::deallocate_object(atbus::detail::fn::allocate_object(100), 100);
+    });
+    worker.join();
+
+    CASE_EXPECT_EQ(2, stats.alloc_times);
+    CASE_EXPECT_EQ(2, stats.free_times);
+    CASE_EXPECT_EQ(0, stats.using_size);
+
+    atbus::detail::fn::set_allocator(NULL);
+}
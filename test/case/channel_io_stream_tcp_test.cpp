@@ -212,15 +212,15 @@ CASE_TEST(channel, io_stream_tcp_basic) {
 
     check_flag = g_check_flag;
     // small buffer
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf, 13);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf, 13);
     g_check_buff_sequence.push_back(std::make_pair(0, 13));
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 13, 28);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 13, 28);
     g_check_buff_sequence.push_back(std::make_pair(13, 28));
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 13 + 28, 100);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 13 + 28, 100);
     g_check_buff_sequence.push_back(std::make_pair(13 + 28, 100));
 
     // big buffer
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 1024, 56 * 1024 + 3);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 1024, 56 * 1024 + 3);
     g_check_buff_sequence.push_back(std::make_pair(1024, 56 * 1024 + 3));
 
     while (g_check_flag - check_flag < 4) {
@@ -229,11 +229,11 @@ CASE_TEST(channel, io_stream_tcp_basic) {
 
     // many big buffer
     {
-        check_flag                                                  = g_check_flag;
-        atbus::channel::io_stream_channel::conn_pool_t::iterator it = svr.conn_pool.begin();
+        check_flag                               = g_check_flag;
+        atbus::channel::io_stream_connection *it = atbus::channel::io_stream_next_connection(&svr, NULL);
         // 跳过listen的socket
-        if (it->second->addr.address == "ipv6://:::16387") {
-            ++it;
+        if (it->addr.address == "ipv6://:::16387") {
+            it = atbus::channel::io_stream_next_connection(&svr, it);
         }
 
         size_t sum_size = 0;
@@ -241,7 +241,7 @@ CASE_TEST(channel, io_stream_tcp_basic) {
         for (int i = 0; i < 153; ++i) {
             size_t s = static_cast<size_t>(rand() % 2048);
             size_t l = static_cast<size_t>(rand() % 10240) + 20 * 1024;
-            atbus::channel::io_stream_send(it->second.get(), buf + s, l);
+            atbus::channel::io_stream_send(it, buf + s, l);
             g_check_buff_sequence.push_back(std::make_pair(s, l));
             sum_size += l;
         }
@@ -254,6 +254,10 @@ CASE_TEST(channel, io_stream_tcp_basic) {
 
         CASE_MSG_INFO() << "recv " << g_recv_rec.second << " bytes data with " << g_recv_rec.first << " packages and checked done."
                         << std::endl;
+
+        // 大数据包回调后缓冲区都归还到共享接收缓冲池
+        CASE_EXPECT_EQ(0, cli.recv_pool.using_size);
+        CASE_EXPECT_LE(cli.recv_pool.cached_size, cli.conf.recv_buffer_max_size * cli.conf.recv_buffer_static);
     }
 
     std::stringstream ssout;
@@ -262,12 +266,420 @@ CASE_TEST(channel, io_stream_tcp_basic) {
 
     atbus::channel::io_stream_close(&svr);
     atbus::channel::io_stream_close(&cli);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
+    CASE_EXPECT_EQ(0, cli.recv_pool.cached_size);
 
     uv_loop_close(&loop);
 }
 
+// io_uring backend, fallback to libuv if not supported
+CASE_TEST(channel, io_stream_tcp_io_uring) {
+    atbus::adapter::loop_t loop;
+    uv_loop_init(&loop);
+
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.backend = atbus::channel::io_stream_backend_t::EN_BT_IO_URING;
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, &loop, &conf);
+    atbus::channel::io_stream_init(&cli, &loop, &conf);
+    CASE_EXPECT_NE(NULL, svr.backend);
+    CASE_EXPECT_NE(NULL, cli.backend);
+    CASE_MSG_INFO() << "io_stream backend: " << svr.backend->name << std::endl;
+#if defined(ATBUS_MACRO_WITH_IO_URING) && ATBUS_MACRO_WITH_IO_URING
+    // 后端初始化失败时会记录错误码并回退，ring初始化成功时必须使用io_uring
+    if (0 == svr.error_code) {
+        CASE_EXPECT_EQ(atbus::channel::io_stream_backend_t::EN_BT_IO_URING, svr.backend->type);
+    }
+    if (0 == cli.error_code) {
+        CASE_EXPECT_EQ(atbus::channel::io_stream_backend_t::EN_BT_IO_URING, cli.backend->type);
+    }
+#endif
+
+    g_check_flag = 0;
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    if (0 == inited_fds) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    int check_flag = g_check_flag;
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    char *buf                                                                 = get_test_buffer();
+
+    check_flag = g_check_flag;
+    // small buffer
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf, 13);
+    g_check_buff_sequence.push_back(std::make_pair(0, 13));
+    // big buffer, larger than one registered receive buffer
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 1024, 56 * 1024 + 3);
+    g_check_buff_sequence.push_back(std::make_pair(1024, 56 * 1024 + 3));
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 13, 28);
+    g_check_buff_sequence.push_back(std::make_pair(13, 28));
+
+    while (g_check_flag - check_flag < 3) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    atbus::channel::io_stream_close(&svr);
+    atbus::channel::io_stream_close(&cli);
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
+
+    while (UV_EBUSY == uv_loop_close(&loop)) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+}
+
+static std::pair<size_t, size_t> g_written_rec = std::make_pair(0, 0);
+static void written_callback_count_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                      atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                      int status,                                       // libuv传入的转态码
+                                      void *,                                           // 额外参数(不同事件不同含义)
+                                      size_t                                            // 额外参数长度
+) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+
+    // 连接还没有回收，写回调总是在断开回调之前
+    CASE_EXPECT_NE(atbus::channel::io_stream_connection::EN_ST_DISCONNECTIED, connection->status);
+
+    // 发送失败时libuv的错误码在channel->error_code里
+    ++g_written_rec.first;
+    if (0 != status || 0 != channel->error_code) {
+        ++g_written_rec.second;
+    }
+}
+
+// peer closed while io_uring sendmsg is still in flight
+CASE_TEST(channel, io_stream_tcp_io_uring_close_while_sending) {
+    atbus::channel::io_stream_conf svr_conf, cli_conf;
+    atbus::channel::io_stream_init_configure(&svr_conf);
+    atbus::channel::io_stream_init_configure(&cli_conf);
+    cli_conf.backend = atbus::channel::io_stream_backend_t::EN_BT_IO_URING;
+
+    // 服务端使用libuv后端，不运行事件循环时不会收取数据
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, NULL, &svr_conf);
+    atbus::channel::io_stream_init(&cli, NULL, &cli_conf);
+    CASE_MSG_INFO() << "io_stream backend: " << cli.backend->name << std::endl;
+
+    // libuv后端的write不带MSG_NOSIGNAL，对端关闭时会触发SIGPIPE，仅在io_uring后端可用时测试
+    if (atbus::channel::io_stream_backend_t::EN_BT_IO_URING != cli.backend->type) {
+        CASE_MSG_INFO() << "io_uring backend unavailable, skip." << std::endl;
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        return;
+    }
+
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN]       = written_callback_count_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_DISCONNECTED] = disconnected_callback_test_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+    if (0 == inited_fds) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds + 1) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    atbus::channel::io_stream_connection *conn = atbus::channel::io_stream_next_connection(&cli, NULL);
+    CASE_EXPECT_NE(NULL, conn);
+    if (NULL == conn) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        return;
+    }
+
+    // 远超socket缓冲区的数据，对端不收取时发送请求会一直挂在ring里
+    char *buf          = get_test_buffer();
+    size_t send_number = 0;
+    g_written_rec      = std::make_pair(0, 0);
+    for (int i = 0; i < 512; ++i) {
+        if (0 == atbus::channel::io_stream_send(conn, buf, 32 * 1024)) {
+            ++send_number;
+        }
+    }
+    CASE_EXPECT_EQ(512, send_number);
+
+    for (int i = 0; i < 16; ++i) {
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_TRUE(ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, atbus::channel::io_stream_connection::EN_CF_WRITING));
+    CASE_EXPECT_LT(g_written_rec.first, send_number);
+
+    // 对端带着未读取的数据关闭，正在进行的发送会失败，剩下的数据也要全部回调
+    check_flag = g_check_flag;
+    atbus::channel::io_stream_close(&svr);
+
+    while (g_check_flag - check_flag < inited_fds) {
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
+    CASE_EXPECT_EQ(send_number, g_written_rec.first);
+    CASE_EXPECT_GT(g_written_rec.second, 0);
+    CASE_MSG_INFO() << "written " << g_written_rec.first << " packages, " << g_written_rec.second << " failed" << std::endl;
+
+    atbus::channel::io_stream_close(&cli);
+}
+
+// idle connections release static send buffers
+CASE_TEST(channel, io_stream_tcp_trim_idle) {
+    atbus::adapter::loop_t loop;
+    uv_loop_init(&loop);
+
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_static   = 4;
+    conf.send_buffer_max_size = 256 * 1024;
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, &loop, &conf);
+    atbus::channel::io_stream_init(&cli, &loop, &conf);
+
+    g_check_flag = 0;
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    if (0 == inited_fds) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    int check_flag = g_check_flag;
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    atbus::channel::io_stream_connection *conn                                = atbus::channel::io_stream_next_connection(&cli, NULL);
+    CASE_EXPECT_NE(NULL, conn);
+    if (NULL == conn) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+    CASE_EXPECT_TRUE(conn->write_buffers.is_static_mode());
+
+    size_t resident_size = atbus::channel::io_stream_get_resident_buffer_size(&cli);
+    CASE_EXPECT_GE(resident_size, conf.send_buffer_max_size);
+
+    // 未超时的连接不释放
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_trim_idle(&cli, 3600 * 1000));
+    CASE_EXPECT_TRUE(conn->write_buffers.is_static_mode());
+
+    CASE_EXPECT_EQ(1, atbus::channel::io_stream_trim_idle(&cli, 0));
+    CASE_EXPECT_TRUE(conn->write_buffers.is_dynamic_mode());
+    CASE_EXPECT_LT(atbus::channel::io_stream_get_resident_buffer_size(&cli), resident_size);
+
+    // 再次发送时恢复静态缓冲区
+    check_flag = g_check_flag;
+    atbus::channel::io_stream_send(conn, get_test_buffer(), 13);
+    g_check_buff_sequence.push_back(std::make_pair(0, 13));
+    CASE_EXPECT_TRUE(conn->write_buffers.is_static_mode());
+
+    while (g_check_flag - check_flag < 1) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    atbus::channel::io_stream_close(&svr);
+    atbus::channel::io_stream_close(&cli);
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_resident_buffer_size(&cli));
+
+    uv_loop_close(&loop);
+}
+
+// small static send buffer, blocks across the bound are split into two segments
+CASE_TEST(channel, io_stream_tcp_static_wrap) {
+    atbus::adapter::loop_t loop;
+    uv_loop_init(&loop);
+
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_static   = 16;
+    conf.send_buffer_max_size = 64 * 1024;
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, &loop, &conf);
+    atbus::channel::io_stream_init(&cli, &loop, &conf);
+
+    g_check_flag = 0;
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    if (0 == inited_fds) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    int check_flag = g_check_flag;
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    atbus::channel::io_stream_connection *conn                                = atbus::channel::io_stream_next_connection(&cli, NULL);
+    CASE_EXPECT_NE(NULL, conn);
+    if (NULL == conn) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+    CASE_EXPECT_TRUE(conn->write_buffers.is_static_mode());
+
+    char *buf  = get_test_buffer();
+    check_flag = g_check_flag;
+    g_recv_rec = std::make_pair(0, 0);
+    for (int i = 0; i < 256; ++i) {
+        size_t s = static_cast<size_t>(rand() % 2048);
+        size_t l = static_cast<size_t>(rand() % 12288) + 1024;
+
+        // 缓冲区满时等待写出后重试，保持队列非空使数据块绕过缓冲区尾部
+        int res = atbus::channel::io_stream_send(conn, buf + s, l);
+        while (EN_ATBUS_ERR_BUFF_LIMIT == res) {
+            uv_run(&loop, UV_RUN_ONCE);
+            res = atbus::channel::io_stream_send(conn, buf + s, l);
+        }
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, res);
+        if (EN_ATBUS_ERR_SUCCESS == res) {
+            g_check_buff_sequence.push_back(std::make_pair(s, l));
+        }
+    }
+
+    while (!g_check_buff_sequence.empty()) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+    CASE_EXPECT_EQ(256, g_check_flag - check_flag);
+    CASE_MSG_INFO() << "recv " << g_recv_rec.second << " bytes data with " << g_recv_rec.first << " packages and checked done."
+                    << std::endl;
+
+    atbus::channel::io_stream_close(&svr);
+    atbus::channel::io_stream_close(&cli);
+    uv_loop_close(&loop);
+}
+
+CASE_TEST(channel, io_stream_tcp_send_v) {
+    atbus::adapter::loop_t loop;
+    uv_loop_init(&loop);
+
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_static   = 16;
+    conf.send_buffer_max_size = 64 * 1024;
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, &loop, &conf);
+    atbus::channel::io_stream_init(&cli, &loop, &conf);
+
+    g_check_flag = 0;
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    if (0 == inited_fds) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    int check_flag = g_check_flag;
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    atbus::channel::io_stream_connection *conn                                = atbus::channel::io_stream_next_connection(&cli, NULL);
+    CASE_EXPECT_NE(NULL, conn);
+    if (NULL == conn) {
+        atbus::channel::io_stream_close(&svr);
+        atbus::channel::io_stream_close(&cli);
+        uv_loop_close(&loop);
+        return;
+    }
+    CASE_EXPECT_TRUE(conn->write_buffers.is_static_mode());
+
+    char *buf  = get_test_buffer();
+    check_flag = g_check_flag;
+    g_recv_rec = std::make_pair(0, 0);
+    for (int i = 0; i < 256; ++i) {
+        size_t s = static_cast<size_t>(rand() % 2048);
+        size_t l = static_cast<size_t>(rand() % 12288) + 1024;
+
+        // 拆成两段发送，接收端收到的是合并后的一条消息
+        const void *bufs[2] = {buf + s, buf + s + l / 3};
+        size_t lens[2]      = {l / 3, l - l / 3};
+        int res             = atbus::channel::io_stream_send_v(conn, bufs, lens, 2);
+        while (EN_ATBUS_ERR_BUFF_LIMIT == res) {
+            uv_run(&loop, UV_RUN_ONCE);
+            res = atbus::channel::io_stream_send_v(conn, bufs, lens, 2);
+        }
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, res);
+        if (EN_ATBUS_ERR_SUCCESS == res) {
+            g_check_buff_sequence.push_back(std::make_pair(s, l));
+        }
+    }
+
+    while (!g_check_buff_sequence.empty()) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+    CASE_EXPECT_EQ(256, g_check_flag - check_flag);
+    CASE_MSG_INFO() << "recv " << g_recv_rec.second << " bytes data with " << g_recv_rec.first << " packages and checked done."
+                    << std::endl;
+
+    atbus::channel::io_stream_close(&svr);
+    atbus::channel::io_stream_close(&cli);
+    uv_loop_close(&loop);
+}
 
 // reset by peer(client)
 CASE_TEST(channel, io_stream_tcp_reset_by_client) {
@@ -297,20 +709,20 @@ CASE_TEST(channel, io_stream_tcp_reset_by_client) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(8);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
     atbus::channel::io_stream_close(&cli);
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     while (g_check_flag - check_flag < inited_fds) {
         atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(8);
     }
-    CASE_EXPECT_EQ(1, svr.conn_pool.size());
+    CASE_EXPECT_EQ(1, atbus::channel::io_stream_get_connection_number(&svr));
 
     atbus::channel::io_stream_close(&svr);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
 }
 
 // reset by peer(server)
@@ -341,17 +753,17 @@ CASE_TEST(channel, io_stream_tcp_reset_by_server) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(8);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
     atbus::channel::io_stream_close(&svr);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
 
     while (g_check_flag - check_flag < inited_fds) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(8);
     }
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     atbus::channel::io_stream_close(&cli);
 }
@@ -410,14 +822,14 @@ CASE_TEST(channel, io_stream_tcp_size_extended) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(8);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
 
-    int res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.recv_buffer_limit_size + 1);
+    int res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.recv_buffer_limit_size + 1);
     CASE_EXPECT_EQ(0, res);
 
-    res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.send_buffer_limit_size + 1);
+    res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.send_buffer_limit_size + 1);
     CASE_EXPECT_EQ(EN_ATBUS_ERR_INVALID_SIZE, res);
 
     while (g_check_flag - check_flag < 1) {
@@ -427,19 +839,19 @@ CASE_TEST(channel, io_stream_tcp_size_extended) {
     }
 
     // 错误的数据大小会导致连接断开
-    res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.send_buffer_limit_size);
+    res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.send_buffer_limit_size);
     CASE_EXPECT_EQ(0, res);
 
     // 有接收端关闭，所以一定是接收端先出发关闭连接。
     // 这里只要判定后触发方完成回调，那么先触发方必然已经完成
-    while (!cli.conn_pool.empty()) {
+    while (0 != atbus::channel::io_stream_get_connection_number(&cli)) {
         atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(32);
     }
 
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
-    CASE_EXPECT_EQ(1, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
+    CASE_EXPECT_EQ(1, atbus::channel::io_stream_get_connection_number(&svr));
 
     atbus::channel::io_stream_close(&cli);
     atbus::channel::io_stream_close(&svr);
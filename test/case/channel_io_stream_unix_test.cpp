@@ -209,15 +209,15 @@ CASE_TEST(channel, io_stream_unix_basic) {
 
     check_flag = g_check_flag;
     // small buffer
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf, 13);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf, 13);
     g_check_buff_sequence.push_back(std::make_pair(0, 13));
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 13, 28);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 13, 28);
     g_check_buff_sequence.push_back(std::make_pair(13, 28));
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 13 + 28, 100);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 13 + 28, 100);
     g_check_buff_sequence.push_back(std::make_pair(13 + 28, 100));
 
     // big buffer
-    atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), buf + 1024, 56 * 1024 + 3);
+    atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), buf + 1024, 56 * 1024 + 3);
     g_check_buff_sequence.push_back(std::make_pair(1024, 56 * 1024 + 3));
 
     while (g_check_flag - check_flag < 4) {
@@ -226,11 +226,11 @@ CASE_TEST(channel, io_stream_unix_basic) {
 
     // many big buffer
     {
-        check_flag                                                  = g_check_flag;
-        atbus::channel::io_stream_channel::conn_pool_t::iterator it = svr.conn_pool.begin();
+        check_flag                               = g_check_flag;
+        atbus::channel::io_stream_connection *it = atbus::channel::io_stream_next_connection(&svr, NULL);
         // 跳过listen的socket
-        if (it->second->addr.address == UNIT_TEST_LISTEN_ADDR) {
-            ++it;
+        if (it->addr.address == UNIT_TEST_LISTEN_ADDR) {
+            it = atbus::channel::io_stream_next_connection(&svr, it);
         }
 
         size_t sum_size = 0;
@@ -238,7 +238,7 @@ CASE_TEST(channel, io_stream_unix_basic) {
         for (int i = 0; i < 153; ++i) {
             size_t s = static_cast<size_t>(rand() % 2048);
             size_t l = static_cast<size_t>(rand() % 10240) + 20 * 1024;
-            atbus::channel::io_stream_send(it->second.get(), buf + s, l);
+            atbus::channel::io_stream_send(it, buf + s, l);
             g_check_buff_sequence.push_back(std::make_pair(s, l));
             sum_size += l;
         }
@@ -255,8 +255,8 @@ CASE_TEST(channel, io_stream_unix_basic) {
 
     atbus::channel::io_stream_close(&svr);
     atbus::channel::io_stream_close(&cli);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     uv_loop_close(&loop);
 }
@@ -285,20 +285,20 @@ CASE_TEST(channel, io_stream_unix_reset_by_client) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(32);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
     atbus::channel::io_stream_close(&cli);
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     while (g_check_flag - check_flag < 3) {
         atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(64);
     }
-    CASE_EXPECT_EQ(1, svr.conn_pool.size());
+    CASE_EXPECT_EQ(1, atbus::channel::io_stream_get_connection_number(&svr));
 
     atbus::channel::io_stream_close(&svr);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
 }
 
 // reset by peer(server)
@@ -324,17 +324,17 @@ CASE_TEST(channel, io_stream_unix_reset_by_server) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(64);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
     atbus::channel::io_stream_close(&svr);
-    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&svr));
 
     while (g_check_flag - check_flag < 3) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(64);
     }
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     atbus::channel::io_stream_close(&cli);
 }
@@ -392,14 +392,14 @@ CASE_TEST(channel, io_stream_unix_size_extended) {
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(64);
     }
-    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    CASE_EXPECT_NE(0, atbus::channel::io_stream_get_connection_number(&cli));
 
     check_flag = g_check_flag;
 
-    int res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.recv_buffer_limit_size + 1);
+    int res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.recv_buffer_limit_size + 1);
     CASE_EXPECT_EQ(0, res);
 
-    res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.send_buffer_limit_size + 1);
+    res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.send_buffer_limit_size + 1);
     CASE_EXPECT_EQ(EN_ATBUS_ERR_INVALID_SIZE, res);
 
     while (g_check_flag - check_flag < 1) {
@@ -409,19 +409,19 @@ CASE_TEST(channel, io_stream_unix_size_extended) {
     }
 
     // 错误的数据大小会导致连接断开
-    res = atbus::channel::io_stream_send(cli.conn_pool.begin()->second.get(), get_test_buffer(), conf.send_buffer_limit_size);
+    res = atbus::channel::io_stream_send(atbus::channel::io_stream_next_connection(&cli, NULL), get_test_buffer(), conf.send_buffer_limit_size);
     CASE_EXPECT_EQ(0, res);
 
     // 有接收端关闭，所以一定是接收端先出发关闭连接。
     // 这里只要判定后触发方完成回调，那么先触发方必然已经完成
-    while (!cli.conn_pool.empty()) {
+    while (0 != atbus::channel::io_stream_get_connection_number(&cli)) {
         atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
         atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
         CASE_THREAD_SLEEP_MS(32);
     }
 
-    CASE_EXPECT_EQ(0, cli.conn_pool.size());
-    CASE_EXPECT_EQ(1, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_get_connection_number(&cli));
+    CASE_EXPECT_EQ(1, atbus::channel::io_stream_get_connection_number(&svr));
 
     atbus::channel::io_stream_close(&cli);
     atbus::channel::io_stream_close(&svr);
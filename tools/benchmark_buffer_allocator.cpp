@@ -0,0 +1,198 @@
+﻿#include <assert.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include <detail/buffer.h>
+#include <detail/libatbus_error.h>
+
+// 模拟发送缓冲区的使用方式: 保持queue depth个在途数据块，先进先出
+struct run_config {
+    size_t max_n;
+    size_t queue_depth;
+    size_t loop_times;
+    size_t static_size;
+
+    std::vector<size_t> sizes;
+};
+
+static run_config conf;
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+static void print_result(const char *name, bench_clock_t::time_point begin, bench_clock_t::time_point end) {
+    double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000.0;
+    if (ms <= 0.0) {
+        ms = 0.001;
+    }
+
+    printf("[ RUNNING  ] %-32s %10.3f ms, %10.0f K ops/s\n", name, ms, conf.loop_times / ms);
+}
+
+static void run_ptmalloc() {
+    std::vector<void *> window(conf.queue_depth, NULL);
+    bench_clock_t::time_point begin = bench_clock_t::now();
+    for (size_t i = 0; i < conf.loop_times; ++i) {
+        size_t s     = conf.sizes[i % conf.sizes.size()];
+        void *&block = window[i % conf.queue_depth];
+        if (NULL != block) {
+            ::free(block);
+        }
+
+        block                                  = ::malloc(atbus::detail::buffer_block::full_size(s));
+        reinterpret_cast<char *>(block)[0]     = static_cast<char>(i);
+        reinterpret_cast<char *>(block)[s - 1] = static_cast<char>(i);
+    }
+
+    for (size_t i = 0; i < window.size(); ++i) {
+        if (NULL != window[i]) {
+            ::free(window[i]);
+        }
+    }
+    print_result("malloc/free(ptmalloc)", begin, bench_clock_t::now());
+}
+
+static void run_buffer_block() {
+    std::vector<atbus::detail::buffer_block *> window(conf.queue_depth, NULL);
+    bench_clock_t::time_point begin = bench_clock_t::now();
+    for (size_t i = 0; i < conf.loop_times; ++i) {
+        size_t s                            = conf.sizes[i % conf.sizes.size()];
+        atbus::detail::buffer_block *&block = window[i % conf.queue_depth];
+        if (NULL != block) {
+            atbus::detail::buffer_block::free(block);
+        }
+
+        block                                          = atbus::detail::buffer_block::malloc(s);
+        reinterpret_cast<char *>(block->data())[0]     = static_cast<char>(i);
+        reinterpret_cast<char *>(block->data())[s - 1] = static_cast<char>(i);
+    }
+
+    for (size_t i = 0; i < window.size(); ++i) {
+        atbus::detail::buffer_block::free(window[i]);
+    }
+    print_result("buffer_block::malloc/free(slab)", begin, bench_clock_t::now());
+}
+
+static void run_buffer_manager(const char *name, atbus::detail::buffer_manager &mgr) {
+    bench_clock_t::time_point begin = bench_clock_t::now();
+    size_t pending                  = 0;
+    size_t failed                   = 0;
+    for (size_t i = 0; i < conf.loop_times; ++i) {
+        size_t s = conf.sizes[i % conf.sizes.size()];
+        if (pending >= conf.queue_depth) {
+            mgr.pop_front(mgr.front()->raw_size());
+            --pending;
+        }
+
+        void *pointer = NULL;
+        // 静态缓冲区满了的时候先弹出一个再重试
+        while (EN_ATBUS_ERR_SUCCESS != mgr.push_back(pointer, s)) {
+            if (mgr.empty()) {
+                break;
+            }
+
+            ++failed;
+            mgr.pop_front(mgr.front()->raw_size());
+            --pending;
+        }
+
+        if (NULL == pointer) {
+            ++failed;
+            continue;
+        }
+
+        ++pending;
+        reinterpret_cast<char *>(pointer)[0]     = static_cast<char>(i);
+        reinterpret_cast<char *>(pointer)[s - 1] = static_cast<char>(i);
+    }
+
+    while (!mgr.empty()) {
+        mgr.pop_front(mgr.front()->raw_size());
+    }
+
+    print_result(name, begin, bench_clock_t::now());
+    if (failed > 0) {
+        printf("[ RUNNING  ] %-32s %llu times buffer full\n", "", static_cast<unsigned long long>(failed));
+    }
+}
+
+static void show_allocator_stats() {
+    std::vector<atbus::detail::buffer_allocator_stats_t> stats;
+    atbus::detail::buffer_block::get_allocator_stats(stats);
+
+    printf("[ RUNNING  ] buffer_block allocator stats:\n");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (0 == stats[i].alloc_times) {
+            continue;
+        }
+
+        printf("[ RUNNING  ]     block size: %8llu, using: %6llu, cached: %6llu, alloc: %10llu, hit: %10llu\n",
+               static_cast<unsigned long long>(stats[i].block_size), static_cast<unsigned long long>(stats[i].using_number),
+               static_cast<unsigned long long>(stats[i].cached_number), static_cast<unsigned long long>(stats[i].alloc_times),
+               static_cast<unsigned long long>(stats[i].hit_times));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: %s <max unit size> [queue depth] [loop times] [static buffer size]\n", argv[0]);
+        return 0;
+    }
+
+    conf.max_n = (size_t)strtol(argv[1], NULL, 10);
+    if (conf.max_n < 8) {
+        conf.max_n = 8;
+    }
+
+    if (argc > 2)
+        conf.queue_depth = (size_t)strtol(argv[2], NULL, 10);
+    else
+        conf.queue_depth = 64;
+
+    if (conf.queue_depth <= 0) {
+        conf.queue_depth = 1;
+    }
+
+    if (argc > 3)
+        conf.loop_times = (size_t)strtol(argv[3], NULL, 10);
+    else
+        conf.loop_times = 10000000;
+
+    if (argc > 4)
+        conf.static_size = (size_t)strtol(argv[4], NULL, 10);
+    else
+        conf.static_size = 2 * conf.queue_depth * atbus::detail::buffer_block::full_size(conf.max_n);
+
+    // 预先生成随机长度，避免随机数影响测试结果
+    srand(static_cast<unsigned>(time(NULL)));
+    conf.sizes.resize(65536);
+    for (size_t i = 0; i < conf.sizes.size(); ++i) {
+        conf.sizes[i] = 8 + static_cast<size_t>(rand()) % (conf.max_n - 7);
+    }
+
+    printf("[ RUNNING  ] unit size: 8-%llu, queue depth: %llu, loop times: %llu, static buffer size: %llu\n",
+           static_cast<unsigned long long>(conf.max_n), static_cast<unsigned long long>(conf.queue_depth),
+           static_cast<unsigned long long>(conf.loop_times), static_cast<unsigned long long>(conf.static_size));
+
+    run_ptmalloc();
+    run_buffer_block();
+
+    {
+        atbus::detail::buffer_manager mgr;
+        run_buffer_manager("buffer_manager(dynamic)", mgr);
+    }
+
+    {
+        atbus::detail::buffer_manager mgr;
+        mgr.set_mode(conf.static_size, conf.queue_depth);
+        run_buffer_manager("buffer_manager(static ring)", mgr);
+    }
+
+    show_allocator_stats();
+    atbus::detail::buffer_block::shrink_allocator();
+    return 0;
+}
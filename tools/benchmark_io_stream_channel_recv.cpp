@@ -107,7 +107,7 @@ static void closed_callback(EXPLICIT_UNUSED_ATTR atbus::channel::io_stream_chann
     assert(connection);
 
     // 除listen外的最后一个连接
-    if (channel->conn_pool.size() <= 2) uv_stop(channel->ev_loop);
+    if (atbus::channel::io_stream_get_connection_number(channel) <= 2) uv_stop(channel->ev_loop);
 }
 
 int main(int argc, char *argv[]) {